@@ -0,0 +1,182 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// arc_replacer.cpp
+//
+// Identification: src/buffer/arc_replacer.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/arc_replacer.h"
+
+#include <algorithm>
+
+namespace bustub {
+
+ArcReplacer::ArcReplacer(size_t num_frames) : replacer_size_(num_frames), frames_(num_frames) {}
+
+auto ArcReplacer::Evict(frame_id_t *frame_id) -> bool {
+  std::scoped_lock<std::mutex> lock(latch_);
+  if (curr_size_ == 0) {
+    return false;
+  }
+  // list 中只有 evictable frame。先淘汰 scan frame；REPLACE：T1 超过目标大小 p 时淘汰 T1 的 LRU，否则淘汰 T2 的 LRU，
+  // 为空时再试另一个
+  std::list<frame_id_t> *list = &scan_;
+  if (list->empty()) {
+    bool t1_first = SizeOf(List::T1) > p_;
+    list = (t1_first ? !t1_.empty() : t2_.empty()) ? &t1_ : &t2_;
+  }
+  BUSTUB_ASSERT(!list->empty(), "curr_size_ is positive but no evictable frame was found");
+  *frame_id = list->front();
+  list->pop_front();
+  auto &frame = frames_[*frame_id];
+  list_size_[static_cast<size_t>(frame.list_)]--;
+  if (frame.page_id_ != INVALID_PAGE_ID && frame.list_ == List::T1) {
+    b1_.PushBack(frame.page_id_);
+  } else if (frame.page_id_ != INVALID_PAGE_ID && frame.list_ == List::T2) {
+    b2_.PushBack(frame.page_id_);
+  }
+  frame = FrameState{};
+  TrimGhosts();
+  curr_size_--;
+  return true;
+}
+
+void ArcReplacer::RecordAccess(frame_id_t frame_id, AccessType access_type) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < replacer_size_, "invalid frame id");
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto &frame = frames_[frame_id];
+  if (access_type == AccessType::Lookup || access_type == AccessType::Index) {
+    frame.hot_ = true;
+  }
+  if (frame.list_ != List::None) {
+    if (frame.list_ == List::Scan) {
+      // 只有 Lookup / Index 访问才能让 scan frame 重新参与 ARC
+      if (frame.hot_) {
+        MoveTo(frame_id, List::T1);
+      }
+    } else if (access_type == AccessType::Scan) {
+      if (!frame.hot_) {
+        MoveTo(frame_id, List::Scan);
+      }
+    } else {
+      // 命中 T1 或 T2，移到 T2 的 MRU 端
+      MoveTo(frame_id, List::T2);
+    }
+    return;
+  }
+  // insert 新的，命中 ghost list 时调整 p_
+  if (access_type == AccessType::Scan) {
+    frame.list_ = List::Scan;
+  } else if (frame.page_id_ != INVALID_PAGE_ID && b1_.map_.count(frame.page_id_) > 0) {
+    p_ = std::min(replacer_size_, p_ + std::max<size_t>(1, b2_.Size() / b1_.Size()));
+    b1_.Erase(frame.page_id_);
+    frame.list_ = List::T2;
+  } else if (frame.page_id_ != INVALID_PAGE_ID && b2_.map_.count(frame.page_id_) > 0) {
+    auto delta = std::max<size_t>(1, b1_.Size() / b2_.Size());
+    p_ = p_ > delta ? p_ - delta : 0;
+    b2_.Erase(frame.page_id_);
+    frame.list_ = List::T2;
+  } else {
+    frame.list_ = List::T1;
+  }
+  auto &to = ListOf(frame.list_);
+  frame.iter_ = to.insert(to.end(), frame_id);
+  list_size_[static_cast<size_t>(frame.list_)]++;
+  frame.evictable_ = true;
+  TrimGhosts();
+  curr_size_++;
+}
+
+void ArcReplacer::SetEvictable(frame_id_t frame_id, bool set_evictable) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < replacer_size_, "invalid frame id");
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto &frame = frames_[frame_id];
+  if (frame.list_ == List::None || frame.evictable_ == set_evictable) {
+    return;
+  }
+  frame.evictable_ = set_evictable;
+  // pin 住的 frame 不在 list 中，unpin 时放回所在 list 的 MRU 端
+  auto &list = ListOf(frame.list_);
+  if (set_evictable) {
+    frame.iter_ = list.insert(list.end(), frame_id);
+    curr_size_++;
+  } else {
+    list.erase(frame.iter_);
+    curr_size_--;
+  }
+}
+
+void ArcReplacer::Remove(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < replacer_size_, "invalid frame id");
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto &frame = frames_[frame_id];
+  // 不存在
+  if (frame.list_ == List::None || !frame.evictable_) {
+    return;
+  }
+  ListOf(frame.list_).erase(frame.iter_);
+  list_size_[static_cast<size_t>(frame.list_)]--;
+  frame = FrameState{};
+  curr_size_--;
+}
+
+auto ArcReplacer::Size() -> size_t { return curr_size_; }
+
+void ArcReplacer::BindPage(frame_id_t frame_id, page_id_t page_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < replacer_size_, "invalid frame id");
+  std::scoped_lock<std::mutex> lock(latch_);
+  frames_[frame_id].page_id_ = page_id;
+}
+
+void ArcReplacer::MoveTo(frame_id_t frame_id, List list) {
+  auto &frame = frames_[frame_id];
+  if (frame.evictable_) {
+    auto &to = ListOf(list);
+    to.splice(to.end(), ListOf(frame.list_), frame.iter_);
+  }
+  list_size_[static_cast<size_t>(frame.list_)]--;
+  list_size_[static_cast<size_t>(list)]++;
+  frame.list_ = list;
+}
+
+void ArcReplacer::TrimGhosts() {
+  while (b1_.Size() > 0 && SizeOf(List::T1) + b1_.Size() > replacer_size_) {
+    b1_.PopFront();
+  }
+  while (SizeOf(List::T1) + SizeOf(List::T2) + b1_.Size() + b2_.Size() > 2 * replacer_size_) {
+    if (b2_.Size() > 0) {
+      b2_.PopFront();
+    } else if (b1_.Size() > 0) {
+      b1_.PopFront();
+    } else {
+      break;
+    }
+  }
+}
+
+auto ArcReplacer::GhostList::Erase(page_id_t page_id) -> bool {
+  auto iter = map_.find(page_id);
+  if (iter == map_.end()) {
+    return false;
+  }
+  pages_.erase(iter->second);
+  map_.erase(iter);
+  return true;
+}
+
+void ArcReplacer::GhostList::PushBack(page_id_t page_id) {
+  Erase(page_id);
+  map_[page_id] = pages_.insert(pages_.end(), page_id);
+}
+
+void ArcReplacer::GhostList::PopFront() {
+  map_.erase(pages_.front());
+  pages_.pop_front();
+}
+
+}  // namespace bustub
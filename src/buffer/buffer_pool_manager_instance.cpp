@@ -12,22 +12,47 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/buffer_pool_manager_instance.h"
+#include <algorithm>
+#include <chrono>  // NOLINT
 #include <cstddef>
+#include <cstring>
+#include <exception>
 #include <memory>
 #include "common/config.h"
 #include "common/exception.h"
 #include "common/logger.h"
 #include "common/macros.h"
+#include "common/profile_counters.h"
 
 namespace bustub {
 
 BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager, size_t replacer_k,
-                                                     LogManager *log_manager)
-    : pool_size_(pool_size), disk_manager_(disk_manager), log_manager_(log_manager) {
+                                                     LogManager *log_manager, ReplacerType replacer_type)
+    : BufferPoolManagerInstance(pool_size, 1, 0, disk_manager, replacer_k, log_manager, replacer_type) {}
+
+BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, uint32_t num_instances, uint32_t instance_index,
+                                                     DiskManager *disk_manager, size_t replacer_k,
+                                                     LogManager *log_manager, ReplacerType replacer_type)
+    : pool_size_(pool_size),
+      num_instances_(num_instances),
+      instance_index_(instance_index),
+      next_page_id_(static_cast<page_id_t>(instance_index)),
+      disk_manager_(disk_manager),
+      disk_scheduler_(std::make_unique<DiskScheduler>(disk_manager)),
+      log_manager_(log_manager),
+      max_prefetch_queue_size_(std::max<size_t>(1, pool_size / 4)) {
+  BUSTUB_ASSERT(num_instances > 0, "If BPI is not part of a pool, then the pool size should just be 1");
+  BUSTUB_ASSERT(
+      instance_index < num_instances,
+      "BPI index cannot be greater than the number of BPIs in the pool. In non-parallel case, index should just be 0.");
   // we allocate a consecutive memory space for the buffer pool
-  pages_ = new Page[pool_size_];
-  page_table_ = new ExtendibleHashTable<page_id_t, frame_id_t>(bucket_size_);
-  replacer_ = new LRUKReplacer(pool_size, replacer_k);
+  // parallel BPM 的各个 instance 轮流放在各个 NUMA node 上
+  frame_arena_ = std::make_unique<FrameArena>(
+      pool_size_, num_instances_ > 1 ? static_cast<int>(instance_index_) % FrameArena::NumNumaNodes() : -1);
+  pages_ = frame_arena_->GetFrames();
+  frame_io_ = new FrameIoState[pool_size_];
+  page_table_ = new StripedHashTable<page_id_t, frame_id_t>(pool_size_);
+  replacer_ = CreateReplacer(replacer_type, pool_size, replacer_k);
 
   // Initially, every page is in the free list.
   for (size_t i = 0; i < pool_size_; ++i) {
@@ -37,118 +62,239 @@ BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, DiskManag
   // throw NotImplementedException(
   //     "BufferPoolManager is not implemented yet. If you have finished implementing BPM, please remove the throw "
   //     "exception line in `buffer_pool_manager_instance.cpp`.");
+  StartBackgroundFlusher(pool_size_ * FLUSHER_HIGH_WATER_PERCENT / 100);
 }
 
 BufferPoolManagerInstance::~BufferPoolManagerInstance() {
-  delete[] pages_;
+  {
+    std::scoped_lock<std::mutex> lock(prefetch_latch_);
+    prefetch_stop_ = true;
+  }
+  prefetch_cv_.notify_one();
+  if (prefetch_thread_.joinable()) {
+    prefetch_thread_.join();
+  }
+  StopBackgroundFlusher();
+  delete[] frame_io_;
   delete page_table_;
   delete replacer_;
 }
 
 auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
-  std::scoped_lock<std::mutex> lock(latch_);
+  std::unique_lock<std::mutex> lock(latch_, std::defer_lock);
+  LockLatch(&lock);
   // LOG_DEBUG("NewPgImp func");
-  // free frame
-  if (!free_list_.empty()) {
-    auto frame_id = free_list_.back();
-    free_list_.pop_back();
-    auto new_page_id = AllocatePage();
-    auto page_ptr = &pages_[frame_id];
-    replacer_->RecordAccess(frame_id);
-    replacer_->SetEvictable(frame_id, false);
-    page_table_->Insert(new_page_id, frame_id);
-    InitPage(page_ptr);
-    page_ptr->page_id_ = new_page_id;
-    page_ptr->pin_count_ = 1;
-    *page_id = new_page_id;
-    // LOG_DEBUG("page id: %d\tframe id: %d", new_page_id, frame_id);
-    // LOG_DEBUG("==================================================================");
-    return page_ptr;
-  }
-  // replacer 中 evit 一个 frame
   frame_id_t frame_id = -1;
-  if (!replacer_->Evict(&frame_id)) {
+  page_id_t old_page_id = INVALID_PAGE_ID;
+  bool old_dirty = false;
+  if (!AcquireFrame(&frame_id, &old_page_id, &old_dirty)) {
     // LOG_DEBUG("there is no evictable frame");
     // LOG_DEBUG("==================================================================");
     return nullptr;
   }
-  auto page_ptr = &pages_[frame_id];
   auto new_page_id = AllocatePage();
-  size_t old_page_id = page_ptr->page_id_;
-  replacer_->RecordAccess(frame_id);
-  replacer_->SetEvictable(frame_id, false);
-  page_table_->Remove(old_page_id);
-  page_table_->Insert(new_page_id, frame_id);
-  // 写 dirty page
-  if (page_ptr->is_dirty_) {
-    disk_manager_->WritePage(old_page_id, page_ptr->data_);
+  InstallPage(frame_id, new_page_id, AccessType::Unknown);
+  auto page_ptr = &pages_[frame_id];
+  // 写 dirty page，写盘期间释放 latch_
+  if (old_dirty) {
+    WaitForFlush(&lock, old_page_id);
+    lock.unlock();
+    try {
+      disk_scheduler_->ScheduleWrite(old_page_id, page_ptr->data_).get();
+    } catch (...) {
+      LockLatch(&lock);
+      AbortLoad(frame_id, new_page_id, old_page_id, true);
+      throw;
+    }
+    page_ptr->ResetMemory();
+    LockLatch(&lock);
+  } else {
+    page_ptr->ResetMemory();
   }
-  InitPage(page_ptr);
-  page_ptr->page_id_ = new_page_id;
-  page_ptr->pin_count_ = 1;
+  FinishIo(frame_id, old_page_id);
+  stats_.new_pages_.fetch_add(1, std::memory_order_relaxed);
   *page_id = new_page_id;
   // LOG_DEBUG("page id: %d\tframe id: %d", new_page_id, frame_id);
   // LOG_DEBUG("==================================================================");
   return page_ptr;
 }
 
-auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) -> Page * {
+auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id, AccessType access_type) -> Page * {
+  return PinPage(page_id, access_type, false);
+}
+
+auto BufferPoolManagerInstance::PinPage(page_id_t page_id, AccessType access_type, bool is_prefetch) -> Page * {
   // LOG_DEBUG("FetchPgImp func: page id is %d", page_id);
   if (page_id == INVALID_PAGE_ID) {
     return nullptr;
   }
-  std::scoped_lock<std::mutex> lock(latch_);
-  // page_id is valid
-  frame_id_t frame_id = -1;
-  // 二次判断
-  if (page_table_->Find(page_id, frame_id)) {
-    replacer_->RecordAccess(frame_id);
-    replacer_->SetEvictable(frame_id, false);
-    pages_[frame_id].pin_count_++;
-    // LOG_DEBUG("==================================================================");
-    return &pages_[frame_id];
-  }
-  // free frame
-  if (!free_list_.empty()) {
-    auto frame_id = free_list_.back();
-    free_list_.pop_back();
-    auto page_ptr = &pages_[frame_id];
-    replacer_->RecordAccess(frame_id);
-    replacer_->SetEvictable(frame_id, false);
-    page_table_->Insert(page_id, frame_id);
-    InitPage(page_ptr);
-    // read from disk
-    disk_manager_->ReadPage(page_id, page_ptr->data_);
-    page_ptr->page_id_ = page_id;
-    page_ptr->pin_count_++;
-    // LOG_DEBUG("page id: %d\tframe id: %d", page_ptr->page_id_, frame_id);
+  ValidatePageId(page_id);
+  std::unique_lock<std::mutex> lock(latch_, std::defer_lock);
+  LockLatch(&lock);
+  PendingLoad load;
+  auto page_ptr = BeginLoad(&lock, page_id, access_type, is_prefetch, &load);
+  if (page_ptr != nullptr || load.frame_id_ == -1) {
     // LOG_DEBUG("==================================================================");
     return page_ptr;
   }
-  // replacer 中 evit 一个 frame
-  if (!replacer_->Evict(&frame_id)) {
+  std::vector<PendingLoad> loads{load};
+  CompleteLoads(&lock, &loads);
+  // LOG_DEBUG("page id: %d\tframe id: %d", page_id, load.frame_id_);
+  // LOG_DEBUG("==================================================================");
+  return &pages_[load.frame_id_];
+}
+
+auto BufferPoolManagerInstance::BeginLoad(std::unique_lock<std::mutex> *lock, page_id_t page_id,
+                                          AccessType access_type, bool is_prefetch, PendingLoad *load) -> Page * {
+  const auto access_index = static_cast<size_t>(access_type);
+  load->frame_id_ = -1;
+  frame_id_t frame_id = -1;
+  while (true) {
+    if (page_table_->Find(page_id, frame_id)) {
+      // 正在被读入的 page 不需要 prefetch；读入失败时 pin 无法按 page id 放掉
+      if (is_prefetch && frame_io_[frame_id].io_pending_) {
+        return nullptr;
+      }
+      replacer_->RecordAccess(frame_id, access_type);
+      replacer_->SetEvictable(frame_id, false);
+      pages_[frame_id].pin_count_++;
+      if (!is_prefetch) {
+        stats_.hits_[access_index].fetch_add(1, std::memory_order_relaxed);
+        ThreadProfileCounters::Get().bpm_hits_++;
+        // 别的线程正在把该 page 读进来，只在这个 frame 上等待
+        WaitForIo(lock, frame_id);
+        if (pages_[frame_id].page_id_ != page_id) {
+          // 读入失败，frame 已经不属于该 page，放掉 pin 之后重新读
+          ReleasePin(frame_id);
+          continue;
+        }
+      }
+      return &pages_[frame_id];
+    }
+    // 后台线程正在写回该 page 的旧副本，写完之后再从磁盘读
+    if (flushing_pages_.count(page_id) > 0) {
+      WaitForFlush(lock, page_id);
+      continue;
+    }
+    // 该 page 刚被换出，还没写回磁盘，等写完之后再从磁盘读
+    auto iter = evicting_pages_.find(page_id);
+    if (iter == evicting_pages_.end()) {
+      break;
+    }
+    auto evicting_frame_id = iter->second;
+    frame_io_[evicting_frame_id].cv_.wait(*lock, [&] {
+      auto it = evicting_pages_.find(page_id);
+      return it == evicting_pages_.end() || it->second != evicting_frame_id;
+    });
+  }
+  page_id_t old_page_id = INVALID_PAGE_ID;
+  bool old_dirty = false;
+  if (!AcquireFrame(&frame_id, &old_page_id, &old_dirty)) {
     // LOG_DEBUG("there is no evictable frame");
-    // LOG_DEBUG("==================================================================");
     return nullptr;
   }
+  InstallPage(frame_id, page_id, access_type);
+  if (is_prefetch) {
+    stats_.prefetches_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    stats_.misses_[access_index].fetch_add(1, std::memory_order_relaxed);
+    ThreadProfileCounters::Get().bpm_misses_++;
+  }
+  if (old_dirty) {
+    WaitForFlush(lock, old_page_id);
+  }
+  *load = {frame_id, page_id, old_page_id, old_dirty};
+  return nullptr;
+}
+
+void BufferPoolManagerInstance::CompleteLoads(std::unique_lock<std::mutex> *lock, std::vector<PendingLoad> *loads) {
+  // frame 已经被 pin 住并标记为 io pending，读写磁盘期间释放 latch_
+  lock->unlock();
+  std::exception_ptr error;
+  std::vector<DiskRequest> requests;
+  std::vector<PendingLoad *> owners;
+  // 一起提交一批请求并等待全部完成，记录失败的 load
+  auto run = [&](bool is_write) {
+    auto futures = disk_scheduler_->Schedule(&requests);
+    for (size_t i = 0; i < futures.size(); i++) {
+      try {
+        futures[i].get();
+      } catch (...) {
+        owners[i]->failed_ = true;
+        owners[i]->old_kept_ = is_write;
+        if (error == nullptr) {
+          error = std::current_exception();
+        }
+      }
+    }
+    requests.clear();
+    owners.clear();
+  };
+  // dirty 的旧 page 先直接从 frame 写回，写到磁盘之后 frame 才能被新 page 覆盖
+  for (auto &load : *loads) {
+    if (load.old_dirty_) {
+      requests.push_back({true, pages_[load.frame_id_].data_, load.old_page_id_, {}});
+      owners.emplace_back(&load);
+    }
+  }
+  if (!requests.empty()) {
+    run(true);
+  }
+  for (auto &load : *loads) {
+    if (!load.failed_) {
+      pages_[load.frame_id_].ResetMemory();
+      requests.push_back({false, pages_[load.frame_id_].data_, load.page_id_, {}});
+      owners.emplace_back(&load);
+    }
+  }
+  if (!requests.empty()) {
+    run(false);
+  }
+  LockLatch(lock);
+  for (const auto &load : *loads) {
+    if (load.failed_) {
+      AbortLoad(load.frame_id_, load.page_id_, load.old_page_id_, load.old_kept_);
+    } else {
+      FinishIo(load.frame_id_, load.old_page_id_);
+    }
+  }
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+}
+
+void BufferPoolManagerInstance::AbortLoad(frame_id_t frame_id, page_id_t page_id, page_id_t old_page_id,
+                                          bool old_kept) {
   auto page_ptr = &pages_[frame_id];
-  replacer_->RecordAccess(frame_id);
-  replacer_->SetEvictable(frame_id, false);
-  size_t old_page_id = page_ptr->page_id_;
-  page_table_->Remove(old_page_id);
-  page_table_->Insert(page_id, frame_id);
-  // 写 dirty page
-  if (page_ptr->is_dirty_) {
-    disk_manager_->WritePage(page_ptr->page_id_, page_ptr->data_);
+  page_table_->Remove(page_id);
+  if (old_kept) {
+    // 旧 page 没有写到磁盘，frame 中仍是它的数据，放回 page table，仍然是 dirty
+    replacer_->BindPage(frame_id, old_page_id);
+    page_table_->Insert(old_page_id, frame_id);
+    page_ptr->page_id_ = old_page_id;
+    page_ptr->is_dirty_ = true;
+    num_dirty_++;
+  } else {
+    page_ptr->page_id_ = INVALID_PAGE_ID;
+    page_ptr->is_dirty_ = false;
+  }
+  // 等待新 page 的线程醒来后发现 page id 不同，放掉自己的 pin 重新读
+  FinishIo(frame_id, old_page_id);
+  ReleasePin(frame_id);
+}
+
+void BufferPoolManagerInstance::ReleasePin(frame_id_t frame_id) {
+  auto page_ptr = &pages_[frame_id];
+  if (--page_ptr->pin_count_ > 0) {
+    return;
+  }
+  replacer_->SetEvictable(frame_id, true);
+  // 最后一个 pin 放掉之后，没有 page 的 frame 回到 free list
+  if (page_ptr->page_id_ == INVALID_PAGE_ID) {
+    replacer_->Remove(frame_id);
+    InitPage(page_ptr);
+    free_list_.emplace_back(frame_id);
   }
-  InitPage(page_ptr);
-  // read from disk
-  disk_manager_->ReadPage(page_id, page_ptr->data_);
-  page_ptr->page_id_ = page_id;
-  page_ptr->pin_count_ = 1;
-  // LOG_DEBUG("page id: %d\tframe id: %d", page_ptr->page_id_, frame_id);
-  // LOG_DEBUG("==================================================================");
-  return page_ptr;
 }
 
 auto BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) -> bool {
@@ -156,7 +302,8 @@ auto BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) ->
   if (page_id == INVALID_PAGE_ID) {
     return false;
   }
-  std::scoped_lock<std::mutex> lock(latch_);
+  std::unique_lock<std::mutex> lock(latch_, std::defer_lock);
+  LockLatch(&lock);
   frame_id_t frame_id = -1;
   if (!page_table_->Find(page_id, frame_id)) {
     // LOG_DEBUG("there is no evictable page with %d id", page_id);
@@ -173,7 +320,15 @@ auto BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) ->
   if (page_ptr->pin_count_ == 0) {
     replacer_->SetEvictable(frame_id, true);
   }
-  page_ptr->is_dirty_ = page_ptr->is_dirty_ || is_dirty;
+  if (is_dirty && !page_ptr->is_dirty_) {
+    page_ptr->is_dirty_ = true;
+    num_dirty_++;
+    // 超过 high-water mark，唤醒后台线程
+    if (num_dirty_ >= dirty_high_water_mark_ && !flusher_wakeup_) {
+      flusher_wakeup_ = true;
+      flusher_cv_.notify_one();
+    }
+  }
   // LOG_DEBUG("the page's is_dirty is %d", page_ptr->is_dirty_);
   // LOG_DEBUG("==================================================================");
   return true;
@@ -184,30 +339,286 @@ auto BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) -> bool {
   if (page_id == INVALID_PAGE_ID) {
     return false;
   }
-  std::scoped_lock<std::mutex> lock(latch_);
+  std::unique_lock<std::mutex> lock(latch_, std::defer_lock);
+  LockLatch(&lock);
   frame_id_t frame_id = -1;
   if (!page_table_->Find(page_id, frame_id)) {
     // LOG_DEBUG("there is no evictable page with %d id", page_id);
     // LOG_DEBUG("==================================================================");
     return false;
   }
-  auto page_ptr = &pages_[frame_id];
-  disk_manager_->WritePage(page_ptr->page_id_, page_ptr->data_);
-  page_ptr->is_dirty_ = false;
+  // 还没从磁盘读完的 page 不能写回
+  WaitForIo(&lock, frame_id);
+  if (pages_[frame_id].page_id_ != page_id) {
+    return false;
+  }
+  // 与后台线程相同：持有 latch_ 时复制出来，写盘期间释放 latch_，之后再修改的 page 会重新变 dirty
+  std::vector<std::pair<page_id_t, frame_id_t>> pages{{page_id, frame_id}};
+  WriteBack(&lock, pages.begin(), pages.end());
   // LOG_DEBUG("page with %d id has been flushed successfully", page_id);
   // LOG_DEBUG("==================================================================");
   return true;
 }
 
 void BufferPoolManagerInstance::FlushAllPgsImp() {
-  // std::scoped_lock<std::shared_mutex> rlock(rwlatch_);
   // LOG_DEBUG("FlushAllPgsImp func");
-  for (size_t i = 0; i < pool_size_; i++) {
-    FlushPgImp(pages_[i].page_id_);
+  std::unique_lock<std::mutex> lock(latch_, std::defer_lock);
+  LockLatch(&lock);
+  // 按 page id 顺序分批写回，每批只拿一次 latch_
+  auto candidates = CollectFlushCandidates();
+  for (size_t begin = 0; begin < candidates.size(); begin += FLUSH_BATCH_SIZE) {
+    auto end = std::min(candidates.size(), begin + FLUSH_BATCH_SIZE);
+    WriteBack(&lock, candidates.begin() + begin, candidates.begin() + end);
   }
   // LOG_DEBUG("==================================================================");
 }
 
+void BufferPoolManagerInstance::PrefetchPgsImp(page_id_t first_page_id, size_t count) {
+  if (first_page_id == INVALID_PAGE_ID) {
+    return;
+  }
+  // 还没有分配的 page 不能读，否则之后 NewPage 分配到同一个 page id 时 page table 中会有两份
+  const page_id_t next_page_id = next_page_id_;
+  std::unique_lock<std::mutex> lock(prefetch_latch_);
+  if (prefetch_stop_) {
+    return;
+  }
+  bool queued = false;
+  for (size_t i = 0; i < count; i++) {
+    auto page_id = static_cast<page_id_t>(first_page_id + i);
+    if (page_id < 0 || page_id >= next_page_id || static_cast<uint32_t>(page_id) % num_instances_ != instance_index_) {
+      continue;
+    }
+    if (prefetch_queue_.size() >= max_prefetch_queue_size_) {
+      break;
+    }
+    if (prefetch_pending_.insert(page_id).second) {
+      prefetch_queue_.emplace_back(page_id);
+      queued = true;
+    }
+  }
+  if (!queued) {
+    return;
+  }
+  if (!prefetch_thread_.joinable()) {
+    prefetch_thread_ = std::thread([this] { BackgroundPrefetch(); });
+  }
+  lock.unlock();
+  prefetch_cv_.notify_one();
+}
+
+void BufferPoolManagerInstance::BackgroundPrefetch() {
+  std::unique_lock<std::mutex> lock(prefetch_latch_);
+  std::vector<page_id_t> page_ids;
+  while (true) {
+    prefetch_cv_.wait(lock, [&] { return prefetch_stop_ || !prefetch_queue_.empty(); });
+    if (prefetch_stop_) {
+      return;
+    }
+    // 一次取出一批 page，它们的读取一起提交
+    while (!prefetch_queue_.empty() && page_ids.size() < PREFETCH_BATCH_SIZE) {
+      auto page_id = prefetch_queue_.front();
+      prefetch_queue_.pop_front();
+      prefetch_pending_.erase(page_id);
+      page_ids.emplace_back(page_id);
+    }
+    lock.unlock();
+    PrefetchBatch(page_ids);
+    page_ids.clear();
+    lock.lock();
+  }
+}
+
+void BufferPoolManagerInstance::PrefetchBatch(const std::vector<page_id_t> &page_ids) {
+  // 走正常的 miss 流程，读盘期间不持有 latch_，读完立即 unpin
+  std::vector<page_id_t> pinned;
+  std::vector<PendingLoad> loads;
+  {
+    std::unique_lock<std::mutex> lock(latch_, std::defer_lock);
+    LockLatch(&lock);
+    for (auto page_id : page_ids) {
+      // 这一批刚换出的 dirty page 要等这一批的 I/O 完成才能再读，跳过它
+      if (!loads.empty() && evicting_pages_.count(page_id) > 0) {
+        continue;
+      }
+      PendingLoad load;
+      if (BeginLoad(&lock, page_id, AccessType::Scan, true, &load) != nullptr) {
+        pinned.emplace_back(page_id);
+      } else if (load.frame_id_ != -1) {
+        loads.emplace_back(load);
+      }
+    }
+    if (!loads.empty()) {
+      // prefetch 只是提示，读失败的 page 已经由 CompleteLoads 放掉，之后的 fetch 会再读一次
+      try {
+        CompleteLoads(&lock, &loads);
+      } catch (const std::exception &e) {
+        LOG_WARN("prefetch failed: %s", e.what());
+      }
+    }
+  }
+  for (const auto &load : loads) {
+    if (!load.failed_) {
+      pinned.emplace_back(load.page_id_);
+    }
+  }
+  for (auto page_id : pinned) {
+    UnpinPgImp(page_id, false);
+  }
+}
+
+void BufferPoolManagerInstance::StartBackgroundFlusher(size_t dirty_high_water_mark,
+                                                       std::chrono::milliseconds interval) {
+  std::scoped_lock<std::mutex> lock(latch_);
+  dirty_high_water_mark_ = std::max<size_t>(1, dirty_high_water_mark);
+  flusher_interval_ = interval;
+  if (flusher_thread_.joinable()) {
+    // 已经在运行，新的 interval 从下一轮开始生效
+    if (num_dirty_ >= dirty_high_water_mark_ && !flusher_wakeup_) {
+      flusher_wakeup_ = true;
+      flusher_cv_.notify_one();
+    }
+    return;
+  }
+  flusher_stop_ = false;
+  flusher_thread_ = std::thread([this] { BackgroundFlush(); });
+}
+
+void BufferPoolManagerInstance::StopBackgroundFlusher() {
+  {
+    std::scoped_lock<std::mutex> lock(latch_);
+    if (!flusher_thread_.joinable()) {
+      return;
+    }
+    flusher_stop_ = true;
+    // 不再需要唤醒后台线程
+    dirty_high_water_mark_ = std::numeric_limits<size_t>::max();
+    flusher_wakeup_ = false;
+  }
+  flusher_cv_.notify_one();
+  flusher_thread_.join();
+}
+
+void BufferPoolManagerInstance::BackgroundFlush() {
+  std::unique_lock<std::mutex> lock(latch_);
+  while (!flusher_stop_) {
+    // 每 flusher_interval_ 清理一次，dirty page 超过 high-water mark 时提前清理
+    flusher_cv_.wait_for(lock, flusher_interval_, [&] { return flusher_stop_ || flusher_wakeup_; });
+    flusher_wakeup_ = false;
+    // 每一轮把所有 frame 扫一遍，每批从上一批停下的 frame 继续扫
+    size_t scanned = 0;
+    while (!flusher_stop_ && num_dirty_ > 0 && scanned < pool_size_) {
+      auto candidates = NextFlushBatch(&scanned);
+      if (candidates.empty()) {
+        continue;
+      }
+      // 异常不能离开后台线程，否则 std::terminate；写失败的 page 仍是 dirty，下一轮再写
+      try {
+        WriteBack(&lock, candidates.begin(), candidates.end());
+      } catch (const std::exception &e) {
+        LOG_ERROR("background flush failed: %s", e.what());
+        break;
+      } catch (...) {
+        LOG_ERROR("background flush failed");
+        break;
+      }
+    }
+  }
+}
+
+auto BufferPoolManagerInstance::NextFlushBatch(size_t *scanned) -> std::vector<std::pair<page_id_t, frame_id_t>> {
+  std::vector<std::pair<page_id_t, frame_id_t>> candidates;
+  for (; *scanned < pool_size_ && candidates.size() < FLUSH_BATCH_SIZE; (*scanned)++) {
+    auto i = flush_cursor_;
+    flush_cursor_ = (flush_cursor_ + 1) % pool_size_;
+    const auto &page = pages_[i];
+    if (page.page_id_ == INVALID_PAGE_ID || !page.is_dirty_ || page.pin_count_ > 0 || frame_io_[i].io_pending_ ||
+        flushing_pages_.count(page.page_id_) > 0) {
+      continue;
+    }
+    candidates.emplace_back(page.page_id_, static_cast<frame_id_t>(i));
+  }
+  std::sort(candidates.begin(), candidates.end());
+  return candidates;
+}
+
+auto BufferPoolManagerInstance::CollectFlushCandidates() -> std::vector<std::pair<page_id_t, frame_id_t>> {
+  std::vector<std::pair<page_id_t, frame_id_t>> candidates;
+  for (size_t i = 0; i < pool_size_; i++) {
+    const auto &page = pages_[i];
+    if (page.page_id_ == INVALID_PAGE_ID || frame_io_[i].io_pending_ || flushing_pages_.count(page.page_id_) > 0) {
+      continue;
+    }
+    candidates.emplace_back(page.page_id_, static_cast<frame_id_t>(i));
+  }
+  std::sort(candidates.begin(), candidates.end());
+  return candidates;
+}
+
+void BufferPoolManagerInstance::WriteBack(std::unique_lock<std::mutex> *lock,
+                                          std::vector<std::pair<page_id_t, frame_id_t>>::const_iterator begin,
+                                          std::vector<std::pair<page_id_t, frame_id_t>>::const_iterator end) {
+  // 持有 latch_ 时把 page 复制出来并清掉 dirty 位，之后再修改的 page 会重新变 dirty
+  std::vector<page_id_t> page_ids;
+  std::vector<char> buffer(static_cast<size_t>(end - begin) * BUSTUB_PAGE_SIZE);
+  for (auto iter = begin; iter != end; ++iter) {
+    auto [page_id, frame_id] = *iter;
+    WaitForFlush(lock, page_id);
+    auto &page = pages_[frame_id];
+    if (page.page_id_ != page_id || frame_io_[frame_id].io_pending_) {
+      continue;
+    }
+    memcpy(buffer.data() + page_ids.size() * BUSTUB_PAGE_SIZE, page.data_, BUSTUB_PAGE_SIZE);
+    if (page.is_dirty_) {
+      page.is_dirty_ = false;
+      num_dirty_--;
+    }
+    flushing_pages_.insert(page_id);
+    page_ids.emplace_back(page_id);
+  }
+  lock->unlock();
+  // 整批一起提交，相邻的 page 由 I/O 线程按 page id 顺序写
+  std::vector<DiskRequest> requests;
+  requests.reserve(page_ids.size());
+  for (size_t i = 0; i < page_ids.size(); i++) {
+    requests.push_back({true, buffer.data() + i * BUSTUB_PAGE_SIZE, page_ids[i], {}});
+  }
+  std::exception_ptr error;
+  std::vector<page_id_t> failed;
+  auto futures = disk_scheduler_->Schedule(&requests);
+  for (size_t i = 0; i < futures.size(); i++) {
+    try {
+      futures[i].get();
+    } catch (...) {
+      failed.emplace_back(page_ids[i]);
+      if (error == nullptr) {
+        error = std::current_exception();
+      }
+    }
+  }
+  stats_.flushes_.fetch_add(page_ids.size() - failed.size(), std::memory_order_relaxed);
+  lock->lock();
+  for (auto page_id : page_ids) {
+    flushing_pages_.erase(page_id);
+  }
+  // 没有写成功的 page 如果还在 buffer pool 中，重新标记为 dirty
+  for (auto page_id : failed) {
+    frame_id_t frame_id = -1;
+    if (page_table_->Find(page_id, frame_id) && pages_[frame_id].page_id_ == page_id && !pages_[frame_id].is_dirty_) {
+      pages_[frame_id].is_dirty_ = true;
+      num_dirty_++;
+    }
+  }
+  flush_cv_.notify_all();
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+}
+
+void BufferPoolManagerInstance::WaitForFlush(std::unique_lock<std::mutex> *lock, page_id_t page_id) {
+  flush_cv_.wait(*lock, [&] { return flushing_pages_.count(page_id) == 0; });
+}
+
 auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
   // LOG_DEBUG("DeletePgImp func: page id is %d", page_id);
   if (page_id == INVALID_PAGE_ID) {
@@ -227,6 +638,9 @@ auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
     // throw Exception("delete failed\n");
     return false;
   }
+  if (page_ptr->is_dirty_) {
+    num_dirty_--;
+  }
   free_list_.emplace_back(frame_id);
   page_table_->Remove(page_id);
   replacer_->Remove(frame_id);
@@ -238,6 +652,111 @@ auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
   return true;
 }
 
-auto BufferPoolManagerInstance::AllocatePage() -> page_id_t { return next_page_id_++; }
+auto BufferPoolManagerInstance::AllocatePage() -> page_id_t {
+  // 每个 instance 只分配 page_id % num_instances_ == instance_index_ 的 page id
+  const page_id_t next_page_id = next_page_id_.fetch_add(static_cast<page_id_t>(num_instances_));
+  ValidatePageId(next_page_id);
+  return next_page_id;
+}
+
+void BufferPoolManagerInstance::ValidatePageId(const page_id_t page_id) const {
+  // allocated pages mod back to this BPI
+  BUSTUB_ASSERT(static_cast<uint32_t>(page_id) % num_instances_ == instance_index_,
+                "page id does not belong to this instance");
+}
+
+auto BufferPoolManagerInstance::AcquireFrame(frame_id_t *frame_id, page_id_t *old_page_id, bool *old_dirty) -> bool {
+  // free frame
+  if (!free_list_.empty()) {
+    *frame_id = free_list_.back();
+    free_list_.pop_back();
+  } else if (replacer_->Evict(frame_id)) {
+    // replacer 中 evit 一个 frame
+    stats_.evictions_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    return false;
+  }
+  auto page_ptr = &pages_[*frame_id];
+  *old_page_id = page_ptr->page_id_;
+  *old_dirty = page_ptr->is_dirty_;
+  if (*old_page_id != INVALID_PAGE_ID) {
+    page_table_->Remove(*old_page_id);
+    // 写回完成之前，fetch 这个 page 的线程需要等待，否则会从磁盘读到旧数据
+    if (*old_dirty) {
+      evicting_pages_[*old_page_id] = *frame_id;
+      num_dirty_--;
+      stats_.dirty_evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  return true;
+}
+
+void BufferPoolManagerInstance::InstallPage(frame_id_t frame_id, page_id_t page_id, AccessType access_type) {
+  auto page_ptr = &pages_[frame_id];
+  replacer_->BindPage(frame_id, page_id);
+  replacer_->RecordAccess(frame_id, access_type);
+  replacer_->SetEvictable(frame_id, false);
+  page_table_->Insert(page_id, frame_id);
+  page_ptr->page_id_ = page_id;
+  page_ptr->pin_count_ = 1;
+  page_ptr->is_dirty_ = false;
+  frame_io_[frame_id].io_pending_ = true;
+}
+
+void BufferPoolManagerInstance::FinishIo(frame_id_t frame_id, page_id_t old_page_id) {
+  if (old_page_id != INVALID_PAGE_ID) {
+    auto iter = evicting_pages_.find(old_page_id);
+    if (iter != evicting_pages_.end() && iter->second == frame_id) {
+      evicting_pages_.erase(iter);
+    }
+  }
+  frame_io_[frame_id].io_pending_ = false;
+  frame_io_[frame_id].cv_.notify_all();
+}
+
+void BufferPoolManagerInstance::LockLatch(std::unique_lock<std::mutex> *lock) {
+  stats_.latch_acquisitions_.fetch_add(1, std::memory_order_relaxed);
+  if (lock->try_lock()) {
+    return;
+  }
+  // 只有竞争时才计时，避免在无竞争的路径上读时钟
+  auto start = std::chrono::steady_clock::now();
+  lock->lock();
+  auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+  stats_.latch_contentions_.fetch_add(1, std::memory_order_relaxed);
+  stats_.latch_wait_ns_.fetch_add(static_cast<uint64_t>(wait.count()), std::memory_order_relaxed);
+}
+
+auto BufferPoolManagerInstance::GetStats() -> BufferPoolStats {
+  BufferPoolStats stats;
+  for (size_t i = 0; i < BufferPoolStats::NUM_ACCESS_TYPES; i++) {
+    stats.hits_[i] = stats_.hits_[i].load(std::memory_order_relaxed);
+    stats.misses_[i] = stats_.misses_[i].load(std::memory_order_relaxed);
+  }
+  stats.new_pages_ = stats_.new_pages_.load(std::memory_order_relaxed);
+  stats.prefetches_ = stats_.prefetches_.load(std::memory_order_relaxed);
+  stats.evictions_ = stats_.evictions_.load(std::memory_order_relaxed);
+  stats.dirty_evictions_ = stats_.dirty_evictions_.load(std::memory_order_relaxed);
+  stats.flushes_ = stats_.flushes_.load(std::memory_order_relaxed);
+  stats.latch_acquisitions_ = stats_.latch_acquisitions_.load(std::memory_order_relaxed);
+  stats.latch_contentions_ = stats_.latch_contentions_.load(std::memory_order_relaxed);
+  stats.latch_wait_ns_ = stats_.latch_wait_ns_.load(std::memory_order_relaxed);
+
+  std::scoped_lock<std::mutex> lock(latch_);
+  stats.pool_size_ = pool_size_;
+  stats.free_frames_ = free_list_.size();
+  stats.dirty_frames_ = num_dirty_;
+  stats.evictable_frames_ = replacer_->Size();
+  for (size_t i = 0; i < pool_size_; i++) {
+    if (pages_[i].pin_count_ > 0) {
+      stats.pinned_frames_++;
+    }
+  }
+  return stats;
+}
+
+void BufferPoolManagerInstance::WaitForIo(std::unique_lock<std::mutex> *lock, frame_id_t frame_id) {
+  frame_io_[frame_id].cv_.wait(*lock, [&] { return !frame_io_[frame_id].io_pending_; });
+}
 
 }  // namespace bustub
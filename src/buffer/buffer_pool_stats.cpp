@@ -0,0 +1,81 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_stats.cpp
+//
+// Identification: src/buffer/buffer_pool_stats.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/buffer_pool_stats.h"
+
+#include <numeric>
+#include <sstream>
+
+namespace bustub {
+
+namespace {
+const char *const ACCESS_TYPE_NAMES[BufferPoolStats::NUM_ACCESS_TYPES] = {"unknown", "lookup", "scan", "index"};
+}  // namespace
+
+auto BufferPoolStats::Hits() const -> uint64_t { return std::accumulate(hits_.begin(), hits_.end(), uint64_t{0}); }
+
+auto BufferPoolStats::Misses() const -> uint64_t {
+  return std::accumulate(misses_.begin(), misses_.end(), uint64_t{0});
+}
+
+auto BufferPoolStats::HitRatio() const -> double {
+  auto total = Hits() + Misses();
+  return total == 0 ? 0 : static_cast<double>(Hits()) / static_cast<double>(total);
+}
+
+auto BufferPoolStats::operator+=(const BufferPoolStats &other) -> BufferPoolStats & {
+  for (size_t i = 0; i < NUM_ACCESS_TYPES; i++) {
+    hits_[i] += other.hits_[i];
+    misses_[i] += other.misses_[i];
+  }
+  new_pages_ += other.new_pages_;
+  prefetches_ += other.prefetches_;
+  evictions_ += other.evictions_;
+  dirty_evictions_ += other.dirty_evictions_;
+  flushes_ += other.flushes_;
+  latch_acquisitions_ += other.latch_acquisitions_;
+  latch_contentions_ += other.latch_contentions_;
+  latch_wait_ns_ += other.latch_wait_ns_;
+  pool_size_ += other.pool_size_;
+  free_frames_ += other.free_frames_;
+  pinned_frames_ += other.pinned_frames_;
+  dirty_frames_ += other.dirty_frames_;
+  evictable_frames_ += other.evictable_frames_;
+  return *this;
+}
+
+auto BufferPoolStats::ToString() const -> std::string {
+  std::ostringstream os;
+  os << "hit_ratio=" << HitRatio() << "\n";
+  os << "hits=" << Hits() << "\n";
+  os << "misses=" << Misses() << "\n";
+  for (size_t i = 0; i < NUM_ACCESS_TYPES; i++) {
+    os << "hits." << ACCESS_TYPE_NAMES[i] << "=" << hits_[i] << "\n";
+    os << "misses." << ACCESS_TYPE_NAMES[i] << "=" << misses_[i] << "\n";
+  }
+  os << "new_pages=" << new_pages_ << "\n";
+  os << "prefetches=" << prefetches_ << "\n";
+  os << "evictions=" << evictions_ << "\n";
+  os << "dirty_evictions=" << dirty_evictions_ << "\n";
+  os << "flushes=" << flushes_ << "\n";
+  os << "latch_acquisitions=" << latch_acquisitions_ << "\n";
+  os << "latch_contentions=" << latch_contentions_ << "\n";
+  os << "latch_wait_ns=" << latch_wait_ns_ << "\n";
+  os << "pool_size=" << pool_size_ << "\n";
+  os << "free_frames=" << free_frames_ << "\n";
+  os << "pinned_frames=" << pinned_frames_ << "\n";
+  os << "dirty_frames=" << dirty_frames_ << "\n";
+  os << "evictable_frames=" << evictable_frames_ << "\n";
+  return os.str();
+}
+
+}  // namespace bustub
@@ -0,0 +1,147 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// clock_replacer.cpp
+//
+// Identification: src/buffer/clock_replacer.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/clock_replacer.h"
+
+namespace bustub {
+
+ClockReplacer::ClockReplacer(size_t num_frames) : replacer_size_(num_frames), frames_(num_frames) {
+  hand_ = ring_.end();
+}
+
+auto ClockReplacer::Evict(frame_id_t *frame_id) -> bool {
+  std::scoped_lock<std::mutex> lock(latch_);
+  if (curr_size_ == 0) {
+    return false;
+  }
+  // scan_frames_ 和 ring_ 中只有 evictable frame
+  if (!scan_frames_.empty()) {
+    *frame_id = scan_frames_.front();
+  } else {
+    // 最多转两圈：第一圈清掉所有 frame 的 ref 位，第二圈一定能找到
+    size_t steps = 2 * ring_.size();
+    for (size_t i = 0; i <= steps; i++) {
+      if (hand_ == ring_.end()) {
+        hand_ = ring_.begin();
+      }
+      auto &frame = frames_[*hand_];
+      if (!frame.ref_) {
+        break;
+      }
+      frame.ref_ = false;
+      ++hand_;
+    }
+    BUSTUB_ASSERT(hand_ != ring_.end() && !frames_[*hand_].ref_, "curr_size_ is positive but no frame was found");
+    *frame_id = *hand_;
+  }
+  Unlink(*frame_id);
+  frames_[*frame_id] = FrameState{};
+  curr_size_--;
+  return true;
+}
+
+void ClockReplacer::RecordAccess(frame_id_t frame_id, AccessType access_type) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < replacer_size_, "invalid frame id");
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto &frame = frames_[frame_id];
+  if (!frame.tracked_) {
+    frame.tracked_ = true;
+    frame.evictable_ = true;
+    Link(frame_id);
+    curr_size_++;
+  }
+  bool scan = frame.scan_;
+  switch (access_type) {
+    case AccessType::Lookup:
+    case AccessType::Index:
+      scan = false;
+      frame.hot_ = true;
+      frame.ref_ = true;
+      break;
+    case AccessType::Scan:
+      // 不热的 frame 放进 scan_frames_，下一次淘汰时直接选中
+      if (!frame.hot_ && !frame.scan_) {
+        scan = true;
+        frame.ref_ = false;
+      }
+      break;
+    case AccessType::Unknown:
+      frame.ref_ = !frame.scan_;
+      break;
+  }
+  if (scan != frame.scan_) {
+    // 在 ring_ 和 scan_frames_ 之间移动，pin 住的 frame 不在其中
+    if (frame.evictable_) {
+      Unlink(frame_id);
+    }
+    frame.scan_ = scan;
+    if (frame.evictable_) {
+      Link(frame_id);
+    }
+  }
+}
+
+void ClockReplacer::SetEvictable(frame_id_t frame_id, bool set_evictable) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < replacer_size_, "invalid frame id");
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto &frame = frames_[frame_id];
+  if (!frame.tracked_ || frame.evictable_ == set_evictable) {
+    return;
+  }
+  frame.evictable_ = set_evictable;
+  if (set_evictable) {
+    Link(frame_id);
+    curr_size_++;
+  } else {
+    Unlink(frame_id);
+    curr_size_--;
+  }
+}
+
+void ClockReplacer::Remove(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < replacer_size_, "invalid frame id");
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto &frame = frames_[frame_id];
+  // 不存在
+  if (!frame.tracked_ || !frame.evictable_) {
+    return;
+  }
+  Unlink(frame_id);
+  frame = FrameState{};
+  curr_size_--;
+}
+
+auto ClockReplacer::Size() -> size_t { return curr_size_; }
+
+void ClockReplacer::Link(frame_id_t frame_id) {
+  auto &frame = frames_[frame_id];
+  if (frame.scan_) {
+    frame.iter_ = scan_frames_.insert(scan_frames_.end(), frame_id);
+    return;
+  }
+  // 放在指针的前面，指针转一圈后才会检查它
+  frame.iter_ = ring_.insert(hand_, frame_id);
+}
+
+void ClockReplacer::Unlink(frame_id_t frame_id) {
+  auto &frame = frames_[frame_id];
+  if (frame.scan_) {
+    scan_frames_.erase(frame.iter_);
+    return;
+  }
+  if (hand_ == frame.iter_) {
+    ++hand_;
+  }
+  ring_.erase(frame.iter_);
+}
+
+}  // namespace bustub
@@ -0,0 +1,136 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// frame_arena.cpp
+//
+// Identification: src/buffer/frame_arena.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/frame_arena.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <string>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <fstream>
+#endif
+
+#include "common/exception.h"
+
+namespace bustub {
+
+namespace {
+
+auto RoundUp(size_t size, size_t alignment) -> size_t { return (size + alignment - 1) / alignment * alignment; }
+
+/** @return an anonymous mapping of `length` bytes with extra mmap `flags`, nullptr if it failed */
+auto MapAnonymous(size_t length, int flags) -> void * {
+  void *addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  return addr == MAP_FAILED ? nullptr : addr;
+}
+
+}  // namespace
+
+FrameArena::FrameArena(size_t num_frames, int numa_node) : num_frames_(num_frames) {
+  auto bytes = std::max<size_t>(num_frames * sizeof(Page), 1);
+  void *frames = nullptr;
+  size_t size = RoundUp(bytes, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+  if (bytes >= HUGE_PAGE_SIZE) {
+    size = RoundUp(bytes, HUGE_PAGE_SIZE);
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+    // 先尝试显式的 huge page，系统没有预留时 mmap 失败
+    if (size >= GIGANTIC_PAGE_SIZE) {
+      mapping_size_ = RoundUp(size, GIGANTIC_PAGE_SIZE);
+      frames = MapAnonymous(mapping_size_, MAP_HUGETLB | (30 << MAP_HUGE_SHIFT));
+    }
+    if (frames == nullptr) {
+      mapping_size_ = size;
+      frames = MapAnonymous(mapping_size_, MAP_HUGETLB | (21 << MAP_HUGE_SHIFT));
+    }
+    mapping_ = frames;
+    huge_page_backed_ = frames != nullptr;
+#endif
+  }
+  if (frames == nullptr) {
+    // 大的 arena 多映射一个 huge page 的长度，以便按 HUGE_PAGE_SIZE 对齐，transparent huge page 才能覆盖整个 arena
+    auto alignment = bytes >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : 1;
+    mapping_size_ = size + alignment - 1;
+    mapping_ = MapAnonymous(mapping_size_, 0);
+    if (mapping_ == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "cannot map the frames of the buffer pool");
+    }
+    frames = reinterpret_cast<void *>(RoundUp(reinterpret_cast<uintptr_t>(mapping_), alignment));
+#ifdef MADV_HUGEPAGE
+    if (alignment == HUGE_PAGE_SIZE) {
+      madvise(frames, size, MADV_HUGEPAGE);
+    }
+#endif
+  }
+  // 必须在第一次写入之前设置，page 在第一次写入时才分配到某个 node 上
+  if (numa_node >= 0) {
+    PreferNode(frames, size, numa_node);
+  }
+  frames_ = static_cast<Page *>(frames);
+  for (size_t i = 0; i < num_frames_; i++) {
+    new (&frames_[i]) Page();
+  }
+}
+
+FrameArena::~FrameArena() {
+  for (size_t i = 0; i < num_frames_; i++) {
+    frames_[i].~Page();
+  }
+  munmap(mapping_, mapping_size_);
+}
+
+auto FrameArena::NumNumaNodes() -> int {
+#ifdef __linux__
+  // 形如 "0-1" 或 "0"
+  static const int num_nodes = [] {
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string range;
+    if (!(online >> range)) {
+      return 1;
+    }
+    auto dash = range.find_last_of('-');
+    try {
+      return dash == std::string::npos ? 1 : std::stoi(range.substr(dash + 1)) + 1;
+    } catch (const std::exception &) {
+      return 1;
+    }
+  }();
+  return num_nodes;
+#else
+  return 1;
+#endif
+}
+
+void FrameArena::PreferNode(void *addr, size_t length, int numa_node) {
+#if defined(__linux__) && defined(SYS_mbind)
+  if (NumNumaNodes() <= 1) {
+    return;
+  }
+  // MPOL_PREFERRED：优先在该 node 上分配，满了再用其他 node，不会因为一个 node 满了而失败
+  constexpr int mpol_preferred = 1;
+  constexpr size_t bits_per_word = sizeof(unsigned long) * 8;  // NOLINT
+  unsigned long node_mask[4] = {};                              // NOLINT
+  auto node = static_cast<size_t>(numa_node % NumNumaNodes());
+  if (node >= sizeof(node_mask) * 8) {
+    return;
+  }
+  node_mask[node / bits_per_word] |= 1UL << (node % bits_per_word);
+  // 失败时只是失去 NUMA 局部性，不影响正确性
+  syscall(SYS_mbind, addr, length, mpol_preferred, node_mask, sizeof(node_mask) * 8 + 1, 0);
+#endif
+}
+
+}  // namespace bustub
@@ -15,122 +15,170 @@
 #include <cstddef>
 #include <memory>
 #include <ostream>
-#include <queue>
 #include "common/exception.h"
 // #include <cstddef>
 
 namespace bustub {
 
 LRUKReplacer::LRUKReplacer(size_t num_frames, size_t k) : replacer_size_(num_frames), k_(k) {
+  BUSTUB_ASSERT(k > 0, "k must be positive");
+  frames_.reserve(num_frames + 1);
   for (size_t i = 0; i <= num_frames; i++) {
-    frame_cache_[i] = std::make_shared<LRUKReplacer::FrameNode>(k);
+    frames_.emplace_back(std::make_unique<LRUKReplacer::FrameNode>(k));
   }
 }
 
 auto LRUKReplacer::Evict(frame_id_t *frame_id) -> bool {
-  std::scoped_lock<std::shared_mutex> wlock(latch_);
-  if (curr_size_ == 0) {
+  std::scoped_lock<std::mutex> lock(latch_);
+  // 最先淘汰 scan frame，其次是 +inf 的 frame，其中第一次访问最早的在最前面
+  if (!scan_set_.empty()) {
+    *frame_id = scan_set_.begin()->second;
+    scan_set_.erase(scan_set_.begin());
+  } else if (!history_set_.empty()) {
+    *frame_id = history_set_.begin()->second;
+    history_set_.erase(history_set_.begin());
+  } else if (!cache_set_.empty()) {
+    *frame_id = cache_set_.begin()->second;
+    cache_set_.erase(cache_set_.begin());
+  } else {
     return false;
   }
-  size_t k_dis = 0;
-  size_t k_timestamp = -1;
-  auto frame_it = frame_cache_.begin();
-  for (auto it = frame_cache_.begin(); it != frame_cache_.end(); it++) {
-    auto frame_ptr = it->second;
-    if (frame_ptr->status_ == 0 || !frame_ptr->evictable_) {
-      continue;
-    }
-    size_t timestamp = frame_ptr->history_access_->front();
-    size_t cnt = frame_ptr->cnt_;
-    size_t dis = cnt < k_ ? -1 : current_timestamp_ - timestamp;
-    if (dis > k_dis || (dis == k_dis && timestamp < k_timestamp)) {
-      k_dis = dis;
-      k_timestamp = timestamp;
-      frame_it = it;
-    }
-  }
-  *frame_id = frame_it->first;
-  auto frame_ptr = frame_it->second;
-  frame_it->second->Init();
+  frames_[*frame_id]->Init();
   curr_size_--;
   return true;
 }
 
-void LRUKReplacer::RecordAccess(frame_id_t frame_id) {
-  std::scoped_lock<std::shared_mutex> rlock(latch_);
+void LRUKReplacer::RecordAccess(frame_id_t frame_id, AccessType access_type) {
   BUSTUB_ASSERT((size_t)frame_id <= replacer_size_, true);
-  auto frame_ptr = frame_cache_[frame_id];
-  std::scoped_lock<std::mutex> lock(frame_ptr->latch_);
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto &node = *frames_[frame_id];
   size_t timestamp = ++current_timestamp_;
   // insert 新的
-  if (frame_ptr->status_ == 0) {
-    frame_ptr->history_access_->emplace(timestamp);
-    frame_ptr->cnt_ = 1;
-    frame_ptr->status_ = 1;
+  if (node.status_ == 0) {
+    node.Push(timestamp);
+    node.status_ = 1;
+    node.hot_ = access_type == AccessType::Lookup || access_type == AccessType::Index;
+    node.scan_ = access_type == AccessType::Scan;
+    node.scan_ts_ = timestamp;
+    Attach(frame_id, node);
     curr_size_++;
     return;
   }
-  frame_ptr->history_access_->emplace(timestamp);
-  frame_ptr->cnt_++;
-  if (frame_ptr->cnt_ > frame_ptr->queue_size_) {
-    frame_ptr->history_access_->pop();
-    frame_ptr->cnt_--;
+  // 排序的 key 会变，需要先取出再放回
+  if (node.evictable_) {
+    Detach(frame_id, node);
+  }
+  switch (access_type) {
+    case AccessType::Lookup:
+    case AccessType::Index:
+      node.hot_ = true;
+      node.scan_ = false;
+      node.Push(timestamp);
+      break;
+    case AccessType::Scan:
+      // scan 不计入历史，只把不热的 frame 标记为可以最先淘汰
+      if (!node.hot_ && !node.scan_) {
+        node.scan_ = true;
+        node.scan_ts_ = timestamp;
+      }
+      break;
+    case AccessType::Unknown:
+      node.Push(timestamp);
+      break;
+  }
+  if (node.evictable_) {
+    Attach(frame_id, node);
   }
 }
 
 void LRUKReplacer::SetEvictable(frame_id_t frame_id, bool set_evictable) {
-  std::scoped_lock<std::shared_mutex> rlock(latch_);
   BUSTUB_ASSERT((size_t)frame_id <= replacer_size_, true);
-  auto frame_ptr = frame_cache_[frame_id];
-  std::scoped_lock<std::mutex> lock(frame_ptr->latch_);
-  if (frame_ptr->status_ == 0) {
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto &node = *frames_[frame_id];
+  if (node.status_ == 0) {
     return;
   }
-  if (set_evictable && !frame_ptr->evictable_) {
-    frame_ptr->evictable_ = set_evictable;
+  if (set_evictable && !node.evictable_) {
+    node.evictable_ = set_evictable;
+    Attach(frame_id, node);
     curr_size_++;
     return;
   }
-  if (!set_evictable && frame_ptr->evictable_) {
-    frame_ptr->evictable_ = set_evictable;
+  if (!set_evictable && node.evictable_) {
+    Detach(frame_id, node);
+    node.evictable_ = set_evictable;
     curr_size_--;
     return;
   }
 }
 
 void LRUKReplacer::Remove(frame_id_t frame_id) {
-  std::scoped_lock<std::shared_mutex> rlock(latch_);
   BUSTUB_ASSERT((size_t)frame_id <= replacer_size_, true);
-  auto frame_ptr = frame_cache_[frame_id];
-  std::scoped_lock<std::mutex> lock(frame_ptr->latch_);
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto &node = *frames_[frame_id];
   // 不存在
-  if (frame_ptr->status_ == 0 || !frame_ptr->evictable_) {
+  if (node.status_ == 0 || !node.evictable_) {
     return;
   }
-  frame_ptr->Init();
+  Detach(frame_id, node);
+  node.Init();
   curr_size_--;
 }
 
 auto LRUKReplacer::Size() -> size_t { return curr_size_; }
 
-LRUKReplacer::~LRUKReplacer() { frame_cache_.clear(); }
+LRUKReplacer::~LRUKReplacer() { frames_.clear(); }
+
+void LRUKReplacer::Attach(frame_id_t frame_id, const FrameNode &node) {
+  if (node.scan_) {
+    scan_set_.emplace(node.scan_ts_, frame_id);
+  } else if (node.cnt_ < k_) {
+    history_set_.emplace(node.Oldest(), frame_id);
+  } else {
+    cache_set_.emplace(node.Oldest(), frame_id);
+  }
+}
+
+void LRUKReplacer::Detach(frame_id_t frame_id, const FrameNode &node) {
+  if (node.scan_) {
+    scan_set_.erase({node.scan_ts_, frame_id});
+  } else if (node.cnt_ < k_) {
+    history_set_.erase({node.Oldest(), frame_id});
+  } else {
+    cache_set_.erase({node.Oldest(), frame_id});
+  }
+}
 
 // ======================
 // 内部类 FrameNode
 // ======================
 
-LRUKReplacer::FrameNode::FrameNode(size_t queue_size) : evictable_(true), status_(0), cnt_(0), queue_size_(queue_size) {
-  history_access_ = new std::queue<size_t>();
-}
-
-LRUKReplacer::FrameNode::~FrameNode() { delete history_access_; }
+LRUKReplacer::FrameNode::FrameNode(size_t queue_size)
+    : evictable_(true),
+      hot_(false),
+      scan_(false),
+      scan_ts_(0),
+      history_access_(queue_size, 0),
+      pos_(0),
+      status_(0),
+      cnt_(0),
+      queue_size_(queue_size) {}
 
 void LRUKReplacer::FrameNode::Init() {
-  delete history_access_;
-  history_access_ = new std::queue<size_t>();
+  pos_ = 0;
   cnt_ = 0;
   status_ = 0;
   evictable_ = true;
+  hot_ = false;
+  scan_ = false;
+}
+
+void LRUKReplacer::FrameNode::Push(size_t timestamp) {
+  history_access_[pos_] = timestamp;
+  pos_ = (pos_ + 1) % queue_size_;
+  if (cnt_ < queue_size_) {
+    cnt_++;
+  }
 }
 
 }  // namespace bustub
@@ -0,0 +1,121 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// parallel_buffer_pool_manager.cpp
+//
+// Identification: src/buffer/parallel_buffer_pool_manager.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/parallel_buffer_pool_manager.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+ParallelBufferPoolManager::ParallelBufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
+                                                     size_t replacer_k, LogManager *log_manager,
+                                                     ReplacerType replacer_type)
+    : num_instances_(num_instances), pool_size_(pool_size) {
+  BUSTUB_ASSERT(num_instances > 0, "ParallelBufferPoolManager needs at least one instance");
+  // Allocate and create individual BufferPoolManagerInstances
+  instances_.reserve(num_instances_);
+  for (size_t i = 0; i < num_instances_; i++) {
+    instances_.emplace_back(new BufferPoolManagerInstance(pool_size_, num_instances_, i, disk_manager, replacer_k,
+                                                          log_manager, replacer_type));
+  }
+}
+
+ParallelBufferPoolManager::~ParallelBufferPoolManager() {
+  for (auto instance : instances_) {
+    delete instance;
+  }
+}
+
+auto ParallelBufferPoolManager::GetPoolSize() -> size_t { return num_instances_ * pool_size_; }
+
+auto ParallelBufferPoolManager::GetStats() -> BufferPoolStats {
+  BufferPoolStats stats;
+  for (auto &instance : instances_) {
+    stats += instance->GetStats();
+  }
+  return stats;
+}
+
+void ParallelBufferPoolManager::StartBackgroundFlusher(size_t dirty_high_water_mark,
+                                                       std::chrono::milliseconds interval) {
+  for (auto instance : instances_) {
+    instance->StartBackgroundFlusher(dirty_high_water_mark / num_instances_, interval);
+  }
+}
+
+void ParallelBufferPoolManager::StopBackgroundFlusher() {
+  for (auto instance : instances_) {
+    instance->StopBackgroundFlusher();
+  }
+}
+
+auto ParallelBufferPoolManager::GetBufferPoolManager(page_id_t page_id) -> BufferPoolManagerInstance * {
+  // page id 由 instance 按 instance_index + k * num_instances 分配，所以取模即可找到对应的 instance
+  return instances_[static_cast<size_t>(page_id) % num_instances_];
+}
+
+auto ParallelBufferPoolManager::NewPgImp(page_id_t *page_id) -> Page * {
+  // 从 start_index_ 开始轮询，直到某个 instance 分配成功或者全部失败
+  size_t start = start_index_.fetch_add(1) % num_instances_;
+  for (size_t i = 0; i < num_instances_; i++) {
+    auto page_ptr = instances_[(start + i) % num_instances_]->NewPage(page_id);
+    if (page_ptr != nullptr) {
+      return page_ptr;
+    }
+  }
+  return nullptr;
+}
+
+auto ParallelBufferPoolManager::FetchPgImp(page_id_t page_id, AccessType access_type) -> Page * {
+  if (page_id == INVALID_PAGE_ID) {
+    return nullptr;
+  }
+  return GetBufferPoolManager(page_id)->FetchPage(page_id, access_type);
+}
+
+auto ParallelBufferPoolManager::UnpinPgImp(page_id_t page_id, bool is_dirty) -> bool {
+  if (page_id == INVALID_PAGE_ID) {
+    return false;
+  }
+  return GetBufferPoolManager(page_id)->UnpinPage(page_id, is_dirty);
+}
+
+auto ParallelBufferPoolManager::FlushPgImp(page_id_t page_id) -> bool {
+  if (page_id == INVALID_PAGE_ID) {
+    return false;
+  }
+  return GetBufferPoolManager(page_id)->FlushPage(page_id);
+}
+
+void ParallelBufferPoolManager::FlushAllPgsImp() {
+  for (auto instance : instances_) {
+    instance->FlushAllPages();
+  }
+}
+
+auto ParallelBufferPoolManager::DeletePgImp(page_id_t page_id) -> bool {
+  if (page_id == INVALID_PAGE_ID) {
+    return true;
+  }
+  return GetBufferPoolManager(page_id)->DeletePage(page_id);
+}
+
+void ParallelBufferPoolManager::PrefetchPgsImp(page_id_t first_page_id, size_t count) {
+  if (first_page_id == INVALID_PAGE_ID) {
+    return;
+  }
+  for (size_t i = 0; i < count; i++) {
+    auto page_id = static_cast<page_id_t>(first_page_id + i);
+    GetBufferPoolManager(page_id)->PrefetchPages(page_id, 1);
+  }
+}
+
+}  // namespace bustub
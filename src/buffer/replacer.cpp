@@ -0,0 +1,37 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// replacer.cpp
+//
+// Identification: src/buffer/replacer.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/replacer.h"
+
+#include "buffer/arc_replacer.h"
+#include "buffer/clock_replacer.h"
+#include "buffer/lru_k_replacer.h"
+#include "buffer/two_queue_replacer.h"
+#include "common/exception.h"
+
+namespace bustub {
+
+auto CreateReplacer(ReplacerType replacer_type, size_t num_frames, size_t k) -> Replacer * {
+  switch (replacer_type) {
+    case ReplacerType::LRUK:
+      return new LRUKReplacer(num_frames, k);
+    case ReplacerType::Clock:
+      return new ClockReplacer(num_frames);
+    case ReplacerType::TwoQueue:
+      return new TwoQueueReplacer(num_frames);
+    case ReplacerType::ARC:
+      return new ArcReplacer(num_frames);
+  }
+  throw Exception(ExceptionType::INVALID, "unknown replacer type");
+}
+
+}  // namespace bustub
@@ -0,0 +1,167 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// two_queue_replacer.cpp
+//
+// Identification: src/buffer/two_queue_replacer.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/two_queue_replacer.h"
+
+#include <algorithm>
+
+namespace bustub {
+
+TwoQueueReplacer::TwoQueueReplacer(size_t num_frames)
+    : replacer_size_(num_frames),
+      kin_(std::max<size_t>(1, num_frames / 4)),
+      kout_(std::max<size_t>(1, num_frames / 2)),
+      frames_(num_frames) {}
+
+auto TwoQueueReplacer::Evict(frame_id_t *frame_id) -> bool {
+  std::scoped_lock<std::mutex> lock(latch_);
+  if (curr_size_ == 0) {
+    return false;
+  }
+  // 队列中只有 evictable frame。先淘汰 scan frame；A1in 超过 kin_ 时先淘汰 A1in，否则先淘汰 Am，为空时再试另一个
+  std::list<frame_id_t> *queue = &scan_;
+  if (queue->empty()) {
+    bool a1in_first = a1in_size_ > kin_;
+    queue = (a1in_first ? !a1in_.empty() : am_.empty()) ? &a1in_ : &am_;
+  }
+  BUSTUB_ASSERT(!queue->empty(), "curr_size_ is positive but no evictable frame was found");
+  *frame_id = queue->front();
+  queue->pop_front();
+  auto &frame = frames_[*frame_id];
+  if (frame.queue_ == Queue::A1in) {
+    a1in_size_--;
+    RememberEvicted(frame.page_id_);
+  }
+  frame = FrameState{};
+  curr_size_--;
+  return true;
+}
+
+void TwoQueueReplacer::RecordAccess(frame_id_t frame_id, AccessType access_type) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < replacer_size_, "invalid frame id");
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto &frame = frames_[frame_id];
+  if (access_type == AccessType::Lookup || access_type == AccessType::Index) {
+    frame.hot_ = true;
+  }
+  switch (frame.queue_) {
+    case Queue::Scan:
+      // 只有 Lookup / Index 访问才能让 scan frame 重新参与 2Q
+      if (frame.hot_) {
+        MoveTo(frame_id, Queue::A1in);
+      }
+      return;
+    case Queue::A1in:
+      // 相关访问，不改变位置
+      if (access_type == AccessType::Scan && !frame.hot_) {
+        MoveTo(frame_id, Queue::Scan);
+      }
+      return;
+    case Queue::Am:
+      if (access_type != AccessType::Scan) {
+        MoveTo(frame_id, Queue::Am);
+      }
+      return;
+    case Queue::None:
+      break;
+  }
+  // insert 新的
+  auto ghost = a1out_map_.find(frame.page_id_);
+  if (access_type == AccessType::Scan) {
+    frame.queue_ = Queue::Scan;
+  } else if (frame.page_id_ != INVALID_PAGE_ID && ghost != a1out_map_.end()) {
+    a1out_.erase(ghost->second);
+    a1out_map_.erase(ghost);
+    frame.queue_ = Queue::Am;
+  } else {
+    frame.queue_ = Queue::A1in;
+    a1in_size_++;
+  }
+  auto &queue = QueueOf(frame.queue_);
+  frame.iter_ = queue.insert(queue.end(), frame_id);
+  frame.evictable_ = true;
+  curr_size_++;
+}
+
+void TwoQueueReplacer::SetEvictable(frame_id_t frame_id, bool set_evictable) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < replacer_size_, "invalid frame id");
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto &frame = frames_[frame_id];
+  if (frame.queue_ == Queue::None || frame.evictable_ == set_evictable) {
+    return;
+  }
+  frame.evictable_ = set_evictable;
+  // pin 住的 frame 不在队列中，unpin 时放回所在队列的尾部
+  auto &queue = QueueOf(frame.queue_);
+  if (set_evictable) {
+    frame.iter_ = queue.insert(queue.end(), frame_id);
+    curr_size_++;
+  } else {
+    queue.erase(frame.iter_);
+    curr_size_--;
+  }
+}
+
+void TwoQueueReplacer::Remove(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < replacer_size_, "invalid frame id");
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto &frame = frames_[frame_id];
+  // 不存在
+  if (frame.queue_ == Queue::None || !frame.evictable_) {
+    return;
+  }
+  QueueOf(frame.queue_).erase(frame.iter_);
+  if (frame.queue_ == Queue::A1in) {
+    a1in_size_--;
+  }
+  frame = FrameState{};
+  curr_size_--;
+}
+
+auto TwoQueueReplacer::Size() -> size_t { return curr_size_; }
+
+void TwoQueueReplacer::BindPage(frame_id_t frame_id, page_id_t page_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < replacer_size_, "invalid frame id");
+  std::scoped_lock<std::mutex> lock(latch_);
+  frames_[frame_id].page_id_ = page_id;
+}
+
+void TwoQueueReplacer::MoveTo(frame_id_t frame_id, Queue queue) {
+  auto &frame = frames_[frame_id];
+  if (frame.evictable_) {
+    auto &to = QueueOf(queue);
+    to.splice(to.end(), QueueOf(frame.queue_), frame.iter_);
+  }
+  if (frame.queue_ == Queue::A1in) {
+    a1in_size_--;
+  }
+  if (queue == Queue::A1in) {
+    a1in_size_++;
+  }
+  frame.queue_ = queue;
+}
+
+void TwoQueueReplacer::RememberEvicted(page_id_t page_id) {
+  if (page_id == INVALID_PAGE_ID) {
+    return;
+  }
+  if (auto old = a1out_map_.find(page_id); old != a1out_map_.end()) {
+    a1out_.erase(old->second);
+  }
+  a1out_map_[page_id] = a1out_.insert(a1out_.end(), page_id);
+  if (a1out_.size() > kout_) {
+    a1out_map_.erase(a1out_.front());
+    a1out_.pop_front();
+  }
+}
+
+}  // namespace bustub
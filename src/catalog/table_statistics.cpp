@@ -0,0 +1,274 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// table_statistics.cpp
+//
+// Identification: src/catalog/table_statistics.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "catalog/table_statistics.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+
+#include "common/util/hash_util.h"
+
+namespace bustub {
+
+namespace {
+
+// HashValue 对整数的 hash 不够分散，HyperLogLog 需要均匀的 bit
+auto Mix(uint64_t hash) -> uint64_t {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+auto IsNumeric(TypeId type) -> bool {
+  switch (type) {
+    case TypeId::TINYINT:
+    case TypeId::SMALLINT:
+    case TypeId::INTEGER:
+    case TypeId::BIGINT:
+    case TypeId::DECIMAL:
+    case TypeId::TIMESTAMP:
+      return true;
+    default:
+      return false;
+  }
+}
+
+auto LessThan(const Value &a, const Value &b) -> bool { return a.CompareLessThan(b) == CmpBool::CmpTrue; }
+
+}  // namespace
+
+std::unordered_map<const Catalog *, std::unordered_map<table_oid_t, std::shared_ptr<TableStatistics>>>
+    StatisticsCatalog::tables_;
+std::shared_mutex StatisticsCatalog::tables_latch_;
+
+void HyperLogLog::Add(const Value &value) {
+  auto hash = Mix(HashUtil::HashValue(&value));
+  auto idx = static_cast<uint32_t>(hash >> (64 - HLL_PRECISION));
+  // 剩下的 bit 中第一个 1 的位置，最低位补 1 保证不为 0
+  auto rest = (hash << HLL_PRECISION) | (1ULL << (HLL_PRECISION - 1));
+  auto rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+  registers_[idx] = std::max(registers_[idx], rank);
+}
+
+auto HyperLogLog::Estimate() const -> double {
+  constexpr auto m = static_cast<double>(HLL_REGISTERS);
+  double sum = 0;
+  size_t zeros = 0;
+  for (auto reg : registers_) {
+    sum += std::ldexp(1.0, -reg);
+    zeros += static_cast<size_t>(reg == 0);
+  }
+  double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+  // 值较少时用 linear counting
+  if (estimate <= 2.5 * m && zeros != 0) {
+    estimate = m * std::log(m / static_cast<double>(zeros));
+  }
+  return estimate;
+}
+
+auto TableStatistics::GetRows() const -> double {
+  std::scoped_lock<std::mutex> lock(latch_);
+  return rows_;
+}
+
+auto TableStatistics::GetDistinct(uint32_t col_idx) const -> double {
+  std::scoped_lock<std::mutex> lock(latch_);
+  const auto &column = columns_[col_idx];
+  return std::max(std::min(column.distinct_.Estimate(), rows_ - column.null_rows_), 1.0);
+}
+
+auto TableStatistics::GetNullFraction(uint32_t col_idx) const -> double {
+  std::scoped_lock<std::mutex> lock(latch_);
+  return rows_ > 0 ? columns_[col_idx].null_rows_ / rows_ : 0;
+}
+
+auto TableStatistics::EstimateEqual(uint32_t col_idx, const Value &value) const -> double {
+  if (value.IsNull()) {
+    return 0;
+  }
+  std::scoped_lock<std::mutex> lock(latch_);
+  if (rows_ <= 0) {
+    return 1;
+  }
+  const auto &column = columns_[col_idx];
+  // 直方图范围之外的值可能是 ANALYZE 之后插入的，不估算为 0
+  if (column.min_.has_value() && (LessThan(value, *column.min_) || LessThan(column.bounds_.back(), value))) {
+    return 1 / rows_;
+  }
+  auto non_null = rows_ - column.null_rows_;
+  auto distinct = std::max(std::min(column.distinct_.Estimate(), non_null), 1.0);
+  return std::max(non_null / distinct / rows_, 1 / rows_);
+}
+
+auto TableStatistics::EstimateRange(uint32_t col_idx, const std::optional<Value> &low,
+                                    const std::optional<Value> &high) const -> double {
+  std::scoped_lock<std::mutex> lock(latch_);
+  if (rows_ <= 0) {
+    return 1;
+  }
+  const auto &column = columns_[col_idx];
+  auto low_fraction = low.has_value() ? FractionBelow(column, *low) : 0.0;
+  auto high_fraction = high.has_value() ? FractionBelow(column, *high) : 1.0;
+  auto non_null = (rows_ - column.null_rows_) / rows_;
+  return std::max(non_null * std::max(high_fraction - low_fraction, 0.0), 1 / rows_);
+}
+
+auto TableStatistics::FractionBelow(const ColumnStatistics &column, const Value &value) const -> double {
+  if (!column.min_.has_value() || value.IsNull()) {
+    return 0.5;
+  }
+  if (!LessThan(*column.min_, value)) {
+    return 0;
+  }
+  const auto &bounds = column.bounds_;
+  auto bucket = static_cast<size_t>(std::lower_bound(bounds.begin(), bounds.end(), value, LessThan) - bounds.begin());
+  if (bucket == bounds.size()) {
+    return 1;
+  }
+  const auto &lower = bucket == 0 ? *column.min_ : bounds[bucket - 1];
+  const auto &upper = bounds[bucket];
+  // 数值类型在 bucket 内按线性插值，其他类型取 bucket 的一半
+  double within = 0.5;
+  if (IsNumeric(value.GetTypeId()) && IsNumeric(lower.GetTypeId())) {
+    auto l = lower.CastAs(TypeId::DECIMAL).GetAs<double>();
+    auto u = upper.CastAs(TypeId::DECIMAL).GetAs<double>();
+    auto v = value.CastAs(TypeId::DECIMAL).GetAs<double>();
+    within = u > l ? std::clamp((v - l) / (u - l), 0.0, 1.0) : 0.5;
+  }
+  return (static_cast<double>(bucket) + within) / static_cast<double>(bounds.size());
+}
+
+void TableStatistics::RecordInserts(const Schema &schema, const std::vector<const Tuple *> &tuples) {
+  std::scoped_lock<std::mutex> lock(latch_);
+  rows_ += static_cast<double>(tuples.size());
+  modified_rows_ += static_cast<double>(tuples.size());
+  for (const auto *tuple : tuples) {
+    for (uint32_t i = 0; i < columns_.size(); i++) {
+      auto value = tuple->GetValue(&schema, i);
+      if (value.IsNull()) {
+        columns_[i].null_rows_++;
+      } else {
+        columns_[i].distinct_.Add(value);
+      }
+    }
+  }
+}
+
+void TableStatistics::RecordDelete(const Schema &schema, const Tuple &tuple) {
+  std::scoped_lock<std::mutex> lock(latch_);
+  rows_ = std::max(rows_ - 1, 0.0);
+  modified_rows_++;
+  for (uint32_t i = 0; i < columns_.size(); i++) {
+    if (tuple.GetValue(&schema, i).IsNull()) {
+      columns_[i].null_rows_ = std::max(columns_[i].null_rows_ - 1, 0.0);
+    }
+  }
+}
+
+auto TableStatistics::IsStale() const -> bool {
+  std::scoped_lock<std::mutex> lock(latch_);
+  return modified_rows_ > AUTO_ANALYZE_BASE_ROWS + AUTO_ANALYZE_FRACTION * analyzed_rows_;
+}
+
+void StatisticsCatalog::Analyze(Catalog *catalog, const TableInfo *table_info, Transaction *txn) {
+  const auto &schema = table_info->schema_;
+  auto column_count = schema.GetColumnCount();
+  std::vector<ColumnStatistics> columns(column_count);
+  // reservoir sampling，每一行被选中的概率相同
+  std::vector<std::vector<Value>> sample;
+  std::mt19937_64 gen(table_info->oid_);
+  size_t rows = 0;
+  auto table_heap = table_info->table_.get();
+  for (auto it = table_heap->Begin(txn); it != table_heap->End(); ++it) {
+    std::vector<Value> values;
+    values.reserve(column_count);
+    for (uint32_t i = 0; i < column_count; i++) {
+      values.emplace_back(it->GetValue(&schema, i));
+      if (values.back().IsNull()) {
+        columns[i].null_rows_++;
+      } else {
+        columns[i].distinct_.Add(values.back());
+      }
+    }
+    if (sample.size() < STATS_SAMPLE_ROWS) {
+      sample.emplace_back(std::move(values));
+    } else if (auto j = std::uniform_int_distribution<size_t>(0, rows)(gen); j < STATS_SAMPLE_ROWS) {
+      sample[j] = std::move(values);
+    }
+    rows++;
+  }
+
+  std::vector<Value> values;
+  for (uint32_t i = 0; i < column_count; i++) {
+    values.clear();
+    for (const auto &row : sample) {
+      if (!row[i].IsNull()) {
+        values.emplace_back(row[i]);
+      }
+    }
+    if (values.empty()) {
+      continue;
+    }
+    std::sort(values.begin(), values.end(), LessThan);
+    auto &column = columns[i];
+    column.min_ = values.front();
+    auto buckets = std::min(STATS_HISTOGRAM_BUCKETS, values.size());
+    for (size_t b = 1; b <= buckets; b++) {
+      column.bounds_.emplace_back(values[(b * values.size() + buckets - 1) / buckets - 1]);
+    }
+  }
+
+  auto statistics = std::make_shared<TableStatistics>(std::move(columns));
+  statistics->rows_ = static_cast<double>(rows);
+  statistics->analyzed_rows_ = static_cast<double>(rows);
+  std::scoped_lock<std::shared_mutex> lock(tables_latch_);
+  tables_[catalog][table_info->oid_] = std::move(statistics);
+}
+
+void StatisticsCatalog::AnalyzeIfStale(Catalog *catalog, const TableInfo *table_info, Transaction *txn) {
+  auto statistics = GetTableStatistics(catalog, table_info->oid_);
+  if (statistics == nullptr || statistics->IsStale()) {
+    Analyze(catalog, table_info, txn);
+  }
+}
+
+void StatisticsCatalog::AnalyzeAll(Catalog *catalog, Transaction *txn) {
+  for (const auto &table_name : catalog->GetTableNames()) {
+    // 内部的表以 __ 开头
+    if (table_name.rfind("__", 0) == 0) {
+      continue;
+    }
+    Analyze(catalog, catalog->GetTable(table_name), txn);
+  }
+}
+
+auto StatisticsCatalog::GetTableStatistics(const Catalog *catalog, table_oid_t oid)
+    -> std::shared_ptr<TableStatistics> {
+  std::shared_lock<std::shared_mutex> lock(tables_latch_);
+  auto it = tables_.find(catalog);
+  if (it == tables_.end()) {
+    return nullptr;
+  }
+  auto table_it = it->second.find(oid);
+  return table_it == it->second.end() ? nullptr : table_it->second;
+}
+
+void StatisticsCatalog::Clear(const Catalog *catalog) {
+  std::scoped_lock<std::shared_mutex> lock(tables_latch_);
+  tables_.erase(catalog);
+}
+
+}  // namespace bustub
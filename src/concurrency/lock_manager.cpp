@@ -11,20 +11,65 @@
 //===----------------------------------------------------------------------===//
 
 #include <algorithm>
+#include <chrono>  // NOLINT
 #include <cstdlib>
 #include <memory>
 #include <mutex>  // NOLINT
 #include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "common/logger.h"
 #include "common/macros.h"
+#include "common/profile_counters.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
 #include "concurrency/transaction_manager.h"
 
 namespace bustub {
 
+LockManager::LockManager() {
+  enable_cycle_detection_ = true;
+  cycle_detection_thread_ = new std::thread(&LockManager::RunCycleDetection, this);
+}
+
+LockManager::~LockManager() {
+  enable_cycle_detection_ = false;
+  cycle_detection_thread_->join();
+  delete cycle_detection_thread_;
+}
+
+template <class Key>
+auto LockManager::NewQueue(LockTableShard<Key> *shard) -> std::shared_ptr<LockRequestQueue> {
+  if (shard->free_queues_.empty()) {
+    return std::make_shared<LockRequestQueue>();
+  }
+  auto queue = std::move(shard->free_queues_.back());
+  shard->free_queues_.pop_back();
+  return queue;
+}
+
+template <class Key>
+void LockManager::RecycleQueue(LockTableShard<Key> *shard, const Key &key, std::shared_ptr<LockRequestQueue> queue) {
+  std::scoped_lock<std::mutex> shard_lock(shard->latch_);
+  auto it = shard->map_.find(key);
+  // 其它线程只在 shard latch 下复制 map 中的 shared_ptr，
+  // 只剩 map 和 queue 两份时没有线程在等待或将要访问它
+  if (it == shard->map_.end() || it->second != queue || queue.use_count() != 2) {
+    return;
+  }
+  {
+    std::scoped_lock<std::mutex> lock(queue->latch_);
+    if (!queue->request_queue_.empty() || queue->upgrading_ != INVALID_TXN_ID) {
+      return;
+    }
+  }
+  shard->map_.erase(it);
+  if (shard->free_queues_.size() < LOCK_QUEUE_POOL_SIZE) {
+    shard->free_queues_.emplace_back(std::move(queue));
+  }
+}
+
 auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oid_t &oid) -> bool {
   LOG_INFO("LockTable(lock mode: %s) start, txn id: %d", ToString(lock_mode).c_str(), txn->GetTransactionId());
   txn->LockTxn();
@@ -44,18 +89,19 @@ auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oi
   }
 
   auto txn_id = txn->GetTransactionId();
-  table_lock_map_latch_.lock();
-  auto lock_request_queue_it = table_lock_map_.find(oid);
+  auto &shard = ShardOf(&table_lock_shards_, oid);
+  shard.latch_.lock();
+  auto lock_request_queue_it = shard.map_.find(oid);
 
   // 3. 如果不存在 lock_request_queue，则 grant
-  if (lock_request_queue_it == table_lock_map_.end()) {
+  if (lock_request_queue_it == shard.map_.end()) {
     auto lock_request = std::make_shared<LockRequest>(txn_id, lock_mode, oid);
     lock_request->granted_ = true;
     AddTableLockOnTxn(txn, lock_mode, oid);
-    auto request_lock_queue = std::make_shared<LockRequestQueue>();
+    auto request_lock_queue = NewQueue(&shard);
     request_lock_queue->request_queue_.emplace_back(lock_request);
-    table_lock_map_[oid] = request_lock_queue;
-    table_lock_map_latch_.unlock();
+    shard.map_[oid] = request_lock_queue;
+    shard.latch_.unlock();
     LOG_INFO("LockTable(lock mode: %s) true, txn id: %d", ToString(lock_mode).c_str(), txn->GetTransactionId());
     txn->UnlockTxn();
     return true;
@@ -63,7 +109,7 @@ auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oi
 
   auto lock_request_queue = lock_request_queue_it->second;
   std::unique_lock<std::mutex> lock(lock_request_queue->latch_);
-  table_lock_map_latch_.unlock();
+  shard.latch_.unlock();
 
   auto lock_request_it =
       std::find_if(lock_request_queue->request_queue_.begin(), lock_request_queue->request_queue_.end(),
@@ -96,13 +142,14 @@ auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oi
         LOG_INFO("LockTable: remove %s on table oid: %d", ToString((*it)->lock_mode_).c_str(), oid);
         it = lock_request_queue->request_queue_.erase(it);
       }
-      lock_request_queue->cv_.notify_all();
 
       lock_request_queue->upgrading_ = txn_id;
       auto first_waiting_it =
           std::find_if(lock_request_queue->request_queue_.begin(), lock_request_queue->request_queue_.end(),
                        [txn_id](const auto &item) { return item->txn_id_ == txn_id && !item->granted_; });
       lock_request_queue->request_queue_.insert(first_waiting_it, new_lock_request);
+      // 等待者前面可能多了 new_lock_request
+      NotifyWaiters(lock_request_queue, deadlock_policy_.load(std::memory_order_relaxed) == DeadlockPolicy::WAIT_DIE);
     } else {
       // 4.2 不需要进行 upgrade
       lock_request_queue->request_queue_.emplace_back(new_lock_request);
@@ -115,11 +162,7 @@ auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oi
   txn->UnlockTxn();
 
   // 5. 如果 new_lock_request 不兼容，则 wait
-  if (!CanGranted(new_lock_request, lock_request_queue)) {
-    lock_request_queue->cv_.wait(lock, [this, txn, new_lock_request, lock_request_queue] {
-      return txn->GetState() == TransactionState::ABORTED || CanGranted(new_lock_request, lock_request_queue);
-    });
-  }
+  WaitForGrant(txn, new_lock_request, lock_request_queue, &lock);
 
   if (lock_request_queue->upgrading_ == txn_id) {
     lock_request_queue->upgrading_ = INVALID_TXN_ID;
@@ -133,7 +176,7 @@ auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oi
       lock_request_queue->request_queue_.erase(tmp_it);
     }
     LOG_INFO("LockTable(lock mode: %s) false, txn id: %d", ToString(lock_mode).c_str(), txn->GetTransactionId());
-    lock_request_queue->cv_.notify_all();
+    NotifyWaiters(lock_request_queue);
     return false;
   }
 
@@ -147,6 +190,96 @@ auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oi
   return true;
 }
 
+auto LockManager::TryLockTable(Transaction *txn, LockMode lock_mode, const table_oid_t &oid) -> bool {
+  txn->LockTxn();
+  LockMode cur_lock_mode;
+  bool has_lock = GetTxnLockModeOnTable(txn, oid, &cur_lock_mode);
+  if (has_lock && cur_lock_mode == lock_mode) {
+    txn->UnlockTxn();
+    return true;
+  }
+  if (txn->GetState() != TransactionState::GROWING || (has_lock && !IsUpgrade(cur_lock_mode, lock_mode))) {
+    txn->UnlockTxn();
+    return false;
+  }
+
+  auto txn_id = txn->GetTransactionId();
+  auto &shard = ShardOf(&table_lock_shards_, oid);
+  shard.latch_.lock();
+  auto &lock_request_queue = shard.map_[oid];
+  if (lock_request_queue == nullptr) {
+    lock_request_queue = NewQueue(&shard);
+  }
+  std::unique_lock<std::mutex> lock(lock_request_queue->latch_);
+  shard.latch_.unlock();
+
+  // 其他 txn 的 lock 都已 granted 且兼容时才 grant，不插队
+  std::shared_ptr<LockRequest> old_lock_request;
+  for (const auto &item : lock_request_queue->request_queue_) {
+    if (item->txn_id_ == txn_id) {
+      if (item->granted_) {
+        old_lock_request = item;
+      }
+      continue;
+    }
+    if (!item->granted_ || !IsCompatible(lock_mode, item->lock_mode_)) {
+      txn->UnlockTxn();
+      return false;
+    }
+  }
+  if (lock_request_queue->upgrading_ != INVALID_TXN_ID) {
+    txn->UnlockTxn();
+    return false;
+  }
+
+  if (old_lock_request != nullptr) {
+    RemoveTableLockOnTxn(txn, old_lock_request->lock_mode_, oid);
+    old_lock_request->lock_mode_ = lock_mode;
+  } else {
+    auto lock_request = std::make_shared<LockRequest>(txn_id, lock_mode, oid);
+    lock_request->granted_ = true;
+    lock_request_queue->request_queue_.emplace_back(lock_request);
+  }
+  AddTableLockOnTxn(txn, lock_mode, oid);
+  LOG_INFO("TryLockTable(lock mode: %s) true, txn id: %d", ToString(lock_mode).c_str(), txn_id);
+  txn->UnlockTxn();
+  return true;
+}
+
+auto LockManager::DowngradeTable(Transaction *txn, LockMode lock_mode, const table_oid_t &oid) -> bool {
+  txn->LockTxn();
+  auto txn_id = txn->GetTransactionId();
+  LockMode cur_lock_mode;
+  // escalate 过的 table lock 还覆盖着已经释放的 row lock，不能降级
+  if (!GetTxnLockModeOnTable(txn, oid, &cur_lock_mode) || !IsUpgrade(lock_mode, cur_lock_mode) ||
+      IsEscalated(txn_id, oid)) {
+    txn->UnlockTxn();
+    return false;
+  }
+
+  auto &shard = ShardOf(&table_lock_shards_, oid);
+  shard.latch_.lock();
+  auto lock_request_queue = shard.map_[oid];
+  std::unique_lock<std::mutex> lock(lock_request_queue->latch_);
+  shard.latch_.unlock();
+
+  for (const auto &item : lock_request_queue->request_queue_) {
+    if (item->txn_id_ == txn_id && item->granted_) {
+      item->lock_mode_ = lock_mode;
+      break;
+    }
+  }
+  RemoveTableLockOnTxn(txn, cur_lock_mode, oid);
+  AddTableLockOnTxn(txn, lock_mode, oid);
+  CheckUnlockTransactionState(txn, cur_lock_mode);
+  LOG_INFO("DowngradeTable(lock mode: %s -> %s), txn id: %d", ToString(cur_lock_mode).c_str(),
+           ToString(lock_mode).c_str(), txn_id);
+  txn->UnlockTxn();
+
+  NotifyWaiters(lock_request_queue);
+  return true;
+}
+
 auto LockManager::UnlockTable(Transaction *txn, const table_oid_t &oid) -> bool {
   LOG_INFO("UnlockTable start, txn id: %d", txn->GetTransactionId());
   // 1. 检查 txn state
@@ -156,6 +289,15 @@ auto LockManager::UnlockTable(Transaction *txn, const table_oid_t &oid) -> bool
   txn->LockTxn();
 
   auto txn_id = txn->GetTransactionId();
+  {
+    std::scoped_lock<std::mutex> lock(escalation_latch_);
+    if (auto it = escalated_tables_.find(txn_id); it != escalated_tables_.end()) {
+      it->second.erase(oid);
+      if (it->second.empty()) {
+        escalated_tables_.erase(it);
+      }
+    }
+  }
 
   // 2. 先 unlock row，后 unlock table
   if (!(*txn->GetSharedRowLockSet())[oid].empty() || !(*txn->GetExclusiveRowLockSet())[oid].empty()) {
@@ -172,11 +314,13 @@ auto LockManager::UnlockTable(Transaction *txn, const table_oid_t &oid) -> bool
     throw TransactionAbortException(txn_id, AbortReason::ATTEMPTED_UNLOCK_BUT_NO_LOCK_HELD);
   }
 
-  table_lock_map_latch_.lock();
+  auto &shard = ShardOf(&table_lock_shards_, oid);
+  shard.latch_.lock();
 
-  auto it = table_lock_map_.find(oid);
+  auto it = shard.map_.find(oid);
   // 不存在 lock_request_queue
-  if (it == table_lock_map_.end()) {
+  if (it == shard.map_.end()) {
+    shard.latch_.unlock();
     txn->SetState(TransactionState::ABORTED);
     txn->UnlockTxn();
     throw TransactionAbortException(txn_id, AbortReason::ATTEMPTED_UNLOCK_BUT_NO_LOCK_HELD);
@@ -184,7 +328,7 @@ auto LockManager::UnlockTable(Transaction *txn, const table_oid_t &oid) -> bool
 
   auto lock_request_queue = it->second;
   std::unique_lock<std::mutex> lock(lock_request_queue->latch_);
-  table_lock_map_latch_.unlock();
+  shard.latch_.unlock();
 
   // 移除所有 txn 在 table 上 granted 的 lock_request
   bool flag = false;
@@ -214,11 +358,79 @@ auto LockManager::UnlockTable(Transaction *txn, const table_oid_t &oid) -> bool
   }
   txn->UnlockTxn();
 
-  lock_request_queue->cv_.notify_all();
+  NotifyWaiters(lock_request_queue);
   return true;
 }
 
 auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_t &oid, const RID &rid) -> bool {
+  if (!AcquireRowLock(txn, lock_mode, oid, rid)) {
+    return false;
+  }
+  MaybeEscalate(txn, oid);
+  return true;
+}
+
+auto LockManager::LockRows(Transaction *txn, LockMode lock_mode, const table_oid_t &oid, const std::vector<RID> &rids)
+    -> bool {
+  if (rids.empty()) {
+    return true;
+  }
+  // 第一个 row 完成所有检查，之后的 row 只需要检查自己的锁
+  if (!AcquireRowLock(txn, lock_mode, oid, rids[0])) {
+    return false;
+  }
+  auto txn_id = txn->GetTransactionId();
+  std::vector<const RID *> slow_rids;
+  txn->LockTxn();
+  bool covered = IsEscalated(txn_id, oid) &&
+                 (txn->IsTableExclusiveLocked(oid) ||
+                  (lock_mode == LockMode::SHARED &&
+                   (txn->IsTableSharedLocked(oid) || txn->IsTableSharedIntentionExclusiveLocked(oid))));
+  if (!covered) {
+    // 按 shard 分组，每个 shard 的 latch 只获取一次
+    std::vector<std::pair<LockTableShard<RID> *, const RID *>> by_shard;
+    by_shard.reserve(rids.size() - 1);
+    for (size_t i = 1; i < rids.size(); i++) {
+      LockMode cur_lock_mode;
+      if (!GetTxnLockModeOnRow(txn, oid, rids[i], &cur_lock_mode)) {
+        by_shard.emplace_back(&ShardOf(&row_lock_shards_, rids[i]), &rids[i]);
+      } else if (cur_lock_mode != lock_mode) {
+        // upgrade
+        slow_rids.emplace_back(&rids[i]);
+      }
+    }
+    std::sort(by_shard.begin(), by_shard.end());
+    for (size_t i = 0; i < by_shard.size();) {
+      auto shard = by_shard[i].first;
+      std::scoped_lock<std::mutex> lock(shard->latch_);
+      for (; i < by_shard.size() && by_shard[i].first == shard; i++) {
+        const auto &rid = *by_shard[i].second;
+        // 其他 txn 的 request 可能不兼容，走 AcquireRowLock
+        if (shard->map_.count(rid) != 0) {
+          slow_rids.emplace_back(&rid);
+          continue;
+        }
+        auto row_lock_request = std::make_shared<LockRequest>(txn_id, lock_mode, oid, rid);
+        row_lock_request->granted_ = true;
+        auto request_lock_queue = NewQueue(shard);
+        request_lock_queue->request_queue_.emplace_back(std::move(row_lock_request));
+        shard->map_[rid] = std::move(request_lock_queue);
+        AddRowLockOnTxn(txn, lock_mode, oid, rid);
+      }
+    }
+  }
+  txn->UnlockTxn();
+  for (auto rid : slow_rids) {
+    if (!AcquireRowLock(txn, lock_mode, oid, *rid)) {
+      return false;
+    }
+  }
+  MaybeEscalate(txn, oid);
+  return true;
+}
+
+auto LockManager::AcquireRowLock(Transaction *txn, LockMode lock_mode, const table_oid_t &oid, const RID &rid)
+    -> bool {
   LOG_INFO("LockRow(lock mode: %s) start, txn id: %d, rid: %s", ToString(lock_mode).c_str(), txn->GetTransactionId(),
            rid.ToString().c_str());
   BUSTUB_ENSURE(txn->GetState() == TransactionState::GROWING || txn->GetState() == TransactionState::SHRINKING,
@@ -264,27 +476,37 @@ auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_
     }
   }
 
-  row_lock_map_latch_.lock();
+  // row lock 已经 escalate，table lock 覆盖这个 row
+  if (IsEscalated(txn_id, oid) &&
+      (txn->IsTableExclusiveLocked(oid) ||
+       (lock_mode == LockMode::SHARED &&
+        (txn->IsTableSharedLocked(oid) || txn->IsTableSharedIntentionExclusiveLocked(oid))))) {
+    txn->UnlockTxn();
+    return true;
+  }
+
+  auto &shard = ShardOf(&row_lock_shards_, rid);
+  shard.latch_.lock();
 
-  auto row_lock_request_queue_it = row_lock_map_.find(rid);
+  auto row_lock_request_queue_it = shard.map_.find(rid);
   // 如果不存在 row_lock_request_queue，则 grant
-  if (row_lock_request_queue_it == row_lock_map_.end()) {
+  if (row_lock_request_queue_it == shard.map_.end()) {
     auto row_lock_request = std::make_shared<LockRequest>(txn_id, lock_mode, oid, rid);
     row_lock_request->granted_ = true;
-    auto request_lock_queue = std::make_shared<LockRequestQueue>();
+    auto request_lock_queue = NewQueue(&shard);
     request_lock_queue->request_queue_.emplace_back(row_lock_request);
-    row_lock_map_[rid] = request_lock_queue;
+    shard.map_[rid] = request_lock_queue;
     AddRowLockOnTxn(txn, lock_mode, oid, rid);
     LOG_INFO("LockRow(lock mode: %s) true, txn id: %d, rid: %s", ToString(lock_mode).c_str(), txn->GetTransactionId(),
              rid.ToString().c_str());
-    row_lock_map_latch_.unlock();
+    shard.latch_.unlock();
     txn->UnlockTxn();
     return true;
   }
 
   auto row_lock_request_queue = row_lock_request_queue_it->second;
   std::unique_lock<std::mutex> lock(row_lock_request_queue->latch_);
-  row_lock_map_latch_.unlock();
+  shard.latch_.unlock();
 
   auto row_lock_request_it =
       std::find_if(row_lock_request_queue->request_queue_.begin(), row_lock_request_queue->request_queue_.end(),
@@ -317,13 +539,15 @@ auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_
                  rid.ToString().c_str());
         it = row_lock_request_queue->request_queue_.erase(it);
       }
-      row_lock_request_queue->cv_.notify_all();
 
       row_lock_request_queue->upgrading_ = txn_id;
       auto first_waiting_it =
           std::find_if(row_lock_request_queue->request_queue_.begin(), row_lock_request_queue->request_queue_.end(),
                        [txn_id](const auto &item) { return item->txn_id_ == txn_id && !item->granted_; });
       row_lock_request_queue->request_queue_.insert(first_waiting_it, row_new_lock_request);
+      // 等待者前面可能多了 row_new_lock_request
+      NotifyWaiters(row_lock_request_queue,
+                    deadlock_policy_.load(std::memory_order_relaxed) == DeadlockPolicy::WAIT_DIE);
     } else {
       // 4.2 不需要进行 upgrade
       row_lock_request_queue->request_queue_.emplace_back(row_new_lock_request);
@@ -336,11 +560,7 @@ auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_
   txn->UnlockTxn();
 
   // 如果 new_lock_request 不兼容，则 wait
-  if (!CanGranted(row_new_lock_request, row_lock_request_queue)) {
-    row_lock_request_queue->cv_.wait(lock, [this, txn, row_new_lock_request, row_lock_request_queue] {
-      return txn->GetState() == TransactionState::ABORTED || CanGranted(row_new_lock_request, row_lock_request_queue);
-    });
-  }
+  WaitForGrant(txn, row_new_lock_request, row_lock_request_queue, &lock);
 
   if (row_lock_request_queue->upgrading_ == txn_id) {
     row_lock_request_queue->upgrading_ = INVALID_TXN_ID;
@@ -355,7 +575,7 @@ auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_
     }
     LOG_INFO("LockRow(lock mode: %s) false, txn id: %d, rid: %s", ToString(lock_mode).c_str(), txn->GetTransactionId(),
              rid.ToString().c_str());
-    row_lock_request_queue->cv_.notify_all();
+    NotifyWaiters(row_lock_request_queue);
     return false;
   }
 
@@ -367,6 +587,70 @@ auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_
   return true;
 }
 
+auto LockManager::IsEscalated(txn_id_t txn_id, const table_oid_t &oid) -> bool {
+  std::scoped_lock<std::mutex> lock(escalation_latch_);
+  auto it = escalated_tables_.find(txn_id);
+  return it != escalated_tables_.end() && it->second.count(oid) > 0;
+}
+
+void LockManager::MaybeEscalate(Transaction *txn, const table_oid_t &oid) {
+  auto threshold = escalation_threshold_.load(std::memory_order_relaxed);
+  if (threshold == 0) {
+    return;
+  }
+  txn->LockTxn();
+  auto &shared_rows = (*txn->GetSharedRowLockSet())[oid];
+  auto &exclusive_rows = (*txn->GetExclusiveRowLockSet())[oid];
+  auto num_rows = shared_rows.size() + exclusive_rows.size();
+  LockMode table_lock_mode;
+  // 超过 threshold 时尝试，失败后每多 threshold 个 row lock 再试一次
+  if (num_rows <= threshold || num_rows % threshold != 1 || !GetTxnLockModeOnTable(txn, oid, &table_lock_mode)) {
+    txn->UnlockTxn();
+    return;
+  }
+  auto lock_mode = LockMode::SHARED;
+  if (!exclusive_rows.empty() || table_lock_mode == LockMode::EXCLUSIVE) {
+    lock_mode = LockMode::EXCLUSIVE;
+  } else if (table_lock_mode != LockMode::INTENTION_SHARED && table_lock_mode != LockMode::SHARED) {
+    lock_mode = LockMode::SHARED_INTENTION_EXCLUSIVE;
+  }
+  txn->UnlockTxn();
+  if (!TryLockTable(txn, lock_mode, oid)) {
+    return;
+  }
+
+  auto txn_id = txn->GetTransactionId();
+  txn->LockTxn();
+  {
+    std::scoped_lock<std::mutex> lock(escalation_latch_);
+    escalated_tables_[txn_id].emplace(oid);
+  }
+  // 释放所有 row lock，txn state 不变
+  std::vector<RID> rids(shared_rows.begin(), shared_rows.end());
+  rids.insert(rids.end(), exclusive_rows.begin(), exclusive_rows.end());
+  for (const auto &rid : rids) {
+    auto &shard = ShardOf(&row_lock_shards_, rid);
+    shard.latch_.lock();
+    auto it = shard.map_.find(rid);
+    if (it == shard.map_.end()) {
+      shard.latch_.unlock();
+      continue;
+    }
+    auto row_lock_request_queue = it->second;
+    std::unique_lock<std::mutex> lock(row_lock_request_queue->latch_);
+    shard.latch_.unlock();
+    row_lock_request_queue->request_queue_.remove_if(
+        [txn_id](const auto &item) { return item->txn_id_ == txn_id && item->granted_; });
+    NotifyWaiters(row_lock_request_queue);
+    lock.unlock();
+    RecycleQueue(&shard, rid, std::move(row_lock_request_queue));
+  }
+  shared_rows.clear();
+  exclusive_rows.clear();
+  LOG_INFO("escalate %lu row locks to %s, txn id: %d, oid: %d", rids.size(), ToString(lock_mode).c_str(), txn_id, oid);
+  txn->UnlockTxn();
+}
+
 auto LockManager::UnlockRow(Transaction *txn, const table_oid_t &oid, const RID &rid) -> bool {
   LOG_INFO("UnlockRow start, txn id: %d, rid: %s", txn->GetTransactionId(), rid.ToString().c_str());
   // if (txn->GetState() != TransactionState::GROWING && txn->GetState() != TransactionState::SHRINKING) {
@@ -380,16 +664,23 @@ auto LockManager::UnlockRow(Transaction *txn, const table_oid_t &oid, const RID
   // 该 txn 未在该 row 上 lock
   LockMode cur_tmp_mode;
   if (!GetTxnLockModeOnRow(txn, oid, rid, &cur_tmp_mode)) {
+    // row lock 在 escalation 时已经释放
+    if (IsEscalated(txn_id, oid)) {
+      txn->UnlockTxn();
+      return true;
+    }
     txn->SetState(TransactionState::ABORTED);
     txn->UnlockTxn();
     throw TransactionAbortException(txn_id, AbortReason::ATTEMPTED_UNLOCK_BUT_NO_LOCK_HELD);
   }
 
-  row_lock_map_latch_.lock();
+  auto &shard = ShardOf(&row_lock_shards_, rid);
+  shard.latch_.lock();
 
-  auto it = row_lock_map_.find(rid);
+  auto it = shard.map_.find(rid);
   // 这个 row 未加锁，则 aborted
-  if (it == row_lock_map_.end()) {
+  if (it == shard.map_.end()) {
+    shard.latch_.unlock();
     txn->SetState(TransactionState::ABORTED);
     txn->UnlockTxn();
     throw TransactionAbortException(txn_id, AbortReason::ATTEMPTED_UNLOCK_BUT_NO_LOCK_HELD);
@@ -397,7 +688,7 @@ auto LockManager::UnlockRow(Transaction *txn, const table_oid_t &oid, const RID
 
   auto lock_request_queue = it->second;
   std::unique_lock<std::mutex> lock(lock_request_queue->latch_);
-  row_lock_map_latch_.unlock();
+  shard.latch_.unlock();
 
   // 移除所有 txn 在 row 上 granted 的 lock_request
   bool flag = false;
@@ -428,7 +719,9 @@ auto LockManager::UnlockRow(Transaction *txn, const table_oid_t &oid, const RID
   }
   txn->UnlockTxn();
 
-  lock_request_queue->cv_.notify_all();
+  NotifyWaiters(lock_request_queue);
+  lock.unlock();
+  RecycleQueue(&shard, rid, std::move(lock_request_queue));
   return true;
 }
 
@@ -455,49 +748,51 @@ void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) {
 auto LockManager::HasCycle(txn_id_t *txn_id) -> bool {
   // std::unique_lock<std::mutex> lock(waits_for_latch_);
   LOG_INFO("HasCycle start");
-  // vis 保存遍历过的 edge
-  std::map<txn_id_t, std::map<txn_id_t, bool>> vis;
   // ordered_keys 从小到大保存 waits_for_ 的 key
   std::vector<txn_id_t> ordered_keys;
+  ordered_keys.reserve(waits_for_.size());
   for (const auto &pair : waits_for_) {
     ordered_keys.push_back(pair.first);
   }
   std::sort(ordered_keys.begin(), ordered_keys.end());
 
+  std::unordered_set<txn_id_t> done;
   for (const auto &key : ordered_keys) {
-    // has 保存走的路径上 txn_id 集合
-    std::set<txn_id_t> has;
-    has.emplace(key);
-    if (DFSHasCyCleL(vis, has, key, txn_id)) {
+    if (done.count(key) == 0 && FindCycle(key, &done, txn_id)) {
       LOG_INFO("HasCycle end(true): %d", *txn_id);
       return true;
     }
   }
-  LOG_INFO("HasCycle end(false): %d", *txn_id);
+  LOG_INFO("HasCycle end(false)");
   return false;
 }
 
-auto LockManager::DFSHasCyCleL(std::map<txn_id_t, std::map<txn_id_t, bool>> &vis, std::set<txn_id_t> &has,
-                               const txn_id_t &now_txn_id, txn_id_t *txn_id) -> bool {
-  for (const auto &next_txn_id : waits_for_[now_txn_id]) {
-    // 已遍历过
-    if (vis[now_txn_id][next_txn_id]) {
+auto LockManager::FindCycle(txn_id_t start, std::unordered_set<txn_id_t> *done, txn_id_t *txn_id) -> bool {
+  // dfs 路径上的 txn，以及它下一个要访问的 edge
+  std::vector<std::pair<txn_id_t, size_t>> path{{start, 0}};
+  std::unordered_set<txn_id_t> on_path{start};
+  while (!path.empty()) {
+    auto now_txn_id = path.back().first;
+    auto it = waits_for_.find(now_txn_id);
+    if (it == waits_for_.end() || path.back().second >= it->second.size()) {
+      on_path.erase(now_txn_id);
+      done->emplace(now_txn_id);
+      path.pop_back();
       continue;
     }
-    vis[now_txn_id][next_txn_id] = true;
-    auto it = has.find(next_txn_id);
-
-    // 有环
-    if (it != has.end()) {
-      *txn_id = now_txn_id;
+    auto next_txn_id = it->second[path.back().second++];
+    // 有环，环是 path 中从 next_txn_id 开始的部分
+    if (on_path.count(next_txn_id) > 0) {
+      *txn_id = next_txn_id;
+      for (auto i = path.rbegin(); i->first != next_txn_id; i++) {
+        *txn_id = std::max(*txn_id, i->first);
+      }
       return true;
     }
-
-    has.emplace(next_txn_id);
-    if (DFSHasCyCleL(vis, has, next_txn_id, txn_id)) {
-      return true;
+    if (done->count(next_txn_id) == 0) {
+      path.emplace_back(next_txn_id, 0);
+      on_path.emplace(next_txn_id);
     }
-    has.erase(next_txn_id);
   }
   return false;
 }
@@ -515,109 +810,180 @@ auto LockManager::GetEdgeList() -> std::vector<std::pair<txn_id_t, txn_id_t>> {
 }
 
 void LockManager::Detection() {
-  std::unique_lock<std::mutex> waits_for_lock(waits_for_latch_);
-  std::unique_lock<std::mutex> table_lock(table_lock_map_latch_);
-  std::unique_lock<std::mutex> row_lock(row_lock_map_latch_);
-  LOG_INFO("Detection start:");
-
-  waits_for_.clear();
-
-  // add edge for table
-  for (auto &pair : table_lock_map_) {
-    AddEdgeFromLRQ(pair.second);
+  // 等待时已经检查过 cycle，这里只处理 Graph API 留下的 cycle
+  std::vector<std::pair<txn_id_t, std::shared_ptr<LockRequestQueue>>> victims;
+  {
+    std::scoped_lock<std::mutex> lock(waits_for_latch_);
+    txn_id_t txn_id = INVALID_TXN_ID;
+    while (HasCycle(&txn_id)) {
+      LOG_INFO("txn %d is aborted", txn_id);
+      waits_for_.erase(txn_id);
+      auto it = waiting_on_.find(txn_id);
+      if (it != waiting_on_.end()) {
+        victims.emplace_back(txn_id, it->second);
+        waiting_on_.erase(it);
+      }
+    }
   }
-
-  // add edge for row
-  for (auto &pair : row_lock_map_) {
-    AddEdgeFromLRQ(pair.second);
+  for (const auto &[txn_id, lock_request_queue] : victims) {
+    AbortWaiter(txn_id, lock_request_queue);
   }
+}
 
-  // LOG_INFO("==============");
-  // std::vector<std::pair<txn_id_t, txn_id_t>> edges;
-  // for (auto &txns : waits_for_) {
-  //   auto t1 = txns.first;
-  //   for (auto &t2 : txns.second) {
-  //     edges.emplace_back(std::make_pair(t1, t2));
-  //   }
-  // }
-  // for (const auto &[t1, t2] : edges) {
-  //   LOG_INFO("%d -> %d", t1, t2);
-  // }
-
-  // 建好图后，检测是否有 cycle，并 abort cycle 中最大的 txn
-  txn_id_t txn_id = INVALID_TXN_ID;
-  while (HasCycle(&txn_id)) {
-    auto txn = TransactionManager::GetTransaction(txn_id);
-    txn->LockTxn();
-    txn->SetState(TransactionState::ABORTED);
-    LOG_INFO("txn %d is aborted", txn_id);
-
-    // remove edge
-    waits_for_.erase(txn_id);
-    for (auto &[k, vs] : waits_for_) {
-      for (auto it = vs.begin(); it != vs.end();) {
-        if (*it == txn_id) {
-          it = vs.erase(it);
-        } else {
-          it++;
-        }
-      }
+void LockManager::WaitForGrant(Transaction *txn, const std::shared_ptr<LockRequest> &lock_request,
+                               const std::shared_ptr<LockRequestQueue> &lock_request_queue,
+                               std::unique_lock<std::mutex> *lock) {
+  auto txn_id = txn->GetTransactionId();
+  bool waiting = false;
+  std::chrono::steady_clock::time_point wait_start;
+  while (txn->GetState() != TransactionState::ABORTED && !CanGranted(lock_request, lock_request_queue)) {
+    if (!waiting) {
+      wait_start = std::chrono::steady_clock::now();
+    }
+    // 每次被唤醒后 queue 都可能变化，重新计算 edge
+    waiting = true;
+    std::shared_ptr<LockRequestQueue> victim_queue;
+    auto victim =
+        AddWaitsFor(txn_id, BlockersOf(lock_request, lock_request_queue), lock_request_queue, &victim_queue);
+    if (victim == INVALID_TXN_ID) {
+      lock_request->cv_.wait(*lock);
+      continue;
+    }
+    // 加锁顺序是 txn latch -> queue latch，abort 前先释放 queue latch
+    lock->unlock();
+    if (victim == txn_id) {
+      txn->LockTxn();
+      txn->SetState(TransactionState::ABORTED);
+      txn->UnlockTxn();
+    } else {
+      AbortWaiter(victim, victim_queue);
     }
+    lock->lock();
+  }
+  if (waiting) {
+    RemoveWaitsFor(txn_id);
+    auto &counters = ThreadProfileCounters::Get();
+    counters.lock_waits_++;
+    counters.lock_wait_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - wait_start)
+                                  .count();
+  }
+}
 
-    // remove lock request for table
-    for (auto &pair : table_lock_map_) {
-      RemoveLQFromLRQ(pair.second, txn_id);
-      pair.second->cv_.notify_all();
+auto LockManager::BlockersOf(const std::shared_ptr<LockRequest> &lock_request,
+                             const std::shared_ptr<LockRequestQueue> &lock_request_queue) -> std::vector<txn_id_t> {
+  std::vector<txn_id_t> blockers;
+  for (const auto &item : lock_request_queue->request_queue_) {
+    if (item == lock_request) {
+      break;
+    }
+    // 前面不兼容的 lock，以及前面还在等待的 lock
+    if (item->txn_id_ != lock_request->txn_id_ &&
+        (!item->granted_ || !IsCompatible(lock_request->lock_mode_, item->lock_mode_))) {
+      blockers.push_back(item->txn_id_);
     }
+  }
+  std::sort(blockers.begin(), blockers.end());
+  blockers.erase(std::unique(blockers.begin(), blockers.end()), blockers.end());
+  return blockers;
+}
 
-    // remove lock request for row
-    for (auto &pair : row_lock_map_) {
-      RemoveLQFromLRQ(pair.second, txn_id);
-      pair.second->cv_.notify_all();
+auto LockManager::AddWaitsFor(txn_id_t txn_id, std::vector<txn_id_t> blockers,
+                              const std::shared_ptr<LockRequestQueue> &lock_request_queue,
+                              std::shared_ptr<LockRequestQueue> *victim_queue) -> txn_id_t {
+  if (deadlock_policy_.load(std::memory_order_relaxed) == DeadlockPolicy::WAIT_DIE) {
+    // 只有 older txn 可以等待 younger txn
+    if (!blockers.empty() && blockers.front() < txn_id) {
+      LOG_INFO("txn %d dies waiting for txn %d", txn_id, blockers.front());
+      return txn_id;
     }
+    return INVALID_TXN_ID;
+  }
 
-    // remove lock on txn
-    txn->GetSharedTableLockSet()->clear();
-    txn->GetExclusiveTableLockSet()->clear();
-    txn->GetIntentionExclusiveTableLockSet()->clear();
-    txn->GetIntentionSharedTableLockSet()->clear();
-    txn->GetSharedIntentionExclusiveTableLockSet()->clear();
-    txn->GetSharedRowLockSet()->clear();
-    txn->GetExclusiveRowLockSet()->clear();
-    txn->UnlockTxn();
+  std::scoped_lock<std::mutex> lock(waits_for_latch_);
+  waits_for_[txn_id] = std::move(blockers);
+  waiting_on_[txn_id] = lock_request_queue;
+  // 新的 cycle 一定经过 txn_id
+  std::unordered_set<txn_id_t> done;
+  txn_id_t victim;
+  if (!FindCycle(txn_id, &done, &victim)) {
+    return INVALID_TXN_ID;
   }
+  LOG_INFO("txn %d is aborted", victim);
+  // 立即移除 victim 的 edge，其它 txn 不会因为同一个 cycle 再选中它
+  waits_for_.erase(victim);
+  auto it = waiting_on_.find(victim);
+  if (it == waiting_on_.end()) {
+    // 只由 Graph API 加入的 txn
+    return INVALID_TXN_ID;
+  }
+  *victim_queue = std::move(it->second);
+  waiting_on_.erase(it);
+  return victim;
 }
 
-void LockManager::RemoveLQFromLRQ(std::shared_ptr<LockRequestQueue> &lock_request_queue, const txn_id_t &txn_id) {
-  for (auto iter = lock_request_queue->request_queue_.begin(); iter != lock_request_queue->request_queue_.end();) {
-    if ((*iter)->txn_id_ == txn_id && (*iter)->granted_) {
-      LOG_INFO("remove granted lock request with txn id: %d", txn_id);
-      iter = lock_request_queue->request_queue_.erase(iter);
-    } else {
-      iter++;
+void LockManager::RemoveWaitsFor(txn_id_t txn_id) {
+  std::scoped_lock<std::mutex> lock(waits_for_latch_);
+  waits_for_.erase(txn_id);
+  waiting_on_.erase(txn_id);
+}
+
+void LockManager::NotifyWaiters(const std::shared_ptr<LockRequestQueue> &lock_request_queue, bool wake_all) {
+  auto &request_queue = lock_request_queue->request_queue_;
+  auto it = request_queue.begin();
+  // FIFO：可以 grant 的等待者是 queue 前面的一段，它与它前面所有的 lock 都兼容
+  for (; it != request_queue.end(); it++) {
+    const auto &lock_request = *it;
+    if (lock_request->granted_) {
+      continue;
     }
+    auto grantable = std::all_of(request_queue.begin(), it, [this, &lock_request](const auto &item) {
+      return IsCompatible(lock_request->lock_mode_, item->lock_mode_) ||
+             (item->txn_id_ == lock_request->txn_id_ && item->lock_mode_ == lock_request->lock_mode_);
+    });
+    if (!grantable) {
+      break;
+    }
+    lock_request->cv_.notify_one();
+  }
+  if (wake_all) {
+    for (; it != request_queue.end(); it++) {
+      (*it)->cv_.notify_one();
+    }
+    return;
+  }
+  if (it == request_queue.end() || deadlock_policy_.load(std::memory_order_relaxed) != DeadlockPolicy::DETECTION) {
+    return;
+  }
+
+  // 其它等待者不唤醒，直接更新它们的 edge。只有 upgrade 会增加 edge，都指向 upgrade 的 txn，
+  // 它等待时会检查经过它的 cycle
+  std::scoped_lock<std::mutex> lock(waits_for_latch_);
+  for (; it != request_queue.end(); it++) {
+    const auto &lock_request = *it;
+    auto waiting_it = waiting_on_.find(lock_request->txn_id_);
+    if (lock_request->granted_ || waiting_it == waiting_on_.end() || waiting_it->second != lock_request_queue) {
+      continue;
+    }
+    waits_for_[lock_request->txn_id_] = BlockersOf(lock_request, lock_request_queue);
   }
 }
 
-void LockManager::AddEdgeFromLRQ(const std::shared_ptr<LockRequestQueue> &lock_request_queue) {
-  auto request_queue = lock_request_queue->request_queue_;
-  for (auto i = request_queue.begin(); i != request_queue.end(); i++) {
-    auto j = i;
-    for (j++; j != request_queue.end(); j++) {
-      // 如果兼容，则不属于 waiting
-      if (IsCompatible(i->get()->lock_mode_, j->get()->lock_mode_)) {
-        continue;
-      }
-      // i -> j
-      if (!i->get()->granted_ && j->get()->granted_) {
-        AddEdge(i->get()->txn_id_, j->get()->txn_id_);
-      }
-      // j -> i
-      if (!j->get()->granted_ && i->get()->granted_) {
-        AddEdge(j->get()->txn_id_, i->get()->txn_id_);
-      }
+void LockManager::AbortWaiter(txn_id_t txn_id, const std::shared_ptr<LockRequestQueue> &lock_request_queue) {
+  auto txn = TransactionManager::GetTransaction(txn_id);
+  txn->LockTxn();
+  {
+    // 等待的 txn 在 queue latch 下检查 state，在 latch 下修改并 notify 才不会错过
+    std::scoped_lock<std::mutex> lock(lock_request_queue->latch_);
+    auto it = std::find_if(lock_request_queue->request_queue_.begin(), lock_request_queue->request_queue_.end(),
+                           [txn_id](const auto &item) { return item->txn_id_ == txn_id && !item->granted_; });
+    // txn 已经 granted 时 cycle 已经不存在了
+    if (it != lock_request_queue->request_queue_.end()) {
+      txn->SetState(TransactionState::ABORTED);
+      (*it)->cv_.notify_one();
     }
   }
+  txn->UnlockTxn();
 }
 
 void LockManager::RunCycleDetection() {
@@ -852,6 +1218,21 @@ void LockManager::RemoveRowLockOnTxn(Transaction *txn, const LockMode &lock_mode
   }
 }
 
+auto LockManager::IsUpgrade(const LockMode &cur_lock_mode, const LockMode &req_lock_mode) -> bool {
+  switch (cur_lock_mode) {
+    case LockMode::INTENTION_SHARED:
+      return req_lock_mode != LockMode::INTENTION_SHARED;
+    case LockMode::SHARED:
+    case LockMode::INTENTION_EXCLUSIVE:
+      return req_lock_mode == LockMode::EXCLUSIVE || req_lock_mode == LockMode::SHARED_INTENTION_EXCLUSIVE;
+    case LockMode::SHARED_INTENTION_EXCLUSIVE:
+      return req_lock_mode == LockMode::EXCLUSIVE;
+    case LockMode::EXCLUSIVE:
+      return false;
+  }
+  return false;
+}
+
 auto LockManager::CanUpgradeLock(Transaction *txn, const LockMode &cur_lock_mode, const LockMode &req_lock_mode)
     -> bool {
   switch (cur_lock_mode) {
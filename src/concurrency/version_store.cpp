@@ -0,0 +1,309 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.cpp
+//
+// Identification: src/concurrency/version_store.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include "concurrency/transaction_manager.h"
+#include "concurrency/version_store.h"
+#include "storage/table/table_heap.h"
+
+namespace bustub {
+
+namespace {
+
+auto IsFinished(txn_id_t txn_id) -> bool {
+  auto state = TransactionManager::GetTransaction(txn_id)->GetState();
+  return state == TransactionState::COMMITTED || state == TransactionState::ABORTED;
+}
+
+}  // namespace
+
+auto VersionStore::GetTable(table_oid_t oid, bool create) -> TableVersions * {
+  {
+    std::shared_lock<std::shared_mutex> rlock(tables_latch_);
+    auto it = tables_.find(oid);
+    if (it != tables_.end()) {
+      return it->second.get();
+    }
+  }
+  if (!create) {
+    return nullptr;
+  }
+  std::scoped_lock<std::shared_mutex> wlock(tables_latch_);
+  auto &table = tables_[oid];
+  if (table == nullptr) {
+    table = std::make_unique<TableVersions>();
+  }
+  return table.get();
+}
+
+auto VersionStore::IsVisible(const UndoEntry &entry, const Snapshot &snapshot) -> bool {
+  if (entry.writer_ == snapshot.txn_id_) {
+    return true;
+  }
+  if (entry.write_ts_ >= snapshot.read_ts_ || snapshot.active_.count(entry.writer_) != 0) {
+    return false;
+  }
+  return TransactionManager::GetTransaction(entry.writer_)->GetState() == TransactionState::COMMITTED;
+}
+
+auto VersionStore::GetSnapshot(Transaction *txn) -> std::shared_ptr<const Snapshot> {
+  auto txn_id = txn->GetTransactionId();
+  bool repeatable = txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ;
+  std::scoped_lock<std::mutex> lock(registry_latch_);
+  if (repeatable) {
+    auto it = txn_snapshots_.find(txn_id);
+    if (it != txn_snapshots_.end()) {
+      return it->second;
+    }
+  }
+  auto snapshot = std::make_shared<Snapshot>();
+  snapshot->txn_id_ = txn_id;
+  snapshot->read_ts_ = next_ts_++;
+  for (auto it = writers_.begin(); it != writers_.end();) {
+    if (IsFinished(it->first)) {
+      it = writers_.erase(it);
+      continue;
+    }
+    if (it->first != txn_id) {
+      snapshot->active_.insert(it->first);
+    }
+    it++;
+  }
+  snapshots_.emplace_back(snapshot);
+  if (repeatable) {
+    txn_snapshots_.emplace(txn_id, snapshot);
+  }
+  return snapshot;
+}
+
+auto VersionStore::RegisterWriter(Transaction *txn) -> uint64_t {
+  std::scoped_lock<std::mutex> lock(registry_latch_);
+  auto [it, inserted] = writers_.try_emplace(txn->GetTransactionId(), next_ts_);
+  if (inserted) {
+    next_ts_++;
+  }
+  return it->second;
+}
+
+void VersionStore::InsertTuples(Transaction *txn, table_oid_t oid, TableHeap *table_heap,
+                                const std::vector<const Tuple *> &tuples, std::vector<RID> *rids) {
+  rids->assign(tuples.size(), RID());
+  if (!IsEnabled()) {
+    for (size_t i = 0; i < tuples.size(); i++) {
+      table_heap->InsertTuple(*tuples[i], &(*rids)[i], txn);
+    }
+    return;
+  }
+  auto table = GetTable(oid, true);
+  // 先增加计数再插入，reader 读到新行之后一定能看到计数或 chain
+  table->inserts_in_flight_.fetch_add(1);
+  for (size_t i = 0; i < tuples.size(); i++) {
+    // 每一行单独持有 latch，reader 最多等待一行的 insert
+    std::scoped_lock<std::mutex> lock(table->insert_latch_);
+    if (table_heap->InsertTuple(*tuples[i], &(*rids)[i], txn)) {
+      RecordWrite(txn, oid, (*rids)[i], nullptr);
+    } else {
+      (*rids)[i] = RID();
+    }
+  }
+  table->inserts_in_flight_.fetch_sub(1);
+}
+
+void VersionStore::RecordWrite(Transaction *txn, table_oid_t oid, const RID &rid, const Tuple *before) {
+  auto txn_id = txn->GetTransactionId();
+  auto write_ts = RegisterWriter(txn);
+  auto shard = ShardOf(GetTable(oid, true), rid.GetPageId());
+  {
+    std::scoped_lock<std::mutex> lock(shard->latch_);
+    auto &chain = shard->pages_[rid.GetPageId()][rid.GetSlotNum()];
+    // 同一个 txn 再次写这一行时，其他 reader 只需要它第一次写之前的版本
+    if (chain.empty() || chain.back().writer_ != txn_id) {
+      chain.push_back(UndoEntry{txn_id, write_ts, before != nullptr, before != nullptr ? *before : Tuple{}});
+    }
+  }
+  if (writes_since_gc_.fetch_add(1, std::memory_order_relaxed) + 1 >= VERSION_GC_INTERVAL) {
+    GarbageCollect();
+  }
+}
+
+auto VersionStore::IsWriteConflict(Transaction *txn, table_oid_t oid, const RID &rid) -> bool {
+  if (txn->GetIsolationLevel() != IsolationLevel::REPEATABLE_READ) {
+    return false;
+  }
+  auto table = GetTable(oid, false);
+  if (table == nullptr) {
+    return false;
+  }
+  auto snapshot = GetSnapshot(txn);
+  auto shard = ShardOf(table, rid.GetPageId());
+  std::scoped_lock<std::mutex> lock(shard->latch_);
+  auto page_it = shard->pages_.find(rid.GetPageId());
+  if (page_it == shard->pages_.end()) {
+    return false;
+  }
+  auto chain_it = page_it->second.find(rid.GetSlotNum());
+  if (chain_it == page_it->second.end()) {
+    return false;
+  }
+  // 已经 abort 的写入被 rollback 了，不算 conflict
+  for (auto it = chain_it->second.rbegin(); it != chain_it->second.rend(); it++) {
+    if (TransactionManager::GetTransaction(it->writer_)->GetState() != TransactionState::ABORTED) {
+      return !IsVisible(*it, *snapshot);
+    }
+  }
+  return false;
+}
+
+auto VersionStore::ReadVisible(TableHeap *table_heap, table_oid_t oid, const RID &rid, const Snapshot &snapshot,
+                               Transaction *txn, Tuple *tuple) -> bool {
+  bool exists = table_heap->GetTuple(rid, tuple, txn);
+  auto table = GetTable(oid, false);
+  if (table == nullptr) {
+    return exists;
+  }
+  // 顺序是 heap -> 计数 -> chain：计数为 0 时，插入这一行的 insert 已经 RecordWrite 了
+  if (exists && table->inserts_in_flight_.load() != 0) {
+    std::scoped_lock<std::mutex> lock(table->insert_latch_);
+  }
+  auto shard = ShardOf(table, rid.GetPageId());
+  std::scoped_lock<std::mutex> lock(shard->latch_);
+  auto page_it = shard->pages_.find(rid.GetPageId());
+  if (page_it == shard->pages_.end()) {
+    return exists;
+  }
+  auto chain_it = page_it->second.find(rid.GetSlotNum());
+  if (chain_it == page_it->second.end()) {
+    return exists;
+  }
+  for (auto it = chain_it->second.rbegin(); it != chain_it->second.rend() && !IsVisible(*it, snapshot); it++) {
+    exists = it->existed_;
+    if (exists) {
+      *tuple = it->before_;
+    }
+  }
+  return exists;
+}
+
+auto VersionStore::HasVersions(table_oid_t oid, const RID &rid) -> bool {
+  auto table = GetTable(oid, false);
+  if (table == nullptr) {
+    return false;
+  }
+  auto shard = ShardOf(table, rid.GetPageId());
+  std::scoped_lock<std::mutex> lock(shard->latch_);
+  auto page_it = shard->pages_.find(rid.GetPageId());
+  return page_it != shard->pages_.end() && page_it->second.count(rid.GetSlotNum()) != 0;
+}
+
+void VersionStore::GetVersionedRids(table_oid_t oid, page_id_t page_id, std::vector<RID> *rids) {
+  auto table = GetTable(oid, false);
+  if (table == nullptr) {
+    return;
+  }
+  auto shard = ShardOf(table, page_id);
+  std::scoped_lock<std::mutex> lock(shard->latch_);
+  auto page_it = shard->pages_.find(page_id);
+  if (page_it == shard->pages_.end()) {
+    return;
+  }
+  for (const auto &[slot, chain] : page_it->second) {
+    rids->emplace_back(page_id, slot);
+  }
+}
+
+auto VersionStore::LiveSnapshots() -> std::vector<std::shared_ptr<const Snapshot>> {
+  std::scoped_lock<std::mutex> lock(registry_latch_);
+  for (auto it = txn_snapshots_.begin(); it != txn_snapshots_.end();) {
+    it = IsFinished(it->first) ? txn_snapshots_.erase(it) : std::next(it);
+  }
+  for (auto it = writers_.begin(); it != writers_.end();) {
+    it = IsFinished(it->first) ? writers_.erase(it) : std::next(it);
+  }
+  std::vector<std::shared_ptr<const Snapshot>> live;
+  size_t n = 0;
+  for (auto &weak : snapshots_) {
+    auto snapshot = weak.lock();
+    if (snapshot != nullptr) {
+      live.emplace_back(std::move(snapshot));
+      snapshots_[n++] = std::move(weak);
+    }
+  }
+  snapshots_.resize(n);
+  return live;
+}
+
+auto VersionStore::CollectChain(table_oid_t oid, UndoChain *chain,
+                                const std::vector<std::shared_ptr<const Snapshot>> &snapshots) -> bool {
+  // 所有 snapshot 都能看到的最新 entry，它和更早的 entry 都不会再被读到
+  for (size_t i = chain->size(); i > 0; i--) {
+    const auto &entry = (*chain)[i - 1];
+    if (TransactionManager::GetTransaction(entry.writer_)->GetState() != TransactionState::COMMITTED) {
+      continue;
+    }
+    if (std::all_of(snapshots.begin(), snapshots.end(),
+                    [&](const auto &snapshot) { return IsVisible(entry, *snapshot); })) {
+      chain->erase(chain->begin(), chain->begin() + i);
+      break;
+    }
+  }
+  // abort 的 txn 在 rollback 之后才释放锁，之后 heap 中已经是它之前的版本
+  auto rolled_back = [oid](const UndoEntry &entry) {
+    auto writer = TransactionManager::GetTransaction(entry.writer_);
+    if (writer->GetState() != TransactionState::ABORTED) {
+      return false;
+    }
+    writer->LockTxn();
+    bool locked = writer->IsTableIntentionExclusiveLocked(oid) || writer->IsTableExclusiveLocked(oid) ||
+                  writer->IsTableSharedIntentionExclusiveLocked(oid);
+    writer->UnlockTxn();
+    return !locked;
+  };
+  chain->erase(std::remove_if(chain->begin(), chain->end(), rolled_back), chain->end());
+  return chain->empty();
+}
+
+void VersionStore::GarbageCollect() {
+  std::unique_lock<std::mutex> gc_lock(gc_latch_, std::try_to_lock);
+  if (!gc_lock.owns_lock()) {
+    return;
+  }
+  writes_since_gc_.store(0, std::memory_order_relaxed);
+  auto snapshots = LiveSnapshots();
+  std::vector<std::pair<table_oid_t, TableVersions *>> tables;
+  {
+    std::shared_lock<std::shared_mutex> rlock(tables_latch_);
+    for (const auto &[oid, table] : tables_) {
+      tables.emplace_back(oid, table.get());
+    }
+  }
+  for (const auto &[oid, table] : tables) {
+    for (auto &shard : table->shards_) {
+      std::scoped_lock<std::mutex> lock(shard.latch_);
+      for (auto page_it = shard.pages_.begin(); page_it != shard.pages_.end();) {
+        auto &slots = page_it->second;
+        for (auto it = slots.begin(); it != slots.end();) {
+          it = CollectChain(oid, &it->second, snapshots) ? slots.erase(it) : std::next(it);
+        }
+        page_it = slots.empty() ? shard.pages_.erase(page_it) : std::next(page_it);
+      }
+    }
+  }
+}
+
+}  // namespace bustub
@@ -38,7 +38,7 @@ auto ExtendibleHashTable<K, V>::IndexOf(const K &key) -> size_t {
 
 template <typename K, typename V>
 auto ExtendibleHashTable<K, V>::GetGlobalDepth() const -> int {
-  std::scoped_lock<std::shared_mutex> rlock(latch_);
+  std::shared_lock<std::shared_mutex> rlock(latch_);
   return GetGlobalDepthInternal();
 }
 
@@ -49,7 +49,7 @@ auto ExtendibleHashTable<K, V>::GetGlobalDepthInternal() const -> int {
 
 template <typename K, typename V>
 auto ExtendibleHashTable<K, V>::GetLocalDepth(int dir_index) const -> int {
-  std::scoped_lock<std::shared_mutex> rlock(latch_);
+  std::shared_lock<std::shared_mutex> rlock(latch_);
   return GetLocalDepthInternal(dir_index);
 }
 
@@ -60,7 +60,7 @@ auto ExtendibleHashTable<K, V>::GetLocalDepthInternal(int dir_index) const -> in
 
 template <typename K, typename V>
 auto ExtendibleHashTable<K, V>::GetNumBuckets() const -> int {
-  std::scoped_lock<std::shared_mutex> rlock(latch_);
+  std::shared_lock<std::shared_mutex> rlock(latch_);
   return GetNumBucketsInternal();
 }
 
@@ -71,13 +71,13 @@ auto ExtendibleHashTable<K, V>::GetNumBucketsInternal() const -> int {
 
 template <typename K, typename V>
 auto ExtendibleHashTable<K, V>::Find(const K &key, V &value) -> bool {
-  std::scoped_lock<std::shared_mutex> rlock(latch_);
+  std::shared_lock<std::shared_mutex> rlock(latch_);
   return dir_[IndexOf(key)]->Find(key, value);
 }
 
 template <typename K, typename V>
 auto ExtendibleHashTable<K, V>::Remove(const K &key) -> bool {
-  std::scoped_lock<std::shared_mutex> rlock(latch_);
+  std::shared_lock<std::shared_mutex> rlock(latch_);
   return dir_[IndexOf(key)]->Remove(key);
 }
 
@@ -135,15 +135,18 @@ void ExtendibleHashTable<K, V>::Insert(const K &key, const V &value) {
 // Bucket
 //===--------------------------------------------------------------------===//
 template <typename K, typename V>
-ExtendibleHashTable<K, V>::Bucket::Bucket(size_t array_size, int depth) : size_(array_size), depth_(depth) {}
+ExtendibleHashTable<K, V>::Bucket::Bucket(size_t array_size, int depth) : size_(array_size), depth_(depth) {
+  items_.reserve(array_size);
+}
 
 template <typename K, typename V>
 auto ExtendibleHashTable<K, V>::Bucket::Find(const K &key, V &value) -> bool {
-  std::scoped_lock<std::shared_mutex> rlock(latch_);
-  auto it = mp_.find(key);
-  if (it != mp_.end()) {
-    value = it->second;
-    return true;
+  std::shared_lock<std::shared_mutex> rlock(latch_);
+  for (const auto &[k, v] : items_) {
+    if (k == key) {
+      value = v;
+      return true;
+    }
   }
   return false;
 }
@@ -151,10 +154,15 @@ auto ExtendibleHashTable<K, V>::Bucket::Find(const K &key, V &value) -> bool {
 template <typename K, typename V>
 auto ExtendibleHashTable<K, V>::Bucket::Remove(const K &key) -> bool {
   std::scoped_lock<std::shared_mutex> wlock(latch_);
-  auto it = mp_.find(key);
-  if (it != mp_.end()) {
-    mp_.erase(it);
-    return true;
+  for (auto &item : items_) {
+    if (item.first == key) {
+      // bucket 内部无序，用最后一个 entry 填补空位
+      if (&item != &items_.back()) {
+        item = std::move(items_.back());
+      }
+      items_.pop_back();
+      return true;
+    }
   }
   return false;
 }
@@ -162,15 +170,16 @@ auto ExtendibleHashTable<K, V>::Bucket::Remove(const K &key) -> bool {
 template <typename K, typename V>
 auto ExtendibleHashTable<K, V>::Bucket::Insert(const K &key, const V &value) -> bool {
   std::scoped_lock<std::shared_mutex> wlock(latch_);
-  auto it = mp_.find(key);
-  if (it != mp_.end()) {
-    it->second = value;
-    return true;
+  for (auto &item : items_) {
+    if (item.first == key) {
+      item.second = value;
+      return true;
+    }
   }
   if (IsFull()) {
     return false;
   }
-  mp_.emplace(key, value);
+  items_.emplace_back(key, value);
   return true;
 }
 
@@ -0,0 +1,147 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// striped_hash_table.cpp
+//
+// Identification: src/container/hash/striped_hash_table.cpp
+//
+// Copyright (c) 2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "common/config.h"
+#include "container/hash/striped_hash_table.h"
+
+namespace bustub {
+
+namespace {
+auto NextPowerOfTwo(size_t n) -> size_t {
+  size_t power = 1;
+  while (power < n) {
+    power <<= 1;
+  }
+  return power;
+}
+}  // namespace
+
+template <typename K, typename V>
+StripedHashTable<K, V>::StripedHashTable(size_t capacity, size_t num_stripes)
+    : stripes_(NextPowerOfTwo(std::max<size_t>(1, num_stripes))) {
+  // 负载因子不超过 1/2，每个 stripe 至少 8 个 slot
+  auto slots_per_stripe = NextPowerOfTwo(std::max<size_t>(8, 2 * capacity / stripes_.size() + 1));
+  for (auto &stripe : stripes_) {
+    stripe.slots_.resize(slots_per_stripe);
+  }
+}
+
+template <typename K, typename V>
+auto StripedHashTable<K, V>::Hash(const K &key) -> uint64_t {
+  // murmur3 的 fmix64
+  auto h = static_cast<uint64_t>(key);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+template <typename K, typename V>
+auto StripedHashTable<K, V>::Probe(const Stripe &stripe, const K &key, uint64_t hash) -> size_t {
+  const size_t mask = stripe.slots_.size() - 1;
+  auto index = HomeOf(hash, mask);
+  while (stripe.slots_[index].used_ && stripe.slots_[index].key_ != key) {
+    index = (index + 1) & mask;
+  }
+  return index;
+}
+
+template <typename K, typename V>
+void StripedHashTable<K, V>::Grow(Stripe *stripe) {
+  std::vector<Slot> old_slots(stripe->slots_.size() * 2);
+  old_slots.swap(stripe->slots_);
+  for (const auto &slot : old_slots) {
+    if (slot.used_) {
+      stripe->slots_[Probe(*stripe, slot.key_, Hash(slot.key_))] = slot;
+    }
+  }
+}
+
+template <typename K, typename V>
+auto StripedHashTable<K, V>::Find(const K &key, V &value) -> bool {
+  auto hash = Hash(key);
+  auto &stripe = StripeOf(hash);
+  std::shared_lock<std::shared_mutex> rlock(stripe.latch_);
+  const auto &slot = stripe.slots_[Probe(stripe, key, hash)];
+  if (!slot.used_) {
+    return false;
+  }
+  value = slot.value_;
+  return true;
+}
+
+template <typename K, typename V>
+void StripedHashTable<K, V>::Insert(const K &key, const V &value) {
+  auto hash = Hash(key);
+  auto &stripe = StripeOf(hash);
+  std::scoped_lock<std::shared_mutex> wlock(stripe.latch_);
+  auto index = Probe(stripe, key, hash);
+  if (stripe.slots_[index].used_) {
+    stripe.slots_[index].value_ = value;
+    return;
+  }
+  // 保证至少还有一个空 slot，probe 才能停下来
+  if (2 * (stripe.size_ + 1) > stripe.slots_.size()) {
+    Grow(&stripe);
+    index = Probe(stripe, key, hash);
+  }
+  stripe.slots_[index] = {key, value, true};
+  stripe.size_++;
+}
+
+template <typename K, typename V>
+auto StripedHashTable<K, V>::Remove(const K &key) -> bool {
+  auto hash = Hash(key);
+  auto &stripe = StripeOf(hash);
+  std::scoped_lock<std::shared_mutex> wlock(stripe.latch_);
+  auto hole = Probe(stripe, key, hash);
+  if (!stripe.slots_[hole].used_) {
+    return false;
+  }
+  // backward shift：把后面 probe 链上的 entry 往前挪填补空位，不留 tombstone
+  const size_t mask = stripe.slots_.size() - 1;
+  auto next = (hole + 1) & mask;
+  while (stripe.slots_[next].used_) {
+    auto home = HomeOf(Hash(stripe.slots_[next].key_), mask);
+    // home 不在 (hole, next] 之间时，entry 可以挪到 hole
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      stripe.slots_[hole] = stripe.slots_[next];
+      hole = next;
+    }
+    next = (next + 1) & mask;
+  }
+  stripe.slots_[hole].used_ = false;
+  stripe.size_--;
+  return true;
+}
+
+template <typename K, typename V>
+auto StripedHashTable<K, V>::Size() const -> size_t {
+  size_t size = 0;
+  for (const auto &stripe : stripes_) {
+    std::shared_lock<std::shared_mutex> rlock(stripe.latch_);
+    size += stripe.size_;
+  }
+  return size;
+}
+
+template class StripedHashTable<page_id_t, frame_id_t>;
+// test purpose
+template class StripedHashTable<int, std::string>;
+
+}  // namespace bustub
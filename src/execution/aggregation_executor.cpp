@@ -9,10 +9,17 @@
 // Copyright (c) 2015-2021, Carnegie Mellon University Database Group
 //
 //===----------------------------------------------------------------------===//
+#include <algorithm>
+#include <condition_variable>  // NOLINT
+#include <deque>
 #include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "execution/executors/aggregation_executor.h"
+#include "execution/executor_profile.h"
+#include "execution/worker_pool.h"
 
 namespace bustub {
 
@@ -20,23 +27,293 @@ AggregationExecutor::AggregationExecutor(ExecutorContext *exec_ctx, const Aggreg
                                          std::unique_ptr<AbstractExecutor> &&child)
     : AbstractExecutor(exec_ctx),
       plan_(plan),
-      child_(std::move(child)),
-      aht_(plan_->GetAggregates(), plan_->GetAggregateTypes()),
-      aht_iterator_(aht_.Begin()) {}
+      child_(ProfileChild(plan->GetChildPlan(), std::move(child))),
+      aht_iterator_(std::unordered_map<AggregateKey, AggregateValue>::const_iterator{}) {}
 
 void AggregationExecutor::Init() {
   child_->Init();
-  Tuple tuple;
-  RID rid;
-  while (child_->Next(&tuple, &rid)) {
-    aht_.InsertCombine(MakeAggregateKey(&tuple), MakeAggregateValue(&tuple));
+  tables_.clear();
+  spill_partitions_.clear();
+  spilled_output_.reset();
+  auto num_threads = std::min<size_t>(std::thread::hardware_concurrency(), AGG_MAX_THREADS);
+  // child 能并行 scan 时直接在 scan 的线程上聚合
+  auto source = num_threads > 1 ? dynamic_cast<MorselSource *>(child_.get()) : nullptr;
+  if (source == nullptr || !ParallelAggregate(source, num_threads)) {
+    // 先读一个 morsel，输入不超过一个 morsel 时不需要开线程
+    std::vector<Tuple> morsel;
+    bool more = ReadMorsel(&morsel);
+    if (more && num_threads > 1) {
+      ParallelAggregate(std::move(morsel), num_threads);
+    } else {
+      SerialAggregate(morsel, more);
+    }
   }
-  aht_iterator_ = aht_.Begin();
+  peak_memory_bytes_ = std::max(peak_memory_bytes_, ResidentGroups() * GroupBytes());
+  if (!spill_partitions_.empty()) {
+    spilled_output_ = std::make_unique<SpillFile>(exec_ctx_->GetBufferPoolManager());
+    for (auto &partition : spill_partitions_) {
+      AggregatePartition(partition.get(), 1);
+      // partition 处理完就释放它的 page
+      partition.reset();
+    }
+    spill_partitions_.clear();
+    spilled_output_->Rewind();
+  }
+  table_index_ = 0;
+  aht_iterator_ = tables_[0].Begin();
   is_successful_ = false;
 }
 
+void AggregationExecutor::SerialAggregate(const std::vector<Tuple> &first_morsel, bool more) {
+  auto &table = tables_.emplace_back(plan_->GetAggregates(), plan_->GetAggregateTypes());
+  auto max_groups = MaxResidentGroups();
+  std::hash<AggregateKey> hasher;
+  std::vector<std::pair<hash_t, Tuple>> spilled;
+  auto aggregate = [&](const Tuple &tuple) {
+    auto key = MakeAggregateKey(&tuple);
+    auto val = MakeAggregateValue(&tuple);
+    if (table.Size() < max_groups) {
+      table.InsertCombine(key, val);
+    } else if (!table.UpdateCombine(key, val)) {
+      spilled.emplace_back(hasher(key), tuple);
+      if (spilled.size() == AGG_MORSEL_SIZE) {
+        SpillTuples(&spilled);
+      }
+    }
+  };
+  for (const auto &tuple : first_morsel) {
+    aggregate(tuple);
+  }
+  while (more && bustub::NextBatch(child_.get(), &child_batch_)) {
+    for (size_t i = 0; i < child_batch_.Size(); i++) {
+      aggregate(child_batch_.GetTuple(i));
+    }
+  }
+  SpillTuples(&spilled);
+}
+
+auto AggregationExecutor::ReadMorsel(std::vector<Tuple> *morsel) -> bool {
+  morsel->clear();
+  morsel->reserve(AGG_MORSEL_SIZE + TupleBatch::BATCH_SIZE);
+  while (morsel->size() < AGG_MORSEL_SIZE) {
+    if (!bustub::NextBatch(child_.get(), &child_batch_)) {
+      return false;
+    }
+    for (size_t i = 0; i < child_batch_.Size(); i++) {
+      morsel->emplace_back(std::move(child_batch_.GetTuple(i)));
+    }
+  }
+  return true;
+}
+
+auto AggregationExecutor::MakePartials(size_t num_threads) const -> PartialTables {
+  PartialTables partials(num_threads);
+  for (auto &partial : partials) {
+    for (size_t p = 0; p < num_threads; p++) {
+      partial.emplace_back(plan_->GetAggregates(), plan_->GetAggregateTypes());
+    }
+  }
+  return partials;
+}
+
+void AggregationExecutor::AggregatePartial(const Tuple &tuple, std::vector<SimpleAggregationHashTable> *partial,
+                                           std::atomic<size_t> *num_groups, size_t max_groups,
+                                           std::vector<std::pair<hash_t, Tuple>> *spilled) {
+  auto key = MakeAggregateKey(&tuple);
+  auto val = MakeAggregateValue(&tuple);
+  auto hash = std::hash<AggregateKey>()(key);
+  auto &table = (*partial)[hash % partial->size()];
+  if (num_groups->load(std::memory_order_relaxed) < max_groups) {
+    auto size = table.Size();
+    table.InsertCombine(key, val);
+    num_groups->fetch_add(table.Size() - size, std::memory_order_relaxed);
+  } else if (!table.UpdateCombine(key, val)) {
+    // 其他线程的 partial table 中可能有这个 key，处理 spill partition 时会合并进去
+    spilled->emplace_back(hash, tuple);
+  }
+}
+
+void AggregationExecutor::ParallelAggregate(std::vector<Tuple> &&first_morsel, size_t num_threads) {
+  auto partials = MakePartials(num_threads);
+  std::mutex latch;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+  std::deque<std::vector<Tuple>> morsels;
+  bool done = false;
+  morsels.emplace_back(std::move(first_morsel));
+
+  // 所有 partial table 的 group 数之和，不同线程中相同的 key 重复计算，所以会偏大
+  auto max_groups = MaxResidentGroups();
+  std::atomic<size_t> num_groups{0};
+
+  std::vector<std::thread> workers;
+  workers.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; i++) {
+    workers.emplace_back([&, i] {
+      std::vector<std::pair<hash_t, Tuple>> spilled;
+      while (true) {
+        std::vector<Tuple> morsel;
+        {
+          std::unique_lock<std::mutex> lock(latch);
+          not_empty.wait(lock, [&] { return !morsels.empty() || done; });
+          if (morsels.empty()) {
+            return;
+          }
+          morsel = std::move(morsels.front());
+          morsels.pop_front();
+        }
+        not_full.notify_one();
+        for (const auto &tuple : morsel) {
+          AggregatePartial(tuple, &partials[i], &num_groups, max_groups, &spilled);
+        }
+        SpillTuples(&spilled);
+      }
+    });
+  }
+  // 当前线程继续读 child，最多缓存 2 * num_threads 个 morsel
+  std::vector<Tuple> morsel;
+  bool more = true;
+  while (more) {
+    more = ReadMorsel(&morsel);
+    if (morsel.empty()) {
+      break;
+    }
+    {
+      std::unique_lock<std::mutex> lock(latch);
+      not_full.wait(lock, [&] { return morsels.size() < 2 * num_threads; });
+      morsels.emplace_back(std::move(morsel));
+    }
+    not_empty.notify_one();
+  }
+  {
+    std::scoped_lock<std::mutex> lock(latch);
+    done = true;
+  }
+  not_empty.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  MergePartials(&partials);
+}
+
+auto AggregationExecutor::ParallelAggregate(MorselSource *source, size_t num_threads) -> bool {
+  auto partials = MakePartials(num_threads);
+  auto max_groups = MaxResidentGroups();
+  std::atomic<size_t> num_groups{0};
+  std::vector<std::vector<std::pair<hash_t, Tuple>>> spilled(num_threads);
+  bool scanned = source->ScanMorsels(num_threads, [&](size_t worker, TupleBatch *batch) {
+    for (size_t i = 0; i < batch->Size(); i++) {
+      AggregatePartial(batch->GetTuple(i), &partials[worker], &num_groups, max_groups, &spilled[worker]);
+    }
+    SpillTuples(&spilled[worker]);
+  });
+  if (!scanned) {
+    return false;
+  }
+  MergePartials(&partials);
+  return true;
+}
+
+void AggregationExecutor::MergePartials(PartialTables *partials) {
+  // task p 合并所有 partial table 的 partition p
+  auto num_partitions = partials->size();
+  for (size_t p = 0; p < num_partitions; p++) {
+    tables_.emplace_back(plan_->GetAggregates(), plan_->GetAggregateTypes());
+  }
+  WorkerPool::Get().RunParallel(num_partitions, [&](size_t p) {
+    for (auto &partial : *partials) {
+      for (auto iter = partial[p].Begin(); iter != partial[p].End(); ++iter) {
+        tables_[p].InsertMerge(iter.Key(), iter.Val());
+      }
+      partial[p].Clear();
+    }
+  });
+}
+
+auto AggregationExecutor::MaxResidentGroups() const -> size_t {
+  return std::max<size_t>(memory_budget_.load(std::memory_order_relaxed) / GroupBytes(), 1);
+}
+
+auto AggregationExecutor::GroupBytes() const -> size_t {
+  // 一个 group 在 unordered_map 中大约占用的空间
+  return sizeof(AggregateKey) + sizeof(AggregateValue) + 4 * sizeof(void *) +
+         (plan_->GetGroupBys().size() + plan_->GetAggregates().size()) * sizeof(Value);
+}
+
+auto AggregationExecutor::ResidentGroups() const -> size_t {
+  size_t num_groups = 0;
+  for (const auto &table : tables_) {
+    num_groups += table.Size();
+  }
+  return num_groups;
+}
+
+void AggregationExecutor::SpillTuples(std::vector<std::pair<hash_t, Tuple>> *tuples) {
+  if (tuples->empty()) {
+    return;
+  }
+  std::scoped_lock<std::mutex> lock(spill_latch_);
+  if (spill_partitions_.empty()) {
+    for (size_t i = 0; i < AGG_SPILL_PARTITIONS; i++) {
+      spill_partitions_.emplace_back(std::make_unique<SpillFile>(exec_ctx_->GetBufferPoolManager()));
+    }
+  }
+  for (const auto &[hash, tuple] : *tuples) {
+    spill_partitions_[SpillPartitionOf(hash, 0)]->Append(tuple);
+  }
+  tuples->clear();
+}
+
+void AggregationExecutor::AggregatePartition(SpillFile *input, size_t depth) {
+  SimpleAggregationHashTable table(plan_->GetAggregates(), plan_->GetAggregateTypes());
+  std::vector<std::unique_ptr<SpillFile>> partitions;
+  auto max_groups = MaxResidentGroups();
+  std::hash<AggregateKey> hasher;
+  input->Rewind();
+  Tuple tuple;
+  while (input->Next(&tuple)) {
+    auto key = MakeAggregateKey(&tuple);
+    auto val = MakeAggregateValue(&tuple);
+    auto hash = hasher(key);
+    if (tables_[hash % tables_.size()].UpdateCombine(key, val)) {
+      continue;
+    }
+    // 太深时不再分区，直接在内存中聚合
+    if (table.Size() < max_groups || depth >= AGG_MAX_SPILL_DEPTH) {
+      table.InsertCombine(key, val);
+      continue;
+    }
+    if (table.UpdateCombine(key, val)) {
+      continue;
+    }
+    if (partitions.empty()) {
+      for (size_t i = 0; i < AGG_SPILL_PARTITIONS; i++) {
+        partitions.emplace_back(std::make_unique<SpillFile>(exec_ctx_->GetBufferPoolManager()));
+      }
+    }
+    partitions[SpillPartitionOf(hash, depth)]->Append(tuple);
+  }
+  for (auto iter = table.Begin(); iter != table.End(); ++iter) {
+    spilled_output_->Append(MakeOutputTuple(iter.Key(), iter.Val()));
+  }
+  peak_memory_bytes_ = std::max(peak_memory_bytes_, (ResidentGroups() + table.Size()) * GroupBytes());
+  table.Clear();
+  for (auto &partition : partitions) {
+    AggregatePartition(partition.get(), depth + 1);
+    partition.reset();
+  }
+}
+
 auto AggregationExecutor::Next(Tuple *tuple, RID *rid) -> bool {
-  if (aht_iterator_ != aht_.End()) {
+  if (spilled_output_ != nullptr && spilled_output_->Next(tuple)) {
+    is_successful_ = true;
+    return true;
+  }
+  // 当前 partition 输出完后换下一个
+  while (aht_iterator_ == tables_[table_index_].End() && table_index_ + 1 < tables_.size()) {
+    aht_iterator_ = tables_[++table_index_].Begin();
+  }
+  if (aht_iterator_ != tables_[table_index_].End()) {
     // 事实上这块的 group by clause 不一定要加到 tuple 中，
     // 测试代码并不会获取该 group by clause，它只会获取下面的 value，
     // 但是它获取 value 是通过地址偏移解决的，然而如果你不加这个 group by clause，
@@ -44,11 +321,7 @@ auto AggregationExecutor::Next(Tuple *tuple, RID *rid) -> bool {
     // 从结果推原因，测试代码 get value 获取的地址偏移是 schema 中 column 决定的，
     // 而这个 offset 是起初就已经定好了，所以必须按照这个规定来
     // std::cout << plan_->output_schema_->ToString() << std::endl;
-    std::vector<Value> v(aht_iterator_.Key().group_bys_);
-    for (const auto &i : aht_iterator_.Val().aggregates_) {
-      v.push_back(i);
-    }
-    *tuple = {v, plan_->output_schema_.get()};
+    *tuple = MakeOutputTuple(aht_iterator_.Key(), aht_iterator_.Val());
     // std::cout << tuple->ToString(plan_->output_schema_.get()) << std::endl;
     ++aht_iterator_;
     is_successful_ = true;
@@ -60,13 +333,24 @@ auto AggregationExecutor::Next(Tuple *tuple, RID *rid) -> bool {
     // 这里要加一个 group cluase 为空的判断
     // 因为测试代码中，如果 group by 为空，则 no output
     if (plan_->group_bys_.empty()) {
-      *tuple = {aht_.GenerateInitialAggregateValue().aggregates_, plan_->output_schema_.get()};
+      *tuple = {tables_[0].GenerateInitialAggregateValue().aggregates_, plan_->output_schema_.get()};
       return true;
     }
   }
   return false;
 }
 
+auto AggregationExecutor::NextBatch(TupleBatch *batch) -> bool {
+  while (!batch->IsFull()) {
+    auto [tuple, rid] = batch->Emplace();
+    if (!AggregationExecutor::Next(tuple, rid)) {
+      batch->PopBack();
+      break;
+    }
+  }
+  return !batch->IsEmpty();
+}
+
 auto AggregationExecutor::GetChildExecutor() const -> const AbstractExecutor * { return child_.get(); }
 
 }  // namespace bustub
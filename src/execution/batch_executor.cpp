@@ -0,0 +1,33 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// batch_executor.cpp
+//
+// Identification: src/execution/batch_executor.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/executors/batch_executor.h"
+
+namespace bustub {
+
+auto NextBatch(AbstractExecutor *executor, TupleBatch *batch) -> bool {
+  batch->Clear();
+  if (auto batch_executor = dynamic_cast<BatchExecutor *>(executor); batch_executor != nullptr) {
+    return batch_executor->NextBatch(batch);
+  }
+  // 还没有实现 NextBatch 的 executor，逐个 tuple 读
+  while (!batch->IsFull()) {
+    auto [tuple, rid] = batch->Emplace();
+    if (!executor->Next(tuple, rid)) {
+      batch->PopBack();
+      break;
+    }
+  }
+  return !batch->IsEmpty();
+}
+
+}  // namespace bustub
@@ -0,0 +1,287 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// compiled_predicate.cpp
+//
+// Identification: src/execution/compiled_predicate.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/compiled_predicate.h"
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "execution/expressions/column_value_expression.h"
+#include "execution/expressions/comparison_expression.h"
+#include "execution/expressions/constant_value_expression.h"
+#include "execution/expressions/logic_expression.h"
+#include "type/limits.h"
+
+namespace bustub {
+
+namespace {
+
+/** @return the value of an inlined column of type T at `offset` of the tuple data */
+template <class T>
+auto LoadColumn(const Tuple *tuple, uint32_t offset) -> T {
+  T value;
+  memcpy(&value, tuple->GetData() + offset, sizeof(T));
+  return value;
+}
+
+/** @return the value reserved for NULL in a column of type T */
+template <class T>
+constexpr auto NullOf() -> T {
+  if constexpr (std::is_same_v<T, int8_t>) {
+    return BUSTUB_INT8_NULL;
+  } else if constexpr (std::is_same_v<T, int16_t>) {
+    return BUSTUB_INT16_NULL;
+  } else if constexpr (std::is_same_v<T, int32_t>) {
+    return BUSTUB_INT32_NULL;
+  } else if constexpr (std::is_same_v<T, int64_t>) {
+    return BUSTUB_INT64_NULL;
+  } else {
+    return BUSTUB_DECIMAL_NULL;
+  }
+}
+
+/** `column op constant`, compared as CompareT. */
+template <class ColumnT, class CompareT>
+struct ColumnConstant {
+  template <class Op>
+  static auto Evaluate(const PredicateNode &node, const Tuple *left, const Tuple *right) -> bool {
+    auto value = LoadColumn<ColumnT>(node.from_right_[0] ? right : left, node.offsets_[0]);
+    if (value == NullOf<ColumnT>()) {
+      return false;
+    }
+    if constexpr (std::is_same_v<CompareT, double>) {
+      return Op{}(static_cast<double>(value), node.decimal_constant_);
+    } else {
+      return Op{}(static_cast<int64_t>(value), node.int_constant_);
+    }
+  }
+};
+
+/** `column op column`, of the same type. */
+template <class ColumnT>
+struct ColumnColumn {
+  template <class Op>
+  static auto Evaluate(const PredicateNode &node, const Tuple *left, const Tuple *right) -> bool {
+    auto a = LoadColumn<ColumnT>(node.from_right_[0] ? right : left, node.offsets_[0]);
+    auto b = LoadColumn<ColumnT>(node.from_right_[1] ? right : left, node.offsets_[1]);
+    if (a == NullOf<ColumnT>() || b == NullOf<ColumnT>()) {
+      return false;
+    }
+    return Op{}(a, b);
+  }
+};
+
+/** @return the instance of Kernel::Evaluate for the comparison operator */
+template <class Kernel>
+auto SelectOperator(ComparisonType comp_type) -> PredicateFn {
+  switch (comp_type) {
+    case ComparisonType::Equal:
+      return &Kernel::template Evaluate<std::equal_to<>>;
+    case ComparisonType::NotEqual:
+      return &Kernel::template Evaluate<std::not_equal_to<>>;
+    case ComparisonType::LessThan:
+      return &Kernel::template Evaluate<std::less<>>;
+    case ComparisonType::LessThanOrEqual:
+      return &Kernel::template Evaluate<std::less_equal<>>;
+    case ComparisonType::GreaterThan:
+      return &Kernel::template Evaluate<std::greater<>>;
+    case ComparisonType::GreaterThanOrEqual:
+      return &Kernel::template Evaluate<std::greater_equal<>>;
+  }
+  return nullptr;
+}
+
+template <class CompareT>
+auto SelectColumnConstant(TypeId type, ComparisonType comp_type) -> PredicateFn {
+  switch (type) {
+    case TypeId::TINYINT:
+      return SelectOperator<ColumnConstant<int8_t, CompareT>>(comp_type);
+    case TypeId::SMALLINT:
+      return SelectOperator<ColumnConstant<int16_t, CompareT>>(comp_type);
+    case TypeId::INTEGER:
+      return SelectOperator<ColumnConstant<int32_t, CompareT>>(comp_type);
+    case TypeId::BIGINT:
+      return SelectOperator<ColumnConstant<int64_t, CompareT>>(comp_type);
+    case TypeId::DECIMAL:
+      return SelectOperator<ColumnConstant<double, CompareT>>(comp_type);
+    default:
+      return nullptr;
+  }
+}
+
+auto SelectColumnColumn(TypeId type, ComparisonType comp_type) -> PredicateFn {
+  switch (type) {
+    case TypeId::TINYINT:
+      return SelectOperator<ColumnColumn<int8_t>>(comp_type);
+    case TypeId::SMALLINT:
+      return SelectOperator<ColumnColumn<int16_t>>(comp_type);
+    case TypeId::INTEGER:
+      return SelectOperator<ColumnColumn<int32_t>>(comp_type);
+    case TypeId::BIGINT:
+      return SelectOperator<ColumnColumn<int64_t>>(comp_type);
+    case TypeId::DECIMAL:
+      return SelectOperator<ColumnColumn<double>>(comp_type);
+    default:
+      return nullptr;
+  }
+}
+
+auto EvaluateAnd(const PredicateNode &node, const Tuple *left, const Tuple *right) -> bool {
+  for (const auto &child : node.children_) {
+    if (!child->fn_(*child, left, right)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+auto EvaluateOr(const PredicateNode &node, const Tuple *left, const Tuple *right) -> bool {
+  for (const auto &child : node.children_) {
+    if (child->fn_(*child, left, right)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/** A comparison with a NULL constant is NULL. */
+auto EvaluateFalse(const PredicateNode &node, const Tuple *left, const Tuple *right) -> bool { return false; }
+
+auto EvaluateBoxed(const PredicateNode &node, const Tuple *left, const Tuple *right) -> bool {
+  auto value = node.right_schema_ == nullptr
+                   ? node.expr_->Evaluate(left, *node.left_schema_)
+                   : node.expr_->EvaluateJoin(left, *node.left_schema_, right, *node.right_schema_);
+  return !value.IsNull() && value.GetAs<bool>();
+}
+
+auto IsIntegral(TypeId type) -> bool {
+  return type == TypeId::TINYINT || type == TypeId::SMALLINT || type == TypeId::INTEGER || type == TypeId::BIGINT;
+}
+
+/** @return the operator with its operands swapped: `a op b` is `b Flip(op) a` */
+auto Flip(ComparisonType comp_type) -> ComparisonType {
+  switch (comp_type) {
+    case ComparisonType::LessThan:
+      return ComparisonType::GreaterThan;
+    case ComparisonType::LessThanOrEqual:
+      return ComparisonType::GreaterThanOrEqual;
+    case ComparisonType::GreaterThan:
+      return ComparisonType::LessThan;
+    case ComparisonType::GreaterThanOrEqual:
+      return ComparisonType::LessThanOrEqual;
+    default:
+      return comp_type;
+  }
+}
+
+}  // namespace
+
+CompiledPredicate::CompiledPredicate(const AbstractExpression &expr, const Schema &schema)
+    : left_schema_(&schema), right_schema_(nullptr), is_join_(false) {
+  root_ = Compile(expr);
+}
+
+CompiledPredicate::CompiledPredicate(const AbstractExpression &expr, const Schema &left_schema,
+                                     const Schema &right_schema)
+    : left_schema_(&left_schema), right_schema_(&right_schema), is_join_(true) {
+  root_ = Compile(expr);
+}
+
+auto CompiledPredicate::Compile(const AbstractExpression &expr) -> std::unique_ptr<PredicateNode> {
+  if (const auto *logic_expr = dynamic_cast<const LogicExpression *>(&expr); logic_expr != nullptr) {
+    auto node = std::make_unique<PredicateNode>();
+    node->fn_ = logic_expr->logic_type_ == LogicType::And ? &EvaluateAnd : &EvaluateOr;
+    for (const auto &child : logic_expr->GetChildren()) {
+      auto child_node = Compile(*child);
+      // (a AND b) AND c 展开为 AND(a, b, c)
+      if (child_node->fn_ == node->fn_) {
+        for (auto &grandchild : child_node->children_) {
+          node->children_.emplace_back(std::move(grandchild));
+        }
+      } else {
+        node->children_.emplace_back(std::move(child_node));
+      }
+    }
+    return node;
+  }
+  const auto *comp_expr = dynamic_cast<const ComparisonExpression *>(&expr);
+  if (comp_expr == nullptr) {
+    return Fallback(expr);
+  }
+
+  auto node = std::make_unique<PredicateNode>();
+  // 找到 column 所在的 tuple、offset 和类型，只支持 inline 的数值类型
+  auto locate = [&](const AbstractExpression &child, size_t side) -> std::optional<TypeId> {
+    const auto *column_expr = dynamic_cast<const ColumnValueExpression *>(&child);
+    if (column_expr == nullptr) {
+      return std::nullopt;
+    }
+    bool from_right = is_join_ && column_expr->GetTupleIdx() == 1;
+    const auto &column = (from_right ? right_schema_ : left_schema_)->GetColumn(column_expr->GetColIdx());
+    if (!column.IsInlined() || (!IsIntegral(column.GetType()) && column.GetType() != TypeId::DECIMAL)) {
+      return std::nullopt;
+    }
+    node->offsets_[side] = column.GetOffset();
+    node->from_right_[side] = from_right;
+    return column.GetType();
+  };
+
+  auto comp_type = comp_expr->comp_type_;
+  const auto &lhs = *comp_expr->GetChildAt(0);
+  const auto &rhs = *comp_expr->GetChildAt(1);
+  auto lhs_type = locate(lhs, 0);
+  if (lhs_type.has_value()) {
+    if (auto rhs_type = locate(rhs, 1); rhs_type.has_value()) {
+      node->fn_ = lhs_type == rhs_type ? SelectColumnColumn(*lhs_type, comp_type) : nullptr;
+      return node->fn_ != nullptr ? std::move(node) : Fallback(expr);
+    }
+  }
+  const auto *constant_expr = dynamic_cast<const ConstantValueExpression *>(&rhs);
+  if (!lhs_type.has_value()) {
+    // constant op column
+    lhs_type = locate(rhs, 0);
+    constant_expr = dynamic_cast<const ConstantValueExpression *>(&lhs);
+    comp_type = Flip(comp_type);
+  }
+  if (!lhs_type.has_value() || constant_expr == nullptr) {
+    return Fallback(expr);
+  }
+  const auto &constant = constant_expr->val_;
+  auto constant_type = constant.GetTypeId();
+  if (!IsIntegral(constant_type) && constant_type != TypeId::DECIMAL) {
+    return Fallback(expr);
+  }
+  if (constant.IsNull()) {
+    node->fn_ = &EvaluateFalse;
+  } else if (IsIntegral(*lhs_type) && IsIntegral(constant_type)) {
+    node->int_constant_ = constant.CastAs(TypeId::BIGINT).GetAs<int64_t>();
+    node->fn_ = SelectColumnConstant<int64_t>(*lhs_type, comp_type);
+  } else {
+    node->decimal_constant_ = constant.CastAs(TypeId::DECIMAL).GetAs<double>();
+    node->fn_ = SelectColumnConstant<double>(*lhs_type, comp_type);
+  }
+  return node->fn_ != nullptr ? std::move(node) : Fallback(expr);
+}
+
+auto CompiledPredicate::Fallback(const AbstractExpression &expr) -> std::unique_ptr<PredicateNode> {
+  fully_compiled_ = false;
+  auto node = std::make_unique<PredicateNode>();
+  node->fn_ = &EvaluateBoxed;
+  node->expr_ = &expr;
+  node->left_schema_ = left_schema_;
+  node->right_schema_ = right_schema_;
+  return node;
+}
+
+}  // namespace bustub
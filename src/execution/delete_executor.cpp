@@ -11,16 +11,23 @@
 //===----------------------------------------------------------------------===//
 
 #include <memory>
+#include <utility>
 #include <vector>
 
+#include "catalog/table_statistics.h"
 #include "common/exception.h"
+#include "concurrency/transaction_manager.h"
 #include "execution/executors/delete_executor.h"
+#include "execution/executor_profile.h"
 
 namespace bustub {
 
 DeleteExecutor::DeleteExecutor(ExecutorContext *exec_ctx, const DeletePlanNode *plan,
                                std::unique_ptr<AbstractExecutor> &&child_executor)
-    : AbstractExecutor(exec_ctx), plan_(plan), child_executor_(std::move(child_executor)), done_(false) {}
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      child_executor_(ProfileChild(plan->GetChildPlan(), std::move(child_executor))),
+      done_(false) {}
 
 void DeleteExecutor::Init() {
   auto txn = exec_ctx_->GetTransaction();
@@ -43,6 +50,10 @@ auto DeleteExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
   int rows = 0;
   Tuple t;
   auto txn = exec_ctx_->GetTransaction();
+  auto version_store = exec_ctx_->GetTransactionManager()->GetVersionStore();
+  auto index_vacuum = exec_ctx_->GetTransactionManager()->GetIndexVacuum();
+  auto indexes = exec_ctx_->GetCatalog()->GetTableIndexes(table_info_->name_);
+  auto statistics = StatisticsCatalog::GetTableStatistics(exec_ctx_->GetCatalog(), table_info_->oid_);
   while (child_executor_->Next(&t, rid)) {
     // lock first if not locked yet, then mark deleted on this row
     RID deleted_rid = t.GetRid();
@@ -53,14 +64,43 @@ auto DeleteExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
         throw ExecutionException("DeleteExecutor::Next failed: lock X on row failed");
       }
     }
-    rows += static_cast<int>(table_heap_ptr_->MarkDelete(deleted_rid, txn));
+    if (version_store->IsEnabled()) {
+      if (version_store->IsWriteConflict(txn, table_info_->oid_, deleted_rid)) {
+        txn->SetState(TransactionState::ABORTED);
+        throw ExecutionException("DeleteExecutor::Next failed: row was written after the snapshot");
+      }
+      // child 在 snapshot 中读到的不一定是最新版本，READ_COMMITTED 下删除加锁之后的版本
+      if (!table_heap_ptr_->GetTuple(deleted_rid, &t, txn)) {
+        continue;
+      }
+      version_store->RecordWrite(txn, table_info_->oid_, deleted_rid, &t);
+    }
+    bool deleted = table_heap_ptr_->MarkDelete(deleted_rid, txn);
+    rows += static_cast<int>(deleted);
+    if (deleted && statistics != nullptr) {
+      statistics->RecordDelete(table_info_->schema_, t);
+    }
     // 更新 index
-    auto indexes = exec_ctx_->GetCatalog()->GetTableIndexes(table_info_->name_);
+    if (index_vacuum->IsEnabled()) {
+      // 只记录 index key，commit 之后由 vacuum 删除
+      std::vector<std::pair<Index *, Tuple>> keys;
+      keys.reserve(indexes.size());
+      for (auto index_info : indexes) {
+        keys.emplace_back(index_info->index_.get(), t.KeyFromTuple(table_info_->schema_, index_info->key_schema_,
+                                                                   index_info->index_->GetKeyAttrs()));
+      }
+      index_vacuum->RecordDelete(txn, table_info_->oid_, deleted_rid, std::move(keys));
+      continue;
+    }
     for (auto index_info : indexes) {
       auto index_key = t.KeyFromTuple(table_info_->schema_, index_info->key_schema_, index_info->index_->GetKeyAttrs());
       index_info->index_->DeleteEntry(index_key, {}, txn);
     }
   }
+  // 表的第一次写入，或者自上次 analyze 后改变了足够多的行时，重新收集统计信息
+  if (rows > 0) {
+    StatisticsCatalog::AnalyzeIfStale(exec_ctx_->GetCatalog(), table_info_, txn);
+  }
   Value value(TypeId::INTEGER, rows);
   std::vector<Value> v;
   v.emplace_back(value);
@@ -0,0 +1,159 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// exchange_executor.cpp
+//
+// Identification: src/execution/exchange_executor.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/executors/exchange_executor.h"
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include "execution/executor_profile.h"
+
+namespace bustub {
+
+namespace {
+
+/** Thrown by a worker blocked on the queue when the exchange is stopped, to stop the scan. */
+struct ExchangeCancelled {};
+
+}  // namespace
+
+ExchangeExecutor::ExchangeExecutor(ExecutorContext *exec_ctx, const ExchangePlanNode *plan,
+                                   std::unique_ptr<AbstractExecutor> &&child_executor)
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      child_executor_(ProfileChild(plan->GetChildPlan(), std::move(child_executor))) {}
+
+ExchangeExecutor::~ExchangeExecutor() { Stop(); }
+
+void ExchangeExecutor::Init() {
+  Stop();
+  child_executor_->Init();
+  std::scoped_lock<std::mutex> lock(latch_);
+  started_ = false;
+  queue_.clear();
+  finished_ = false;
+  cancelled_ = false;
+  error_ = nullptr;
+  current_.Clear();
+  current_index_ = 0;
+}
+
+void ExchangeExecutor::Start() {
+  started_ = true;
+  driver_ = std::thread([this] {
+    try {
+      auto source = dynamic_cast<MorselSource *>(child_executor_.get());
+      auto push = [&](size_t worker, TupleBatch *batch) { Push(batch); };
+      if (source == nullptr || !source->ScanMorsels(plan_->GetNumThreads(), push)) {
+        TupleBatch batch;
+        while (bustub::NextBatch(child_executor_.get(), &batch)) {
+          Push(&batch);
+        }
+      }
+    } catch (const ExchangeCancelled &) {
+      // 被 Stop 取消
+    } catch (...) {
+      std::scoped_lock<std::mutex> lock(latch_);
+      error_ = std::current_exception();
+    }
+    {
+      std::scoped_lock<std::mutex> lock(latch_);
+      finished_ = true;
+    }
+    not_empty_.notify_all();
+  });
+}
+
+void ExchangeExecutor::Stop() {
+  {
+    std::scoped_lock<std::mutex> lock(latch_);
+    cancelled_ = true;
+  }
+  not_full_.notify_all();
+  if (driver_.joinable()) {
+    driver_.join();
+  }
+}
+
+void ExchangeExecutor::Push(TupleBatch *batch) {
+  std::unique_lock<std::mutex> lock(latch_);
+  auto capacity = EXCHANGE_QUEUE_BATCHES_PER_THREAD * std::max<size_t>(plan_->GetNumThreads(), 1);
+  not_full_.wait(lock, [&] { return cancelled_ || queue_.size() < capacity; });
+  if (cancelled_) {
+    throw ExchangeCancelled{};
+  }
+  queue_.emplace_back(std::move(*batch));
+  if (free_batches_.empty()) {
+    *batch = TupleBatch();
+  } else {
+    *batch = std::move(free_batches_.back());
+    free_batches_.pop_back();
+  }
+  batch->Clear();
+  lock.unlock();
+  not_empty_.notify_one();
+}
+
+auto ExchangeExecutor::Pop(TupleBatch *batch) -> bool {
+  if (!started_) {
+    Start();
+  }
+  std::unique_lock<std::mutex> lock(latch_);
+  not_empty_.wait(lock, [&] { return finished_ || !queue_.empty(); });
+  if (queue_.empty()) {
+    if (error_ != nullptr) {
+      std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+    return false;
+  }
+  batch->Clear();
+  free_batches_.emplace_back(std::move(*batch));
+  *batch = std::move(queue_.front());
+  queue_.pop_front();
+  lock.unlock();
+  not_full_.notify_one();
+  return true;
+}
+
+auto ExchangeExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  while (current_index_ == current_.Size()) {
+    if (!Pop(&current_)) {
+      return false;
+    }
+    current_index_ = 0;
+  }
+  *tuple = current_.GetTuple(current_index_);
+  *rid = current_.GetRid(current_index_);
+  current_index_++;
+  return true;
+}
+
+auto ExchangeExecutor::NextBatch(TupleBatch *batch) -> bool {
+  // Next 读了一部分的 batch 先输出剩下的
+  if (current_index_ < current_.Size()) {
+    while (current_index_ < current_.Size() && !batch->IsFull()) {
+      batch->Append(current_.GetTuple(current_index_), current_.GetRid(current_index_));
+      current_index_++;
+    }
+    return true;
+  }
+  return Pop(batch);
+}
+
+auto ExchangeExecutor::ScanMorsels(size_t num_threads, const MorselConsumer &consume) -> bool {
+  auto source = dynamic_cast<MorselSource *>(child_executor_.get());
+  if (started_ || source == nullptr) {
+    return false;
+  }
+  return source->ScanMorsels(num_threads, consume);
+}
+
+}  // namespace bustub
@@ -0,0 +1,295 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// executor_profile.cpp
+//
+// Identification: src/execution/executor_profile.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/executor_profile.h"
+#include <time.h>  // NOLINT
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "common/profile_counters.h"
+#include "execution/executor_factory.h"
+#include "fmt/format.h"
+
+namespace bustub {
+
+namespace {
+
+auto ClockNs(clockid_t clock) -> int64_t {
+  timespec ts{};
+  clock_gettime(clock, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/** @return like ProfileSample::Now(), but with the CPU time of the process and the counters of the whole pool */
+auto ProcessSample(BufferPoolManager *bpm) -> ProfileSample {
+  auto sample = ProfileSample::Now();
+  sample.cpu_ns_ = ClockNs(CLOCK_PROCESS_CPUTIME_ID);
+  auto stats = bpm->GetStats();
+  sample.bpm_hits_ = static_cast<int64_t>(stats.Hits());
+  sample.bpm_misses_ = static_cast<int64_t>(stats.Misses());
+  return sample;
+}
+
+auto FormatMs(int64_t ns) -> std::string { return fmt::format("{:.3f}ms", static_cast<double>(ns) / 1e6); }
+
+auto FormatBytes(size_t bytes) -> std::string {
+  if (bytes < 1024) {
+    return fmt::format("{}B", bytes);
+  }
+  if (bytes < (1 << 20)) {
+    return fmt::format("{:.1f}KB", static_cast<double>(bytes) / 1024);
+  }
+  return fmt::format("{:.1f}MB", static_cast<double>(bytes) / (1 << 20));
+}
+
+}  // namespace
+
+/*****************************************************************************
+ * ProfileSample
+ *****************************************************************************/
+
+auto ProfileSample::Now() -> ProfileSample {
+  const auto &counters = ThreadProfileCounters::Get();
+  ProfileSample sample;
+  sample.wall_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch())
+                        .count();
+  sample.cpu_ns_ = ClockNs(CLOCK_THREAD_CPUTIME_ID);
+  sample.bpm_hits_ = static_cast<int64_t>(counters.bpm_hits_);
+  sample.bpm_misses_ = static_cast<int64_t>(counters.bpm_misses_);
+  sample.lock_waits_ = static_cast<int64_t>(counters.lock_waits_);
+  sample.lock_wait_ns_ = static_cast<int64_t>(counters.lock_wait_ns_);
+  return sample;
+}
+
+auto ProfileSample::operator+=(const ProfileSample &other) -> ProfileSample & {
+  wall_ns_ += other.wall_ns_;
+  cpu_ns_ += other.cpu_ns_;
+  bpm_hits_ += other.bpm_hits_;
+  bpm_misses_ += other.bpm_misses_;
+  lock_waits_ += other.lock_waits_;
+  lock_wait_ns_ += other.lock_wait_ns_;
+  return *this;
+}
+
+auto ProfileSample::operator-=(const ProfileSample &other) -> ProfileSample & {
+  wall_ns_ -= other.wall_ns_;
+  cpu_ns_ -= other.cpu_ns_;
+  bpm_hits_ -= other.bpm_hits_;
+  bpm_misses_ -= other.bpm_misses_;
+  lock_waits_ -= other.lock_waits_;
+  lock_wait_ns_ -= other.lock_wait_ns_;
+  return *this;
+}
+
+/*****************************************************************************
+ * ProfilingExecutor
+ *****************************************************************************/
+
+ProfilingExecutor::ProfilingExecutor(std::unique_ptr<AbstractExecutor> &&child, OperatorProfile *profile)
+    : AbstractExecutor(child->GetExecutorContext()),
+      child_(std::move(child)),
+      profile_(profile),
+      memory_(dynamic_cast<const MemoryConsumer *>(child_.get())) {}
+
+ProfilingExecutor::~ProfilingExecutor() { UpdatePeakMemory(); }
+
+void ProfilingExecutor::Init() {
+  auto start = ProfileSample::Now();
+  child_->Init();
+  auto sample = ProfileSample::Now();
+  sample -= start;
+  profile_->init_ += sample;
+  profile_->init_calls_++;
+  UpdatePeakMemory();
+}
+
+auto ProfilingExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  auto start = ProfileSample::Now();
+  bool produced = child_->Next(tuple, rid);
+  auto sample = ProfileSample::Now();
+  sample -= start;
+  profile_->next_ += sample;
+  profile_->next_calls_++;
+  if (produced) {
+    profile_->rows_++;
+  } else {
+    UpdatePeakMemory();
+  }
+  return produced;
+}
+
+auto ProfilingExecutor::NextBatch(TupleBatch *batch) -> bool {
+  auto start = ProfileSample::Now();
+  bool produced = bustub::NextBatch(child_.get(), batch);
+  auto sample = ProfileSample::Now();
+  sample -= start;
+  profile_->next_ += sample;
+  profile_->next_calls_++;
+  if (produced) {
+    profile_->rows_ += batch->Size();
+  } else {
+    UpdatePeakMemory();
+  }
+  return produced;
+}
+
+auto ProfilingExecutor::ScanMorsels(size_t num_threads, const MorselConsumer &consume) -> bool {
+  auto source = dynamic_cast<MorselSource *>(child_.get());
+  if (source == nullptr) {
+    return false;
+  }
+  auto bpm = exec_ctx_->GetBufferPoolManager();
+  // 每个 worker 在 consume 中花费的时间，即 parent 在该线程上的工作，不算在这个 executor 中
+  std::vector<ProfileSample> consumed(num_threads);
+  std::atomic<uint64_t> rows{0};
+  auto start = ProcessSample(bpm);
+  bool scanned = source->ScanMorsels(num_threads, [&](size_t worker, TupleBatch *batch) {
+    rows.fetch_add(batch->Size(), std::memory_order_relaxed);
+    auto consume_start = ProfileSample::Now();
+    consume(worker, batch);
+    auto sample = ProfileSample::Now();
+    sample -= consume_start;
+    consumed[worker] += sample;
+  });
+  if (!scanned) {
+    return false;
+  }
+  auto sample = ProcessSample(bpm);
+  sample -= start;
+  for (auto &worker_sample : consumed) {
+    // worker 同时运行，wall time 按平均值扣除；lock wait 只统计了当前线程
+    worker_sample.wall_ns_ /= static_cast<int64_t>(num_threads);
+    worker_sample.lock_waits_ = 0;
+    worker_sample.lock_wait_ns_ = 0;
+    sample -= worker_sample;
+  }
+  profile_->next_ += sample;
+  profile_->next_calls_++;
+  profile_->rows_ += rows.load();
+  profile_->parallel_ = true;
+  UpdatePeakMemory();
+  return true;
+}
+
+void ProfilingExecutor::UpdatePeakMemory() {
+  if (memory_ != nullptr) {
+    profile_->peak_memory_bytes_ = std::max(profile_->peak_memory_bytes_, memory_->PeakMemoryBytes());
+  }
+}
+
+/*****************************************************************************
+ * ExecutorProfiler
+ *****************************************************************************/
+
+ExecutorProfiler::Scope::Scope(ExecutorProfiler *profiler) : previous_(CurrentSlot()) { CurrentSlot() = profiler; }
+
+ExecutorProfiler::Scope::~Scope() { CurrentSlot() = previous_; }
+
+auto ExecutorProfiler::CurrentSlot() -> ExecutorProfiler *& {
+  static thread_local ExecutorProfiler *current = nullptr;
+  return current;
+}
+
+auto ExecutorProfiler::Current() -> ExecutorProfiler * { return CurrentSlot(); }
+
+auto ExecutorProfiler::Wrap(const AbstractPlanNode *plan, std::unique_ptr<AbstractExecutor> &&executor)
+    -> std::unique_ptr<AbstractExecutor> {
+  auto &profile = profiles_[plan];
+  if (profile == nullptr) {
+    profile = std::make_unique<OperatorProfile>();
+  }
+  return std::make_unique<ProfilingExecutor>(std::move(executor), profile.get());
+}
+
+auto ExecutorProfiler::GetProfile(const AbstractPlanNode *plan) const -> const OperatorProfile * {
+  auto iter = profiles_.find(plan);
+  return iter == profiles_.end() ? nullptr : iter->second.get();
+}
+
+auto ExecutorProfiler::ToString(const AbstractPlanNode &plan) const -> std::string {
+  std::string out;
+  AppendNode(plan, 0, &out);
+  return out;
+}
+
+void ExecutorProfiler::AppendNode(const AbstractPlanNode &plan, size_t indent, std::string *out) const {
+  // 只取 plan 自己的一行，children 在下面递归输出
+  auto line = plan.ToString(false);
+  line = line.substr(0, line.find('\n'));
+  out->append(indent, ' ');
+  out->append(line);
+  if (const auto *profile = GetProfile(&plan); profile == nullptr) {
+    out->append(" (never executed)");
+  } else {
+    auto total = profile->Total();
+    // 减去 children 的部分，得到这个 node 自己的开销
+    auto self = total;
+    for (const auto &child : plan.GetChildren()) {
+      if (const auto *child_profile = GetProfile(child.get()); child_profile != nullptr) {
+        self -= child_profile->Total();
+      }
+    }
+    out->append(fmt::format(" (rows={} loops={} time={} self={} cpu={} self_cpu={} bpm_hits={} bpm_misses={}",
+                            profile->rows_, profile->init_calls_, FormatMs(total.wall_ns_),
+                            FormatMs(std::max<int64_t>(self.wall_ns_, 0)), FormatMs(total.cpu_ns_),
+                            FormatMs(std::max<int64_t>(self.cpu_ns_, 0)), std::max<int64_t>(self.bpm_hits_, 0),
+                            std::max<int64_t>(self.bpm_misses_, 0)));
+    if (self.lock_waits_ > 0) {
+      out->append(fmt::format(" lock_waits={} lock_wait={}", self.lock_waits_, FormatMs(self.lock_wait_ns_)));
+    }
+    if (profile->peak_memory_bytes_ > 0) {
+      out->append(fmt::format(" peak_memory={}", FormatBytes(profile->peak_memory_bytes_)));
+    }
+    if (profile->parallel_) {
+      out->append(" parallel");
+    }
+    out->append(")");
+  }
+  out->append("\n");
+  for (const auto &child : plan.GetChildren()) {
+    AppendNode(*child, indent + 2, out);
+  }
+}
+
+auto ProfileChild(const AbstractPlanNodeRef &plan, std::unique_ptr<AbstractExecutor> &&child)
+    -> std::unique_ptr<AbstractExecutor> {
+  auto profiler = ExecutorProfiler::Current();
+  if (profiler == nullptr || child == nullptr) {
+    return std::move(child);
+  }
+  return profiler->Wrap(plan.get(), std::move(child));
+}
+
+auto ExplainAnalyze(ExecutorContext *exec_ctx, const AbstractPlanNodeRef &plan) -> std::string {
+  ExecutorProfiler profiler;
+  {
+    std::unique_ptr<AbstractExecutor> executor;
+    {
+      // children 由各 executor 的构造函数通过 ProfileChild() 包装
+      ExecutorProfiler::Scope scope(&profiler);
+      executor = profiler.Wrap(plan.get(), ExecutorFactory::CreateExecutor(exec_ctx, plan));
+    }
+    executor->Init();
+    TupleBatch batch;
+    while (bustub::NextBatch(executor.get(), &batch)) {
+      // 只统计，不输出结果
+      batch.Clear();
+    }
+  }
+  return profiler.ToString(*plan);
+}
+
+}  // namespace bustub
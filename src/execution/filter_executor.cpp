@@ -1,4 +1,5 @@
 #include "execution/executors/filter_executor.h"
+#include "execution/executor_profile.h"
 #include "common/exception.h"
 #include "type/value_factory.h"
 
@@ -6,16 +7,17 @@ namespace bustub {
 
 FilterExecutor::FilterExecutor(ExecutorContext *exec_ctx, const FilterPlanNode *plan,
                                std::unique_ptr<AbstractExecutor> &&child_executor)
-    : AbstractExecutor(exec_ctx), plan_(plan), child_executor_(std::move(child_executor)) {}
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      child_executor_(ProfileChild(plan->GetChildPlan(), std::move(child_executor))) {}
 
 void FilterExecutor::Init() {
   // Initialize the child executor
   child_executor_->Init();
+  predicate_ = std::make_unique<CompiledPredicate>(*plan_->GetPredicate(), child_executor_->GetOutputSchema());
 }
 
 auto FilterExecutor::Next(Tuple *tuple, RID *rid) -> bool {
-  auto filter_expr = plan_->GetPredicate();
-
   while (true) {
     // Get the next tuple
     const auto status = child_executor_->Next(tuple, rid);
@@ -24,11 +26,34 @@ auto FilterExecutor::Next(Tuple *tuple, RID *rid) -> bool {
       return false;
     }
 
-    auto value = filter_expr->Evaluate(tuple, child_executor_->GetOutputSchema());
-    if (!value.IsNull() && value.GetAs<bool>()) {
+    if (predicate_->Evaluate(tuple)) {
+      return true;
+    }
+  }
+}
+
+auto FilterExecutor::NextBatch(TupleBatch *batch) -> bool {
+  // 在 child 的 batch 上原地过滤，全部被过滤掉时读下一个 batch
+  while (bustub::NextBatch(child_executor_.get(), batch)) {
+    batch->Select([&](const Tuple &tuple) { return predicate_->Evaluate(&tuple); });
+    if (!batch->IsEmpty()) {
       return true;
     }
   }
+  return false;
+}
+
+auto FilterExecutor::ScanMorsels(size_t num_threads, const MorselConsumer &consume) -> bool {
+  auto source = dynamic_cast<MorselSource *>(child_executor_.get());
+  if (source == nullptr) {
+    return false;
+  }
+  return source->ScanMorsels(num_threads, [&](size_t worker, TupleBatch *batch) {
+    batch->Select([&](const Tuple &tuple) { return predicate_->Evaluate(&tuple); });
+    if (!batch->IsEmpty()) {
+      consume(worker, batch);
+    }
+  });
 }
 
 }  // namespace bustub
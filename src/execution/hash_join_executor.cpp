@@ -11,6 +11,15 @@
 //===----------------------------------------------------------------------===//
 
 #include "execution/executors/hash_join_executor.h"
+#include <algorithm>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "binder/table_ref/bound_join_ref.h"
+#include "common/exception.h"
+#include "execution/executor_profile.h"
+#include "type/value_factory.h"
 
 // Note for 2022 Fall: You don't need to implement HashJoinExecutor to pass all tests. You ONLY need to implement it
 // if you want to get faster in leaderboard tests.
@@ -20,15 +29,319 @@ namespace bustub {
 HashJoinExecutor::HashJoinExecutor(ExecutorContext *exec_ctx, const HashJoinPlanNode *plan,
                                    std::unique_ptr<AbstractExecutor> &&left_child,
                                    std::unique_ptr<AbstractExecutor> &&right_child)
-    : AbstractExecutor(exec_ctx) {
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      left_executor_(ProfileChild(plan->GetLeftPlan(), std::move(left_child))),
+      right_executor_(ProfileChild(plan->GetRightPlan(), std::move(right_child))) {
   if (!(plan->GetJoinType() == JoinType::LEFT || plan->GetJoinType() == JoinType::INNER)) {
     // Note for 2022 Fall: You ONLY need to implement left join and inner join.
     throw bustub::NotImplementedException(fmt::format("join type {} not supported", plan->GetJoinType()));
   }
 }
 
-void HashJoinExecutor::Init() { throw NotImplementedException("HashJoinExecutor is not implemented"); }
+void HashJoinExecutor::Init() {
+  left_executor_->Init();
+  right_executor_->Init();
+  grace_ = false;
+  left_partitions_.clear();
+  right_partitions_.clear();
+  left_batch_.Clear();
+  left_index_ = 0;
+  left_done_ = false;
+  probe_started_ = false;
+  Build();
+  if (grace_) {
+    PartitionLeft();
+  } else {
+    BuildTable();
+  }
+  has_left_tuple_ = false;
+}
 
-auto HashJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool { return false; }
+void HashJoinExecutor::Build() {
+  build_tuples_.clear();
+  build_keys_.clear();
+  build_bytes_ = 0;
+  auto budget = memory_budget_.load(std::memory_order_relaxed);
+  const auto &right_schema = right_executor_->GetOutputSchema();
+  TupleBatch batch;
+  while (bustub::NextBatch(right_executor_.get(), &batch)) {
+    for (size_t i = 0; i < batch.Size(); i++) {
+      auto &tuple = batch.GetTuple(i);
+      auto key = plan_->RightJoinKeyExpression().Evaluate(&tuple, right_schema);
+      if (grace_) {
+        // right tuple 只会和 key 相同的 left tuple 匹配，NULL key 不需要保留
+        if (!key.IsNull()) {
+          auto hash = KeyHash(key);
+          right_partitions_[GracePartition(hash)]->Append(tuple);
+        }
+        continue;
+      }
+      build_bytes_ += tuple.GetLength() + sizeof(Tuple) + sizeof(Value) + sizeof(BuildEntry);
+      build_tuples_.emplace_back(std::move(tuple));
+      build_keys_.emplace_back(key);
+      peak_memory_bytes_ = std::max(peak_memory_bytes_, build_bytes_);
+      if (build_bytes_ > budget) {
+        StartSpilling();
+      }
+    }
+  }
+}
+
+void HashJoinExecutor::StartSpilling() {
+  auto bpm = exec_ctx_->GetBufferPoolManager();
+  for (size_t i = 0; i < GRACE_NUM_PARTITIONS; i++) {
+    left_partitions_.emplace_back(std::make_unique<SpillFile>(bpm));
+    right_partitions_.emplace_back(std::make_unique<SpillFile>(bpm));
+  }
+  for (size_t i = 0; i < build_tuples_.size(); i++) {
+    if (!build_keys_[i].IsNull()) {
+      auto hash = KeyHash(build_keys_[i]);
+      right_partitions_[GracePartition(hash)]->Append(build_tuples_[i]);
+    }
+  }
+  build_tuples_.clear();
+  build_keys_.clear();
+  grace_ = true;
+}
+
+void HashJoinExecutor::PartitionLeft() {
+  // unpin right partition 正在写的 page，同一时间只有一侧的 partition 各 pin 住一个 page
+  for (auto &partition : right_partitions_) {
+    partition->Rewind();
+  }
+  const auto &left_schema = left_executor_->GetOutputSchema();
+  while (bustub::NextBatch(left_executor_.get(), &left_batch_)) {
+    for (size_t i = 0; i < left_batch_.Size(); i++) {
+      const auto &tuple = left_batch_.GetTuple(i);
+      auto key = plan_->LeftJoinKeyExpression().Evaluate(&tuple, left_schema);
+      // NULL key 不会匹配，但 left join 仍然要输出，放在任意一个 partition 中
+      size_t partition = 0;
+      if (!key.IsNull()) {
+        partition = GracePartition(KeyHash(key));
+      }
+      left_partitions_[partition]->Append(tuple);
+    }
+  }
+  left_batch_.Clear();
+  for (auto &partition : left_partitions_) {
+    partition->Rewind();
+  }
+  grace_partition_ = 0;
+  LoadPartition(0);
+}
+
+void HashJoinExecutor::LoadPartition(size_t partition) {
+  build_tuples_.clear();
+  build_keys_.clear();
+  // 没有 left tuple 的 partition 不需要 build
+  if (left_partitions_[partition]->GetNumTuples() > 0) {
+    const auto &right_schema = right_executor_->GetOutputSchema();
+    auto &right_partition = right_partitions_[partition];
+    Tuple tuple;
+    size_t bytes = 0;
+    while (right_partition->Next(&tuple)) {
+      bytes += tuple.GetLength() + sizeof(Tuple) + sizeof(Value) + sizeof(BuildEntry);
+      build_keys_.emplace_back(plan_->RightJoinKeyExpression().Evaluate(&tuple, right_schema));
+      build_tuples_.emplace_back(tuple);
+    }
+    peak_memory_bytes_ = std::max(peak_memory_bytes_, bytes);
+  }
+  // right partition 已经读入内存，释放它的 page
+  right_partitions_[partition].reset();
+  BuildTable();
+}
+
+void HashJoinExecutor::BuildTable() {
+  std::vector<BuildEntry> entries;
+  entries.reserve(build_keys_.size());
+  for (size_t i = 0; i < build_keys_.size(); i++) {
+    if (!build_keys_[i].IsNull()) {
+      entries.push_back({KeyHash(build_keys_[i]), static_cast<uint32_t>(i)});
+    }
+  }
+
+  // partition 数为 2 的幂，使每个 partition 约 HJ_PARTITION_SIZE 个 entry
+  size_t partition_bits = 0;
+  while (partition_bits < HJ_MAX_PARTITION_BITS && (HJ_PARTITION_SIZE << partition_bits) < entries.size()) {
+    partition_bits++;
+  }
+  size_t num_partitions = static_cast<size_t>(1) << partition_bits;
+  partition_mask_ = num_partitions - 1;
+
+  // radix partition：先计数，再按 offset 分散到各个 partition
+  partition_offsets_.assign(num_partitions + 1, 0);
+  for (const auto &entry : entries) {
+    partition_offsets_[(entry.hash_ & partition_mask_) + 1]++;
+  }
+  for (size_t i = 0; i < num_partitions; i++) {
+    partition_offsets_[i + 1] += partition_offsets_[i];
+  }
+  entries_.resize(entries.size());
+  std::vector<size_t> cursors(partition_offsets_.begin(), partition_offsets_.end() - 1);
+  for (const auto &entry : entries) {
+    entries_[cursors[entry.hash_ & partition_mask_]++] = entry;
+  }
+  for (size_t i = 0; i < num_partitions; i++) {
+    std::sort(entries_.begin() + partition_offsets_[i], entries_.begin() + partition_offsets_[i + 1],
+              [](const BuildEntry &a, const BuildEntry &b) { return a.hash_ < b.hash_; });
+  }
+}
+
+auto HashJoinExecutor::NextLeftTuple() -> bool {
+  probe_started_ = true;
+  if (left_done_) {
+    return false;
+  }
+  if (!grace_) {
+    if (left_index_ == left_batch_.Size()) {
+      if (!bustub::NextBatch(left_executor_.get(), &left_batch_)) {
+        return false;
+      }
+      left_index_ = 0;
+    }
+    left_tuple_ = std::move(left_batch_.GetTuple(left_index_++));
+  } else {
+    if (grace_partition_ == GRACE_NUM_PARTITIONS) {
+      return false;
+    }
+    // 当前 partition 的 left tuple 读完后，释放它并载入下一个 partition
+    while (!left_partitions_[grace_partition_]->Next(&left_tuple_)) {
+      left_partitions_[grace_partition_].reset();
+      if (++grace_partition_ == GRACE_NUM_PARTITIONS) {
+        return false;
+      }
+      LoadPartition(grace_partition_);
+    }
+  }
+  left_matched_ = false;
+  left_key_ = plan_->LeftJoinKeyExpression().Evaluate(&left_tuple_, left_executor_->GetOutputSchema());
+  if (left_key_.IsNull()) {
+    match_pos_ = match_end_ = 0;
+    return true;
+  }
+  left_hash_ = KeyHash(left_key_);
+  std::tie(match_pos_, match_end_) = MatchRange(left_hash_);
+  return true;
+}
+
+auto HashJoinExecutor::KeyHash(const Value &key) -> hash_t {
+  // HashValue 对整数的 hash 不够分散，与 table_statistics.cpp 的 Mix() 一样用 fmix64 打散
+  uint64_t hash = HashUtil::HashValue(&key);
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return static_cast<hash_t>(hash);
+}
+
+auto HashJoinExecutor::MatchRange(hash_t hash) const -> std::pair<size_t, size_t> {
+  auto partition = hash & partition_mask_;
+  auto begin = entries_.begin() + partition_offsets_[partition];
+  auto end = entries_.begin() + partition_offsets_[partition + 1];
+  auto it = std::lower_bound(begin, end, hash, [](const BuildEntry &entry, hash_t h) { return entry.hash_ < h; });
+  return {it - entries_.begin(), end - entries_.begin()};
+}
+
+void HashJoinExecutor::MakeOutputTuple(const Tuple &left_tuple, const Tuple *right_tuple, Tuple *tuple) const {
+  const auto &left_schema = left_executor_->GetOutputSchema();
+  const auto &right_schema = right_executor_->GetOutputSchema();
+  std::vector<Value> values;
+  values.reserve(GetOutputSchema().GetColumnCount());
+  for (uint32_t i = 0; i < left_schema.GetColumnCount(); i++) {
+    values.emplace_back(left_tuple.GetValue(&left_schema, i));
+  }
+  for (uint32_t i = 0; i < right_schema.GetColumnCount(); i++) {
+    values.emplace_back(right_tuple == nullptr ? ValueFactory::GetNullValueByType(right_schema.GetColumn(i).GetType())
+                                               : right_tuple->GetValue(&right_schema, i));
+  }
+  *tuple = {values, &GetOutputSchema()};
+}
+
+auto HashJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  while (true) {
+    if (!has_left_tuple_) {
+      if (!NextLeftTuple()) {
+        return false;
+      }
+      has_left_tuple_ = true;
+    }
+    // 同一 partition 中 hash 相同的 entry 是连续的，hash 相同时再比较 key
+    while (match_pos_ < match_end_ && entries_[match_pos_].hash_ == left_hash_) {
+      auto index = entries_[match_pos_++].index_;
+      if (left_key_.CompareEquals(build_keys_[index]) == CmpBool::CmpTrue) {
+        left_matched_ = true;
+        MakeOutputTuple(left_tuple_, &build_tuples_[index], tuple);
+        return true;
+      }
+    }
+    has_left_tuple_ = false;
+    if (plan_->GetJoinType() == JoinType::LEFT && !left_matched_) {
+      MakeOutputTuple(left_tuple_, nullptr, tuple);
+      return true;
+    }
+  }
+}
+
+auto HashJoinExecutor::NextBatch(TupleBatch *batch) -> bool {
+  while (!batch->IsFull()) {
+    auto [tuple, rid] = batch->Emplace();
+    if (!HashJoinExecutor::Next(tuple, rid)) {
+      batch->PopBack();
+      break;
+    }
+  }
+  return !batch->IsEmpty();
+}
+
+auto HashJoinExecutor::ScanMorsels(size_t num_threads, const MorselConsumer &consume) -> bool {
+  auto source = dynamic_cast<MorselSource *>(left_executor_.get());
+  if (source == nullptr || grace_ || probe_started_) {
+    return false;
+  }
+  const auto &left_schema = left_executor_->GetOutputSchema();
+  bool is_left_join = plan_->GetJoinType() == JoinType::LEFT;
+  // 每个 worker 的 output batch，满了就交给 consume
+  std::vector<TupleBatch> outputs(num_threads);
+  auto emit = [&](size_t worker, const Tuple &left_tuple, const Tuple *right_tuple) {
+    auto &output = outputs[worker];
+    auto [tuple, rid] = output.Emplace();
+    MakeOutputTuple(left_tuple, right_tuple, tuple);
+    if (output.IsFull()) {
+      consume(worker, &output);
+      output.Clear();
+    }
+  };
+  bool scanned = source->ScanMorsels(num_threads, [&](size_t worker, TupleBatch *batch) {
+    for (size_t i = 0; i < batch->Size(); i++) {
+      const auto &left_tuple = batch->GetTuple(i);
+      auto key = plan_->LeftJoinKeyExpression().Evaluate(&left_tuple, left_schema);
+      bool matched = false;
+      if (!key.IsNull()) {
+        auto hash = KeyHash(key);
+        for (auto [pos, end] = MatchRange(hash); pos < end && entries_[pos].hash_ == hash; pos++) {
+          auto index = entries_[pos].index_;
+          if (key.CompareEquals(build_keys_[index]) == CmpBool::CmpTrue) {
+            matched = true;
+            emit(worker, left_tuple, &build_tuples_[index]);
+          }
+        }
+      }
+      if (is_left_join && !matched) {
+        emit(worker, left_tuple, nullptr);
+      }
+    }
+    // 这个 morsel 剩下的输出，不等到下一个 morsel
+    if (!outputs[worker].IsEmpty()) {
+      consume(worker, &outputs[worker]);
+      outputs[worker].Clear();
+    }
+  });
+  if (scanned) {
+    left_done_ = true;
+  }
+  return scanned;
+}
 
 }  // namespace bustub
@@ -9,28 +9,173 @@
 // Copyright (c) 2015-19, Carnegie Mellon University Database Group
 //
 //===----------------------------------------------------------------------===//
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "common/exception.h"
+#include "concurrency/transaction_manager.h"
 #include "execution/executors/index_scan_executor.h"
+#include "type/value_factory.h"
 
 namespace bustub {
 IndexScanExecutor::IndexScanExecutor(ExecutorContext *exec_ctx, const IndexScanPlanNode *plan)
     : AbstractExecutor(exec_ctx), plan_(plan) {}
 
 void IndexScanExecutor::Init() {
+  BUSTUB_ASSERT(plan_->key_predicate_ == nullptr, "the parameters of a prepared plan must be bound");
   auto index_info = exec_ctx_->GetCatalog()->GetIndex(plan_->index_oid_);
   index_ptr_ = dynamic_cast<BPlusTreeIndexForOneIntegerColumn *>(index_info->index_.get());
-  index_iterator_ = std::make_unique<BPlusTreeIndexIteratorForOneIntegerColumn>(index_ptr_->GetBeginIterator());
-  table_heap_ptr_ = exec_ctx_->GetCatalog()->GetTable(index_info->table_name_)->table_.get();
+  low_key_ = plan_->low_key_;
+  high_key_ = plan_->high_key_;
+  range_done_ = false;
+  batch_.clear();
+  batch_idx_ = 0;
+  auto table_info = exec_ctx_->GetCatalog()->GetTable(index_info->table_name_);
+  table_heap_ptr_ = table_info->table_.get();
+  table_oid_ = table_info->oid_;
+  auto txn = exec_ctx_->GetTransaction();
+  auto isolation_level = txn->GetIsolationLevel();
+  auto version_store = exec_ctx_->GetTransactionManager()->GetVersionStore();
+  snapshot_ = nullptr;
+  lock_rows_ = false;
+  if (isolation_level == IsolationLevel::REPEATABLE_READ || isolation_level == IsolationLevel::READ_COMMITTED) {
+    if (version_store->IsEnabled()) {
+      // MVCC：在 snapshot 中读，table 和 row 都不加锁
+      snapshot_ = version_store->GetSnapshot(txn);
+    } else if (!txn->IsTableSharedLocked(table_oid_) && !txn->IsTableSharedIntentionExclusiveLocked(table_oid_) &&
+               !txn->IsTableExclusiveLocked(table_oid_)) {
+      // 与 SeqScanExecutor 相同：没有覆盖所有行的 table lock 时先拿 IS，再逐行加 S lock
+      lock_rows_ = true;
+      if (!txn->IsTableIntentionSharedLocked(table_oid_) && !txn->IsTableIntentionExclusiveLocked(table_oid_) &&
+          !exec_ctx_->GetLockManager()->LockTable(txn, LockManager::LockMode::INTENTION_SHARED, table_oid_)) {
+        txn->SetState(TransactionState::ABORTED);
+        throw ExecutionException("IndexScanExecutor::Init failed: lock table IS lock failed");
+      }
+    }
+  }
+  key_schema_ = &index_info->key_schema_;
+  key_attrs_ = index_info->index_->GetKeyAttrs();
+}
+
+void IndexScanExecutor::FillBatch() {
+  batch_.clear();
+  batch_idx_ = 0;
+  if (range_done_) {
+    return;
+  }
+  // 把 range 转换成 index 的 key
+  auto to_index_key = [&](const std::optional<Value> &value) -> std::optional<IntegerKeyType> {
+    if (!value.has_value()) {
+      return std::nullopt;
+    }
+    IntegerKeyType index_key;
+    index_key.SetFromKey(Tuple({*value}, key_schema_));
+    return index_key;
+  };
+  auto iterator = index_ptr_->GetRangeIterator(to_index_key(low_key_), to_index_key(high_key_), plan_->reverse_);
+  for (; !iterator.IsEnd() && batch_.size() < INDEX_SCAN_BATCH_SIZE; ++iterator) {
+    batch_.emplace_back(*iterator);
+  }
+  if (iterator.IsEnd()) {
+    range_done_ = true;
+    return;
+  }
+  // key 是唯一的，下一批从最后一个 key 之后开始，iterator 析构时放开 leaf
+  auto last_key = batch_.back().first.ToValue(key_schema_, 0).GetAs<int32_t>();
+  if (plan_->reverse_) {
+    high_key_ = ValueFactory::GetIntegerValue(last_key);
+  } else if (last_key == std::numeric_limits<int32_t>::max()) {
+    range_done_ = true;
+  } else {
+    low_key_ = ValueFactory::GetIntegerValue(last_key + 1);
+  }
 }
 
 auto IndexScanExecutor::Next(Tuple *tuple, RID *rid) -> bool {
-  if (*index_iterator_ == index_ptr_->GetEndIterator()) {
+  auto version_store = exec_ctx_->GetTransactionManager()->GetVersionStore();
+  auto index_vacuum = exec_ctx_->GetTransactionManager()->GetIndexVacuum();
+  while (true) {
+    if (batch_idx_ == batch_.size()) {
+      FillBatch();
+      if (batch_.empty()) {
+        return false;
+      }
+    }
+    const auto &[key, entry_rid] = batch_[batch_idx_++];
+    *rid = entry_rid;
+    // 有旧版本的行需要读 heap 和 undo chain，其余行 index 中的 key 就是 snapshot 看到的；
+    // 需要 row lock 时 entry 在加锁前读出，可能已经过时，只能读 heap
+    bool from_index = plan_->index_only_ && !lock_rows_ &&
+                      (snapshot_ == nullptr || !version_store->HasVersions(table_oid_, *rid));
+    if (from_index) {
+      // 删除的行的 entry 可能还在等待 vacuum
+      if (index_vacuum->IsDead(table_oid_, *rid)) {
+        continue;
+      }
+      // 上层只读 key 列，直接用 index 的 key 构造 tuple，其余列为 NULL
+      const auto &schema = GetOutputSchema();
+      std::vector<Value> values;
+      values.reserve(schema.GetColumnCount());
+      for (uint32_t i = 0; i < schema.GetColumnCount(); i++) {
+        values.emplace_back(ValueFactory::GetNullValueByType(schema.GetColumn(i).GetType()));
+      }
+      for (uint32_t i = 0; i < key_attrs_.size(); i++) {
+        values[key_attrs_[i]] = key.ToValue(key_schema_, i);
+      }
+      *tuple = Tuple(values, &schema);
+    } else if (snapshot_ != nullptr) {
+      // snapshot 看不到这一行时跳过
+      if (!version_store->ReadVisible(table_heap_ptr_, table_oid_, *rid, *snapshot_, exec_ctx_->GetTransaction(),
+                                      tuple)) {
+        continue;
+      }
+    } else {
+      bool locked = LockRow(*rid);
+      // 从读出 entry 到加锁之间 tuple 可能已被删除，或者 key 已被修改到 range 之外
+      bool found = table_heap_ptr_->GetTuple(*rid, tuple, exec_ctx_->GetTransaction()) && InRange(*tuple);
+      UnlockRow(*rid, locked);
+      if (!found) {
+        continue;
+      }
+    }
+    return true;
+  }
+}
+
+auto IndexScanExecutor::InRange(const Tuple &tuple) const -> bool {
+  auto key = tuple.GetValue(&GetOutputSchema(), key_attrs_[0]);
+  if (key.IsNull()) {
     return false;
   }
-  *rid = (**index_iterator_).second;
-  table_heap_ptr_->GetTuple(*rid, tuple, exec_ctx_->GetTransaction());
-  ++(*index_iterator_);
-  // index_iterator_->operator++();
+  return (!plan_->low_key_.has_value() || key.CompareGreaterThanEquals(*plan_->low_key_) == CmpBool::CmpTrue) &&
+         (!plan_->high_key_.has_value() || key.CompareLessThan(*plan_->high_key_) == CmpBool::CmpTrue);
+}
+
+auto IndexScanExecutor::LockRow(const RID &rid) -> bool {
+  if (!lock_rows_) {
+    return false;
+  }
+  auto txn = exec_ctx_->GetTransaction();
+  if (txn->IsRowSharedLocked(table_oid_, rid) || txn->IsRowExclusiveLocked(table_oid_, rid)) {
+    return false;
+  }
+  if (!exec_ctx_->GetLockManager()->LockRow(txn, LockManager::LockMode::SHARED, table_oid_, rid)) {
+    txn->SetState(TransactionState::ABORTED);
+    throw ExecutionException("IndexScanExecutor::Next failed: lock row failed");
+  }
   return true;
 }
 
+void IndexScanExecutor::UnlockRow(const RID &rid, bool locked) {
+  // REPEATABLE_READ growing 阶段不能 unlock
+  auto txn = exec_ctx_->GetTransaction();
+  if (locked && txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED &&
+      !exec_ctx_->GetLockManager()->UnlockRow(txn, table_oid_, rid)) {
+    txn->SetState(TransactionState::ABORTED);
+    throw ExecutionException("IndexScanExecutor::Next failed: unlock row failed");
+  }
+}
+
 }  // namespace bustub
@@ -10,17 +10,26 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <memory>
+#include <utility>
 #include <vector>
 
+#include "catalog/table_statistics.h"
 #include "common/exception.h"
+#include "concurrency/transaction_manager.h"
+#include "execution/executors/batch_executor.h"
+#include "execution/executor_profile.h"
 #include "execution/executors/insert_executor.h"
 
 namespace bustub {
 
 InsertExecutor::InsertExecutor(ExecutorContext *exec_ctx, const InsertPlanNode *plan,
                                std::unique_ptr<AbstractExecutor> &&child_executor)
-    : AbstractExecutor(exec_ctx), plan_(plan), child_executor_(std::move(child_executor)), done_(false) {}
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      child_executor_(ProfileChild(plan->GetChildPlan(), std::move(child_executor))),
+      done_(false) {}
 
 void InsertExecutor::Init() {
   auto txn = exec_ctx_->GetTransaction();
@@ -36,27 +45,64 @@ void InsertExecutor::Init() {
   }
 }
 
-auto InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
+auto InsertExecutor::Next([[maybe_unused]] Tuple *tuple, [[maybe_unused]] RID *rid) -> bool {
   if (done_) {
     return false;
   }
   int rows = 0;
-  Tuple t;
   auto txn = exec_ctx_->GetTransaction();
-  while (child_executor_->Next(&t, rid)) {
-    // insert tuple first, then lock S on this row
-    RID inserted_rid;
-    rows += static_cast<int>(table_heap_ptr_->InsertTuple(t, &inserted_rid, txn));
-    if (!exec_ctx_->GetLockManager()->LockRow(txn, LockManager::LockMode::EXCLUSIVE, table_info_->oid_, inserted_rid)) {
+  auto indexes = exec_ctx_->GetCatalog()->GetTableIndexes(table_info_->name_);
+  auto version_store = exec_ctx_->GetTransactionManager()->GetVersionStore();
+  auto index_vacuum = exec_ctx_->GetTransactionManager()->GetIndexVacuum();
+  auto statistics = StatisticsCatalog::GetTableStatistics(exec_ctx_->GetCatalog(), table_info_->oid_);
+  // 每个 index 攒一个 batch 的 entry 再一起插入
+  std::vector<std::vector<std::pair<Tuple, RID>>> index_entries(indexes.size());
+  TupleBatch batch;
+  std::vector<const Tuple *> tuples;
+  std::vector<RID> rids;
+  std::vector<RID> inserted_rids;
+  std::vector<const Tuple *> inserted_tuples;
+  while (NextBatch(child_executor_.get(), &batch)) {
+    tuples.clear();
+    for (size_t i = 0; i < batch.Size(); i++) {
+      tuples.emplace_back(&batch.GetTuple(i));
+    }
+    // insert the whole batch first, then lock X on its rows
+    // 新行的 undo chain 记录它之前不存在，snapshot 看不到 uncommitted 的行
+    version_store->InsertTuples(txn, table_info_->oid_, table_heap_ptr_, tuples, &rids);
+    inserted_rids.clear();
+    inserted_tuples.clear();
+    for (size_t i = 0; i < tuples.size(); i++) {
+      if (rids[i].GetPageId() == INVALID_PAGE_ID) {
+        continue;
+      }
+      inserted_rids.emplace_back(rids[i]);
+      inserted_tuples.emplace_back(tuples[i]);
+      // 更新 index
+      for (size_t j = 0; j < indexes.size(); j++) {
+        auto index_key =
+            tuples[i]->KeyFromTuple(table_info_->schema_, indexes[j]->key_schema_, indexes[j]->index_->GetKeyAttrs());
+        index_entries[j].emplace_back(std::move(index_key), rids[i]);
+      }
+    }
+    rows += static_cast<int>(inserted_rids.size());
+    if (statistics != nullptr) {
+      statistics->RecordInserts(table_info_->schema_, inserted_tuples);
+    }
+    if (!exec_ctx_->GetLockManager()->LockRows(txn, LockManager::LockMode::EXCLUSIVE, table_info_->oid_,
+                                               inserted_rids)) {
       txn->SetState(TransactionState::ABORTED);
       throw ExecutionException("InsertExecutor::Next failed: lock X on row failed");
     }
-    // 更新 index
-    auto indexes = exec_ctx_->GetCatalog()->GetTableIndexes(table_info_->name_);
-    for (auto index_info : indexes) {
-      auto index_key = t.KeyFromTuple(table_info_->schema_, index_info->key_schema_, index_info->index_->GetKeyAttrs());
-      index_info->index_->InsertEntry(index_key, inserted_rid, txn);
+    // dead row 的 key 或 RID 可能被再次插入
+    if (!indexes.empty() && index_vacuum->HasDeadRows(table_info_->oid_)) {
+      index_vacuum->Vacuum(txn);
     }
+    InsertIndexEntries(indexes, &index_entries);
+  }
+  // 表的第一次写入，或者自上次 analyze 后改变了足够多的行时，重新收集统计信息
+  if (rows > 0) {
+    StatisticsCatalog::AnalyzeIfStale(exec_ctx_->GetCatalog(), table_info_, txn);
   }
   Value value(TypeId::INTEGER, rows);
   std::vector<Value> v;
@@ -69,4 +115,34 @@ auto InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
   done_ = true;
   return true;
 }
+
+void InsertExecutor::InsertIndexEntries(const std::vector<IndexInfo *> &indexes,
+                                        std::vector<std::vector<std::pair<Tuple, RID>>> *index_entries) {
+  auto txn = exec_ctx_->GetTransaction();
+  auto index_vacuum = exec_ctx_->GetTransactionManager()->GetIndexVacuum();
+  for (size_t i = 0; i < indexes.size(); i++) {
+    auto &entries = (*index_entries)[i];
+    auto index = indexes[i]->index_.get();
+    auto index_ptr = dynamic_cast<BPlusTreeIndexForOneIntegerColumn *>(index);
+    // 整个 batch 都插入成功时不需要逐个检查
+    bool check_each = index_ptr == nullptr || index_ptr->InsertEntries(entries, txn) < entries.size();
+    for (size_t j = 0; check_each && j < entries.size(); j++) {
+      const auto &[index_key, inserted_rid] = entries[j];
+      if (index_ptr != nullptr) {
+        std::vector<RID> rids;
+        index_ptr->ScanKey(index_key, &rids, txn);
+        if (std::find(rids.begin(), rids.end(), inserted_rid) != rids.end()) {
+          continue;
+        }
+      }
+      // key 被 dead row 占用时等待它的 deleter 结束；被 live row 占用时 abort
+      if (!index_vacuum->InsertEntry(txn, exec_ctx_->GetLockManager(), table_info_->oid_, index, index_key,
+                                     inserted_rid)) {
+        txn->SetState(TransactionState::ABORTED);
+        throw ExecutionException("InsertExecutor::Next failed: duplicate key in index " + indexes[i]->name_);
+      }
+    }
+    entries.clear();
+  }
+}
 }  // namespace bustub
@@ -0,0 +1,159 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// merge_join_executor.cpp
+//
+// Identification: src/execution/merge_join_executor.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/executors/merge_join_executor.h"
+#include <memory>
+#include <vector>
+#include "binder/table_ref/bound_join_ref.h"
+#include "common/exception.h"
+#include "execution/executor_profile.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+namespace {
+
+auto LessThan(const Value &a, const Value &b) -> bool { return a.CompareLessThan(b) == CmpBool::CmpTrue; }
+
+auto Equals(const Value &a, const Value &b) -> bool { return a.CompareEquals(b) == CmpBool::CmpTrue; }
+
+}  // namespace
+
+MergeJoinExecutor::MergeJoinExecutor(ExecutorContext *exec_ctx, const MergeJoinPlanNode *plan,
+                                     std::unique_ptr<AbstractExecutor> &&left_executor,
+                                     std::unique_ptr<AbstractExecutor> &&right_executor)
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      left_executor_(ProfileChild(plan->GetLeftPlan(), std::move(left_executor))),
+      right_executor_(ProfileChild(plan->GetRightPlan(), std::move(right_executor))) {
+  if (plan->GetJoinType() != JoinType::LEFT && plan->GetJoinType() != JoinType::INNER) {
+    throw bustub::NotImplementedException(fmt::format("join type {} not supported", plan->GetJoinType()));
+  }
+  is_inner_join_ = plan->GetJoinType() == JoinType::INNER;
+}
+
+void MergeJoinExecutor::Init() {
+  left_executor_->Init();
+  right_executor_->Init();
+  left_batch_.Clear();
+  left_index_ = 0;
+  left_tuple_ = nullptr;
+  right_batch_.Clear();
+  right_index_ = 0;
+  run_.clear();
+  has_run_ = false;
+  run_pos_ = 0;
+  NextRightTuple();
+}
+
+auto MergeJoinExecutor::NextLeftTuple() -> bool {
+  if (left_index_ == left_batch_.Size()) {
+    if (!bustub::NextBatch(left_executor_.get(), &left_batch_)) {
+      left_tuple_ = nullptr;
+      return false;
+    }
+    left_index_ = 0;
+  }
+  left_tuple_ = &left_batch_.GetTuple(left_index_++);
+  left_key_ = plan_->LeftJoinKeyExpression().Evaluate(left_tuple_, left_executor_->GetOutputSchema());
+  left_matched_ = false;
+  run_pos_ = 0;
+  return true;
+}
+
+auto MergeJoinExecutor::NextRightTuple() -> bool {
+  if (right_index_ == right_batch_.Size()) {
+    if (!bustub::NextBatch(right_executor_.get(), &right_batch_)) {
+      right_tuple_ = nullptr;
+      return false;
+    }
+    right_index_ = 0;
+  }
+  right_tuple_ = &right_batch_.GetTuple(right_index_++);
+  right_key_ = plan_->RightJoinKeyExpression().Evaluate(right_tuple_, right_executor_->GetOutputSchema());
+  return true;
+}
+
+void MergeJoinExecutor::LoadRun() {
+  // left key 是递增的，比 run 大时 run 不会再被用到
+  if (has_run_ && !LessThan(run_key_, left_key_)) {
+    return;
+  }
+  run_.clear();
+  has_run_ = false;
+  while (right_tuple_ != nullptr && (right_key_.IsNull() || LessThan(right_key_, left_key_))) {
+    NextRightTuple();
+  }
+  if (right_tuple_ == nullptr || !Equals(right_key_, left_key_)) {
+    return;
+  }
+  run_key_ = right_key_;
+  has_run_ = true;
+  while (right_tuple_ != nullptr && !right_key_.IsNull() && Equals(right_key_, run_key_)) {
+    run_.emplace_back(*right_tuple_);
+    NextRightTuple();
+  }
+}
+
+void MergeJoinExecutor::MakeOutputTuple(const Tuple *right_tuple, Tuple *tuple) const {
+  const auto &left_schema = left_executor_->GetOutputSchema();
+  const auto &right_schema = right_executor_->GetOutputSchema();
+  std::vector<Value> values;
+  values.reserve(GetOutputSchema().GetColumnCount());
+  for (uint32_t i = 0; i < left_schema.GetColumnCount(); i++) {
+    values.emplace_back(left_tuple_->GetValue(&left_schema, i));
+  }
+  for (uint32_t i = 0; i < right_schema.GetColumnCount(); i++) {
+    values.emplace_back(right_tuple == nullptr ? ValueFactory::GetNullValueByType(right_schema.GetColumn(i).GetType())
+                                               : right_tuple->GetValue(&right_schema, i));
+  }
+  *tuple = {values, &GetOutputSchema()};
+}
+
+auto MergeJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  while (true) {
+    if (left_tuple_ == nullptr && !NextLeftTuple()) {
+      return false;
+    }
+    // 当前 left tuple 与 run 中的 right tuple 逐个输出
+    if (!left_key_.IsNull()) {
+      LoadRun();
+      if (has_run_ && Equals(run_key_, left_key_) && run_pos_ < run_.size()) {
+        MakeOutputTuple(&run_[run_pos_++], tuple);
+        left_matched_ = true;
+        return true;
+      }
+    }
+    // left tuple is over, left join outputs it with NULLs if it had no match
+    bool output_null = !is_inner_join_ && !left_matched_;
+    if (output_null) {
+      MakeOutputTuple(nullptr, tuple);
+    }
+    left_tuple_ = nullptr;
+    if (output_null) {
+      return true;
+    }
+  }
+}
+
+auto MergeJoinExecutor::NextBatch(TupleBatch *batch) -> bool {
+  while (!batch->IsFull()) {
+    auto [tuple, rid] = batch->Emplace();
+    if (!MergeJoinExecutor::Next(tuple, rid)) {
+      batch->PopBack();
+      break;
+    }
+  }
+  return !batch->IsEmpty();
+}
+
+}  // namespace bustub
@@ -11,8 +11,12 @@
 //===----------------------------------------------------------------------===//
 
 #include "execution/executors/nested_index_join_executor.h"
+#include <algorithm>
+#include <utility>
 #include <vector>
 #include "common/exception.h"
+#include "concurrency/transaction_manager.h"
+#include "execution/executor_profile.h"
 #include "type/value.h"
 #include "type/value_factory.h"
 
@@ -20,7 +24,9 @@ namespace bustub {
 
 NestIndexJoinExecutor::NestIndexJoinExecutor(ExecutorContext *exec_ctx, const NestedIndexJoinPlanNode *plan,
                                              std::unique_ptr<AbstractExecutor> &&child_executor)
-    : AbstractExecutor(exec_ctx), plan_(plan), child_executor_(std::move(child_executor)) {
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      child_executor_(ProfileChild(plan->GetChildPlan(), std::move(child_executor))) {
   if (!(plan->GetJoinType() == JoinType::LEFT || plan->GetJoinType() == JoinType::INNER)) {
     // Note for 2022 Fall: You ONLY need to implement left join and inner join.
     throw bustub::NotImplementedException(fmt::format("join type {} not supported", plan->GetJoinType()));
@@ -32,29 +38,98 @@ void NestIndexJoinExecutor::Init() {
   child_executor_->Init();
   inner_index_info_ = exec_ctx_->GetCatalog()->GetIndex(plan_->GetIndexOid());
   inner_table_info_ = exec_ctx_->GetCatalog()->GetTable(plan_->GetInnerTableOid());
+  outer_tuples_.clear();
+  batch_results_.clear();
+  batch_tuples_.clear();
+  batch_pos_ = 0;
+  match_pos_ = 0;
 }
 
-auto NestIndexJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+auto NestIndexJoinExecutor::FetchBatch() -> bool {
+  outer_tuples_.clear();
+  batch_pos_ = 0;
+  match_pos_ = 0;
+  std::vector<Tuple> keys;
   Tuple left_tuple;
   RID left_rid;
-  auto left_schema = child_executor_->GetOutputSchema();
-  auto right_schema = inner_table_info_->schema_;
-  while (child_executor_->Next(&left_tuple, &left_rid)) {
+  auto key_schema = inner_index_info_->index_->GetKeySchema();
+  while (outer_tuples_.size() < NIJ_BATCH_SIZE && child_executor_->Next(&left_tuple, &left_rid)) {
     // outer table 一定有 inner table index 的 schema，
     // 因为他们通过 index 联立的
-    auto key_schema = inner_index_info_->index_->GetKeySchema();
+    std::vector<Value> values{plan_->KeyPredicate()->Evaluate(&left_tuple, child_executor_->GetOutputSchema())};
+    keys.emplace_back(values, key_schema);
+    outer_tuples_.emplace_back(std::move(left_tuple));
+  }
+  if (outer_tuples_.empty()) {
+    return false;
+  }
+  auto index_ptr = dynamic_cast<BPlusTreeIndexForOneIntegerColumn *>(inner_index_info_->index_.get());
+  if (index_ptr != nullptr) {
+    index_ptr->ScanKeys(keys, &batch_results_, exec_ctx_->GetTransaction());
+  } else {
+    // 不是 B+ 树 index 时逐个查找
+    batch_results_.assign(keys.size(), {});
+    for (size_t i = 0; i < keys.size(); i++) {
+      inner_index_info_->index_->ScanKey(keys[i], &batch_results_[i], exec_ctx_->GetTransaction());
+    }
+  }
+  // vacuum 还没有删除的 index entry 指向已经删除的行
+  auto index_vacuum = exec_ctx_->GetTransactionManager()->GetIndexVacuum();
+  auto oid = inner_table_info_->oid_;
+  if (index_vacuum->HasDeadRows(oid)) {
+    for (auto &results : batch_results_) {
+      results.erase(std::remove_if(results.begin(), results.end(),
+                                   [&](const RID &rid) { return index_vacuum->IsDead(oid, rid); }),
+                    results.end());
+    }
+  }
+  // 按 page 顺序读取 inner table，同一个 page 的 tuple 连续读取，多个 outer tuple 匹配的 RID 只读一次
+  std::vector<std::pair<size_t, size_t>> order;
+  batch_tuples_.resize(batch_results_.size());
+  for (size_t i = 0; i < batch_results_.size(); i++) {
+    batch_tuples_[i].resize(batch_results_[i].size());
+    for (size_t j = 0; j < batch_results_[i].size(); j++) {
+      order.emplace_back(i, j);
+    }
+  }
+  auto rid_of = [&](const std::pair<size_t, size_t> &pos) -> const RID & {
+    return batch_results_[pos.first][pos.second];
+  };
+  std::sort(order.begin(), order.end(), [&](const auto &a, const auto &b) {
+    const auto &rid_a = rid_of(a);
+    const auto &rid_b = rid_of(b);
+    return rid_a.GetPageId() != rid_b.GetPageId() ? rid_a.GetPageId() < rid_b.GetPageId()
+                                                 : rid_a.GetSlotNum() < rid_b.GetSlotNum();
+  });
+  for (size_t k = 0; k < order.size(); k++) {
+    auto [i, j] = order[k];
+    if (k > 0 && rid_of(order[k - 1]) == rid_of(order[k])) {
+      auto [prev_i, prev_j] = order[k - 1];
+      batch_tuples_[i][j] = batch_tuples_[prev_i][prev_j];
+    } else if (!inner_table_info_->table_->GetTuple(rid_of(order[k]), &batch_tuples_[i][j],
+                                                    exec_ctx_->GetTransaction())) {
+      throw Exception("can not find tuple with rid\n");
+    }
+  }
+  return true;
+}
+
+auto NestIndexJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  const auto &left_schema = child_executor_->GetOutputSchema();
+  const auto &right_schema = inner_table_info_->schema_;
+  while (true) {
+    if (batch_pos_ == outer_tuples_.size() && !FetchBatch()) {
+      return false;
+    }
+    const auto &left_tuple = outer_tuples_[batch_pos_];
+    const auto &results = batch_results_[batch_pos_];
     std::vector<Value> values;
-    auto value = plan_->KeyPredicate()->Evaluate(&left_tuple, child_executor_->GetOutputSchema());
-    values.push_back(value);
-    Tuple key(values, key_schema);
-    std::vector<RID> results;
-    inner_index_info_->index_->ScanKey(key, &results, exec_ctx_->GetTransaction());
     if (results.empty()) {
+      batch_pos_++;
       if (is_inner_) {
         continue;
       }
       // 输出一个空的
-      values.clear();
       for (int i = 0, sz = left_schema.GetColumnCount(); i < sz; i++) {
         values.emplace_back(left_tuple.GetValue(&left_schema, i));
       }
@@ -64,24 +139,21 @@ auto NestIndexJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
       *tuple = {values, &(plan_->OutputSchema())};
       return true;
     }
-    values.clear();
-    // 读取符合条件的 tuple
-    for (auto &rid : results) {
-      Tuple right_tuple;
-      if (!inner_table_info_->table_->GetTuple(rid, &right_tuple, exec_ctx_->GetTransaction())) {
-        throw Exception("can not find tuple with rid\n");
-      }
-      for (int i = 0, sz = left_schema.GetColumnCount(); i < sz; i++) {
-        values.emplace_back(left_tuple.GetValue(&left_schema, i));
-      }
-      for (int i = 0, sz = right_schema.GetColumnCount(); i < sz; i++) {
-        values.emplace_back(right_tuple.GetValue(&right_schema, i));
-      }
-      *tuple = {values, &(plan_->OutputSchema())};
-      return true;
+    // 每次输出一个符合条件的 tuple
+    const auto &right_tuple = batch_tuples_[batch_pos_][match_pos_];
+    if (++match_pos_ == results.size()) {
+      batch_pos_++;
+      match_pos_ = 0;
+    }
+    for (int i = 0, sz = left_schema.GetColumnCount(); i < sz; i++) {
+      values.emplace_back(left_tuple.GetValue(&left_schema, i));
+    }
+    for (int i = 0, sz = right_schema.GetColumnCount(); i < sz; i++) {
+      values.emplace_back(right_tuple.GetValue(&right_schema, i));
     }
+    *tuple = {values, &(plan_->OutputSchema())};
+    return true;
   }
-  return false;
 }
 
 }  // namespace bustub
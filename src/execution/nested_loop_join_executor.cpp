@@ -11,21 +11,97 @@
 //===----------------------------------------------------------------------===//
 
 #include "execution/executors/nested_loop_join_executor.h"
+#include <algorithm>
+#include <functional>
 #include <memory>
 #include <vector>
 #include "binder/table_ref/bound_join_ref.h"
 #include "common/exception.h"
+#include "execution/executor_profile.h"
+#include "execution/expressions/column_value_expression.h"
+#include "execution/expressions/constant_value_expression.h"
+#include "execution/expressions/logic_expression.h"
 #include "type/value_factory.h"
 
 namespace bustub {
 
+namespace {
+
+auto IsNumeric(TypeId type) -> bool {
+  return type == TypeId::TINYINT || type == TypeId::SMALLINT || type == TypeId::INTEGER || type == TypeId::BIGINT ||
+         type == TypeId::DECIMAL;
+}
+
+/** @return the operator with its operands swapped: `a op b` is `b Flip(op) a` */
+auto Flip(ComparisonType comp_type) -> ComparisonType {
+  switch (comp_type) {
+    case ComparisonType::LessThan:
+      return ComparisonType::GreaterThan;
+    case ComparisonType::LessThanOrEqual:
+      return ComparisonType::GreaterThanOrEqual;
+    case ComparisonType::GreaterThan:
+      return ComparisonType::LessThan;
+    case ComparisonType::GreaterThanOrEqual:
+      return ComparisonType::LessThanOrEqual;
+    default:
+      return comp_type;
+  }
+}
+
+void SplitConjuncts(const AbstractExpressionRef &expr, std::vector<AbstractExpressionRef> *conjuncts) {
+  if (const auto *logic_expr = dynamic_cast<const LogicExpression *>(expr.get());
+      logic_expr != nullptr && logic_expr->logic_type_ == LogicType::And) {
+    SplitConjuncts(logic_expr->GetChildAt(0), conjuncts);
+    SplitConjuncts(logic_expr->GetChildAt(1), conjuncts);
+    return;
+  }
+  const auto *constant_expr = dynamic_cast<const ConstantValueExpression *>(expr.get());
+  if (constant_expr != nullptr && !constant_expr->val_.IsNull() &&
+      constant_expr->val_.CastAs(TypeId::BOOLEAN).GetAs<bool>()) {
+    return;
+  }
+  conjuncts->emplace_back(expr);
+}
+
+/** mask[i] &= valid[i] && column[i] op value; 没有分支，编译器可以向量化 */
+template <class T, class Op>
+void SelectBlock(const std::vector<T> &column, const std::vector<uint8_t> &valid, T value, std::vector<uint8_t> *mask) {
+  const T *col = column.data();
+  const uint8_t *val = valid.data();
+  uint8_t *out = mask->data();
+  for (size_t i = 0, n = column.size(); i < n; i++) {
+    out[i] &= val[i] & static_cast<uint8_t>(Op{}(col[i], value));
+  }
+}
+
+template <class T>
+void SelectBlock(ComparisonType comp_type, const std::vector<T> &column, const std::vector<uint8_t> &valid, T value,
+                 std::vector<uint8_t> *mask) {
+  switch (comp_type) {
+    case ComparisonType::Equal:
+      return SelectBlock<T, std::equal_to<>>(column, valid, value, mask);
+    case ComparisonType::NotEqual:
+      return SelectBlock<T, std::not_equal_to<>>(column, valid, value, mask);
+    case ComparisonType::LessThan:
+      return SelectBlock<T, std::less<>>(column, valid, value, mask);
+    case ComparisonType::LessThanOrEqual:
+      return SelectBlock<T, std::less_equal<>>(column, valid, value, mask);
+    case ComparisonType::GreaterThan:
+      return SelectBlock<T, std::greater<>>(column, valid, value, mask);
+    case ComparisonType::GreaterThanOrEqual:
+      return SelectBlock<T, std::greater_equal<>>(column, valid, value, mask);
+  }
+}
+
+}  // namespace
+
 NestedLoopJoinExecutor::NestedLoopJoinExecutor(ExecutorContext *exec_ctx, const NestedLoopJoinPlanNode *plan,
                                                std::unique_ptr<AbstractExecutor> &&left_executor,
                                                std::unique_ptr<AbstractExecutor> &&right_executor)
     : AbstractExecutor(exec_ctx),
       plan_(plan),
-      left_executor_(std::move(left_executor)),
-      right_executor_(std::move(right_executor)),
+      left_executor_(ProfileChild(plan->GetLeftPlan(), std::move(left_executor))),
+      right_executor_(ProfileChild(plan->GetRightPlan(), std::move(right_executor))),
       left_schema_(left_executor_->GetOutputSchema()),
       right_schema_(right_executor_->GetOutputSchema()) {
   if (plan->GetJoinType() != JoinType::LEFT && plan->GetJoinType() != JoinType::INNER) {
@@ -37,77 +113,223 @@ NestedLoopJoinExecutor::NestedLoopJoinExecutor(ExecutorContext *exec_ctx, const
 void NestedLoopJoinExecutor::Init() {
   left_executor_->Init();
   right_executor_->Init();
-
-  // left_schema_ = left_executor_->GetOutputSchema();
-  // right_schema_ = right_executor_->GetOutputSchema();
-  all_columns_.clear();
+  is_inner_join_ = plan_->GetJoinType() == JoinType::INNER;
+  CompilePredicate();
+  left_block_.clear();
+  left_matched_.clear();
+  left_batch_.Clear();
+  left_index_ = 0;
+  left_done_ = false;
+  left_pos_ = 0;
+  unmatched_pos_ = 0;
   right_tuples_.clear();
-
+  right_cache_bytes_ = 0;
+  caching_ = true;
+  right_cached_ = false;
+  right_batch_.Clear();
   right_index_ = 0;
-  Tuple tuple;
-  RID rid;
-  while (right_executor_->Next(&tuple, &rid)) {
-    right_tuples_.emplace_back(tuple);
+  right_tuple_ = nullptr;
+}
+
+void NestedLoopJoinExecutor::CompilePredicate() {
+  block_comparisons_.clear();
+  std::vector<AbstractExpressionRef> conjuncts;
+  SplitConjuncts(plan_->Predicate(), &conjuncts);
+  residual_expr_ = nullptr;
+  for (const auto &conjunct : conjuncts) {
+    const auto *comp_expr = dynamic_cast<const ComparisonExpression *>(conjunct.get());
+    const ColumnValueExpression *lhs = nullptr;
+    const ColumnValueExpression *rhs = nullptr;
+    if (comp_expr != nullptr) {
+      lhs = dynamic_cast<const ColumnValueExpression *>(comp_expr->GetChildAt(0).get());
+      rhs = dynamic_cast<const ColumnValueExpression *>(comp_expr->GetChildAt(1).get());
+    }
+    if (lhs != nullptr && rhs != nullptr && lhs->GetTupleIdx() != rhs->GetTupleIdx()) {
+      auto comp_type = comp_expr->comp_type_;
+      if (lhs->GetTupleIdx() == 1) {
+        std::swap(lhs, rhs);
+        comp_type = Flip(comp_type);
+      }
+      auto left_type = left_schema_.GetColumn(lhs->GetColIdx()).GetType();
+      auto right_type = right_schema_.GetColumn(rhs->GetColIdx()).GetType();
+      if (IsNumeric(left_type) && IsNumeric(right_type)) {
+        auto &comparison = block_comparisons_.emplace_back();
+        comparison.comp_type_ = comp_type;
+        comparison.left_col_idx_ = lhs->GetColIdx();
+        comparison.right_col_idx_ = rhs->GetColIdx();
+        comparison.is_decimal_ = left_type == TypeId::DECIMAL || right_type == TypeId::DECIMAL;
+        continue;
+      }
+    }
+    residual_expr_ = residual_expr_ == nullptr
+                         ? conjunct
+                         : std::make_shared<LogicExpression>(residual_expr_, conjunct, LogicType::And);
+  }
+  residual_ = nullptr;
+  if (residual_expr_ != nullptr) {
+    residual_ = std::make_unique<CompiledPredicate>(*residual_expr_, left_schema_, right_schema_);
   }
-  for (auto &column : left_schema_.GetColumns()) {
-    all_columns_.emplace_back(column);
+}
+
+auto NestedLoopJoinExecutor::NextLeftBlock() -> bool {
+  left_block_.clear();
+  auto budget = memory_budget_.load(std::memory_order_relaxed) / 2;
+  size_t bytes = 0;
+  // 至少放入一个 tuple
+  while (!left_done_ && (left_block_.empty() || bytes < budget)) {
+    if (left_index_ == left_batch_.Size()) {
+      if (!bustub::NextBatch(left_executor_.get(), &left_batch_)) {
+        left_done_ = true;
+        break;
+      }
+      left_index_ = 0;
+    }
+    left_block_.emplace_back(left_batch_.GetTuple(left_index_++));
+    bytes += left_block_.back().GetLength() + sizeof(Tuple);
   }
-  for (auto &column : right_schema_.GetColumns()) {
-    all_columns_.emplace_back(column);
+  left_block_bytes_ = bytes;
+  peak_memory_bytes_ = std::max(peak_memory_bytes_, bytes + (right_cached_ ? right_cache_bytes_ : 0));
+  if (left_block_.empty()) {
+    return false;
   }
-  is_inner_join_ = plan_->GetJoinType() == JoinType::INNER;
-  is_successful_ = false;
-  need_next_left_tuple_ = true;
+  auto size = left_block_.size();
+  for (auto &comparison : block_comparisons_) {
+    comparison.valid_.resize(size);
+    if (comparison.is_decimal_) {
+      comparison.decimals_.resize(size);
+    } else {
+      comparison.ints_.resize(size);
+    }
+    for (size_t i = 0; i < size; i++) {
+      auto value = left_block_[i].GetValue(&left_schema_, comparison.left_col_idx_);
+      comparison.valid_[i] = static_cast<uint8_t>(!value.IsNull());
+      if (value.IsNull()) {
+        continue;
+      }
+      if (comparison.is_decimal_) {
+        comparison.decimals_[i] = value.CastAs(TypeId::DECIMAL).GetAs<double>();
+      } else {
+        comparison.ints_[i] = value.CastAs(TypeId::BIGINT).GetAs<int64_t>();
+      }
+    }
+  }
+  left_matched_.assign(size, 0);
+  left_pos_ = size;
+  unmatched_pos_ = 0;
+  // 第一个 block 使用 Init 中打开的 right child，之后没有缓存时重新 scan
+  if (!caching_ && !right_cached_) {
+    right_executor_->Init();
+  }
+  right_batch_.Clear();
+  right_index_ = 0;
+  return true;
 }
 
-auto NestedLoopJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
-  // next left tuple
-  RID r;
-  if (need_next_left_tuple_) {
-    if (!left_executor_->Next(&left_tuple_, &r)) {
+auto NestedLoopJoinExecutor::NextRightTuple() -> bool {
+  if (right_cached_) {
+    if (right_index_ == right_tuples_.size()) {
+      return false;
+    }
+    right_tuple_ = &right_tuples_[right_index_++];
+    return true;
+  }
+  if (right_index_ == right_batch_.Size()) {
+    if (!bustub::NextBatch(right_executor_.get(), &right_batch_)) {
+      // 第一次 scan 结束时 right tuple 都在缓存中
+      right_cached_ = caching_;
+      caching_ = false;
       return false;
     }
-    need_next_left_tuple_ = false;
-    is_successful_ = false;
     right_index_ = 0;
   }
-  Schema schema(all_columns_);
-  std::vector<Value> value;
-  // right tuple is over
-  if (right_index_ == right_tuples_.size()) {
-    // need next left tuple
-    need_next_left_tuple_ = true;
-    // need a left tuple with empty right tuple
-    if (!is_inner_join_ && !is_successful_) {
-      for (int i = 0, left_column_size = left_schema_.GetColumnCount(); i < left_column_size; i++) {
-        value.emplace_back(left_tuple_.GetValue(&left_schema_, i));
-      }
-      for (int i = 0, right_column_size = right_schema_.GetColumnCount(); i < right_column_size; i++) {
-        value.emplace_back(ValueFactory::GetNullValueByType(right_schema_.GetColumn(i).GetType()));
-      }
-      *tuple = {value, &schema};
-      return true;
+  right_tuple_ = &right_batch_.GetTuple(right_index_++);
+  if (caching_) {
+    right_cache_bytes_ += right_tuple_->GetLength() + sizeof(Tuple);
+    if (right_cache_bytes_ > memory_budget_.load(std::memory_order_relaxed) / 2) {
+      caching_ = false;
+      right_tuples_.clear();
+      right_tuples_.shrink_to_fit();
+    } else {
+      right_tuples_.emplace_back(*right_tuple_);
+      peak_memory_bytes_ = std::max(peak_memory_bytes_, left_block_bytes_ + right_cache_bytes_);
+    }
+  }
+  return true;
+}
+
+void NestedLoopJoinExecutor::ComputeMask() {
+  mask_.assign(left_block_.size(), 1);
+  for (const auto &comparison : block_comparisons_) {
+    auto value = right_tuple_->GetValue(&right_schema_, comparison.right_col_idx_);
+    if (value.IsNull()) {
+      std::fill(mask_.begin(), mask_.end(), 0);
+      return;
+    }
+    if (comparison.is_decimal_) {
+      SelectBlock<double>(comparison.comp_type_, comparison.decimals_, comparison.valid_,
+                          value.CastAs(TypeId::DECIMAL).GetAs<double>(), &mask_);
+    } else {
+      SelectBlock<int64_t>(comparison.comp_type_, comparison.ints_, comparison.valid_,
+                           value.CastAs(TypeId::BIGINT).GetAs<int64_t>(), &mask_);
     }
-    return Next(tuple, rid);
-  }
-  Tuple right_tuple;
-  for (int i = right_index_, sz = right_tuples_.size(); i < sz; i++) {
-    right_tuple = right_tuples_[right_index_++];
-    auto status_value = plan_->Predicate().EvaluateJoin(&left_tuple_, left_executor_->GetOutputSchema(), &right_tuple,
-                                                        right_executor_->GetOutputSchema());
-    if (!status_value.IsNull() && status_value.GetAs<bool>()) {
-      for (int i = 0, left_column_size = left_schema_.GetColumnCount(); i < left_column_size; i++) {
-        value.emplace_back(left_tuple_.GetValue(&left_schema_, i));
+  }
+}
+
+void NestedLoopJoinExecutor::MakeOutputTuple(const Tuple &left_tuple, const Tuple *right_tuple, Tuple *tuple) {
+  values_.clear();
+  for (int i = 0, left_column_size = left_schema_.GetColumnCount(); i < left_column_size; i++) {
+    values_.emplace_back(left_tuple.GetValue(&left_schema_, i));
+  }
+  for (int i = 0, right_column_size = right_schema_.GetColumnCount(); i < right_column_size; i++) {
+    values_.emplace_back(right_tuple == nullptr
+                             ? ValueFactory::GetNullValueByType(right_schema_.GetColumn(i).GetType())
+                             : right_tuple->GetValue(&right_schema_, i));
+  }
+  // output schema 即 left table 的 column 后接 right table 的 column
+  *tuple = {values_, &GetOutputSchema()};
+}
+
+auto NestedLoopJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  while (true) {
+    // 当前 right tuple 与 block 中通过比较的 left tuple
+    while (left_pos_ < left_block_.size()) {
+      auto i = left_pos_++;
+      if (mask_[i] != 0 && (residual_ == nullptr || residual_->EvaluateJoin(&left_block_[i], right_tuple_))) {
+        left_matched_[i] = 1;
+        MakeOutputTuple(left_block_[i], right_tuple_, tuple);
+        return true;
       }
-      for (int i = 0, right_column_size = right_schema_.GetColumnCount(); i < right_column_size; i++) {
-        value.emplace_back(right_tuple.GetValue(&right_schema_, i));
+    }
+    if (!left_block_.empty() && NextRightTuple()) {
+      ComputeMask();
+      left_pos_ = 0;
+      continue;
+    }
+    // right side is over for this block, left join outputs the unmatched left tuples with NULLs
+    if (!is_inner_join_) {
+      while (unmatched_pos_ < left_block_.size()) {
+        auto i = unmatched_pos_++;
+        if (left_matched_[i] == 0) {
+          MakeOutputTuple(left_block_[i], nullptr, tuple);
+          return true;
+        }
       }
-      *tuple = {value, &schema};
-      is_successful_ = true;
-      return true;
+    }
+    if (!NextLeftBlock()) {
+      return false;
+    }
+  }
+}
+
+auto NestedLoopJoinExecutor::NextBatch(TupleBatch *batch) -> bool {
+  while (!batch->IsFull()) {
+    auto [tuple, rid] = batch->Emplace();
+    if (!NestedLoopJoinExecutor::Next(tuple, rid)) {
+      batch->PopBack();
+      break;
     }
   }
-  return Next(tuple, rid);
+  return !batch->IsEmpty();
 }
 
 }  // namespace bustub
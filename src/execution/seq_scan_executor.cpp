@@ -11,25 +11,44 @@
 //===----------------------------------------------------------------------===//
 
 #include "execution/executors/seq_scan_executor.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <vector>
 #include "common/exception.h"
+#include "concurrency/transaction_manager.h"
+#include "execution/worker_pool.h"
+#include "storage/page/table_page.h"
 
 namespace bustub {
 
 SeqScanExecutor::SeqScanExecutor(ExecutorContext *exec_ctx, const SeqScanPlanNode *plan)
-    : AbstractExecutor(exec_ctx),
-      plan_(plan),
-      table_iterator_ptr_(exec_ctx->GetCatalog()->GetTable(plan->table_oid_)->table_->End()),
-      table_iterator_end_(exec_ctx->GetCatalog()->GetTable(plan->table_oid_)->table_->End()) {}
+    : AbstractExecutor(exec_ctx), plan_(plan) {}
 
 void SeqScanExecutor::Init() {
+  ReleaseEscalation();
   auto oid = plan_->GetTableOid();
   auto txn = exec_ctx_->GetTransaction();
   auto isolation_level = txn->GetIsolationLevel();
+  // 已经持有 S/SIX/X table lock 时不需要再 lock row
+  table_covered_ = txn->IsTableSharedLocked(oid) || txn->IsTableSharedIntentionExclusiveLocked(oid) ||
+                   txn->IsTableExclusiveLocked(oid);
+  rows_locked_ = 0;
+  snapshot_ = nullptr;
+  auto version_store = exec_ctx_->GetTransactionManager()->GetVersionStore();
+  if (version_store->IsEnabled() && (isolation_level == IsolationLevel::REPEATABLE_READ ||
+                                     isolation_level == IsolationLevel::READ_COMMITTED)) {
+    // MVCC：在 snapshot 中读，table 和 row 都不加锁
+    snapshot_ = version_store->GetSnapshot(txn);
+  }
   switch (isolation_level) {
     case IsolationLevel::REPEATABLE_READ:
     case IsolationLevel::READ_COMMITTED: {
       // 如果没有 IS/IX，则获取
-      if (!txn->IsTableIntentionSharedLocked(oid) && !txn->IsTableIntentionExclusiveLocked(oid)) {
+      if (snapshot_ == nullptr && !table_covered_ && !txn->IsTableIntentionSharedLocked(oid) &&
+          !txn->IsTableIntentionExclusiveLocked(oid)) {
         if (!exec_ctx_->GetLockManager()->LockTable(txn, LockManager::LockMode::INTENTION_SHARED, oid)) {
           txn->SetState(TransactionState::ABORTED);
           throw ExecutionException("SeqScanExecutor::Init failed: lock table IS lock failed");
@@ -42,41 +61,217 @@ void SeqScanExecutor::Init() {
     }
   }
   table_heap_ptr_ = exec_ctx_->GetCatalog()->GetTable(oid)->table_.get();
-  table_iterator_ptr_ = table_heap_ptr_->Begin(txn);
+  started_ = false;
+  page_rids_.clear();
+  page_rid_pos_ = 0;
+  next_page_id_ = table_heap_ptr_->GetFirstPageId();
+  filter_ = plan_->filter_predicate_ == nullptr
+                ? nullptr
+                : std::make_unique<CompiledPredicate>(*plan_->filter_predicate_, plan_->OutputSchema());
 }
 
-auto SeqScanExecutor::Next(Tuple *tuple, RID *rid) -> bool {
-  if (table_iterator_ptr_ == table_heap_ptr_->End()) {
-    return false;
+auto SeqScanExecutor::ReadPageRids(page_id_t page_id, std::vector<RID> *rids) -> page_id_t {
+  auto bpm = exec_ctx_->GetBufferPoolManager();
+  auto page = reinterpret_cast<TablePage *>(bpm->FetchPage(page_id, AccessType::Scan));
+  if (page == nullptr) {
+    throw ExecutionException("SeqScanExecutor failed: no free frame in the buffer pool");
+  }
+  auto first = rids->size();
+  page->RLatch();
+  RID rid;
+  RID next_rid;
+  for (bool has_rid = page->GetFirstTupleRid(&rid); has_rid; rid = next_rid) {
+    rids->emplace_back(rid);
+    has_rid = page->GetNextTupleRid(rid, &next_rid);
   }
+  auto next_page_id = page->GetNextPageId();
+  page->RUnlatch();
+  bpm->UnpinPage(page_id, false);
+  if (snapshot_ != nullptr) {
+    // heap 中已经删除的行，snapshot 可能还能看到
+    exec_ctx_->GetTransactionManager()->GetVersionStore()->GetVersionedRids(plan_->GetTableOid(), page_id, rids);
+    std::sort(rids->begin() + first, rids->end(),
+              [](const RID &a, const RID &b) { return a.GetSlotNum() < b.GetSlotNum(); });
+    rids->erase(std::unique(rids->begin() + first, rids->end()), rids->end());
+  }
+  return next_page_id;
+}
 
+auto SeqScanExecutor::ReadRow(const RID &rid, Tuple *tuple) -> bool {
+  auto txn = exec_ctx_->GetTransaction();
+  bool found;
+  if (snapshot_ != nullptr) {
+    found = exec_ctx_->GetTransactionManager()->GetVersionStore()->ReadVisible(
+        table_heap_ptr_, plan_->GetTableOid(), rid, *snapshot_, txn, tuple);
+  } else {
+    bool locked = LockRow(rid);
+    // 从读出 RID 到加锁之间 tuple 可能已被删除
+    found = table_heap_ptr_->GetTuple(rid, tuple, txn);
+    UnlockRow(rid, locked);
+  }
+  return found && (filter_ == nullptr || filter_->Evaluate(tuple));
+}
+
+auto SeqScanExecutor::LockRow(const RID &rid) -> bool {
   auto txn = exec_ctx_->GetTransaction();
   auto isolation_level = txn->GetIsolationLevel();
+  if ((isolation_level != IsolationLevel::REPEATABLE_READ && isolation_level != IsolationLevel::READ_COMMITTED) ||
+      table_covered_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  auto oid = plan_->GetTableOid();
+  // 并行 scan 时其他线程可能同时修改 txn 的 lock set
+  txn->LockTxn();
+  bool held = txn->IsRowSharedLocked(oid, rid) || txn->IsRowExclusiveLocked(oid, rid);
+  txn->UnlockTxn();
+  if (held) {
+    return false;
+  }
+  if (!exec_ctx_->GetLockManager()->LockRow(txn, LockManager::LockMode::SHARED, oid, rid)) {
+    txn->SetState(TransactionState::ABORTED);
+    throw ExecutionException("SeqScanExecutor::Next failed: lock row failed");
+  }
+  if (isolation_level == IsolationLevel::READ_COMMITTED &&
+      rows_locked_.fetch_add(1, std::memory_order_relaxed) + 1 == SEQ_SCAN_ESCALATION_ROWS) {
+    TryEscalate();
+  }
+  return true;
+}
 
-  // if not lock on this row, then lock
+void SeqScanExecutor::TryEscalate() {
+  auto txn = exec_ctx_->GetTransaction();
   auto oid = plan_->GetTableOid();
-  *rid = table_iterator_ptr_->GetRid();
-  bool succ = false;
-  if ((isolation_level == IsolationLevel::REPEATABLE_READ || isolation_level == IsolationLevel::READ_COMMITTED) &&
-      !txn->IsRowSharedLocked(oid, *rid) && !txn->IsRowExclusiveLocked(oid, *rid)) {
-    if (!exec_ctx_->GetLockManager()->LockRow(exec_ctx_->GetTransaction(), LockManager::LockMode::SHARED, oid, *rid)) {
-      txn->SetState(TransactionState::ABORTED);
-      throw ExecutionException("SeqScanExecutor::Next failed: lock row failed");
-    }
-    succ = true;
+  txn->LockTxn();
+  // 持有 IX 时升级到 SIX 后无法在 scan 结束时只还原 scan 自己的部分，只从 IS 升级
+  bool only_is = txn->IsTableIntentionSharedLocked(oid);
+  txn->UnlockTxn();
+  if (only_is && exec_ctx_->GetLockManager()->TryLockTable(txn, LockManager::LockMode::SHARED, oid)) {
+    escalated_ = true;
+    table_covered_.store(true, std::memory_order_release);
+    return;
   }
+  // 有其他 txn 在写，过 SEQ_SCAN_ESCALATION_ROWS 行再试
+  rows_locked_.store(0, std::memory_order_relaxed);
+}
 
-  *tuple = *table_iterator_ptr_++;
+void SeqScanExecutor::ReleaseEscalation() {
+  if (!escalated_) {
+    return;
+  }
+  escalated_ = false;
+  table_covered_.store(false, std::memory_order_release);
+  rows_locked_.store(0, std::memory_order_relaxed);
+  exec_ctx_->GetLockManager()->DowngradeTable(exec_ctx_->GetTransaction(), LockManager::LockMode::INTENTION_SHARED,
+                                              plan_->GetTableOid());
+}
 
+void SeqScanExecutor::UnlockRow(const RID &rid, bool locked) {
   // unlock
   // REPEATABLE_READ growing 阶段不能 unlock
   // READ_UNCOMMITTED 不需要 lock
-  if (succ && isolation_level == IsolationLevel::READ_COMMITTED) {
-    if (!exec_ctx_->GetLockManager()->UnlockRow(txn, oid, *rid)) {
+  auto txn = exec_ctx_->GetTransaction();
+  if (locked && txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) {
+    if (!exec_ctx_->GetLockManager()->UnlockRow(txn, plan_->GetTableOid(), rid)) {
       txn->SetState(TransactionState::ABORTED);
       throw ExecutionException("SeqScanExecutor::Next failed: unlock row failed");
     }
   }
+}
+
+auto SeqScanExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  started_ = true;
+  // 一个 page 一个 page 地读：ReadPageRids 对每个 page 只 fetch 一次，同时告诉 buffer pool 这是顺序扫描，
+  // 并得到 page chain 中的下一个 page
+  while (true) {
+    while (page_rid_pos_ < page_rids_.size()) {
+      *rid = page_rids_[page_rid_pos_++];
+      // 不满足 filter 的行直接跳过，不交给上层
+      if (ReadRow(*rid, tuple)) {
+        return true;
+      }
+    }
+    if (next_page_id_ == INVALID_PAGE_ID) {
+      ReleaseEscalation();
+      return false;
+    }
+    page_rids_.clear();
+    page_rid_pos_ = 0;
+    next_page_id_ = ReadPageRids(next_page_id_, &page_rids_);
+    if (next_page_id_ != INVALID_PAGE_ID) {
+      exec_ctx_->GetBufferPoolManager()->PrefetchPages(next_page_id_, SEQ_SCAN_PREFETCH_DEPTH);
+    }
+  }
+}
+
+auto SeqScanExecutor::NextBatch(TupleBatch *batch) -> bool {
+  // 直接写入 batch 中的 tuple，加锁和 page hint 与 Next 相同
+  while (!batch->IsFull()) {
+    auto [tuple, rid] = batch->Emplace();
+    if (!SeqScanExecutor::Next(tuple, rid)) {
+      batch->PopBack();
+      break;
+    }
+  }
+  return !batch->IsEmpty();
+}
+
+auto SeqScanExecutor::ScanMorsels(size_t num_threads, const MorselConsumer &consume) -> bool {
+  if (started_) {
+    return false;
+  }
+  auto bpm = exec_ctx_->GetBufferPoolManager();
+  // page chain 是链表，morsel 只能按顺序切：持有 latch 读出下 SEQ_SCAN_MORSEL_PAGES 个 page 的 RID，
+  // 加锁和读 tuple 在 latch 外进行
+  std::mutex chain_latch;
+  page_id_t next_page_id = table_heap_ptr_->GetFirstPageId();
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+  auto next_morsel = [&](std::vector<RID> *rids) -> bool {
+    rids->clear();
+    std::scoped_lock<std::mutex> lock(chain_latch);
+    for (size_t i = 0; i < SEQ_SCAN_MORSEL_PAGES && next_page_id != INVALID_PAGE_ID; i++) {
+      next_page_id = ReadPageRids(next_page_id, rids);
+      if (next_page_id != INVALID_PAGE_ID) {
+        bpm->PrefetchPages(next_page_id, SEQ_SCAN_PREFETCH_DEPTH);
+      }
+    }
+    return !rids->empty() || next_page_id != INVALID_PAGE_ID;
+  };
+
+  WorkerPool::Get().RunParallel(num_threads, [&](size_t i) {
+    TupleBatch batch;
+    std::vector<RID> rids;
+    try {
+      while (!failed.load(std::memory_order_relaxed) && next_morsel(&rids)) {
+        for (const auto &rid : rids) {
+          auto [tuple, tuple_rid] = batch.Emplace();
+          *tuple_rid = rid;
+          if (!ReadRow(rid, tuple)) {
+            batch.PopBack();
+          } else if (batch.IsFull()) {
+            consume(i, &batch);
+            batch.Clear();
+          }
+        }
+      }
+      if (!batch.IsEmpty() && !failed.load(std::memory_order_relaxed)) {
+        consume(i, &batch);
+      }
+    } catch (...) {
+      std::scoped_lock<std::mutex> lock(chain_latch);
+      if (!failed.exchange(true)) {
+        error = std::current_exception();
+      }
+    }
+  });
+  // 剩下的 Next 不再返回 tuple
+  started_ = true;
+  page_rids_.clear();
+  next_page_id_ = INVALID_PAGE_ID;
+  ReleaseEscalation();
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
   return true;
 }
 
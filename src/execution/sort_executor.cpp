@@ -1,45 +1,133 @@
 #include "execution/executors/sort_executor.h"
 #include <algorithm>
+#include <iterator>
+#include "execution/executor_profile.h"
 
 namespace bustub {
 
 SortExecutor::SortExecutor(ExecutorContext *exec_ctx, const SortPlanNode *plan,
                            std::unique_ptr<AbstractExecutor> &&child_executor)
-    : AbstractExecutor(exec_ctx), plan_(plan), child_executor_(std::move(child_executor)) {}
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      child_executor_(ProfileChild(plan->GetChildPlan(), std::move(child_executor))),
+      encoder_(plan_->GetOrderBy()) {}
 
 void SortExecutor::Init() {
   child_executor_->Init();
+  sort_entries_.clear();
+  runs_.clear();
+  auto budget = memory_budget_.load(std::memory_order_relaxed);
+  size_t bytes = 0;
   Tuple tuple;
   RID rid;
   while (child_executor_->Next(&tuple, &rid)) {
-    sort_tuples_.emplace_back(tuple);
-  }
-  std::sort(sort_tuples_.begin(), sort_tuples_.end(), [this](const Tuple &a, const Tuple &b) {
-    for (auto [order_by_type, expr] : plan_->GetOrderBy()) {
-      if (order_by_type == OrderByType::INVALID) {
-        continue;
-      }
-      Value first = expr->Evaluate(&a, child_executor_->GetOutputSchema());
-      Value second = expr->Evaluate(&b, child_executor_->GetOutputSchema());
-      if (first.CompareEquals(second) == CmpBool::CmpTrue) {
-        continue;
-      }
-      if (order_by_type == OrderByType::DEFAULT || order_by_type == OrderByType::ASC) {
-        return first.CompareLessThan(second) == CmpBool::CmpTrue;
-      }
-      // DESC
-      return first.CompareGreaterThan(second) == CmpBool::CmpTrue;
+    auto key = encoder_.MakeKey(tuple, child_executor_->GetOutputSchema());
+    bytes += tuple.GetLength() + sizeof(SortEntry) + key.normalized_.capacity() + key.values_.size() * sizeof(Value);
+    sort_entries_.push_back({std::move(key), tuple});
+    peak_memory_bytes_ = std::max(peak_memory_bytes_, bytes);
+    if (bytes > budget) {
+      SpillRun();
+      bytes = 0;
     }
-    return true;
-  });
-  sort_tuples_iter_ = sort_tuples_.begin();
+  }
+  if (runs_.empty()) {
+    SortEntries();
+    sort_pos_ = 0;
+    return;
+  }
+  if (!sort_entries_.empty()) {
+    SpillRun();
+  }
+  // run 太多时先把每 SORT_MAX_FAN_IN 个 run 合并成一个
+  while (runs_.size() > SORT_MAX_FAN_IN) {
+    std::vector<std::unique_ptr<SpillFile>> rest(std::make_move_iterator(runs_.begin() + SORT_MAX_FAN_IN),
+                                                 std::make_move_iterator(runs_.end()));
+    runs_.resize(SORT_MAX_FAN_IN);
+    InitMerge();
+    auto merged = std::make_unique<SpillFile>(exec_ctx_->GetBufferPoolManager());
+    while (NextMerged(&tuple)) {
+      merged->Append(tuple);
+    }
+    merged->Rewind();
+    rest.emplace_back(std::move(merged));
+    runs_ = std::move(rest);
+  }
+  InitMerge();
 }
 
 auto SortExecutor::Next(Tuple *tuple, RID *rid) -> bool {
-  if (sort_tuples_iter_ == sort_tuples_.end()) {
+  if (!runs_.empty()) {
+    return NextMerged(tuple);
+  }
+  if (sort_pos_ == sort_entries_.size()) {
+    return false;
+  }
+  *tuple = sort_entries_[sort_pos_++].tuple_;
+  return true;
+}
+
+void SortExecutor::SortEntries() {
+  if (!encoder_.IsNormalized() || encoder_.GetKeySize() > sizeof(uint64_t)) {
+    std::sort(sort_entries_.begin(), sort_entries_.end(),
+              [this](const SortEntry &a, const SortEntry &b) { return EntryLess(a, b); });
+    return;
+  }
+  // 短的 normalized key 可以直接作为整数做 radix sort，再按结果重排 entry
+  std::vector<std::pair<uint64_t, uint32_t>> keys;
+  keys.reserve(sort_entries_.size());
+  for (size_t i = 0; i < sort_entries_.size(); i++) {
+    keys.emplace_back(SortKeyEncoder::KeyPrefix(sort_entries_[i].key_), static_cast<uint32_t>(i));
+  }
+  RadixSortKeys(&keys, encoder_.GetKeySize());
+  std::vector<SortEntry> sorted;
+  sorted.reserve(sort_entries_.size());
+  for (const auto &key : keys) {
+    sorted.emplace_back(std::move(sort_entries_[key.second]));
+  }
+  sort_entries_ = std::move(sorted);
+}
+
+void SortExecutor::SpillRun() {
+  SortEntries();
+  auto run = std::make_unique<SpillFile>(exec_ctx_->GetBufferPoolManager());
+  for (const auto &entry : sort_entries_) {
+    run->Append(entry.tuple_);
+  }
+  // unpin 正在写的 page
+  run->Rewind();
+  runs_.emplace_back(std::move(run));
+  sort_entries_.clear();
+}
+
+void SortExecutor::InitMerge() {
+  merge_heads_.assign(runs_.size(), SortEntry{});
+  merge_heap_.clear();
+  for (size_t i = 0; i < runs_.size(); i++) {
+    if (runs_[i]->Next(&merge_heads_[i].tuple_)) {
+      merge_heads_[i].key_ = encoder_.MakeKey(merge_heads_[i].tuple_, child_executor_->GetOutputSchema());
+      merge_heap_.emplace_back(i);
+    }
+  }
+  std::make_heap(merge_heap_.begin(), merge_heap_.end(),
+                 [this](size_t a, size_t b) { return EntryLess(merge_heads_[b], merge_heads_[a]); });
+}
+
+auto SortExecutor::NextMerged(Tuple *tuple) -> bool {
+  if (merge_heap_.empty()) {
     return false;
   }
-  *tuple = *(sort_tuples_iter_++);
+  auto heap_cmp = [this](size_t a, size_t b) { return EntryLess(merge_heads_[b], merge_heads_[a]); };
+  std::pop_heap(merge_heap_.begin(), merge_heap_.end(), heap_cmp);
+  auto run = merge_heap_.back();
+  *tuple = merge_heads_[run].tuple_;
+  if (runs_[run]->Next(&merge_heads_[run].tuple_)) {
+    merge_heads_[run].key_ = encoder_.MakeKey(merge_heads_[run].tuple_, child_executor_->GetOutputSchema());
+    std::push_heap(merge_heap_.begin(), merge_heap_.end(), heap_cmp);
+  } else {
+    // run 读完了，释放它的 page
+    merge_heap_.pop_back();
+    runs_[run].reset();
+  }
   return true;
 }
 
@@ -0,0 +1,164 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// sort_key.cpp
+//
+// Identification: src/execution/sort_key.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/sort_key.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace bustub {
+
+namespace {
+
+/** @return number of bytes of the normalized key of type `type`, 0 if it has no fixed width */
+auto NormalizedWidth(TypeId type) -> size_t {
+  switch (type) {
+    case TypeId::BOOLEAN:
+    case TypeId::TINYINT:
+      return 1;
+    case TypeId::SMALLINT:
+      return 2;
+    case TypeId::INTEGER:
+      return 4;
+    case TypeId::BIGINT:
+    case TypeId::DECIMAL:
+    case TypeId::TIMESTAMP:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+/** Append the low `width` bytes of `bits` big-endian, inverted for DESC. */
+void AppendBigEndian(uint64_t bits, size_t width, bool desc, std::string *key) {
+  for (size_t i = width; i > 0; i--) {
+    auto byte = static_cast<uint8_t>(bits >> ((i - 1) * 8));
+    key->push_back(static_cast<char>(desc ? ~byte : byte));
+  }
+}
+
+/** @return the bits of `value` whose unsigned order is the order of the values */
+auto OrderedBits(const Value &value) -> uint64_t {
+  switch (value.GetTypeId()) {
+    case TypeId::BOOLEAN:
+    case TypeId::TINYINT:
+      return static_cast<uint8_t>(value.GetAs<int8_t>()) ^ 0x80U;
+    case TypeId::SMALLINT:
+      return static_cast<uint16_t>(value.GetAs<int16_t>()) ^ 0x8000U;
+    case TypeId::INTEGER:
+      return static_cast<uint32_t>(value.GetAs<int32_t>()) ^ 0x80000000U;
+    case TypeId::BIGINT:
+      return static_cast<uint64_t>(value.GetAs<int64_t>()) ^ (1ULL << 63);
+    case TypeId::TIMESTAMP:
+      return value.GetAs<uint64_t>();
+    case TypeId::DECIMAL: {
+      auto d = value.GetAs<double>();
+      // -0.0 与 0.0 相等
+      if (d == 0) {
+        d = 0;
+      }
+      uint64_t bits;
+      memcpy(&bits, &d, sizeof(bits));
+      return (bits >> 63) != 0 ? ~bits : bits | (1ULL << 63);
+    }
+    default:
+      return 0;
+  }
+}
+
+}  // namespace
+
+SortKeyEncoder::SortKeyEncoder(const std::vector<std::pair<OrderByType, AbstractExpressionRef>> &order_bys)
+    : order_bys_(order_bys) {
+  for (const auto &[order_by_type, expr] : order_bys_) {
+    if (order_by_type == OrderByType::INVALID) {
+      continue;
+    }
+    auto width = NormalizedWidth(expr->GetReturnType());
+    if (width == 0) {
+      normalized_ = false;
+    }
+    key_size_ += width;
+  }
+}
+
+auto SortKeyEncoder::MakeKey(const Tuple &tuple, const Schema &schema) const -> SortKey {
+  SortKey key;
+  if (!normalized_) {
+    key.values_.reserve(order_bys_.size());
+    for (const auto &order_by : order_bys_) {
+      key.values_.emplace_back(order_by.second->Evaluate(&tuple, schema));
+    }
+    return key;
+  }
+  key.normalized_.reserve(key_size_);
+  for (const auto &[order_by_type, expr] : order_bys_) {
+    if (order_by_type == OrderByType::INVALID) {
+      continue;
+    }
+    auto value = expr->Evaluate(&tuple, schema);
+    auto type = expr->GetReturnType();
+    if (value.GetTypeId() != type) {
+      value = value.CastAs(type);
+    }
+    AppendBigEndian(OrderedBits(value), NormalizedWidth(type), order_by_type == OrderByType::DESC, &key.normalized_);
+  }
+  return key;
+}
+
+auto SortKeyEncoder::KeyPrefix(const SortKey &key) -> uint64_t {
+  uint64_t prefix = 0;
+  for (size_t i = 0; i < key.normalized_.size() && i < sizeof(uint64_t); i++) {
+    prefix = (prefix << 8) | static_cast<uint8_t>(key.normalized_[i]);
+  }
+  return prefix;
+}
+
+auto SortKeyEncoder::ValuesLess(const std::vector<Value> &a, const std::vector<Value> &b) const -> bool {
+  for (size_t i = 0; i < order_bys_.size(); i++) {
+    auto order_by_type = order_bys_[i].first;
+    if (order_by_type == OrderByType::INVALID || a[i].CompareEquals(b[i]) == CmpBool::CmpTrue) {
+      continue;
+    }
+    if (order_by_type == OrderByType::DEFAULT || order_by_type == OrderByType::ASC) {
+      return a[i].CompareLessThan(b[i]) == CmpBool::CmpTrue;
+    }
+    // DESC
+    return a[i].CompareGreaterThan(b[i]) == CmpBool::CmpTrue;
+  }
+  // 相等时不能返回 true，否则不是 strict weak ordering
+  return false;
+}
+
+void RadixSortKeys(std::vector<std::pair<uint64_t, uint32_t>> *keys, size_t key_bytes) {
+  std::vector<std::pair<uint64_t, uint32_t>> buffer(keys->size());
+  for (size_t pass = 0; pass < key_bytes; pass++) {
+    auto shift = pass * 8;
+    std::array<size_t, 257> offsets{};
+    for (const auto &key : *keys) {
+      offsets[((key.first >> shift) & 0xFF) + 1]++;
+    }
+    // 所有 key 这一位都相同，不需要移动
+    if (std::any_of(offsets.begin() + 1, offsets.end(), [&](size_t count) { return count == keys->size(); })) {
+      continue;
+    }
+    for (size_t i = 0; i < 256; i++) {
+      offsets[i + 1] += offsets[i];
+    }
+    for (const auto &key : *keys) {
+      buffer[offsets[(key.first >> shift) & 0xFF]++] = key;
+    }
+    keys->swap(buffer);
+  }
+}
+
+}  // namespace bustub
@@ -0,0 +1,96 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// spill_file.cpp
+//
+// Identification: src/execution/spill_file.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/spill_file.h"
+#include <cstring>
+#include "common/exception.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+SpillFile::~SpillFile() {
+  FinishWritePage();
+  if (read_page_ != nullptr) {
+    bpm_->UnpinPage(read_page_->GetPageId(), false);
+  }
+  for (auto page_id : page_ids_) {
+    bpm_->DeletePage(page_id);
+  }
+}
+
+void SpillFile::Append(const Tuple &tuple) {
+  size_t record_size = sizeof(uint32_t) + tuple.GetLength();
+  BUSTUB_ASSERT(SPILL_PAGE_HEADER_SIZE + record_size <= BUSTUB_PAGE_SIZE, "tuple does not fit in a page");
+  if (write_page_ == nullptr || write_offset_ + record_size > BUSTUB_PAGE_SIZE) {
+    FinishWritePage();
+    page_id_t page_id;
+    write_page_ = bpm_->NewPage(&page_id);
+    if (write_page_ == nullptr) {
+      throw ExecutionException("SpillFile::Append failed: no free frame in the buffer pool");
+    }
+    page_ids_.emplace_back(page_id);
+    memset(write_page_->GetData(), 0, SPILL_PAGE_HEADER_SIZE);
+    write_offset_ = SPILL_PAGE_HEADER_SIZE;
+  }
+  auto data = write_page_->GetData();
+  tuple.SerializeTo(data + write_offset_);
+  write_offset_ += record_size;
+  (*reinterpret_cast<uint32_t *>(data))++;
+  num_tuples_++;
+}
+
+void SpillFile::FinishWritePage() {
+  if (write_page_ != nullptr) {
+    bpm_->UnpinPage(write_page_->GetPageId(), true);
+    write_page_ = nullptr;
+  }
+}
+
+void SpillFile::Rewind() {
+  FinishWritePage();
+  if (read_page_ != nullptr) {
+    bpm_->UnpinPage(read_page_->GetPageId(), false);
+    read_page_ = nullptr;
+  }
+  read_page_index_ = 0;
+  read_count_ = 0;
+  read_offset_ = SPILL_PAGE_HEADER_SIZE;
+}
+
+auto SpillFile::Next(Tuple *tuple) -> bool {
+  while (true) {
+    if (read_page_ == nullptr) {
+      if (read_page_index_ >= page_ids_.size()) {
+        return false;
+      }
+      read_page_ = bpm_->FetchPage(page_ids_[read_page_index_], AccessType::Scan);
+      if (read_page_ == nullptr) {
+        throw ExecutionException("SpillFile::Next failed: no free frame in the buffer pool");
+      }
+      read_count_ = 0;
+      read_offset_ = SPILL_PAGE_HEADER_SIZE;
+    }
+    auto data = read_page_->GetData();
+    if (read_count_ < *reinterpret_cast<const uint32_t *>(data)) {
+      tuple->DeserializeFrom(data + read_offset_);
+      read_offset_ += sizeof(uint32_t) + tuple->GetLength();
+      read_count_++;
+      return true;
+    }
+    // 当前 page 读完了
+    bpm_->UnpinPage(read_page_->GetPageId(), false);
+    read_page_ = nullptr;
+    read_page_index_++;
+  }
+}
+
+}  // namespace bustub
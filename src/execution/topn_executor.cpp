@@ -1,64 +1,63 @@
 #include "execution/executors/topn_executor.h"
-#include <queue>
+#include <algorithm>
+#include <utility>
+#include "execution/executor_profile.h"
 
 namespace bustub {
 
 TopNExecutor::TopNExecutor(ExecutorContext *exec_ctx, const TopNPlanNode *plan,
                            std::unique_ptr<AbstractExecutor> &&child_executor)
-    : AbstractExecutor(exec_ctx), plan_(plan), child_executor_(std::move(child_executor)) {}
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      child_executor_(ProfileChild(plan->GetChildPlan(), std::move(child_executor))),
+      encoder_(plan_->GetOrderBy()) {}
 
 void TopNExecutor::Init() {
   child_executor_->Init();
+  tuples_.clear();
+  entries_.clear();
+  entries_pos_ = 0;
+  auto n = plan_->GetN();
+  if (n == 0) {
+    return;
+  }
+  // 最大堆，堆顶是当前 N 个 tuple 中排在最后的
+  auto cmp = [this](const TopNEntry &a, const TopNEntry &b) { return encoder_.Less(a.key_, b.key_); };
   Tuple tuple;
   RID rid;
-  // ASC: a < b 为 true
-  // DASC: a > b 为 true
-  auto cmp = [this](const Tuple &a, const Tuple &b) {
-    for (auto [order_by_type, expr] : plan_->GetOrderBy()) {
-      if (order_by_type == OrderByType::INVALID) {
-        continue;
-      }
-      Value first = expr->Evaluate(&a, child_executor_->GetOutputSchema());
-      Value second = expr->Evaluate(&b, child_executor_->GetOutputSchema());
-      if (first.CompareEquals(second) == CmpBool::CmpTrue) {
-        continue;
-      }
-      if (order_by_type == OrderByType::DEFAULT || order_by_type == OrderByType::ASC) {
-        return first.CompareLessThan(second) == CmpBool::CmpTrue;
-      }
-      // DESC
-      return first.CompareGreaterThan(second) == CmpBool::CmpTrue;
-    }
-    return false;
-  };
-  std::priority_queue<Tuple, std::vector<Tuple>, decltype(cmp)> pri_tuples(cmp);
   while (child_executor_->Next(&tuple, &rid)) {
-    if (pri_tuples.size() < plan_->GetN()) {
-      pri_tuples.emplace(tuple);
+    auto key = encoder_.MakeKey(tuple, child_executor_->GetOutputSchema());
+    if (entries_.size() < n) {
+      entries_.push_back({std::move(key), tuples_.size()});
+      tuples_.emplace_back(std::move(tuple));
+      std::push_heap(entries_.begin(), entries_.end(), cmp);
       continue;
     }
-    if (pri_tuples.empty()) {
+    // 不比堆顶小的 tuple 不可能进入前 N 个，直接丢弃
+    if (!encoder_.Less(key, entries_.front().key_)) {
       continue;
     }
-    auto top = pri_tuples.top();
-    if (!cmp(top, tuple)) {
-      pri_tuples.pop();
-      pri_tuples.emplace(tuple);
-    }
+    std::pop_heap(entries_.begin(), entries_.end(), cmp);
+    auto &entry = entries_.back();
+    entry.key_ = std::move(key);
+    tuples_[entry.slot_] = std::move(tuple);
+    std::push_heap(entries_.begin(), entries_.end(), cmp);
   }
-  while (!pri_tuples.empty()) {
-    tuples_.emplace_back(pri_tuples.top());
-    pri_tuples.pop();
+  std::sort_heap(entries_.begin(), entries_.end(), cmp);
+  // 堆满之后 tuple 数不再变化，结束时的大小即峰值
+  size_t bytes = 0;
+  for (size_t i = 0; i < entries_.size(); i++) {
+    bytes += tuples_[i].GetLength() + sizeof(Tuple) + sizeof(TopNEntry) + entries_[i].key_.normalized_.capacity() +
+             entries_[i].key_.values_.size() * sizeof(Value);
   }
-  std::reverse(std::begin(tuples_), std::end(tuples_));
-  tuples_iter_ = tuples_.begin();
+  peak_memory_bytes_ = std::max(peak_memory_bytes_, bytes);
 }
 
 auto TopNExecutor::Next(Tuple *tuple, RID *rid) -> bool {
-  if (tuples_iter_ == tuples_.end()) {
+  if (entries_pos_ == entries_.size()) {
     return false;
   }
-  *tuple = *(tuples_iter_++);
+  *tuple = tuples_[entries_[entries_pos_++].slot_];
   return true;
 }
 
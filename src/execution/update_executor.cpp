@@ -10,19 +10,166 @@
 //
 //===----------------------------------------------------------------------===//
 #include <memory>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include "common/exception.h"
+#include "concurrency/transaction_manager.h"
 #include "execution/executors/update_executor.h"
+#include "execution/executor_profile.h"
+#include "execution/expressions/column_value_expression.h"
 
 namespace bustub {
 
 UpdateExecutor::UpdateExecutor(ExecutorContext *exec_ctx, const UpdatePlanNode *plan,
                                std::unique_ptr<AbstractExecutor> &&child_executor)
-    : AbstractExecutor(exec_ctx) {
-  // As of Fall 2022, you DON'T need to implement update executor to have perfect score in project 3 / project 4.
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      child_executor_(ProfileChild(plan->GetChildPlan(), std::move(child_executor))) {}
+
+void UpdateExecutor::Init() {
+  auto txn = exec_ctx_->GetTransaction();
+  table_info_ = exec_ctx_->GetCatalog()->GetTable(plan_->TableOid());
+  table_heap_ptr_ = table_info_->table_.get();
+  child_executor_->Init();
+  done_ = false;
+  // table 加 IX if not locked yet
+  if (!txn->IsTableIntentionExclusiveLocked(table_info_->oid_)) {
+    if (!exec_ctx_->GetLockManager()->LockTable(txn, LockManager::LockMode::INTENTION_EXCLUSIVE, table_info_->oid_)) {
+      txn->SetState(TransactionState::ABORTED);
+      throw ExecutionException("UpdateExecutor::Init failed: lock IX on table failed");
+    }
+  }
+  // target expression 只是读出原来的列时，这一列不会改变
+  indexes_ = exec_ctx_->GetCatalog()->GetTableIndexes(table_info_->name_);
+  index_may_change_.assign(indexes_.size(), false);
+  for (size_t i = 0; i < indexes_.size(); i++) {
+    for (auto col_idx : indexes_[i]->index_->GetKeyAttrs()) {
+      const auto *column_expr = dynamic_cast<const ColumnValueExpression *>(plan_->target_expressions_[col_idx].get());
+      if (column_expr == nullptr || column_expr->GetTupleIdx() != 0 || column_expr->GetColIdx() != col_idx) {
+        index_may_change_[i] = true;
+        break;
+      }
+    }
+  }
 }
 
-void UpdateExecutor::Init() { throw NotImplementedException("UpdateExecutor is not implemented"); }
+auto UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
+  if (done_) {
+    return false;
+  }
+  int rows = 0;
+  Tuple t;
+  auto txn = exec_ctx_->GetTransaction();
+  auto oid = table_info_->oid_;
+  const auto &schema = table_info_->schema_;
+  auto version_store = exec_ctx_->GetTransactionManager()->GetVersionStore();
+  auto index_vacuum = exec_ctx_->GetTransactionManager()->GetIndexVacuum();
+  // 已经 update 过的行：key 改变后 index scan 会在后面再次读到它，重新插入的行 seq scan 也会再次读到
+  std::unordered_set<RID> updated_rids;
+  std::vector<Value> values;
+  values.reserve(plan_->target_expressions_.size());
+  // 新的 key 可能是 dead row 的 key：每个 statement 只 vacuum 一次，deleter 还没结束的由 InsertIndexEntry() 等待
+  if (!indexes_.empty() && index_vacuum->HasDeadRows(oid)) {
+    index_vacuum->Vacuum(txn);
+  }
+  while (child_executor_->Next(&t, rid)) {
+    RID old_rid = t.GetRid();
+    if (updated_rids.count(old_rid) != 0) {
+      continue;
+    }
+    if (!txn->IsRowExclusiveLocked(oid, old_rid)) {
+      if (!exec_ctx_->GetLockManager()->LockRow(txn, LockManager::LockMode::EXCLUSIVE, oid, old_rid)) {
+        txn->SetState(TransactionState::ABORTED);
+        throw ExecutionException("UpdateExecutor::Next failed: lock X on row failed");
+      }
+    }
+    if (version_store->IsEnabled()) {
+      if (version_store->IsWriteConflict(txn, oid, old_rid)) {
+        txn->SetState(TransactionState::ABORTED);
+        throw ExecutionException("UpdateExecutor::Next failed: row was written after the snapshot");
+      }
+      // child 在 snapshot 中读到的不一定是最新版本，READ_COMMITTED 下 update 加锁之后的版本
+      if (!table_heap_ptr_->GetTuple(old_rid, &t, txn)) {
+        continue;
+      }
+      version_store->RecordWrite(txn, oid, old_rid, &t);
+    }
+    values.clear();
+    for (const auto &expr : plan_->target_expressions_) {
+      values.emplace_back(expr->Evaluate(&t, schema));
+    }
+    Tuple new_tuple(values, &schema);
+
+    if (table_heap_ptr_->UpdateTuple(new_tuple, old_rid, txn)) {
+      // 原地 update，只更新 key 改变的 index
+      for (size_t i = 0; i < indexes_.size(); i++) {
+        if (!index_may_change_[i]) {
+          continue;
+        }
+        const auto &key_schema = indexes_[i]->key_schema_;
+        const auto &key_attrs = indexes_[i]->index_->GetKeyAttrs();
+        auto old_key = t.KeyFromTuple(schema, key_schema, key_attrs);
+        auto new_key = new_tuple.KeyFromTuple(schema, key_schema, key_attrs);
+        bool changed = false;
+        for (uint32_t j = 0; j < key_attrs.size() && !changed; j++) {
+          changed = !old_key.GetValue(&key_schema, j).CompareExactlyEquals(new_key.GetValue(&key_schema, j));
+        }
+        if (changed) {
+          indexes_[i]->index_->DeleteEntry(old_key, old_rid, txn);
+          InsertIndexEntry(indexes_[i], new_key, old_rid);
+        }
+      }
+      updated_rids.insert(old_rid);
+      rows++;
+      continue;
+    }
+    if (txn->GetState() == TransactionState::ABORTED) {
+      throw ExecutionException("UpdateExecutor::Next failed: update tuple failed");
+    }
 
-auto UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool { return false; }
+    // page 中放不下新的 tuple：删除后重新插入，所有 index 都指向新的 RID
+    table_heap_ptr_->MarkDelete(old_rid, txn);
+    std::vector<RID> new_rids;
+    version_store->InsertTuples(txn, oid, table_heap_ptr_, {&new_tuple}, &new_rids);
+    auto new_rid = new_rids[0];
+    if (new_rid.GetPageId() == INVALID_PAGE_ID) {
+      txn->SetState(TransactionState::ABORTED);
+      throw ExecutionException("UpdateExecutor::Next failed: insert updated tuple failed");
+    }
+    updated_rids.insert(new_rid);
+    if (!exec_ctx_->GetLockManager()->LockRow(txn, LockManager::LockMode::EXCLUSIVE, oid, new_rid)) {
+      txn->SetState(TransactionState::ABORTED);
+      throw ExecutionException("UpdateExecutor::Next failed: lock X on row failed");
+    }
+    for (auto index_info : indexes_) {
+      const auto &key_attrs = index_info->index_->GetKeyAttrs();
+      index_info->index_->DeleteEntry(t.KeyFromTuple(schema, index_info->key_schema_, key_attrs), old_rid, txn);
+      InsertIndexEntry(index_info, new_tuple.KeyFromTuple(schema, index_info->key_schema_, key_attrs), new_rid);
+    }
+    rows++;
+  }
+  Value value(TypeId::INTEGER, rows);
+  std::vector<Value> v;
+  v.emplace_back(value);
+  std::vector<Column> col;
+  col.emplace_back("", INTEGER);
+  Schema out_schema(col);
+  Tuple tmp_tuple(v, &out_schema);
+  *tuple = tmp_tuple;
+  done_ = true;
+  return true;
+}
+
+void UpdateExecutor::InsertIndexEntry(IndexInfo *index_info, const Tuple &key, const RID &rid) {
+  auto txn = exec_ctx_->GetTransaction();
+  auto index_vacuum = exec_ctx_->GetTransactionManager()->GetIndexVacuum();
+  if (!index_vacuum->InsertEntry(txn, exec_ctx_->GetLockManager(), table_info_->oid_, index_info->index_.get(), key,
+                                 rid)) {
+    txn->SetState(TransactionState::ABORTED);
+    throw ExecutionException("UpdateExecutor::Next failed: duplicate key in index " + index_info->name_);
+  }
+}
 
 }  // namespace bustub
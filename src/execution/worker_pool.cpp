@@ -0,0 +1,109 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// worker_pool.cpp
+//
+// Identification: src/execution/worker_pool.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/worker_pool.h"
+#include <algorithm>
+
+namespace bustub {
+
+WorkerPool::WorkerPool(size_t num_threads) {
+  threads_.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; i++) {
+    threads_.emplace_back(&WorkerPool::RunWorker, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::scoped_lock<std::mutex> lock(latch_);
+    stopped_ = true;
+  }
+  queue_cv_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+auto WorkerPool::Get() -> WorkerPool & {
+  static WorkerPool pool(std::max<size_t>(std::thread::hardware_concurrency(), 1));
+  return pool;
+}
+
+void WorkerPool::RunTasks(TaskGroup *group) {
+  size_t done = 0;
+  std::exception_ptr error;
+  for (auto i = group->next_++; i < group->num_tasks_; i = group->next_++) {
+    try {
+      (*group->task_)(i);
+    } catch (...) {
+      if (error == nullptr) {
+        error = std::current_exception();
+      }
+    }
+    done++;
+  }
+  if (done == 0) {
+    return;
+  }
+  std::scoped_lock<std::mutex> lock(group->latch_);
+  if (group->error_ == nullptr) {
+    group->error_ = error;
+  }
+  group->done_ += done;
+  if (group->done_ == group->num_tasks_) {
+    group->done_cv_.notify_all();
+  }
+}
+
+void WorkerPool::RunWorker() {
+  while (true) {
+    std::shared_ptr<TaskGroup> group;
+    {
+      std::unique_lock<std::mutex> lock(latch_);
+      queue_cv_.wait(lock, [&] { return stopped_ || !queue_.empty(); });
+      if (stopped_) {
+        return;
+      }
+      group = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    RunTasks(group.get());
+  }
+}
+
+void WorkerPool::RunParallel(size_t num_tasks, const std::function<void(size_t)> &task) {
+  if (num_tasks == 0) {
+    return;
+  }
+  auto group = std::make_shared<TaskGroup>();
+  group->task_ = &task;
+  group->num_tasks_ = num_tasks;
+  // 调用线程自己也执行 task，最多再需要 num_tasks - 1 个 pool thread
+  auto helpers = std::min(num_tasks - 1, threads_.size());
+  if (helpers > 0) {
+    {
+      std::scoped_lock<std::mutex> lock(latch_);
+      for (size_t i = 0; i < helpers; i++) {
+        queue_.push_back(group);
+      }
+    }
+    queue_cv_.notify_all();
+  }
+  RunTasks(group.get());
+  std::unique_lock<std::mutex> lock(group->latch_);
+  group->done_cv_.wait(lock, [&] { return group->done_ == group->num_tasks_; });
+  if (group->error_ != nullptr) {
+    std::rethrow_exception(group->error_);
+  }
+}
+
+}  // namespace bustub
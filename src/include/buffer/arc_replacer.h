@@ -0,0 +1,118 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// arc_replacer.h
+//
+// Identification: src/include/buffer/arc_replacer.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+/**
+ * ArcReplacer implements the Adaptive Replacement Cache policy (Megiddo & Modha, FAST'03).
+ *
+ * Resident frames live in T1 (seen once recently) or T2 (seen at least twice). The ids of pages evicted from T1 and T2
+ * are remembered in the ghost lists B1 and B2. A miss that hits B1 means T1 was too small, a miss that hits B2 means T2
+ * was too small, and the target size p of T1 is adapted accordingly, so the policy tunes itself between recency and
+ * frequency without a parameter.
+ *
+ * Frames marked by a Scan access are kept outside of T1/T2 in a FIFO that is drained first. They are neither promoted
+ * to T2 nor remembered in the ghost lists, so a hinted scan does not skew p.
+ *
+ * Only evictable frames are linked in the lists, so Evict() takes the LRU end of a list in O(1). A pinned frame keeps
+ * its list, and counts towards its size, but is unlinked until it is unpinned and goes back to the MRU end.
+ */
+class ArcReplacer : public Replacer {
+ public:
+  /**
+   * @brief Create a new ArcReplacer.
+   * @param num_frames the maximum number of frames the ArcReplacer will be required to store
+   */
+  explicit ArcReplacer(size_t num_frames);
+
+  DISALLOW_COPY_AND_MOVE(ArcReplacer);
+
+  ~ArcReplacer() override = default;
+
+  auto Evict(frame_id_t *frame_id) -> bool override;
+
+  void RecordAccess(frame_id_t frame_id, AccessType access_type = AccessType::Unknown) override;
+
+  void SetEvictable(frame_id_t frame_id, bool set_evictable) override;
+
+  void Remove(frame_id_t frame_id) override;
+
+  auto Size() -> size_t override;
+
+  void BindPage(frame_id_t frame_id, page_id_t page_id) override;
+
+ private:
+  enum class List { None = 0, Scan, T1, T2 };
+
+  struct FrameState {
+    List list_{List::None};
+    bool evictable_{false};
+    bool hot_{false};
+    page_id_t page_id_{INVALID_PAGE_ID};
+    std::list<frame_id_t>::iterator iter_;
+  };
+
+  // frame 所在的 list
+  auto ListOf(List list) -> std::list<frame_id_t> & { return list == List::Scan ? scan_ : list == List::T1 ? t1_ : t2_; }
+  // 属于 list 的 frames 数量，包括 pin 住而不在 list 中的
+  auto SizeOf(List list) const -> size_t { return list_size_[static_cast<size_t>(list)]; }
+  // 把 frame 移到 list 的尾部（MRU 端），pin 住的 frame 只改变所属 list，调用前需持有 latch_
+  void MoveTo(frame_id_t frame_id, List list);
+
+  /** A list of page ids evicted recently, with O(1) lookup. */
+  struct GhostList {
+    std::list<page_id_t> pages_;
+    std::unordered_map<page_id_t, std::list<page_id_t>::iterator> map_;
+
+    auto Size() const -> size_t { return pages_.size(); }
+    auto Erase(page_id_t page_id) -> bool;
+    void PushBack(page_id_t page_id);
+    void PopFront();
+  };
+
+  // 保证 |T1| + |B1| <= c 且 |T1| + |T2| + |B1| + |B2| <= 2c，调用前需持有 latch_
+  void TrimGhosts();
+
+  // 即 ARC 中的 c
+  size_t replacer_size_;
+  // T1 的目标大小，0 <= p_ <= c
+  size_t p_{0};
+  // 当前 evictable frames 数量
+  std::atomic<size_t> curr_size_{0};
+  std::vector<FrameState> frames_;
+  // 以下 list 只包含 evictable frames
+  // 被 Scan 标记的 frames，FIFO，最先淘汰
+  std::list<frame_id_t> scan_;
+  std::list<frame_id_t> t1_;
+  std::list<frame_id_t> t2_;
+  // 每个 List 的 frames 数量
+  std::array<size_t, 4> list_size_{};
+  GhostList b1_;
+  GhostList b2_;
+  std::mutex latch_;
+};
+
+}  // namespace bustub
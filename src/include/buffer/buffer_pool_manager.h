@@ -0,0 +1,122 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_manager.h
+//
+// Identification: src/include/buffer/buffer_pool_manager.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+
+#include "buffer/buffer_pool_stats.h"
+#include "buffer/replacer.h"
+#include "common/config.h"
+#include "storage/page/page.h"
+
+namespace bustub {
+
+/**
+ * BufferPoolManager reads disk pages to and from its internal buffer pool.
+ */
+class BufferPoolManager {
+ public:
+  BufferPoolManager() = default;
+  /**
+   * Destroys an existing BufferPoolManager.
+   */
+  virtual ~BufferPoolManager() = default;
+
+  /** @brief Create a new page in the buffer pool. */
+  auto NewPage(page_id_t *page_id) -> Page * { return NewPgImp(page_id); }
+
+  /**
+   * @brief Fetch the requested page from the buffer pool.
+   * @param page_id id of page to be fetched
+   * @param access_type how the caller is going to use the page, passed on to the replacer as a hint
+   */
+  auto FetchPage(page_id_t page_id, AccessType access_type = AccessType::Unknown) -> Page * {
+    return FetchPgImp(page_id, access_type);
+  }
+
+  /** @brief Unpin the target page from the buffer pool. */
+  auto UnpinPage(page_id_t page_id, bool is_dirty) -> bool { return UnpinPgImp(page_id, is_dirty); }
+
+  /** @brief Flush the target page to disk. */
+  auto FlushPage(page_id_t page_id) -> bool { return FlushPgImp(page_id); }
+
+  /** @brief Flush all the pages in the buffer pool to disk. */
+  void FlushAllPages() { FlushAllPgsImp(); }
+
+  /** @brief Delete a page from the buffer pool. */
+  auto DeletePage(page_id_t page_id) -> bool { return DeletePgImp(page_id); }
+
+  /**
+   * @brief Ask the buffer pool to load pages [first_page_id, first_page_id + count) in the background, without pinning
+   * them, so that a sequential reader finds them in memory. Pages that do not exist yet are ignored.
+   */
+  void PrefetchPages(page_id_t first_page_id, size_t count) { PrefetchPgsImp(first_page_id, count); }
+
+  /** @brief Return the size (number of frames) of the buffer pool. */
+  virtual auto GetPoolSize() -> size_t = 0;
+
+  /** @brief Return a snapshot of the counters of the buffer pool. */
+  virtual auto GetStats() -> BufferPoolStats = 0;
+
+ protected:
+  /**
+   * @brief Create a new page in the buffer pool.
+   * @param[out] page_id id of created page
+   * @return nullptr if no new pages could be created, otherwise pointer to new page
+   */
+  virtual auto NewPgImp(page_id_t *page_id) -> Page * = 0;
+
+  /**
+   * @brief Fetch the requested page from the buffer pool.
+   * @param page_id id of page to be fetched
+   * @param access_type the access hint of the caller
+   * @return nullptr if page_id cannot be fetched, otherwise pointer to the requested page
+   */
+  virtual auto FetchPgImp(page_id_t page_id, AccessType access_type) -> Page * = 0;
+
+  /**
+   * @brief Unpin the target page from the buffer pool.
+   * @param page_id id of page to be unpinned
+   * @param is_dirty true if the page should be marked as dirty, false otherwise
+   * @return false if the page pin count is <= 0 before this call, true otherwise
+   */
+  virtual auto UnpinPgImp(page_id_t page_id, bool is_dirty) -> bool = 0;
+
+  /**
+   * @brief Flush the target page to disk.
+   * @param page_id id of page to be flushed, cannot be INVALID_PAGE_ID
+   * @return false if the page could not be found in the page table, true otherwise
+   */
+  virtual auto FlushPgImp(page_id_t page_id) -> bool = 0;
+
+  /**
+   * @brief Flush all the pages in the buffer pool to disk.
+   */
+  virtual void FlushAllPgsImp() = 0;
+
+  /**
+   * @brief Delete a page from the buffer pool.
+   * @param page_id id of page to be deleted
+   * @return false if the page exists but could not be deleted, true if the page didn't exist or deletion succeeded
+   */
+  virtual auto DeletePgImp(page_id_t page_id) -> bool = 0;
+
+  /**
+   * @brief Start loading pages in the background. Prefetching is only a hint, so the default does nothing.
+   * @param first_page_id id of the first page to load
+   * @param count number of consecutive page ids to load
+   */
+  virtual void PrefetchPgsImp(page_id_t first_page_id, size_t count) {}
+};
+
+}  // namespace bustub
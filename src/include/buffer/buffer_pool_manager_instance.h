@@ -12,17 +12,31 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
 #include <iostream>
+#include <limits>
 #include <list>
+#include <memory>
 #include <mutex>  // NOLINT
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/frame_arena.h"
 #include "buffer/lru_k_replacer.h"
+#include "buffer/replacer.h"
 #include "common/config.h"
-#include "container/hash/extendible_hash_table.h"
+#include "container/hash/striped_hash_table.h"
 #include "recovery/log_manager.h"
 #include "storage/disk/disk_manager.h"
+#include "storage/disk/disk_scheduler.h"
 #include "storage/page/page.h"
 
 namespace bustub {
@@ -33,14 +47,31 @@ namespace bustub {
 class BufferPoolManagerInstance : public BufferPoolManager {
  public:
   /**
-   * @brief Creates a new BufferPoolManagerInstance.
+   * @brief Creates a new BufferPoolManagerInstance, with its background writer running (see StartBackgroundFlusher())
+   * and woken up early once FLUSHER_HIGH_WATER_PERCENT of the frames are dirty.
    * @param pool_size the size of the buffer pool
    * @param disk_manager the disk manager
    * @param replacer_k the lookback constant k for the LRU-K replacer
    * @param log_manager the log manager (for testing only: nullptr = disable logging). Please ignore this for P1.
+   * @param replacer_type the replacement policy of the pool
    */
   BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager, size_t replacer_k = LRUK_REPLACER_K,
-                            LogManager *log_manager = nullptr);
+                            LogManager *log_manager = nullptr, ReplacerType replacer_type = ReplacerType::LRUK);
+
+  /**
+   * @brief Creates a new BufferPoolManagerInstance that is one shard of a ParallelBufferPoolManager, with its
+   * background writer running as above.
+   * @param pool_size the size of this instance's buffer pool
+   * @param num_instances total number of BPIs in the parallel BPM
+   * @param instance_index index of this BPI in the parallel BPM
+   * @param disk_manager the disk manager
+   * @param replacer_k the lookback constant k for the LRU-K replacer
+   * @param log_manager the log manager (for testing only: nullptr = disable logging). Please ignore this for P1.
+   * @param replacer_type the replacement policy of the pool
+   */
+  BufferPoolManagerInstance(size_t pool_size, uint32_t num_instances, uint32_t instance_index,
+                            DiskManager *disk_manager, size_t replacer_k = LRUK_REPLACER_K,
+                            LogManager *log_manager = nullptr, ReplacerType replacer_type = ReplacerType::LRUK);
 
   /**
    * @brief Destroy an existing BufferPoolManagerInstance.
@@ -53,6 +84,31 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** @brief Return the pointer to all the pages in the buffer pool. */
   auto GetPages() -> Page * { return pages_; }
 
+  /**
+   * @brief Return a snapshot of the counters of this instance. The frame counts are taken under latch_ with one pass
+   * over the frames; the event counters are read without the latch and may be slightly behind.
+   */
+  auto GetStats() -> BufferPoolStats override;
+
+  /**
+   * @brief Start a background writer that cleans dirty, unpinned frames so that misses find clean victims.
+   *
+   * The writer wakes up every `interval`, or as soon as the number of dirty frames reaches `dirty_high_water_mark`,
+   * and makes one pass over the frames, writing the dirty unpinned pages back in batches of FLUSH_BATCH_SIZE, each in
+   * page id order and with one latch_ acquisition. Each batch is collected from the frame where the previous one
+   * stopped, so a pass costs one scan of the pool. A failed write is logged and its pages stay dirty.
+   *
+   * The constructor starts the writer; calling this while it is running only changes its parameters.
+   *
+   * @param dirty_high_water_mark number of dirty frames that wakes the writer up early
+   * @param interval how long the writer sleeps between two rounds
+   */
+  void StartBackgroundFlusher(size_t dirty_high_water_mark,
+                              std::chrono::milliseconds interval = std::chrono::milliseconds(50));
+
+  /** @brief Stop the background writer started by StartBackgroundFlusher(), if any. */
+  void StopBackgroundFlusher();
+
  protected:
   /**
    * TODO(P1): Add implementation
@@ -87,9 +143,10 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    * In addition, remember to disable eviction and record the access history of the frame like you did for NewPgImp().
    *
    * @param page_id id of page to be fetched
+   * @param access_type the access hint of the caller, recorded in the replacer
    * @return nullptr if page_id cannot be fetched, otherwise pointer to the requested page
    */
-  auto FetchPgImp(page_id_t page_id) -> Page * override;
+  auto FetchPgImp(page_id_t page_id, AccessType access_type) -> Page * override;
 
   /**
    * TODO(P1): Add implementation
@@ -114,6 +171,10 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    * Use the DiskManager::WritePage() method to flush a page to disk, REGARDLESS of the dirty flag.
    * Unset the dirty flag of the page after flushing.
    *
+   * The page is copied and its dirty flag cleared under latch_, and the copy is written through WriteBack() with
+   * latch_ released, so fetches and unpins on this instance do not wait for the disk. A page modified during the
+   * write is dirty again afterwards.
+   *
    * @param page_id id of page to be flushed, cannot be INVALID_PAGE_ID
    * @return false if the page could not be found in the page table, true otherwise
    */
@@ -141,23 +202,39 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    */
   auto DeletePgImp(page_id_t page_id) -> bool override;
 
+  /**
+   * @brief Queue the pages owned by this instance for the prefetch thread, which is started on first use. The prefetch
+   * thread loads each page like FetchPgImp(page_id, AccessType::Scan) and unpins it right away, so prefetched pages
+   * are the first to go if nobody reads them. Pages that were never allocated, are already queued, or do not fit in
+   * the queue are skipped.
+   */
+  void PrefetchPgsImp(page_id_t first_page_id, size_t count) override;
+
   /** Number of pages in the buffer pool. */
   const size_t pool_size_;
+  /** How many instances are in the parallel BPM (if present, otherwise just 1 BPI) */
+  const uint32_t num_instances_ = 1;
+  /** Index of this BPI in the parallel BPM (if present, otherwise just 0) */
+  const uint32_t instance_index_ = 0;
   /** The next page id to be allocated  */
   std::atomic<page_id_t> next_page_id_ = 0;
-  /** Bucket size for the extendible hash table */
-  const size_t bucket_size_ = 4;
 
-  /** Array of buffer pool pages. */
+  /**
+   * Array of buffer pool pages, in frame_arena_. An instance of a parallel BPM places its frames on NUMA node
+   * `instance_index % number of nodes`.
+   */
+  std::unique_ptr<FrameArena> frame_arena_;
   Page *pages_;
   /** Pointer to the disk manager. */
   DiskManager *disk_manager_;
+  /** Runs the page reads and writes on the disk manager, so that the I/Os of a batch overlap. */
+  std::unique_ptr<DiskScheduler> disk_scheduler_;
   /** Pointer to the log manager. Please ignore this for P1. */
   LogManager *log_manager_ __attribute__((__unused__));
-  /** Page table for keeping track of buffer pool pages. */
-  ExtendibleHashTable<page_id_t, frame_id_t> *page_table_;
+  /** Page table for keeping track of buffer pool pages, it never holds more than pool_size_ entries. */
+  StripedHashTable<page_id_t, frame_id_t> *page_table_;
   /** Replacer to find unpinned pages for replacement. */
-  LRUKReplacer *replacer_;
+  Replacer *replacer_;
   /** List of free frames that don't have any pages on them. */
   std::list<frame_id_t> free_list_;
   /** This latch protects shared data structures. We recommend updating this comment to describe what it protects. */
@@ -166,9 +243,81 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   // std::mutex *page_latch_;
   // free_list_ 专属锁，获取之前需要先获取 latch_ 的读锁
   // std::mutex free_list_latch_;
-  // 全局锁
+  // 全局锁，disk I/O 期间不持有
   std::mutex latch_;
 
+  /**
+   * Per-frame I/O state. A frame whose io_pending_ is set has been reserved for a page that is still being written back
+   * and/or read from disk outside of latch_; its metadata is already installed, but its data must not be used yet.
+   * io_pending_ is protected by latch_, and cv_ is waited on with latch_.
+   */
+  struct FrameIoState {
+    bool io_pending_{false};
+    std::condition_variable cv_;
+  };
+  /** Array of per-frame I/O states, indexed by frame id. */
+  FrameIoState *frame_io_;
+  /** Dirty pages that have left the page table but whose write-back has not finished yet, mapped to their frame. */
+  std::unordered_map<page_id_t, frame_id_t> evicting_pages_;
+
+  /** Max number of pages copied out and written back per latch_ acquisition */
+  static constexpr size_t FLUSH_BATCH_SIZE = 64;
+  /** Percentage of dirty frames that wakes up the background writer started by the constructor */
+  static constexpr size_t FLUSHER_HIGH_WATER_PERCENT = 50;
+  /** Number of frames whose is_dirty_ is set, protected by latch_ */
+  size_t num_dirty_{0};
+  /** Pages whose copy is being written back by WriteBack() outside of latch_. Protected by latch_. */
+  std::unordered_set<page_id_t> flushing_pages_;
+  /** Notified, with latch_, when pages leave flushing_pages_ */
+  std::condition_variable flush_cv_;
+  /** Number of dirty frames that wakes the background writer up early */
+  size_t dirty_high_water_mark_{std::numeric_limits<size_t>::max()};
+  /** How long the background writer sleeps between two rounds */
+  std::chrono::milliseconds flusher_interval_{50};
+  /** Set, with latch_, when the number of dirty frames reaches dirty_high_water_mark_ */
+  bool flusher_wakeup_{false};
+  /** Set, with latch_, to stop the background writer */
+  bool flusher_stop_{false};
+  /** Frame the background writer collects its next batch from, protected by latch_ */
+  size_t flush_cursor_{0};
+  /** Waited on by the background writer, with latch_ */
+  std::condition_variable flusher_cv_;
+  std::thread flusher_thread_;
+
+  /** Max number of queued pages the prefetch thread loads with one batch of reads */
+  static constexpr size_t PREFETCH_BATCH_SIZE = 16;
+  /** Prefetch requests are dropped once this many pages are queued */
+  const size_t max_prefetch_queue_size_;
+  /** Protects the prefetch queue. Never held together with latch_. */
+  std::mutex prefetch_latch_;
+  /** Waited on by the prefetch thread, with prefetch_latch_ */
+  std::condition_variable prefetch_cv_;
+  /** Pages waiting to be prefetched, in request order */
+  std::deque<page_id_t> prefetch_queue_;
+  /** Pages in prefetch_queue_, to drop duplicated requests */
+  std::unordered_set<page_id_t> prefetch_pending_;
+  /** Set, with prefetch_latch_, to stop the prefetch thread */
+  bool prefetch_stop_{false};
+  std::thread prefetch_thread_;
+
+  /**
+   * Event counters reported by GetStats(). They are bumped with relaxed atomics, mostly while latch_ is held anyway,
+   * so that GetStats() can read them without taking latch_.
+   */
+  struct StatsCounters {
+    std::array<std::atomic<uint64_t>, BufferPoolStats::NUM_ACCESS_TYPES> hits_{};
+    std::array<std::atomic<uint64_t>, BufferPoolStats::NUM_ACCESS_TYPES> misses_{};
+    std::atomic<uint64_t> new_pages_{0};
+    std::atomic<uint64_t> prefetches_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> dirty_evictions_{0};
+    std::atomic<uint64_t> flushes_{0};
+    std::atomic<uint64_t> latch_acquisitions_{0};
+    std::atomic<uint64_t> latch_contentions_{0};
+    std::atomic<uint64_t> latch_wait_ns_{0};
+  };
+  StatsCounters stats_;
+
   /**
    * @brief Allocate a page on disk. Caller should acquire the latch before calling this function.
    * @return the id of the allocated page
@@ -183,6 +332,13 @@ class BufferPoolManagerInstance : public BufferPoolManager {
     // This is a no-nop right now without a more complex data structure to track deallocated pages
   }
 
+  /**
+   * @brief Validate that the page_id being used is accessible to this BPI. This can be used in all of the functions to
+   * validate input data and ensure that a parallel BPM is routing requests to the correct BPI
+   * @param page_id
+   */
+  void ValidatePageId(page_id_t page_id) const;
+
   // TODO(student): You may add additional private members and helper functions
  private:
   // 初始化 page
@@ -195,6 +351,116 @@ class BufferPoolManagerInstance : public BufferPoolManager {
     }
   }
 
+  /**
+   * @brief Take a frame from the free list or the replacer and detach its old page. Caller must hold latch_.
+   * If the old page is dirty it is registered in evicting_pages_ until the frame's I/O finishes.
+   * @param[out] frame_id the reserved frame
+   * @param[out] old_page_id the page that was in the frame, INVALID_PAGE_ID for a free frame
+   * @param[out] old_dirty whether the old page has to be written back
+   * @return false if every frame is pinned
+   */
+  auto AcquireFrame(frame_id_t *frame_id, page_id_t *old_page_id, bool *old_dirty) -> bool;
+
+  /**
+   * @brief Map page_id to frame_id, pin it once and mark the frame as I/O pending. Caller must hold latch_.
+   */
+  void InstallPage(frame_id_t frame_id, page_id_t page_id, AccessType access_type);
+
+  /**
+   * @brief Clear the frame's I/O pending flag, forget the evicted page and wake up the waiters. Caller must hold latch_.
+   */
+  void FinishIo(frame_id_t frame_id, page_id_t old_page_id);
+
+  /**
+   * @brief Block on the frame until its pending I/O is done. latch_ is released while waiting.
+   */
+  void WaitForIo(std::unique_lock<std::mutex> *lock, frame_id_t frame_id);
+
+  /**
+   * @brief Block until no old copy of page_id is being written back by WriteBack(). latch_ is released while waiting.
+   */
+  void WaitForFlush(std::unique_lock<std::mutex> *lock, page_id_t page_id);
+
+  /** @brief Main loop of the background writer. */
+  void BackgroundFlush();
+
+  /** @brief Main loop of the prefetch thread. */
+  void BackgroundPrefetch();
+
+  /** @brief Load the given pages like PinPage(page_id, AccessType::Scan, true) with one batch of reads, then unpin. */
+  void PrefetchBatch(const std::vector<page_id_t> &page_ids);
+
+  /** A frame reserved by BeginLoad() for a page whose read, and the write-back of the old page, are still to be done */
+  struct PendingLoad {
+    frame_id_t frame_id_{-1};
+    page_id_t page_id_{INVALID_PAGE_ID};
+    page_id_t old_page_id_{INVALID_PAGE_ID};
+    bool old_dirty_{false};
+    /** Set by CompleteLoads() if the write-back or the read failed */
+    bool failed_{false};
+    /** The write-back of the old page failed, so the frame still holds the old page */
+    bool old_kept_{false};
+  };
+
+  /**
+   * @brief Pin page_id if it is resident, otherwise reserve a frame for it and describe the I/O left in `load`. Caller
+   * must hold latch_, which may be released while waiting for other I/Os on the page.
+   * @return the pinned page on a hit; nullptr on a miss, with load->frame_id_ set to -1 if every frame is pinned
+   */
+  auto BeginLoad(std::unique_lock<std::mutex> *lock, page_id_t page_id, AccessType access_type, bool is_prefetch,
+                 PendingLoad *load) -> Page *;
+
+  /**
+   * @brief Write back the old pages of `loads` in one batch, then read the new pages in another, and finish their
+   * frames. A frame is only overwritten once its old page is on disk. Caller must hold latch_, which is released
+   * during the I/O. Failed loads are marked and undone with AbortLoad(), dropping the caller's pin, and the first error
+   * is rethrown with latch_ held.
+   */
+  void CompleteLoads(std::unique_lock<std::mutex> *lock, std::vector<PendingLoad> *loads);
+
+  /**
+   * @brief Undo InstallPage() of page_id after its load failed. Caller must hold latch_.
+   * page_id leaves the page table. If `old_kept`, the old page goes back in the frame, still dirty; otherwise the frame
+   * returns to the free list once the threads that pinned it waiting for page_id have dropped their pins.
+   */
+  void AbortLoad(frame_id_t frame_id, page_id_t page_id, page_id_t old_page_id, bool old_kept);
+
+  /** @brief Drop a pin taken on a frame while its load was pending, see AbortLoad(). Caller must hold latch_. */
+  void ReleasePin(frame_id_t frame_id);
+
+  /**
+   * @brief Fetch a page and pin it, the body of FetchPgImp().
+   * @param is_prefetch true when called by the prefetch thread, whose loads are counted apart from reader hits/misses
+   */
+  auto PinPage(page_id_t page_id, AccessType access_type, bool is_prefetch) -> Page *;
+
+  /**
+   * @brief Lock a deferred or unlocked lock on latch_, counting the acquisition and, if another thread holds latch_,
+   * the time spent waiting for it.
+   */
+  void LockLatch(std::unique_lock<std::mutex> *lock);
+
+  /**
+   * @brief Collect every resident page to write back, sorted by page id. Caller must hold latch_.
+   */
+  auto CollectFlushCandidates() -> std::vector<std::pair<page_id_t, frame_id_t>>;
+
+  /**
+   * @brief Collect up to FLUSH_BATCH_SIZE dirty unpinned frames, sorted by page id, scanning from flush_cursor_ and
+   * leaving it after the last frame scanned. Caller must hold latch_.
+   * @param[in,out] scanned number of frames scanned in this pass, stops the scan at pool_size_
+   */
+  auto NextFlushBatch(size_t *scanned) -> std::vector<std::pair<page_id_t, frame_id_t>>;
+
+  /**
+   * @brief Copy the given pages out of their frames and clear their dirty flags under latch_, then write the copies
+   * outside of latch_. Pages that left their frame in the meantime are skipped. Caller must hold latch_.
+   * If a write fails, the pages still resident are marked dirty again and the first error is rethrown with latch_ held.
+   */
+  void WriteBack(std::unique_lock<std::mutex> *lock,
+                 std::vector<std::pair<page_id_t, frame_id_t>>::const_iterator begin,
+                 std::vector<std::pair<page_id_t, frame_id_t>>::const_iterator end);
+
   // 输出当前 page 情况
 };
 }  // namespace bustub
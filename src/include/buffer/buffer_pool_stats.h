@@ -0,0 +1,78 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_stats.h
+//
+// Identification: src/include/buffer/buffer_pool_stats.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "buffer/replacer.h"
+
+namespace bustub {
+
+/**
+ * A point-in-time snapshot of the counters of a buffer pool, returned by BufferPoolManager::GetStats().
+ *
+ * Hits and misses are broken down by the AccessType hint of the FetchPage() call, which tells apart index pages
+ * (Index), table pages read by scans (Scan) and point lookups (Lookup). Loads done by the prefetch thread are counted
+ * in prefetches_ only, so a page that was prefetched in time shows up as a hit of the reader that asked for it.
+ */
+struct BufferPoolStats {
+  static constexpr size_t NUM_ACCESS_TYPES = static_cast<size_t>(AccessType::Index) + 1;
+
+  /** FetchPage() calls that found the page in the pool, indexed by AccessType */
+  std::array<uint64_t, NUM_ACCESS_TYPES> hits_{};
+  /** FetchPage() calls that read the page from disk, indexed by AccessType */
+  std::array<uint64_t, NUM_ACCESS_TYPES> misses_{};
+  /** Pages created by NewPage() */
+  uint64_t new_pages_{0};
+  /** Pages read from disk by the prefetch thread */
+  uint64_t prefetches_{0};
+  /** Frames taken from the replacer, i.e. not from the free list */
+  uint64_t evictions_{0};
+  /** Dirty pages written back because their frame was evicted */
+  uint64_t dirty_evictions_{0};
+  /** Pages written back by FlushPage(), FlushAllPages() or the background writer */
+  uint64_t flushes_{0};
+  /** Acquisitions of the pool latch on the NewPage() / FetchPage() / UnpinPage() paths */
+  uint64_t latch_acquisitions_{0};
+  /** Acquisitions that found the latch held by another thread */
+  uint64_t latch_contentions_{0};
+  /** Total time spent waiting for the latch by contended acquisitions */
+  uint64_t latch_wait_ns_{0};
+
+  /** Number of frames of the pool */
+  size_t pool_size_{0};
+  /** Frames that hold no page */
+  size_t free_frames_{0};
+  /** Frames whose page has a non-zero pin count */
+  size_t pinned_frames_{0};
+  /** Frames whose page is dirty */
+  size_t dirty_frames_{0};
+  /** Frames the replacer is allowed to evict */
+  size_t evictable_frames_{0};
+
+  auto Hits() const -> uint64_t;
+  auto Misses() const -> uint64_t;
+  /** @return hits / (hits + misses), or 0 if nothing was fetched yet */
+  auto HitRatio() const -> double;
+
+  /** @brief Add up the counters of another pool, used to aggregate the instances of a parallel BPM. */
+  auto operator+=(const BufferPoolStats &other) -> BufferPoolStats &;
+
+  /** @return the snapshot as one `name=value` line per counter */
+  auto ToString() const -> std::string;
+};
+
+}  // namespace bustub
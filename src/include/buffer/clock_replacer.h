@@ -0,0 +1,90 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// clock_replacer.h
+//
+// Identification: src/include/buffer/clock_replacer.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+/**
+ * ClockReplacer implements the CLOCK (second chance) replacement policy.
+ *
+ * Every access sets the frame's reference bit. The clock hand sweeps over the frames, clearing reference bits, and
+ * evicts the first evictable frame whose bit is already clear. This approximates LRU with O(1) bookkeeping per access.
+ * Frames marked by a Scan access are kept in a FIFO that is drained before the hand moves, so taking them neither
+ * costs a sweep nor clears the reference bits of the hot frames.
+ *
+ * The clock is a ring of the evictable frames only: a pinned frame is unlinked from it, and is linked again just
+ * behind the hand when it is unpinned. The hand therefore never sweeps over pinned frames, and Evict() takes amortized
+ * O(1) however many frames are pinned.
+ */
+class ClockReplacer : public Replacer {
+ public:
+  /**
+   * @brief Create a new ClockReplacer.
+   * @param num_frames the maximum number of frames the ClockReplacer will be required to store
+   */
+  explicit ClockReplacer(size_t num_frames);
+
+  DISALLOW_COPY_AND_MOVE(ClockReplacer);
+
+  ~ClockReplacer() override = default;
+
+  auto Evict(frame_id_t *frame_id) -> bool override;
+
+  void RecordAccess(frame_id_t frame_id, AccessType access_type = AccessType::Unknown) override;
+
+  void SetEvictable(frame_id_t frame_id, bool set_evictable) override;
+
+  void Remove(frame_id_t frame_id) override;
+
+  auto Size() -> size_t override;
+
+ private:
+  struct FrameState {
+    bool tracked_{false};
+    bool evictable_{false};
+    bool ref_{false};
+    bool hot_{false};
+    bool scan_{false};
+    // 在 ring_ 或 scan_frames_ 中的位置，只对 evictable frame 有效
+    std::list<frame_id_t>::iterator iter_;
+  };
+
+  // 把 evictable frame 放进 ring_ 或 scan_frames_，调用前需持有 latch_
+  void Link(frame_id_t frame_id);
+  // 把 frame 从 ring_ 或 scan_frames_ 中取出，调用前需持有 latch_
+  void Unlink(frame_id_t frame_id);
+
+  size_t replacer_size_;
+  // 当前 evictable frames 数量
+  std::atomic<size_t> curr_size_{0};
+  std::vector<FrameState> frames_;
+  // 没有被 Scan 标记的 evictable frames，首尾相连组成时钟
+  std::list<frame_id_t> ring_;
+  // 时钟指针，指向下一个要检查的 frame，为 ring_.end() 时回到开头
+  std::list<frame_id_t>::iterator hand_;
+  // 被 Scan 标记的 evictable frames，FIFO，最先淘汰
+  std::list<frame_id_t> scan_frames_;
+  std::mutex latch_;
+};
+
+}  // namespace bustub
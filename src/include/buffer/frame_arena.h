@@ -0,0 +1,71 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// frame_arena.h
+//
+// Identification: src/include/buffer/frame_arena.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+
+#include "storage/page/page.h"
+
+namespace bustub {
+
+/**
+ * FrameArena holds the frames of a buffer pool in one mapping backed by huge pages where the OS allows it, instead of
+ * `new Page[pool_size]`, so that a large pool needs far fewer TLB entries.
+ *
+ * The arena first asks for explicit huge pages (1 GB pages for a mapping of at least 1 GB, 2 MB pages otherwise). When
+ * none are reserved, it falls back to a regular mapping aligned to 2 MB and advised as transparent huge pages. Small
+ * arenas, and systems without mmap huge page support, use the regular mapping only.
+ *
+ * An arena can be placed on a NUMA node: the mapping prefers that node's memory before its pages are first touched,
+ * and spills to the other nodes when it is full.
+ */
+class FrameArena {
+ public:
+  static constexpr size_t HUGE_PAGE_SIZE = 2UL << 20;
+  static constexpr size_t GIGANTIC_PAGE_SIZE = 1UL << 30;
+
+  /**
+   * Map and construct the frames.
+   * @param num_frames number of frames
+   * @param numa_node NUMA node whose memory the frames prefer, or -1 to leave placement to the OS
+   */
+  explicit FrameArena(size_t num_frames, int numa_node = -1);
+
+  /** Destroy the frames and unmap them. */
+  ~FrameArena();
+
+  FrameArena(const FrameArena &) = delete;
+  auto operator=(const FrameArena &) -> FrameArena & = delete;
+
+  /** @return the first of the num_frames frames */
+  auto GetFrames() -> Page * { return frames_; }
+
+  /** @return `true` if the frames are backed by explicit huge pages, not only advised as transparent huge pages */
+  auto IsHugePageBacked() const -> bool { return huge_page_backed_; }
+
+  /** @return the number of NUMA nodes of the host, 1 when it is not a NUMA system */
+  static auto NumNumaNodes() -> int;
+
+ private:
+  /** Make the pages of [addr, addr + length) prefer `numa_node`. Does nothing where NUMA policies are not supported. */
+  static void PreferNode(void *addr, size_t length, int numa_node);
+
+  size_t num_frames_;
+  Page *frames_{nullptr};
+  // mmap 返回的地址和长度，frames_ 可能在其中按 HUGE_PAGE_SIZE 对齐后的位置
+  void *mapping_{nullptr};
+  size_t mapping_size_{0};
+  bool huge_page_backed_{false};
+};
+
+}  // namespace bustub
@@ -19,11 +19,11 @@
 #include <list>
 #include <memory>
 #include <mutex>  // NOLINT
-#include <queue>
-#include <shared_mutex>  // NOLINT
-#include <unordered_map>
+#include <set>
+#include <utility>
 #include <vector>
 
+#include "buffer/replacer.h"
 #include "common/config.h"
 #include "common/logger.h"
 #include "common/macros.h"
@@ -41,7 +41,7 @@ namespace bustub {
  * +inf as its backward k-distance. When multiple frames have +inf backward k-distance,
  * classical LRU algorithm is used to choose victim.
  */
-class LRUKReplacer {
+class LRUKReplacer : public Replacer {
  public:
   /**
    *
@@ -59,7 +59,7 @@ class LRUKReplacer {
    *
    * @brief Destroys the LRUReplacer.
    */
-  ~LRUKReplacer();
+  ~LRUKReplacer() override;
 
   /**
    * TODO(P1): Add implementation
@@ -77,7 +77,7 @@ class LRUKReplacer {
    * @param[out] frame_id id of frame that is evicted.
    * @return true if a frame is evicted successfully, false if no frames can be evicted.
    */
-  auto Evict(frame_id_t *frame_id) -> bool;
+  auto Evict(frame_id_t *frame_id) -> bool override;
 
   /**
    * TODO(P1): Add implementation
@@ -88,9 +88,13 @@ class LRUKReplacer {
    * If frame id is invalid (ie. larger than replacer_size_), throw an exception. You can
    * also use BUSTUB_ASSERT to abort the process if frame id is invalid.
    *
+   * A Scan access marks a frame that has never been hot as cheap to evict: it moves to scan_set_, which is drained
+   * before the +inf and the k-distance frames, and its timestamp is not added to the history.
+   *
    * @param frame_id id of frame that received a new access.
+   * @param access_type type of access that was received
    */
-  void RecordAccess(frame_id_t frame_id);
+  void RecordAccess(frame_id_t frame_id, AccessType access_type = AccessType::Unknown) override;
 
   /**
    * TODO(P1): Add implementation
@@ -109,7 +113,7 @@ class LRUKReplacer {
    * @param frame_id id of frame whose 'evictable' status will be modified
    * @param set_evictable whether the given frame is evictable or not
    */
-  void SetEvictable(frame_id_t frame_id, bool set_evictable);
+  void SetEvictable(frame_id_t frame_id, bool set_evictable) override;
 
   /**
    * TODO(P1): Add implementation
@@ -128,7 +132,7 @@ class LRUKReplacer {
    *
    * @param frame_id id of frame to be removed
    */
-  void Remove(frame_id_t frame_id);
+  void Remove(frame_id_t frame_id) override;
 
   /**
    * TODO(P1): Add implementation
@@ -137,43 +141,66 @@ class LRUKReplacer {
    *
    * @return size_t
    */
-  auto Size() -> size_t;
+  auto Size() -> size_t override;
 
   class FrameNode {
    public:
     explicit FrameNode(size_t queue_size);
-    ~FrameNode();
 
     // 初始化
     void Init();
 
+    // 记录一次访问，只保留最近 queue_size_ 次
+    void Push(size_t timestamp);
+
+    // 最近 queue_size_ 次访问中最早的一次，访问次数不足时即第一次访问的时间
+    auto Oldest() const -> size_t { return cnt_ < queue_size_ ? history_access_[0] : history_access_[pos_]; }
+
     bool evictable_;
-    std::queue<size_t> *history_access_;
+    // 被 Lookup / Index 访问过，之后的 Scan 访问不会再把它标记为 scan frame
+    bool hot_;
+    // 被 Scan 访问标记，淘汰时最先被选中
+    bool scan_;
+    // 被标记为 scan frame 的时间
+    size_t scan_ts_;
+    // 固定 queue_size_ 个元素的环形数组
+    std::vector<size_t> history_access_;
+    // 下一次写入 history_access_ 的位置
+    size_t pos_;
     // 为 0 则代表未使用，1 代表使用
     size_t status_;
-    // 当前 history_access_.size()
+    // 当前 history_access_ 中有效的个数
     size_t cnt_;
     // cnt_ <= queue_size_
     size_t queue_size_;
-    std::mutex latch_;
   };
 
  private:
   // TODO(student): implement me! You can replace these member variables as you like.
   // Remove maybe_unused if you start using them.
 
+  // 把 evictable frame 放进 scan_set_、history_set_ 或 cache_set_，调用前需持有 latch_
+  void Attach(frame_id_t frame_id, const FrameNode &node);
+  // 把 evictable frame 从 scan_set_、history_set_ 或 cache_set_ 中取出，调用前需持有 latch_
+  void Detach(frame_id_t frame_id, const FrameNode &node);
+
   // 当前时间戳，每次调用 RecordAccess 的时候自增
   std::atomic<size_t> current_timestamp_{0};
-  // 当前 replacer 保存的 evictable frames 数量，即：frame_cache_ 中 evictable frames 的数量
+  // 当前 replacer 保存的 evictable frames 数量，即：scan_set_.size() + history_set_.size() + cache_set_.size()
   std::atomic<size_t> curr_size_{0};
-  // replacer 最大可以同时保存的 evictable frames 的数量，即：
-  // frame_cache_ 中 evictable frames 同时存在的数量
+  // replacer 最大可以同时保存的 evictable frames 的数量
   size_t replacer_size_;
-  // 当 frame 访问次数不小 k 时，则将其从 history_access_ 移至 frame_cache_
+  // 当 frame 访问次数不小 k 时，则将其从 history_set_ 移至 cache_set_
   size_t k_;
   // frame id -> frame node
-  std::unordered_map<frame_id_t, std::shared_ptr<FrameNode>> frame_cache_;
-  std::shared_mutex latch_;
+  std::vector<std::unique_ptr<FrameNode>> frames_;
+  // 被 Scan 标记的 evictable frames，按标记时间排序，最先淘汰
+  std::set<std::pair<size_t, frame_id_t>> scan_set_;
+  // 访问次数小于 k 的 evictable frames，按第一次访问时间排序（FIFO），+inf 的 k-distance
+  std::set<std::pair<size_t, frame_id_t>> history_set_;
+  // 访问次数达到 k 的 evictable frames，按倒数第 k 次访问时间排序，begin() 即 k-distance 最大的 frame
+  std::set<std::pair<size_t, frame_id_t>> cache_set_;
+  std::mutex latch_;
 };
 
 }  // namespace bustub
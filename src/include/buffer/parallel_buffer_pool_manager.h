@@ -0,0 +1,121 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// parallel_buffer_pool_manager.h
+//
+// Identification: src/include/buffer/parallel_buffer_pool_manager.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/buffer_pool_manager_instance.h"
+#include "common/config.h"
+#include "recovery/log_manager.h"
+#include "storage/disk/disk_manager.h"
+#include "storage/page/page.h"
+
+namespace bustub {
+
+/**
+ * ParallelBufferPoolManager shards pages across several BufferPoolManagerInstances.
+ *
+ * A page always lives in the instance `page_id % num_instances`, so every instance keeps its own latch, free list,
+ * replacer and page table, and threads touching different shards never contend with each other.
+ */
+class ParallelBufferPoolManager : public BufferPoolManager {
+ public:
+  /**
+   * @brief Creates a new ParallelBufferPoolManager.
+   * @param num_instances the number of individual BufferPoolManagerInstances to store
+   * @param pool_size the pool size of each BufferPoolManagerInstance
+   * @param disk_manager the disk manager
+   * @param replacer_k the lookback constant k for the LRU-K replacer of every instance
+   * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param replacer_type the replacement policy of every instance
+   */
+  ParallelBufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
+                            size_t replacer_k = LRUK_REPLACER_K, LogManager *log_manager = nullptr,
+                            ReplacerType replacer_type = ReplacerType::LRUK);
+
+  /**
+   * @brief Destroy an existing ParallelBufferPoolManager.
+   */
+  ~ParallelBufferPoolManager() override;
+
+  /** @brief Return the size (number of frames) of all the buffer pools together. */
+  auto GetPoolSize() -> size_t override;
+
+  /** @brief Return the sum of the stats snapshots of all the instances. */
+  auto GetStats() -> BufferPoolStats override;
+
+  /**
+   * @brief Start the background writer of every instance.
+   * @param dirty_high_water_mark number of dirty frames of the whole pool that wakes the writers up early, split evenly
+   * over the instances
+   * @param interval how long the writers sleep between two rounds
+   */
+  void StartBackgroundFlusher(size_t dirty_high_water_mark,
+                              std::chrono::milliseconds interval = std::chrono::milliseconds(50));
+
+  /** @brief Stop the background writer of every instance. */
+  void StopBackgroundFlusher();
+
+  /** @brief Return the number of BufferPoolManagerInstances. */
+  auto GetNumInstances() const -> size_t { return num_instances_; }
+
+  /**
+   * @brief Get the BufferPoolManagerInstance that is responsible for handling the given page id.
+   * @param page_id id of page
+   * @return pointer to the BufferPoolManagerInstance responsible for handling given page id
+   */
+  auto GetBufferPoolManager(page_id_t page_id) -> BufferPoolManagerInstance *;
+
+ protected:
+  /**
+   * @brief Create a new page. Instances are tried round-robin starting at `start_index_`, so new pages spread over
+   * all shards and a shard whose frames are all pinned does not block allocation.
+   *
+   * @param[out] page_id id of created page
+   * @return nullptr if no instance could create a new page, otherwise pointer to new page
+   */
+  auto NewPgImp(page_id_t *page_id) -> Page * override;
+
+  /** @brief Fetch the requested page from the responsible instance. */
+  auto FetchPgImp(page_id_t page_id, AccessType access_type) -> Page * override;
+
+  /** @brief Unpin the target page in the responsible instance. */
+  auto UnpinPgImp(page_id_t page_id, bool is_dirty) -> bool override;
+
+  /** @brief Flush the target page through the responsible instance. */
+  auto FlushPgImp(page_id_t page_id) -> bool override;
+
+  /** @brief Flush all the pages of every instance to disk. */
+  void FlushAllPgsImp() override;
+
+  /** @brief Prefetch every page through the instance responsible for it. */
+  void PrefetchPgsImp(page_id_t first_page_id, size_t count) override;
+
+  /** @brief Delete a page from the responsible instance. */
+  auto DeletePgImp(page_id_t page_id) -> bool override;
+
+ private:
+  /** Number of BufferPoolManagerInstances */
+  const size_t num_instances_;
+  /** Pool size of each BufferPoolManagerInstance */
+  const size_t pool_size_;
+  /** The instances, instance i owns all page ids with page_id % num_instances_ == i */
+  std::vector<BufferPoolManagerInstance *> instances_;
+  /** The instance NewPgImp starts from next time */
+  std::atomic<size_t> start_index_{0};
+};
+
+}  // namespace bustub
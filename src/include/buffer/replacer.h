@@ -0,0 +1,94 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// replacer.h
+//
+// Identification: src/include/buffer/replacer.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * How a page is going to be used by the caller of FetchPage(), passed on to the replacer as a hint.
+ * - Unknown: no information, the access is recorded as usual.
+ * - Lookup / Index: point lookups and index traversals. The frame is treated as hot for the rest of its residency.
+ * - Scan: sequential scans. A frame that is not hot is marked cheap to evict so that a large scan only recycles its
+ *   own frames instead of flushing the hot set; the scan access itself does not count towards the frame's history.
+ */
+enum class AccessType { Unknown = 0, Lookup, Scan, Index };
+
+/** The replacement policies a BufferPoolManagerInstance can be built with. */
+enum class ReplacerType { LRUK = 0, Clock, TwoQueue, ARC };
+
+/**
+ * Replacer is an abstract class that tracks page usage of the frames of a buffer pool.
+ *
+ * A frame starts being tracked (and is evictable) at its first RecordAccess() after construction, Evict() or Remove().
+ * The buffer pool pins a frame with SetEvictable(frame_id, false) and releases it with SetEvictable(frame_id, true).
+ * Every policy evicts evictable frames marked by AccessType::Scan before any other frame.
+ */
+class Replacer {
+ public:
+  Replacer() = default;
+  virtual ~Replacer() = default;
+
+  /**
+   * @brief Pick an evictable frame according to the policy, stop tracking it and return it.
+   * @param[out] frame_id id of frame that is evicted.
+   * @return true if a frame is evicted successfully, false if no frames can be evicted.
+   */
+  virtual auto Evict(frame_id_t *frame_id) -> bool = 0;
+
+  /**
+   * @brief Record the event that the given frame id is accessed at current timestamp.
+   * @param frame_id id of frame that received a new access.
+   * @param access_type type of access that was received, see AccessType
+   */
+  virtual void RecordAccess(frame_id_t frame_id, AccessType access_type = AccessType::Unknown) = 0;
+
+  /**
+   * @brief Toggle whether a frame is evictable or non-evictable, and update the replacer's size accordingly.
+   * @param frame_id id of frame whose 'evictable' status will be modified
+   * @param set_evictable whether the given frame is evictable or not
+   */
+  virtual void SetEvictable(frame_id_t frame_id, bool set_evictable) = 0;
+
+  /**
+   * @brief Stop tracking an evictable frame, e.g. because its page was deleted. Untracked frames are ignored.
+   * @param frame_id id of frame to be removed
+   */
+  virtual void Remove(frame_id_t frame_id) = 0;
+
+  /** @return the number of evictable frames */
+  virtual auto Size() -> size_t = 0;
+
+  /**
+   * @brief Tell the replacer which page is about to be loaded into frame_id. Called before the RecordAccess() that
+   * starts tracking the frame. Policies that remember recently evicted pages (2Q, ARC) key their ghost lists on it;
+   * the others can ignore it.
+   * @param frame_id id of the frame
+   * @param page_id id of the page now held by the frame
+   */
+  virtual void BindPage(frame_id_t frame_id, page_id_t page_id) {}
+};
+
+/**
+ * @brief Create a replacer of the given type.
+ * @param replacer_type which policy to use
+ * @param num_frames the maximum number of frames the replacer will be required to store
+ * @param k the lookback constant of LRU-K, ignored by the other policies
+ * @return a heap-allocated replacer owned by the caller
+ */
+auto CreateReplacer(ReplacerType replacer_type, size_t num_frames, size_t k) -> Replacer *;
+
+}  // namespace bustub
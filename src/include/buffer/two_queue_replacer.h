@@ -0,0 +1,110 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// two_queue_replacer.h
+//
+// Identification: src/include/buffer/two_queue_replacer.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+/**
+ * TwoQueueReplacer implements the full 2Q replacement policy (Johnson & Shasha, VLDB'94).
+ *
+ * A page loaded for the first time enters the FIFO queue A1in. Re-references while it is in A1in are treated as
+ * correlated and ignored. When a page is evicted from A1in its id is remembered in the ghost queue A1out, and a page
+ * that comes back while it is still in A1out is considered hot and goes to the LRU queue Am. A one-pass scan therefore
+ * only ever cycles through A1in and cannot push the hot pages out of Am.
+ *
+ * Frames marked by a Scan access are kept in a separate FIFO that is drained first, and their pages are not remembered
+ * in A1out, so a hinted scan does not even disturb A1in.
+ *
+ * Only evictable frames are linked in the queues, so Evict() takes the head of a queue in O(1). A pinned frame keeps
+ * its queue but is unlinked, and goes back to the tail of that queue when it is unpinned.
+ */
+class TwoQueueReplacer : public Replacer {
+ public:
+  /**
+   * @brief Create a new TwoQueueReplacer.
+   * @param num_frames the maximum number of frames the TwoQueueReplacer will be required to store
+   */
+  explicit TwoQueueReplacer(size_t num_frames);
+
+  DISALLOW_COPY_AND_MOVE(TwoQueueReplacer);
+
+  ~TwoQueueReplacer() override = default;
+
+  auto Evict(frame_id_t *frame_id) -> bool override;
+
+  void RecordAccess(frame_id_t frame_id, AccessType access_type = AccessType::Unknown) override;
+
+  void SetEvictable(frame_id_t frame_id, bool set_evictable) override;
+
+  void Remove(frame_id_t frame_id) override;
+
+  auto Size() -> size_t override;
+
+  void BindPage(frame_id_t frame_id, page_id_t page_id) override;
+
+ private:
+  enum class Queue { None = 0, Scan, A1in, Am };
+
+  struct FrameState {
+    Queue queue_{Queue::None};
+    bool evictable_{false};
+    bool hot_{false};
+    page_id_t page_id_{INVALID_PAGE_ID};
+    std::list<frame_id_t>::iterator iter_;
+  };
+
+  // frame 所在的队列
+  auto QueueOf(Queue queue) -> std::list<frame_id_t> & {
+    return queue == Queue::Scan ? scan_ : queue == Queue::A1in ? a1in_ : am_;
+  }
+  // 把 frame 移到 queue 的尾部，pin 住的 frame 只改变所属队列，调用前需持有 latch_
+  void MoveTo(frame_id_t frame_id, Queue queue);
+
+  // 将被淘汰的 page id 放进 A1out，调用前需持有 latch_
+  void RememberEvicted(page_id_t page_id);
+
+  size_t replacer_size_;
+  // A1in 的目标大小，超过时优先从 A1in 淘汰
+  size_t kin_;
+  // A1out 最多记住的 page 数量
+  size_t kout_;
+  // 当前 evictable frames 数量
+  std::atomic<size_t> curr_size_{0};
+  std::vector<FrameState> frames_;
+  // 以下队列只包含 evictable frames
+  // 被 Scan 标记的 frames，FIFO，最先淘汰
+  std::list<frame_id_t> scan_;
+  // FIFO，头部最早进入
+  std::list<frame_id_t> a1in_;
+  // 属于 A1in 的 frames 数量，包括 pin 住而不在 a1in_ 中的
+  size_t a1in_size_{0};
+  // LRU，头部最久未访问
+  std::list<frame_id_t> am_;
+  // ghost FIFO，只保存 page id
+  std::list<page_id_t> a1out_;
+  std::unordered_map<page_id_t, std::list<page_id_t>::iterator> a1out_map_;
+  std::mutex latch_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,160 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// table_statistics.h
+//
+// Identification: src/include/catalog/table_statistics.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "catalog/catalog.h"
+#include "catalog/schema.h"
+#include "common/config.h"
+#include "concurrency/transaction.h"
+#include "storage/table/tuple.h"
+#include "type/value.h"
+
+namespace bustub {
+
+/** HyperLogLog sketch of the number of distinct values of a column. */
+class HyperLogLog {
+ public:
+  void Add(const Value &value);
+
+  /** @return the estimated number of distinct values added */
+  auto Estimate() const -> double;
+
+ private:
+  /** 2^HLL_PRECISION registers, about 1.6% standard error */
+  static constexpr uint32_t HLL_PRECISION = 12;
+  static constexpr uint32_t HLL_REGISTERS = 1U << HLL_PRECISION;
+
+  std::array<uint8_t, HLL_REGISTERS> registers_{};
+};
+
+/** Statistics of one column: NULLs, distinct values and an equi-depth histogram of a sample of the values. */
+struct ColumnStatistics {
+  /** Number of rows where the column is NULL */
+  double null_rows_{0};
+  HyperLogLog distinct_;
+  /** Smallest sampled value, and the upper bound of each bucket, which all hold the same number of sampled values */
+  std::optional<Value> min_;
+  std::vector<Value> bounds_;
+};
+
+/**
+ * TableStatistics holds the row count and per-column statistics of a table, built by StatisticsCatalog::Analyze().
+ *
+ * The row and NULL counts and the distinct sketches are kept up to date by the insert and delete executors. The
+ * histograms are not, they only give the fraction of the values in a range, which changes slowly; they are rebuilt by
+ * the next Analyze(), which runs once enough rows have changed (see IsStale()).
+ */
+class TableStatistics {
+ public:
+  explicit TableStatistics(std::vector<ColumnStatistics> columns) : columns_(std::move(columns)) {}
+
+  auto GetRows() const -> double;
+
+  /** @return the estimated number of distinct non-NULL values of column `col_idx` */
+  auto GetDistinct(uint32_t col_idx) const -> double;
+
+  /** @return the fraction of the rows where column `col_idx` is NULL */
+  auto GetNullFraction(uint32_t col_idx) const -> double;
+
+  /** @return the estimated fraction of the rows where column `col_idx` equals `value` */
+  auto EstimateEqual(uint32_t col_idx, const Value &value) const -> double;
+
+  /**
+   * @return the estimated fraction of the rows where column `col_idx` is between `low` and `high`, whether the bounds
+   * are included or not; a missing bound leaves that side open
+   */
+  auto EstimateRange(uint32_t col_idx, const std::optional<Value> &low, const std::optional<Value> &high) const
+      -> double;
+
+  /** Add the rows inserted into the table. */
+  void RecordInserts(const Schema &schema, const std::vector<const Tuple *> &tuples);
+
+  /** Remove a row deleted from the table, only from the row and NULL counts. */
+  void RecordDelete(const Schema &schema, const Tuple &tuple);
+
+  /**
+   * @return `true` once more than AUTO_ANALYZE_BASE_ROWS plus AUTO_ANALYZE_FRACTION of the rows seen by Analyze() have
+   * been inserted or deleted since, so the histograms may no longer describe the table
+   */
+  auto IsStale() const -> bool;
+
+ private:
+  friend class StatisticsCatalog;
+
+  /** 直方图中小于 value 的 non-NULL 值的比例 */
+  auto FractionBelow(const ColumnStatistics &column, const Value &value) const -> double;
+
+  static constexpr double AUTO_ANALYZE_BASE_ROWS = 50;
+  static constexpr double AUTO_ANALYZE_FRACTION = 0.1;
+
+  double rows_{0};
+  /** Rows counted by Analyze(), and rows inserted or deleted after it */
+  double analyzed_rows_{0};
+  double modified_rows_{0};
+  std::vector<ColumnStatistics> columns_;
+  mutable std::mutex latch_;
+};
+
+/**
+ * StatisticsCatalog keeps the TableStatistics of the tables of each Catalog, which has no place for them.
+ *
+ * ANALYZE runs Analyze() on a table: it scans the whole TableHeap once, counting rows and NULLs and feeding every
+ * value to the distinct sketches, and builds the histograms from a reservoir sample of STATS_SAMPLE_ROWS rows. The
+ * insert and delete executors run AnalyzeIfStale() on their table when they finish, so a table gets statistics when
+ * it is first loaded and they are rebuilt as it changes. A table that was never analyzed has no statistics, and the
+ * optimizer falls back to its defaults for it.
+ */
+class StatisticsCatalog {
+ public:
+  /**
+   * Build the statistics of a table and replace the old ones. The scan takes no locks, the statistics are
+   * approximate anyway.
+   */
+  static void Analyze(Catalog *catalog, const TableInfo *table_info, Transaction *txn);
+
+  /**
+   * Analyze() a table that has no statistics yet, or whose statistics are stale (see TableStatistics::IsStale()).
+   * The full scan is paid again only after a fraction of the table has changed.
+   */
+  static void AnalyzeIfStale(Catalog *catalog, const TableInfo *table_info, Transaction *txn);
+
+  /** Analyze() every table of the catalog. */
+  static void AnalyzeAll(Catalog *catalog, Transaction *txn);
+
+  /** @return the statistics of table `oid`, nullptr if it has not been analyzed */
+  static auto GetTableStatistics(const Catalog *catalog, table_oid_t oid) -> std::shared_ptr<TableStatistics>;
+
+  /** Forget the statistics of every table of the catalog, e.g. before it is destroyed. */
+  static void Clear(const Catalog *catalog);
+
+ private:
+  /** Number of rows sampled for the histograms, and number of buckets of each histogram */
+  static constexpr size_t STATS_SAMPLE_ROWS = 30000;
+  static constexpr size_t STATS_HISTOGRAM_BUCKETS = 64;
+
+  static std::unordered_map<const Catalog *, std::unordered_map<table_oid_t, std::shared_ptr<TableStatistics>>>
+      tables_;
+  static std::shared_mutex tables_latch_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,41 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// profile_counters.h
+//
+// Identification: src/include/common/profile_counters.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+
+namespace bustub {
+
+/**
+ * Running totals of the work the calling thread did in the buffer pool and the lock manager. They are always counted,
+ * a thread-local increment each, and EXPLAIN ANALYZE reads them before and after every executor call to attribute the
+ * difference to that executor.
+ */
+struct ThreadProfileCounters {
+  /** FetchPage() calls that found the page in the pool */
+  uint64_t bpm_hits_{0};
+  /** FetchPage() calls that read the page from disk */
+  uint64_t bpm_misses_{0};
+  /** Lock requests that could not be granted right away */
+  uint64_t lock_waits_{0};
+  /** Total time spent waiting for those locks */
+  uint64_t lock_wait_ns_{0};
+
+  /** @return the counters of the calling thread */
+  static auto Get() -> ThreadProfileCounters & {
+    static thread_local ThreadProfileCounters counters;
+    return counters;
+  }
+};
+
+}  // namespace bustub
@@ -13,13 +13,16 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <functional>
 #include <list>
-#include <map>
 #include <memory>
 #include <mutex>  // NOLINT
-#include <set>
 #include <string>
+#include <thread>  // NOLINT
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -40,6 +43,9 @@ class LockManager {
  public:
   enum class LockMode { SHARED, EXCLUSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED_INTENTION_EXCLUSIVE };
 
+  /** How deadlocks are handled, see [DEADLOCK_NOTE] */
+  enum class DeadlockPolicy { DETECTION, WAIT_DIE };
+
   /**
    * Structure to hold a lock request.
    * This could be a lock request on a table OR a row.
@@ -62,14 +68,14 @@ class LockManager {
     RID rid_;
     /** Whether the lock has been granted or not */
     bool granted_{false};
+    /** For notifying the txn waiting on this request, with the latch_ of its queue */
+    std::condition_variable cv_;
   };
 
   class LockRequestQueue {
    public:
     /** List of lock requests for the same resource (table or row) */
     std::list<std::shared_ptr<LockRequest>> request_queue_;
-    /** For notifying blocked transactions on this rid */
-    std::condition_variable cv_;
     /** txn_id of an upgrading transaction (if any) */
     txn_id_t upgrading_ = INVALID_TXN_ID;
     /** coordination */
@@ -79,16 +85,9 @@ class LockManager {
   /**
    * Creates a new lock manager configured for the deadlock detection policy.
    */
-  LockManager() {
-    enable_cycle_detection_ = true;
-    cycle_detection_thread_ = new std::thread(&LockManager::RunCycleDetection, this);
-  }
+  LockManager();
 
-  ~LockManager() {
-    enable_cycle_detection_ = false;
-    cycle_detection_thread_->join();
-    delete cycle_detection_thread_;
-  }
+  ~LockManager();
 
   /**
    * [LOCK_NOTE]
@@ -235,6 +234,28 @@ class LockManager {
    */
   auto UnlockTable(Transaction *txn, const table_oid_t &oid) -> bool;
 
+  /**
+   * Acquire or upgrade a lock on a table only if it can be granted right away: no other transaction holds an
+   * incompatible lock, waits for the table or is upgrading on it. Never blocks, aborts or throws.
+   *
+   * @param txn the transaction requesting the lock
+   * @param lock_mode the lock mode for the requested lock
+   * @param oid the table_oid_t of the table to be locked in lock_mode
+   * @return true if the txn now holds lock_mode on the table, false if nothing changed
+   */
+  auto TryLockTable(Transaction *txn, LockMode lock_mode, const table_oid_t &oid) -> bool;
+
+  /**
+   * Replace the lock held on a table by a weaker one it can be upgraded from, e.g. S by IS, and wake up the waiters.
+   * Releasing the stronger lock moves the transaction to SHRINKING as UnlockTable() would.
+   *
+   * @param txn the transaction holding the lock
+   * @param lock_mode the weaker lock mode to keep
+   * @param oid the table_oid_t of the locked table
+   * @return true if the lock was downgraded, false if the txn holds no lock on the table stronger than lock_mode
+   */
+  auto DowngradeTable(Transaction *txn, LockMode lock_mode, const table_oid_t &oid) -> bool;
+
   /**
    * Acquire a lock on rid in the given lock_mode.
    * If the transaction already holds a lock on the row, upgrade the lock
@@ -252,6 +273,14 @@ class LockManager {
    */
   auto LockRow(Transaction *txn, LockMode lock_mode, const table_oid_t &oid, const RID &rid) -> bool;
 
+  /**
+   * Acquire a lock on a batch of rows of the same table, as LockRow() on each of them in order. The checks of the
+   * transaction and its table lock are made once, rows that no transaction has locked yet (e.g. rows just inserted) are
+   * granted with one latch of each lock table shard, and escalation is checked once at the end.
+   * @return true if every row was locked, false as soon as one of them was not
+   */
+  auto LockRows(Transaction *txn, LockMode lock_mode, const table_oid_t &oid, const std::vector<RID> &rids) -> bool;
+
   /**
    * Release the lock held on a row by the transaction.
    *
@@ -267,6 +296,39 @@ class LockManager {
    */
   auto UnlockRow(Transaction *txn, const table_oid_t &oid, const RID &rid) -> bool;
 
+  /**
+   * [ESCALATION_NOTE]
+   *
+   * Once a transaction holds more than `rows` row locks on one table, its table lock is upgraded to cover them all:
+   * IS to S, IX to SIX, or to X when one of the row locks is X, and the row locks are released. The upgrade is only
+   * made when TryLockTable() can grant it right away; otherwise it is tried again every `rows` more row locks.
+   * Row locks asked for later on that table are granted by the table lock without a LockRequest, and unlocking a row
+   * whose lock was released this way succeeds. 0 disables escalation, which is the default.
+   */
+  void SetEscalationThreshold(size_t rows) { escalation_threshold_.store(rows, std::memory_order_relaxed); }
+
+  /**
+   * [DEADLOCK_NOTE]
+   *
+   * DETECTION (default):
+   *    The waits-for graph only holds the transactions that are blocked. A blocked request adds an edge to every
+   *    transaction ahead of it in the queue that it waits for: an incompatible request, or one that is still waiting
+   *    itself. Its edges are kept up to date as the queue changes and removed once it stops waiting. Adding edges is
+   *    followed by a search for a cycle through the blocked transaction, so a deadlock is broken as soon as it forms:
+   *    the youngest transaction of the cycle is set ABORTED and woken up, and its lock request returns false.
+   *    RunCycleDetection() only checks the graph for cycles left by the Graph API.
+   *
+   * WAIT_DIE:
+   *    No graph is kept. A request that would wait for an older transaction (a smaller txn id) aborts its own
+   *    transaction and returns false instead; only older transactions wait for younger ones.
+   *
+   * WAKEUPS:
+   *    A blocked request waits on its own condition variable. When a queue changes, only the waiting requests at the
+   *    front of the queue that can now be granted are woken up, in queue order; under DETECTION the edges of the
+   *    others are updated in place. An upgrade under WAIT_DIE wakes every waiter, to check it again.
+   */
+  void SetDeadlockPolicy(DeadlockPolicy policy) { deadlock_policy_.store(policy, std::memory_order_relaxed); }
+
   /*** Graph API ***/
 
   /**
@@ -324,6 +386,8 @@ class LockManager {
 
   /** cur_lock_mode -> req_lock_mode，不符合条件则 abort */
   auto CanUpgradeLock(Transaction *txn, const LockMode &cur_lock_mode, const LockMode &req_lock_mode) -> bool;
+  /** 与 CanUpgradeLock 相同，但不 abort txn */
+  static auto IsUpgrade(const LockMode &cur_lock_mode, const LockMode &req_lock_mode) -> bool;
 
   /** txn 内部锁的更改 */
   void AddTableLockOnTxn(Transaction *txn, const LockMode &lock_mode, const table_oid_t &oid);
@@ -331,6 +395,13 @@ class LockManager {
   void AddRowLockOnTxn(Transaction *txn, const LockMode &lock_mode, const table_oid_t &oid, const RID &rid);
   void RemoveRowLockOnTxn(Transaction *txn, const LockMode &lock_mode, const table_oid_t &oid, const RID &rid);
 
+  /** 行锁的获取，LockRow 之后再检查是否需要 escalation */
+  auto AcquireRowLock(Transaction *txn, LockMode lock_mode, const table_oid_t &oid, const RID &rid) -> bool;
+  /** 见 [ESCALATION_NOTE] */
+  void MaybeEscalate(Transaction *txn, const table_oid_t &oid);
+  /** txn 在该 table 上的 row lock 是否已经 escalate 为 table lock */
+  auto IsEscalated(txn_id_t txn_id, const table_oid_t &oid) -> bool;
+
   /** 是否可以 grant */
   auto CanGranted(const std::shared_ptr<LockRequest> &lock_request,
                   const std::shared_ptr<LockRequestQueue> &lock_request_queue, const bool &output = true) -> bool;
@@ -342,34 +413,102 @@ class LockManager {
   void CheckUnlockTransactionState(const TransactionState &transaction_state, const IsolationLevel &isolation_level,
                                    const LockMode &lock_mode, Transaction *txn);
 
-  /** dfs 检查是否有 cycle */
-  auto DFSHasCyCleL(std::map<txn_id_t, std::map<txn_id_t, bool>> &vis, std::set<txn_id_t> &has,
-                    const txn_id_t &now_txn_id, txn_id_t *txn_id) -> bool;
+  /**
+   * 从 start 开始 dfs，找到 cycle 时 txn_id 为 cycle 中最大的 txn id。
+   * done 中的 txn 已经检查过，不在任何 cycle 中
+   */
+  auto FindCycle(txn_id_t start, std::unordered_set<txn_id_t> *done, txn_id_t *txn_id) -> bool;
 
   /** RunCycleDetection 内部执行的逻辑 */
   void Detection();
 
-  /** 根据 lock_request_queue 的 txn 建立 edge */
-  void AddEdgeFromLRQ(const std::shared_ptr<LockRequestQueue> &lock_request_queue);
+  /** 等待 lock_request 可以 grant 或 txn aborted，lock 为 queue 的 latch */
+  void WaitForGrant(Transaction *txn, const std::shared_ptr<LockRequest> &lock_request,
+                    const std::shared_ptr<LockRequestQueue> &lock_request_queue, std::unique_lock<std::mutex> *lock);
+
+  /** lock_request 在 queue 中等待的其它 txn，从小到大 */
+  auto BlockersOf(const std::shared_ptr<LockRequest> &lock_request,
+                  const std::shared_ptr<LockRequestQueue> &lock_request_queue) -> std::vector<txn_id_t>;
+
+  /**
+   * txn 在 queue 上等待 blockers，按 deadlock policy 更新 waits-for graph。
+   * @return 需要 abort 的 txn，victim_queue 为它等待的 queue；不需要 abort 则为 INVALID_TXN_ID
+   */
+  auto AddWaitsFor(txn_id_t txn_id, std::vector<txn_id_t> blockers,
+                   const std::shared_ptr<LockRequestQueue> &lock_request_queue,
+                   std::shared_ptr<LockRequestQueue> *victim_queue) -> txn_id_t;
+
+  /** txn 不再等待，移除它的 edge */
+  void RemoveWaitsFor(txn_id_t txn_id);
+
+  /**
+   * queue 变化后，唤醒前面可以 grant 的等待者，DETECTION 下更新其它等待者的 edge；
+   * wake_all 时唤醒所有等待者。调用时持有 queue 的 latch
+   */
+  void NotifyWaiters(const std::shared_ptr<LockRequestQueue> &lock_request_queue, bool wake_all = false);
+
+  /** abort 在 queue 上等待的 txn 并唤醒它，调用时不能持有任何 queue 的 latch */
+  void AbortWaiter(txn_id_t txn_id, const std::shared_ptr<LockRequestQueue> &lock_request_queue);
 
-  /** 移除 lock_request_queue 中 txn id 已 granted 的 lock_request */
-  void RemoveLQFromLRQ(std::shared_ptr<LockRequestQueue> &lock_request_queue, const txn_id_t &txn_id);
+  /**
+   * One shard of a lock table: the queues of the resources that hash to it, and the idle queues kept for reuse.
+   * A queue is only taken out of map_ or put into it under latch_, so a thread that copied the shared_ptr out of
+   * map_ keeps the queue in the map until it drops the copy.
+   */
+  template <class Key>
+  struct LockTableShard {
+    std::unordered_map<Key, std::shared_ptr<LockRequestQueue>> map_;
+    std::vector<std::shared_ptr<LockRequestQueue>> free_queues_;
+    /** Coordination */
+    std::mutex latch_;
+  };
+
+  static constexpr size_t LOCK_TABLE_SHARD_BITS = 6;
+  static constexpr size_t LOCK_TABLE_SHARDS = 1 << LOCK_TABLE_SHARD_BITS;
+  /** 每个 shard 最多缓存的空闲 queue 数 */
+  static constexpr size_t LOCK_QUEUE_POOL_SIZE = 256;
+
+  template <class Key>
+  using ShardedLockMap = std::array<LockTableShard<Key>, LOCK_TABLE_SHARDS>;
+
+  /** @return the shard of `key`, by the high bits of its mixed hash */
+  template <class Key>
+  static auto ShardOf(ShardedLockMap<Key> *lock_map, const Key &key) -> LockTableShard<Key> & {
+    auto hash = static_cast<uint64_t>(std::hash<Key>()(key)) * 0x9E3779B97F4A7C15ULL;
+    return (*lock_map)[hash >> (64 - LOCK_TABLE_SHARD_BITS)];
+  }
+
+  /** @return an empty queue, from the shard's pool if it has one; the caller holds shard.latch_ */
+  template <class Key>
+  static auto NewQueue(LockTableShard<Key> *shard) -> std::shared_ptr<LockRequestQueue>;
+
+  /**
+   * Take the queue of `key` out of the shard and back to its pool, if it has no request left and no other thread
+   * holds it. `queue` is the caller's copy, with its latch released.
+   */
+  template <class Key>
+  static void RecycleQueue(LockTableShard<Key> *shard, const Key &key, std::shared_ptr<LockRequestQueue> queue);
 
   /** Fall 2022 */
-  /** Structure that holds lock requests for a given table oid */
-  std::unordered_map<table_oid_t, std::shared_ptr<LockRequestQueue>> table_lock_map_;
-  /** Coordination */
-  std::mutex table_lock_map_latch_;
+  /** Structure that holds lock requests for a given table oid, sharded by oid */
+  ShardedLockMap<table_oid_t> table_lock_shards_;
 
-  /** Structure that holds lock requests for a given RID */
-  std::unordered_map<RID, std::shared_ptr<LockRequestQueue>> row_lock_map_;
-  /** Coordination */
-  std::mutex row_lock_map_latch_;
+  /** Structure that holds lock requests for a given RID, sharded by RID */
+  ShardedLockMap<RID> row_lock_shards_;
 
   std::atomic<bool> enable_cycle_detection_;
   std::thread *cycle_detection_thread_;
   /** Waits-for graph representation. */
   std::unordered_map<txn_id_t, std::vector<txn_id_t>> waits_for_;
+  /** 每个等待中的 txn 所在的 queue，用于唤醒 victim */
+  std::unordered_map<txn_id_t, std::shared_ptr<LockRequestQueue>> waiting_on_;
+  std::atomic<DeadlockPolicy> deadlock_policy_{DeadlockPolicy::DETECTION};
+  /** 默认不 escalate，由 SetEscalationThreshold() 打开 */
+  static constexpr size_t LOCK_ESCALATION_DEFAULT_THRESHOLD = 0;
+  std::atomic<size_t> escalation_threshold_{LOCK_ESCALATION_DEFAULT_THRESHOLD};
+  /** 每个 txn 中 row lock 已经 escalate 的 table，UnlockTable 时移除 */
+  std::unordered_map<txn_id_t, std::unordered_set<table_oid_t>> escalated_tables_;
+  std::mutex escalation_latch_;
   std::mutex waits_for_latch_;
 };
 
@@ -0,0 +1,119 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_manager.h
+//
+// Identification: src/include/concurrency/transaction_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <shared_mutex>  // NOLINT
+#include <unordered_map>
+#include <unordered_set>
+
+#include "common/config.h"
+#include "common/rwlatch.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction.h"
+#include "concurrency/version_store.h"
+#include "recovery/log_manager.h"
+#include "storage/index/index_vacuum.h"
+
+namespace bustub {
+class LockManager;
+
+/**
+ * TransactionManager keeps track of all the transactions running in the system.
+ *
+ * It also owns the state that lives as long as the transactions it tracks: the old row versions of MVCC readers (see
+ * [MVCC_NOTE]) and the index entries of deleted rows waiting for the vacuum (see IndexVacuum). Both only read the
+ * state of the transactions through GetTransaction(), so the lock manager takes no part in them.
+ */
+class TransactionManager {
+ public:
+  explicit TransactionManager(LockManager *lock_manager, LogManager *log_manager = nullptr)
+      : lock_manager_(lock_manager), log_manager_(log_manager) {}
+
+  ~TransactionManager() = default;
+
+  /**
+   * Begins a new transaction.
+   * @param txn an optional transaction object to be initialized, otherwise a new transaction is created.
+   * @param isolation_level an optional isolation level of the transaction.
+   * @return an initialized transaction
+   */
+  auto Begin(Transaction *txn = nullptr, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ)
+      -> Transaction *;
+
+  /**
+   * Commits a transaction.
+   * @param txn the transaction to commit
+   */
+  void Commit(Transaction *txn);
+
+  /**
+   * Aborts a transaction
+   * @param txn the transaction to abort
+   */
+  void Abort(Transaction *txn);
+
+  /**
+   * Global list of running transactions
+   */
+
+  /** The transaction map is a global list of all the running transactions in the system. */
+  static std::unordered_map<txn_id_t, Transaction *> txn_map;
+  static std::shared_mutex txn_map_mutex;
+
+  /**
+   * Locates and returns the transaction with the given transaction ID.
+   * @param txn_id the id of the transaction to be found, it must exist!
+   * @return the transaction with the given transaction id
+   */
+  static auto GetTransaction(txn_id_t txn_id) -> Transaction * {
+    TransactionManager::txn_map_mutex.lock_shared();
+    assert(TransactionManager::txn_map.find(txn_id) != TransactionManager::txn_map.end());
+    auto *res = TransactionManager::txn_map[txn_id];
+    assert(res != nullptr);
+    TransactionManager::txn_map_mutex.unlock_shared();
+    return res;
+  }
+
+  /** Prevents all transactions from performing operations, used for checkpointing. */
+  void BlockAllTransactions();
+
+  /** Resumes all transactions, used for checkpointing. */
+  void ResumeTransactions();
+
+  /** @return the old row versions that snapshot readers read instead of locking, see [MVCC_NOTE] */
+  auto GetVersionStore() -> VersionStore * { return &version_store_; }
+
+  /** @return the deferred removal of the index entries of deleted rows, see IndexVacuum */
+  auto GetIndexVacuum() -> IndexVacuum * { return &index_vacuum_; }
+
+ private:
+  /**
+   * Releases all the locks held by the given transaction.
+   * @param txn the transaction whose locks should be released
+   */
+  void ReleaseLocks(Transaction *txn);
+
+  std::atomic<txn_id_t> next_txn_id_{0};
+  LockManager *lock_manager_ __attribute__((__unused__));
+  LogManager *log_manager_ __attribute__((__unused__));
+
+  /** The global transaction latch is used for checkpointing. */
+  ReaderWriterLatch global_txn_latch_;
+
+  VersionStore version_store_;
+  IndexVacuum index_vacuum_;
+};
+
+}  // namespace bustub
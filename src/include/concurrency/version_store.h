@@ -0,0 +1,188 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.h
+//
+// Identification: src/include/concurrency/version_store.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "common/config.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+class TableHeap;
+
+/** The set of row versions a reader sees, see [MVCC_NOTE] */
+struct Snapshot {
+  /** The txn reading in the snapshot, which always sees its own writes */
+  txn_id_t txn_id_;
+  /** Writers that first wrote at or after this timestamp are not seen */
+  uint64_t read_ts_;
+  /** Writers that had written but not finished when the snapshot was taken, are not seen either */
+  std::unordered_set<txn_id_t> active_;
+};
+
+/**
+ * VersionStore keeps the old versions of the rows being written, so that readers read a snapshot without locks.
+ *
+ * [MVCC_NOTE]
+ *
+ * The table heap holds the newest version of every row, as before. A writer saves the version it replaces into the
+ * row's undo chain before every insert (the row did not exist), delete or update, under its X row lock. Each entry
+ * of the chain, newest first, holds the writer and the timestamp of its first write.
+ *
+ * A reader in a snapshot reads the heap, then walks the chain back past the entries of writers it does not see: the
+ * ones that are not COMMITTED, started writing after the snapshot, or were still running when it was taken. The
+ * version before the first entry it sees is the one it reads; none when the row did not exist. A row that is deleted
+ * in the heap is still read from its chain, so a scan also visits the versioned slots of each page.
+ *
+ * A REPEATABLE_READ txn takes its snapshot at its first read and keeps it, a READ_COMMITTED one takes a new snapshot
+ * at every scan. Readers take no table or row locks, and writers still take IX and X locks as without MVCC. Under
+ * REPEATABLE_READ, writing a row whose newest version the snapshot does not see aborts the writer.
+ *
+ * Index entries are removed by deletes as before, so an index scan cannot find a row deleted after its snapshot.
+ *
+ * Entries are removed every VERSION_GC_INTERVAL writes, once their writer is seen by every live snapshot, together
+ * with every older entry; entries of aborted writers once the abort has been rolled back.
+ */
+class VersionStore {
+ public:
+  /**
+   * Turn MVCC on or off for REPEATABLE_READ and READ_COMMITTED. Writers only keep the undo chains while it is on, so it
+   * is set while no transaction is running.
+   */
+  void SetEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+
+  auto IsEnabled() const -> bool { return enabled_.load(std::memory_order_relaxed); }
+
+  /** @return the snapshot of a scan of `txn`: the txn's own under REPEATABLE_READ, a new one under READ_COMMITTED */
+  auto GetSnapshot(Transaction *txn) -> std::shared_ptr<const Snapshot>;
+
+  /**
+   * Insert a batch of tuples into the heap of table `oid` and, with MVCC on, record that the rows did not exist before,
+   * so that a reader never finds a new row without its chain.
+   * @param[out] rids resized to tuples.size(), (*rids)[i] receives the RID of tuples[i], or an invalid RID if the heap
+   * could not insert it
+   */
+  void InsertTuples(Transaction *txn, table_oid_t oid, TableHeap *table_heap, const std::vector<const Tuple *> &tuples,
+                    std::vector<RID> *rids);
+
+  /**
+   * Save the version of a row before `txn` writes it. The txn must hold an X lock on the row, unless it inserts it.
+   * @param before the current version of the row, nullptr for a row being inserted
+   */
+  void RecordWrite(Transaction *txn, table_oid_t oid, const RID &rid, const Tuple *before);
+
+  /**
+   * @return `true` if `txn` may not write the row: under REPEATABLE_READ, its newest version was written by a txn the
+   * snapshot of `txn` does not see
+   */
+  auto IsWriteConflict(Transaction *txn, table_oid_t oid, const RID &rid) -> bool;
+
+  /**
+   * Read the version of a row that `snapshot` sees.
+   * @param[out] tuple the version, if any
+   * @return `false` if the snapshot sees no version of the row
+   */
+  auto ReadVisible(TableHeap *table_heap, table_oid_t oid, const RID &rid, const Snapshot &snapshot, Transaction *txn,
+                   Tuple *tuple) -> bool;
+
+  /** @return `true` if the row has an undo chain, i.e. some snapshot may see another version than the heap's */
+  auto HasVersions(table_oid_t oid, const RID &rid) -> bool;
+
+  /** Append the RIDs of the rows of page `page_id` that have an undo chain. */
+  void GetVersionedRids(table_oid_t oid, page_id_t page_id, std::vector<RID> *rids);
+
+  /** Remove the entries no snapshot needs any more, see [MVCC_NOTE]. */
+  void GarbageCollect();
+
+ private:
+  /** One old version of a row */
+  struct UndoEntry {
+    /** The txn that replaced this version, and the timestamp of its first write */
+    txn_id_t writer_;
+    uint64_t write_ts_;
+    /** Whether the row existed before the write, and its version then */
+    bool existed_;
+    Tuple before_;
+  };
+
+  /** Undo chain of a row, oldest first */
+  using UndoChain = std::vector<UndoEntry>;
+
+  static constexpr size_t VERSION_STORE_SHARDS = 16;
+  /** Number of recorded writes between two garbage collections */
+  static constexpr size_t VERSION_GC_INTERVAL = 1024;
+
+  struct VersionShard {
+    // page id -> slot -> undo chain
+    std::unordered_map<page_id_t, std::unordered_map<uint32_t, UndoChain>> pages_;
+    std::mutex latch_;
+  };
+
+  struct TableVersions {
+    std::array<VersionShard, VERSION_STORE_SHARDS> shards_;
+    // 插入 heap 和 RecordWrite 在 insert_latch_ 下完成，reader 在 heap 中读到没有 chain 的行时等待正在进行的 insert
+    std::atomic<size_t> inserts_in_flight_{0};
+    std::mutex insert_latch_;
+  };
+
+  /** @return the versions of table `oid`; created if `create`, otherwise nullptr if the table has none */
+  auto GetTable(table_oid_t oid, bool create) -> TableVersions *;
+
+  static auto ShardOf(TableVersions *table, page_id_t page_id) -> VersionShard * {
+    return &table->shards_[static_cast<uint32_t>(page_id) % VERSION_STORE_SHARDS];
+  }
+
+  /** @return `true` if a reader in `snapshot` sees the write of `entry` */
+  static auto IsVisible(const UndoEntry &entry, const Snapshot &snapshot) -> bool;
+
+  /** @return the timestamp of the first write of `txn`, registering it as a writer on its first write */
+  auto RegisterWriter(Transaction *txn) -> uint64_t;
+
+  /** 删除已经结束的 writer 和 snapshot，return 所有仍然可能被读的 snapshot */
+  auto LiveSnapshots() -> std::vector<std::shared_ptr<const Snapshot>>;
+
+  /** 清理一条 undo chain，return chain 是否已经为空 */
+  static auto CollectChain(table_oid_t oid, UndoChain *chain,
+                           const std::vector<std::shared_ptr<const Snapshot>> &snapshots) -> bool;
+
+  std::atomic<bool> enabled_{false};
+
+  std::unordered_map<table_oid_t, std::unique_ptr<TableVersions>> tables_;
+  std::shared_mutex tables_latch_;
+
+  /** Next timestamp of a first write or a snapshot */
+  uint64_t next_ts_{1};
+  /** Writers that have not been seen finished yet -> timestamp of their first write */
+  std::unordered_map<txn_id_t, uint64_t> writers_;
+  /** Every snapshot that was taken, kept alive by the scans reading in it */
+  std::vector<std::weak_ptr<const Snapshot>> snapshots_;
+  /** Snapshots of REPEATABLE_READ txns, kept until the txn finishes */
+  std::unordered_map<txn_id_t, std::shared_ptr<const Snapshot>> txn_snapshots_;
+  std::mutex registry_latch_;
+
+  std::atomic<size_t> writes_since_gc_{0};
+  std::mutex gc_latch_;
+};
+
+}  // namespace bustub
@@ -21,7 +21,6 @@
 #include <memory>
 #include <mutex>  // NOLINT
 #include <shared_mutex>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -115,7 +114,7 @@ class ExtendibleHashTable : public HashTable<K, V> {
     explicit Bucket(size_t size, int depth = 0);
 
     /** @brief Check if a bucket is full. */
-    inline auto IsFull() const -> bool { return mp_.size() == size_; }
+    inline auto IsFull() const -> bool { return items_.size() == size_; }
 
     /** @brief Get the local depth of the bucket. */
     inline auto GetDepth() const -> int { return depth_; }
@@ -123,7 +122,7 @@ class ExtendibleHashTable : public HashTable<K, V> {
     /** @brief Increment the local depth of a bucket. */
     inline void IncrementDepth() { depth_++; }
 
-    inline auto GetItems() -> std::unordered_map<K, V> & { return mp_; }
+    inline auto GetItems() -> std::vector<std::pair<K, V>> & { return items_; }
 
     /**
      * @brief 类似 ExtendibleHashTable::IndexOf
@@ -171,8 +170,8 @@ class ExtendibleHashTable : public HashTable<K, V> {
     size_t size_;
     int depth_;
     // std::list<std::pair<K, V>> list_;
-    // key -> value
-    std::unordered_map<K, V> mp_;
+    // 连续存放的 key/value，bucket 很小，线性查找比 hash map 的指针跳转更快
+    std::vector<std::pair<K, V>> items_;
     // 增加一个锁
     mutable std::shared_mutex latch_;
   };
@@ -184,6 +183,7 @@ class ExtendibleHashTable : public HashTable<K, V> {
   int global_depth_;    // The global depth of the directory
   size_t bucket_size_;  // The size of a bucket
   int num_buckets_;     // The number of buckets in the hash table
+  // Find/Remove 和不需要分裂的 Insert 只持有读锁加 bucket 锁，分裂 bucket 和扩展 directory 时持有写锁
   mutable std::shared_mutex latch_;
   std::vector<std::shared_ptr<Bucket>> dir_;  // The directory of the hash table
 
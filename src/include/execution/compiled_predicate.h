@@ -0,0 +1,90 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// compiled_predicate.h
+//
+// Identification: src/include/execution/compiled_predicate.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "catalog/schema.h"
+#include "execution/expressions/abstract_expression.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+struct PredicateNode;
+
+/** A compiled predicate node: `true` if the node is true for the tuples, `false` if it is false or NULL. */
+using PredicateFn = auto (*)(const PredicateNode &node, const Tuple *left, const Tuple *right) -> bool;
+
+/** A node of a compiled predicate. */
+struct PredicateNode {
+  PredicateFn fn_{nullptr};
+  // comparison：两边 column 在 tuple 中的 offset，以及在 left 还是 right tuple 中
+  std::array<uint32_t, 2> offsets_{0, 0};
+  std::array<bool, 2> from_right_{false, false};
+  // `column op constant` 的 constant，已经转为比较时使用的类型
+  int64_t int_constant_{0};
+  double decimal_constant_{0};
+  // AND / OR 的所有子节点，嵌套的同种 AND / OR 被展开到同一层
+  std::vector<std::unique_ptr<PredicateNode>> children_;
+  // 没有编译的子表达式，以及它作用的 schema
+  const AbstractExpression *expr_{nullptr};
+  const Schema *left_schema_{nullptr};
+  const Schema *right_schema_{nullptr};
+};
+
+/**
+ * CompiledPredicate turns a filter or join predicate into a tree of typed kernels once, when the executor is
+ * initialized, so that rows are evaluated without the AbstractExpression tree or Value boxing.
+ *
+ * `column op constant` and `column op column` on TINYINT / SMALLINT / INTEGER / BIGINT / DECIMAL columns compile to a
+ * template instance per column type and operator, which reads the column straight from the tuple data and compares it
+ * as int64_t, or as double when either side is a DECIMAL. AND / OR compile to a loop over their flattened children.
+ * Any other sub-expression is evaluated through AbstractExpression as before.
+ *
+ * A predicate is only used as a filter, so NULL and false are both `false`. Without NOT, this two-valued logic gives
+ * the same rows as SQL's three-valued one.
+ */
+class CompiledPredicate {
+ public:
+  /** Compile the predicate of a filter over tuples of `schema`. */
+  CompiledPredicate(const AbstractExpression &expr, const Schema &schema);
+
+  /** Compile the predicate of a join over left tuples of `left_schema` and right tuples of `right_schema`. */
+  CompiledPredicate(const AbstractExpression &expr, const Schema &left_schema, const Schema &right_schema);
+
+  /** @return `true` if the predicate is true on the tuple */
+  auto Evaluate(const Tuple *tuple) const -> bool { return root_->fn_(*root_, tuple, nullptr); }
+
+  /** @return `true` if the predicate is true on the pair of tuples */
+  auto EvaluateJoin(const Tuple *left, const Tuple *right) const -> bool { return root_->fn_(*root_, left, right); }
+
+  /** @return `true` if no part of the predicate needs the AbstractExpression fallback */
+  auto IsFullyCompiled() const -> bool { return fully_compiled_; }
+
+ private:
+  auto Compile(const AbstractExpression &expr) -> std::unique_ptr<PredicateNode>;
+
+  /** @return the boxed node of `expr`, evaluated through AbstractExpression */
+  auto Fallback(const AbstractExpression &expr) -> std::unique_ptr<PredicateNode>;
+
+  const Schema *left_schema_;
+  const Schema *right_schema_;
+  bool is_join_;
+  bool fully_compiled_{true};
+  std::unique_ptr<PredicateNode> root_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,169 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// executor_profile.h
+//
+// Identification: src/include/execution/executor_profile.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "execution/executor_context.h"
+#include "execution/executors/abstract_executor.h"
+#include "execution/executors/batch_executor.h"
+#include "execution/plans/abstract_plan.h"
+
+namespace bustub {
+
+/** Implemented by executors that hold tuples or tables in memory (hash tables, sort runs, join blocks). */
+class MemoryConsumer {
+ public:
+  virtual ~MemoryConsumer() = default;
+
+  /** @return the largest number of bytes the executor held in memory at once, estimated like its memory budget */
+  virtual auto PeakMemoryBytes() const -> size_t = 0;
+};
+
+/** The cost of some executor calls, read from the clocks and the ThreadProfileCounters. */
+struct ProfileSample {
+  int64_t wall_ns_{0};
+  int64_t cpu_ns_{0};
+  int64_t bpm_hits_{0};
+  int64_t bpm_misses_{0};
+  int64_t lock_waits_{0};
+  int64_t lock_wait_ns_{0};
+
+  /** @return the totals of the calling thread so far */
+  static auto Now() -> ProfileSample;
+
+  auto operator+=(const ProfileSample &other) -> ProfileSample &;
+  auto operator-=(const ProfileSample &other) -> ProfileSample &;
+};
+
+/** What EXPLAIN ANALYZE measured for one plan node. The samples include the work of its children. */
+struct OperatorProfile {
+  /** Tuples produced */
+  uint64_t rows_{0};
+  /** Init() calls, more than one when a join rescans the node */
+  uint64_t init_calls_{0};
+  /** Next() / NextBatch() / ScanMorsels() calls */
+  uint64_t next_calls_{0};
+  ProfileSample init_;
+  ProfileSample next_;
+  /** Largest PeakMemoryBytes() of the executor, 0 if it is not a MemoryConsumer */
+  size_t peak_memory_bytes_{0};
+  /** Some tuples were produced by ScanMorsels() on worker threads */
+  bool parallel_{false};
+
+  auto Total() const -> ProfileSample {
+    auto total = init_;
+    total += next_;
+    return total;
+  }
+};
+
+/**
+ * ProfilingExecutor sits between an executor and its parent and adds the cost of every call into the executor to the
+ * OperatorProfile of its plan node, so the profiled executors themselves are unchanged.
+ *
+ * Init(), Next() and NextBatch() are measured on the calling thread. A ScanMorsels() call runs the executor on worker
+ * threads, so it is measured with the process CPU time and the buffer pool counters of the whole pool (other queries
+ * running at the same time are counted too), minus the work of the parent's consumer on the workers.
+ */
+class ProfilingExecutor : public AbstractExecutor, public BatchExecutor, public MorselSource {
+ public:
+  /**
+   * @param child The executor to profile
+   * @param profile The profile to add the calls to, owned by the ExecutorProfiler
+   */
+  ProfilingExecutor(std::unique_ptr<AbstractExecutor> &&child, OperatorProfile *profile);
+
+  ~ProfilingExecutor() override;
+
+  void Init() override;
+
+  auto Next(Tuple *tuple, RID *rid) -> bool override;
+
+  auto NextBatch(TupleBatch *batch) -> bool override;
+
+  auto ScanMorsels(size_t num_threads, const MorselConsumer &consume) -> bool override;
+
+  auto GetOutputSchema() const -> const Schema & override { return child_->GetOutputSchema(); }
+
+ private:
+  void UpdatePeakMemory();
+
+  std::unique_ptr<AbstractExecutor> child_;
+  OperatorProfile *profile_;
+  // child_ 不是 MemoryConsumer 时为 nullptr
+  const MemoryConsumer *memory_;
+};
+
+/**
+ * ExecutorProfiler collects the OperatorProfile of every node of a plan while its executors run, and prints the plan
+ * annotated with them. Profiling is enabled per thread: while a Scope is alive, executors created on the thread wrap
+ * their children in a ProfilingExecutor (see ProfileChild()). Without one, executors are created exactly as before and
+ * run with no overhead.
+ */
+class ExecutorProfiler {
+ public:
+  /** Makes a profiler the one executors created on this thread report to, until the Scope is destroyed. */
+  class Scope {
+   public:
+    explicit Scope(ExecutorProfiler *profiler);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    auto operator=(const Scope &) -> Scope & = delete;
+
+   private:
+    ExecutorProfiler *previous_;
+  };
+
+  /** @return the profiler of the calling thread, nullptr when not profiling */
+  static auto Current() -> ExecutorProfiler *;
+
+  /** @return `executor` wrapped in a ProfilingExecutor reporting to the profile of `plan` */
+  auto Wrap(const AbstractPlanNode *plan, std::unique_ptr<AbstractExecutor> &&executor)
+      -> std::unique_ptr<AbstractExecutor>;
+
+  /** @return the profile of a plan node, nullptr if it never had an executor */
+  auto GetProfile(const AbstractPlanNode *plan) const -> const OperatorProfile *;
+
+  /**
+   * @return one line per plan node: the node, then its rows, loops (Init() calls), total and self time (total minus
+   * the children's), CPU time, buffer pool hits and misses of the node itself, lock waits and peak memory
+   */
+  auto ToString(const AbstractPlanNode &plan) const -> std::string;
+
+ private:
+  void AppendNode(const AbstractPlanNode &plan, size_t indent, std::string *out) const;
+
+  static auto CurrentSlot() -> ExecutorProfiler *&;
+
+  std::unordered_map<const AbstractPlanNode *, std::unique_ptr<OperatorProfile>> profiles_;
+};
+
+/**
+ * Called by executors on the children they are constructed with.
+ * @return `child` wrapped for the profiler of this thread if there is one, otherwise `child` itself
+ */
+auto ProfileChild(const AbstractPlanNodeRef &plan, std::unique_ptr<AbstractExecutor> &&child)
+    -> std::unique_ptr<AbstractExecutor>;
+
+/**
+ * EXPLAIN ANALYZE: run `plan` to completion with profiling, dropping its output.
+ * @return the plan annotated with the profile of each node
+ */
+auto ExplainAnalyze(ExecutorContext *exec_ctx, const AbstractPlanNodeRef &plan) -> std::string;
+
+}  // namespace bustub
@@ -12,7 +12,9 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -20,9 +22,12 @@
 #include "common/util/hash_util.h"
 #include "container/hash/hash_function.h"
 #include "execution/executor_context.h"
+#include "execution/executor_profile.h"
 #include "execution/executors/abstract_executor.h"
+#include "execution/executors/batch_executor.h"
 #include "execution/expressions/abstract_expression.h"
 #include "execution/plans/aggregation_plan.h"
+#include "execution/spill_file.h"
 #include "storage/table/tuple.h"
 #include "type/type_id.h"
 #include "type/value_factory.h"
@@ -72,7 +77,6 @@ class SimpleAggregationHashTable {
    * @param input The input value
    */
   void CombineAggregateValues(AggregateValue *result, const AggregateValue &input) {
-    std::vector<Value> values{};
     for (uint32_t i = 0; i < agg_exprs_.size(); i++) {
       switch (agg_types_[i]) {
         case AggregationType::CountStarAggregate:
@@ -120,10 +124,70 @@ class SimpleAggregationHashTable {
    * @param agg_val the value to be inserted
    */
   void InsertCombine(const AggregateKey &agg_key, const AggregateValue &agg_val) {
-    if (ht_.count(agg_key) == 0) {
-      ht_.insert({agg_key, GenerateInitialAggregateValue()});
+    auto [iter, inserted] = ht_.try_emplace(agg_key);
+    if (inserted) {
+      iter->second = GenerateInitialAggregateValue();
     }
-    CombineAggregateValues(&ht_[agg_key], agg_val);
+    CombineAggregateValues(&iter->second, agg_val);
+  }
+
+  /**
+   * Combines the input into the aggregation of a key only if the key is already in the hash table.
+   * @return `true` if the key was found
+   */
+  auto UpdateCombine(const AggregateKey &agg_key, const AggregateValue &agg_val) -> bool {
+    auto iter = ht_.find(agg_key);
+    if (iter == ht_.end()) {
+      return false;
+    }
+    CombineAggregateValues(&iter->second, agg_val);
+    return true;
+  }
+
+  /**
+   * Combines the partial aggregates of another table into the aggregation result.
+   * @param[out] result The output aggregate value
+   * @param partial The aggregate value of the same key in a partial table
+   */
+  void MergeAggregateValues(AggregateValue *result, const AggregateValue &partial) {
+    for (uint32_t i = 0; i < agg_exprs_.size(); i++) {
+      const auto &value = partial.aggregates_[i];
+      if (value.IsNull()) {
+        continue;
+      }
+      auto &agg = result->aggregates_[i];
+      switch (agg_types_[i]) {
+        case AggregationType::CountStarAggregate:
+        case AggregationType::CountAggregate:
+        case AggregationType::SumAggregate:
+          agg = agg.IsNull() ? value : agg.Add(value);
+          break;
+        case AggregationType::MinAggregate:
+          if (agg.IsNull() || agg.CompareGreaterThan(value) == CmpBool::CmpTrue) {
+            agg = value;
+          }
+          break;
+        case AggregationType::MaxAggregate:
+          if (agg.IsNull() || agg.CompareLessThan(value) == CmpBool::CmpTrue) {
+            agg = value;
+          }
+          break;
+      }
+    }
+  }
+
+  /**
+   * Inserts the partial aggregates of a key and merges them with the current aggregation.
+   * @param agg_key the key to be inserted
+   * @param partial the partial aggregate value of the key
+   */
+  void InsertMerge(const AggregateKey &agg_key, const AggregateValue &partial) {
+    auto [iter, inserted] = ht_.try_emplace(agg_key);
+    if (inserted) {
+      iter->second = partial;
+      return;
+    }
+    MergeAggregateValues(&iter->second, partial);
   }
 
   /**
@@ -131,6 +195,9 @@ class SimpleAggregationHashTable {
    */
   void Clear() { ht_.clear(); }
 
+  /** @return number of keys in the hash table */
+  auto Size() const -> size_t { return ht_.size(); }
+
   /** An iterator over the aggregation hash table */
   class Iterator {
    public:
@@ -178,8 +245,19 @@ class SimpleAggregationHashTable {
 /**
  * AggregationExecutor executes an aggregation operation (e.g. COUNT, SUM, MIN, MAX)
  * over the tuples produced by a child executor.
+ *
+ * When the child produces more than one morsel (AGG_MORSEL_SIZE tuples) and there is more than one core, Init()
+ * aggregates in parallel: the executor thread reads morsels from the child and hands them to worker threads, each
+ * filling thread-local partial tables partitioned by the hash of the group by key. Worker i then merges partition i
+ * of every partial table, so the result is one table per partition.
+ *
+ * The tables hold at most about the memory budget worth of groups (see SetMemoryBudget()). Past it, input tuples of
+ * groups already in a table are still aggregated in place, and tuples of new groups are written to AGG_SPILL_PARTITIONS
+ * SpillFiles by key hash. Each spilled partition is then aggregated on its own, with its groups found in the resident
+ * tables combined there, re-partitioning it again when it does not fit either, and its result is written out to a
+ * SpillFile of output tuples. Next() returns those first, then the resident tables.
  */
-class AggregationExecutor : public AbstractExecutor {
+class AggregationExecutor : public AbstractExecutor, public BatchExecutor, public MemoryConsumer {
  public:
   /**
    * Construct a new AggregationExecutor instance.
@@ -201,12 +279,25 @@ class AggregationExecutor : public AbstractExecutor {
    */
   auto Next(Tuple *tuple, RID *rid) -> bool override;
 
+  /**
+   * Yield the next batch of tuples from the aggregation.
+   * @param[out] batch The batch to fill
+   * @return `true` if at least one tuple was produced, `false` if there are no more tuples
+   */
+  auto NextBatch(TupleBatch *batch) -> bool override;
+
   /** @return The output schema for the aggregation */
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); };
 
   /** Do not use or remove this function, otherwise you will get zero points. */
   auto GetChildExecutor() const -> const AbstractExecutor *;
 
+  /** @return The largest number of bytes of groups held in the tables, estimated per group like the memory budget */
+  auto PeakMemoryBytes() const -> size_t override { return peak_memory_bytes_; }
+
+  /** Set the number of bytes of groups an aggregation keeps in memory before it spills input tuples. */
+  static void SetMemoryBudget(size_t bytes) { memory_budget_.store(bytes, std::memory_order_relaxed); }
+
  private:
   /** @return The tuple as an AggregateKey */
   auto MakeAggregateKey(const Tuple *tuple) -> AggregateKey {
@@ -217,6 +308,71 @@ class AggregationExecutor : public AbstractExecutor {
     return {keys};
   }
 
+  /**
+   * Read batches from the child until the morsel has at least AGG_MORSEL_SIZE tuples.
+   * @return `true` if the morsel is full, so that the child may have more tuples
+   */
+  auto ReadMorsel(std::vector<Tuple> *morsel) -> bool;
+
+  /** Aggregate `first_morsel`, and the rest of the child if there may be `more`, on this thread into tables_[0]. */
+  void SerialAggregate(const std::vector<Tuple> &first_morsel, bool more);
+
+  /** Aggregate `first_morsel` and the rest of the child with `num_threads` workers into tables_. */
+  void ParallelAggregate(std::vector<Tuple> &&first_morsel, size_t num_threads);
+
+  /**
+   * Aggregate the morsels of `source` on its `num_threads` workers into tables_.
+   * @return `false` if the source cannot scan in parallel
+   */
+  auto ParallelAggregate(MorselSource *source, size_t num_threads) -> bool;
+
+  /** Partial tables of parallel workers: partials[i][p] for the keys of worker i in partition hash % num_threads = p */
+  using PartialTables = std::vector<std::vector<SimpleAggregationHashTable>>;
+
+  /** @return empty partial tables for `num_threads` workers */
+  auto MakePartials(size_t num_threads) const -> PartialTables;
+
+  /**
+   * Aggregate a tuple into the partial tables of a worker, or add it to `spilled` once the groups of all the partial
+   * tables, counted in `num_groups`, reach the memory budget.
+   */
+  void AggregatePartial(const Tuple &tuple, std::vector<SimpleAggregationHashTable> *partial,
+                        std::atomic<size_t> *num_groups, size_t max_groups,
+                        std::vector<std::pair<hash_t, Tuple>> *spilled);
+
+  /** Merge partition p of every partial table into tables_[p], with one WorkerPool task per partition. */
+  void MergePartials(PartialTables *partials);
+
+  /** @return number of groups the tables may hold within the memory budget */
+  auto MaxResidentGroups() const -> size_t;
+
+  /** @return about the number of bytes a group takes in a SimpleAggregationHashTable */
+  auto GroupBytes() const -> size_t;
+
+  /** @return number of groups in tables_ */
+  auto ResidentGroups() const -> size_t;
+
+  /** Append (key hash, tuple) pairs to the spill partitions chosen by the hash, and clear them. */
+  void SpillTuples(std::vector<std::pair<hash_t, Tuple>> *tuples);
+
+  /**
+   * Aggregate the spilled tuples of `input` into the resident tables or a table of their own, whose output tuples
+   * are appended to spilled_output_. New groups that do not fit are partitioned again on the hash bits of `depth`.
+   */
+  void AggregatePartition(SpillFile *input, size_t depth);
+
+  /** @return The output tuple of a group */
+  auto MakeOutputTuple(const AggregateKey &key, const AggregateValue &val) const -> Tuple {
+    std::vector<Value> values(key.group_bys_);
+    values.insert(values.end(), val.aggregates_.begin(), val.aggregates_.end());
+    return {values, plan_->output_schema_.get()};
+  }
+
+  /** @return The spill partition of a key hash at recursion `depth` */
+  static auto SpillPartitionOf(hash_t hash, size_t depth) -> size_t {
+    return (hash >> (AGG_SPILL_HASH_SHIFT + 8 * depth)) % AGG_SPILL_PARTITIONS;
+  }
+
   /** @return The tuple as an AggregateValue */
   auto MakeAggregateValue(const Tuple *tuple) -> AggregateValue {
     std::vector<Value> vals;
@@ -231,10 +387,29 @@ class AggregationExecutor : public AbstractExecutor {
   const AggregationPlanNode *plan_;
   /** The child executor that produces tuples over which the aggregation is computed */
   std::unique_ptr<AbstractExecutor> child_;
-  /** Simple aggregation hash table */
-  SimpleAggregationHashTable aht_;
-  /** Simple aggregation hash table iterator */
+  /** The last batch read from the child, only used by the thread reading the child */
+  TupleBatch child_batch_;
+  static constexpr size_t AGG_MORSEL_SIZE = 2048;
+  static constexpr size_t AGG_MAX_THREADS = 16;
+  static constexpr size_t AGG_DEFAULT_MEMORY_BUDGET = 64 << 20;
+  static constexpr size_t AGG_SPILL_PARTITIONS = 16;
+  // 与 tables_ 的 partition（hash 取模）无关的高位，每深一层用下一个字节
+  static constexpr size_t AGG_SPILL_HASH_SHIFT = 32;
+  static constexpr size_t AGG_MAX_SPILL_DEPTH = 3;
+
+  static inline std::atomic<size_t> memory_budget_{AGG_DEFAULT_MEMORY_BUDGET};
+
+  /** Simple aggregation hash tables, one per partition of the key hash (only one without parallelism) */
+  std::vector<SimpleAggregationHashTable> tables_;
+  size_t table_index_{0};
+  /** Simple aggregation hash table iterator, over tables_[table_index_] */
   SimpleAggregationHashTable::Iterator aht_iterator_;
   bool is_successful_;
+  // 超过内存预算后新 group 的 input tuple，按 key hash 分区
+  std::vector<std::unique_ptr<SpillFile>> spill_partitions_;
+  std::mutex spill_latch_;
+  size_t peak_memory_bytes_{0};
+  // spill 出去的 group 的结果
+  std::unique_ptr<SpillFile> spilled_output_;
 };
 }  // namespace bustub
@@ -0,0 +1,150 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// batch_executor.h
+//
+// Identification: src/include/execution/executors/batch_executor.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "common/rid.h"
+#include "execution/executors/abstract_executor.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * TupleBatch holds up to BATCH_SIZE rows produced by one NextBatch() call, with a selection vector of the rows still
+ * alive so that a filter drops rows without moving tuples. The tuple storage is kept across Clear() and reused by the
+ * next batch.
+ *
+ * Expressions evaluate on a Tuple and its Schema, so rows keep the tuple layout instead of one vector per column.
+ */
+class TupleBatch {
+ public:
+  static constexpr size_t BATCH_SIZE = 1024;
+
+  /** @return number of selected rows */
+  auto Size() const -> size_t { return sel_.size(); }
+
+  auto IsEmpty() const -> bool { return sel_.empty(); }
+
+  /** @return `true` if no more rows can be appended */
+  auto IsFull() const -> bool { return num_rows_ == BATCH_SIZE; }
+
+  /** Remove all rows. */
+  void Clear() {
+    num_rows_ = 0;
+    sel_.clear();
+  }
+
+  /** @return the i-th selected tuple */
+  auto GetTuple(size_t i) -> Tuple & { return tuples_[sel_[i]]; }
+  auto GetTuple(size_t i) const -> const Tuple & { return tuples_[sel_[i]]; }
+
+  /** @return RID of the i-th selected tuple */
+  auto GetRid(size_t i) const -> const RID & { return rids_[sel_[i]]; }
+
+  /**
+   * Append a row, selected, and return its tuple and RID for the producer to fill in place.
+   * The batch must not be full.
+   */
+  auto Emplace() -> std::pair<Tuple *, RID *> {
+    if (num_rows_ == tuples_.size()) {
+      tuples_.emplace_back();
+      rids_.emplace_back();
+    }
+    sel_.push_back(static_cast<uint32_t>(num_rows_));
+    auto row = num_rows_++;
+    return {&tuples_[row], &rids_[row]};
+  }
+
+  /** Remove the row returned by the last Emplace(), when the producer had nothing to put in it. */
+  void PopBack() {
+    num_rows_--;
+    sel_.pop_back();
+  }
+
+  /** Append a copy of a row. */
+  void Append(const Tuple &tuple, const RID &rid) {
+    auto [t, r] = Emplace();
+    *t = tuple;
+    *r = rid;
+  }
+
+  /** Keep only the selected rows for which `pred(const Tuple &)` is true. */
+  template <class Pred>
+  void Select(Pred &&pred) {
+    size_t n = 0;
+    for (auto row : sel_) {
+      if (pred(tuples_[row])) {
+        sel_[n++] = row;
+      }
+    }
+    sel_.resize(n);
+  }
+
+ private:
+  std::vector<Tuple> tuples_;
+  std::vector<RID> rids_;
+  // 行数，tuples_ 中后面的 tuple 是之前 batch 留下的
+  size_t num_rows_{0};
+  // 被选中的行在 tuples_ 中的下标，按顺序
+  std::vector<uint32_t> sel_;
+};
+
+/**
+ * BatchExecutor is implemented by executors that produce a whole batch per call, next to AbstractExecutor::Next().
+ * A parent mixes the two calls freely on the same child: both continue from where the other stopped.
+ */
+class BatchExecutor {
+ public:
+  virtual ~BatchExecutor() = default;
+
+  /**
+   * Yield the next batch of tuples.
+   * @param[out] batch The batch to fill, cleared by the caller
+   * @return `true` if at least one tuple was produced, `false` if there are no more tuples
+   */
+  virtual auto NextBatch(TupleBatch *batch) -> bool = 0;
+};
+
+/** Consumer of the batches of a parallel scan, called concurrently by `worker` in [0, num_threads). */
+using MorselConsumer = std::function<void(size_t worker, TupleBatch *batch)>;
+
+/**
+ * MorselSource is implemented by executors whose input can be read by several threads at once. The input is cut into
+ * morsels, each worker thread takes the next morsel whenever it is done with its last one, and the tuples are handed
+ * to the consumer in batches on the thread that read them. A morsel-driven parent runs its own work per batch on the
+ * same threads.
+ */
+class MorselSource {
+ public:
+  virtual ~MorselSource() = default;
+
+  /**
+   * Produce all the remaining tuples with `num_threads` worker threads. An exception in a worker, including one thrown
+   * by `consume`, stops the scan and is rethrown here once all workers are done.
+   * @return `false` if the executor cannot scan in parallel, nothing was produced then
+   */
+  virtual auto ScanMorsels(size_t num_threads, const MorselConsumer &consume) -> bool = 0;
+};
+
+/**
+ * Clear `batch` and fill it from `executor`: with NextBatch() if it is a BatchExecutor, otherwise with Next() until the
+ * batch is full or the executor is exhausted.
+ * @return `true` if at least one tuple was produced, `false` if there are no more tuples
+ */
+auto NextBatch(AbstractExecutor *executor, TupleBatch *batch) -> bool;
+
+}  // namespace bustub
@@ -0,0 +1,118 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// exchange_executor.h
+//
+// Identification: src/include/execution/executors/exchange_executor.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "execution/executor_context.h"
+#include "execution/executors/abstract_executor.h"
+#include "execution/executors/batch_executor.h"
+#include "execution/plans/exchange_plan.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * ExchangeExecutor gathers the tuples of a child pipeline run on several threads.
+ *
+ * On the first Next() or NextBatch(), a driver thread calls ScanMorsels() of the child, a MorselSource, and the worker
+ * threads of the scan push each of their output batches into a queue of EXCHANGE_QUEUE_BATCHES_PER_THREAD batches per
+ * thread, waiting while it is full. Next() and NextBatch() take the batches from the queue. A child that cannot scan
+ * in parallel is read with NextBatch() on the driver thread instead.
+ *
+ * A parent that consumes morsels itself, like an aggregation, calls ScanMorsels() of the exchange, which hands the
+ * morsels of the child to it directly, without the queue.
+ */
+class ExchangeExecutor : public AbstractExecutor, public BatchExecutor, public MorselSource {
+ public:
+  /**
+   * Construct a new ExchangeExecutor instance.
+   * @param exec_ctx The executor context
+   * @param plan The exchange plan to be executed
+   * @param child_executor The pipeline to run in parallel
+   */
+  ExchangeExecutor(ExecutorContext *exec_ctx, const ExchangePlanNode *plan,
+                   std::unique_ptr<AbstractExecutor> &&child_executor);
+
+  /** Stop the pipeline if it is still running. */
+  ~ExchangeExecutor() override;
+
+  /** Initialize the exchange, stopping the pipeline of the last Init() if it is still running */
+  void Init() override;
+
+  /**
+   * Yield the next tuple gathered from the pipeline.
+   * @param[out] tuple The next tuple produced by the pipeline
+   * @param[out] rid The RID of the tuple
+   * @return `true` if a tuple was produced, `false` if there are no more tuples
+   */
+  auto Next(Tuple *tuple, RID *rid) -> bool override;
+
+  /**
+   * Yield the next batch gathered from the pipeline.
+   * @param[out] batch The batch to fill
+   * @return `true` if at least one tuple was produced, `false` if there are no more tuples
+   */
+  auto NextBatch(TupleBatch *batch) -> bool override;
+
+  /** Hand the morsels of the child to `consume` directly, only possible before the first Next() or NextBatch(). */
+  auto ScanMorsels(size_t num_threads, const MorselConsumer &consume) -> bool override;
+
+  /** @return The output schema for the exchange */
+  auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); };
+
+ private:
+  static constexpr size_t EXCHANGE_QUEUE_BATCHES_PER_THREAD = 2;
+
+  /** Start the driver thread. */
+  void Start();
+
+  /** Cancel the pipeline and wait for the driver thread. */
+  void Stop();
+
+  /** Move a batch of the pipeline into the queue, called by the worker threads. */
+  void Push(TupleBatch *batch);
+
+  /**
+   * Replace `batch` with the next batch of the queue, rethrowing the exception of the pipeline if it failed.
+   * @return `false` if the pipeline is done and the queue is empty
+   */
+  auto Pop(TupleBatch *batch) -> bool;
+
+  /** The exchange plan node to be executed. */
+  const ExchangePlanNode *plan_;
+  std::unique_ptr<AbstractExecutor> child_executor_;
+  bool started_{false};
+  std::thread driver_;
+  // 以下由 latch_ 保护
+  std::mutex latch_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<TupleBatch> queue_;
+  // 已经读完的 batch，worker 交给 queue 的 batch 换成它们，复用 tuple 的空间
+  std::vector<TupleBatch> free_batches_;
+  bool finished_{false};
+  bool cancelled_{false};
+  std::exception_ptr error_;
+  // Next 读到的 batch，以及其中下一个 tuple
+  TupleBatch current_;
+  size_t current_index_{0};
+};
+
+}  // namespace bustub
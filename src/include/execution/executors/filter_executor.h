@@ -15,8 +15,10 @@
 #include <memory>
 #include <vector>
 
+#include "execution/compiled_predicate.h"
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
+#include "execution/executors/batch_executor.h"
 #include "execution/plans/filter_plan.h"
 #include "execution/plans/seq_scan_plan.h"
 #include "storage/table/tuple.h"
@@ -26,7 +28,7 @@ namespace bustub {
 /**
  * The FilterExecutor executor executes a filter.
  */
-class FilterExecutor : public AbstractExecutor {
+class FilterExecutor : public AbstractExecutor, public BatchExecutor, public MorselSource {
  public:
   /**
    * Construct a new FilterExecutor instance.
@@ -48,6 +50,19 @@ class FilterExecutor : public AbstractExecutor {
    */
   auto Next(Tuple *tuple, RID *rid) -> bool override;
 
+  /**
+   * Yield the next batch of tuples from the filter.
+   * @param[out] batch The batch to fill
+   * @return `true` if at least one tuple was produced, `false` if there are no more tuples
+   */
+  auto NextBatch(TupleBatch *batch) -> bool override;
+
+  /**
+   * Filter the morsels of the child on its worker threads, if the child is a MorselSource.
+   * @return `false` if the child cannot scan in parallel
+   */
+  auto ScanMorsels(size_t num_threads, const MorselConsumer &consume) -> bool override;
+
   /** @return The output schema for the filter plan */
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); }
 
@@ -57,5 +72,8 @@ class FilterExecutor : public AbstractExecutor {
 
   /** The child executor from which tuples are obtained */
   std::unique_ptr<AbstractExecutor> child_executor_;
+
+  /** The predicate, compiled in Init() */
+  std::unique_ptr<CompiledPredicate> predicate_;
 };
 }  // namespace bustub
@@ -12,20 +12,40 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <utility>
+#include <vector>
 
+#include "common/util/hash_util.h"
 #include "execution/executor_context.h"
+#include "execution/executor_profile.h"
 #include "execution/executors/abstract_executor.h"
+#include "execution/executors/batch_executor.h"
 #include "execution/plans/hash_join_plan.h"
+#include "execution/spill_file.h"
 #include "storage/table/tuple.h"
 
 namespace bustub {
 
 /**
- * HashJoinExecutor executes a nested-loop JOIN on two tables.
+ * HashJoinExecutor executes an equi-JOIN on two tables with a hash table built on the right child.
+ *
+ * The join key hash is HashUtil::HashValue() run through a 64-bit finalizer (see KeyHash()), since the raw hash of an
+ * integer spreads poorly over its bits. The build entries (join key hash, index of the right tuple) are radix
+ * partitioned on the low bits of the hash into enough partitions that each one holds about HJ_PARTITION_SIZE entries,
+ * and sorted by hash inside a partition, so probing one left tuple binary-searches a cache-sized array. The left child
+ * is streamed and never materialized.
+ *
+ * When the right tuples take more than the memory budget (see SetMemoryBudget()), the join turns into a Grace hash
+ * join: both children are partitioned on the top bits of the join key hash into GRACE_NUM_PARTITIONS SpillFiles, and
+ * the partitions are joined one pair at a time, building the table above on the right partition only. A partition that
+ * is still larger than the budget is joined in memory anyway.
+ *
+ * Once the table is built, the probe is read-only, so an in-memory join whose left child is a MorselSource is one too:
+ * ScanMorsels() probes each morsel of the left child on the worker thread that read it.
  */
-class HashJoinExecutor : public AbstractExecutor {
+class HashJoinExecutor : public AbstractExecutor, public BatchExecutor, public MorselSource, public MemoryConsumer {
  public:
   /**
    * Construct a new HashJoinExecutor instance.
@@ -48,12 +68,108 @@ class HashJoinExecutor : public AbstractExecutor {
    */
   auto Next(Tuple *tuple, RID *rid) -> bool override;
 
+  /**
+   * Yield the next batch of tuples from the join.
+   * @param[out] batch The batch to fill
+   * @return `true` if at least one tuple was produced, `false` if there are no more tuples
+   */
+  auto NextBatch(TupleBatch *batch) -> bool override;
+
+  /**
+   * Probe the morsels of the left child on its worker threads, if the child is a MorselSource, the join is not a grace
+   * hash join and Next() or NextBatch() was not called since Init().
+   */
+  auto ScanMorsels(size_t num_threads, const MorselConsumer &consume) -> bool override;
+
   /** @return The output schema for the join */
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); };
 
+  /** @return The largest number of bytes of right tuples held in memory, by the build or a grace partition */
+  auto PeakMemoryBytes() const -> size_t override { return peak_memory_bytes_; }
+
+  /** Set the number of bytes of right tuples a hash join keeps in memory before it spills both children. */
+  static void SetMemoryBudget(size_t bytes) { memory_budget_.store(bytes, std::memory_order_relaxed); }
+
  private:
-  /** The NestedLoopJoin plan node to be executed. */
+  /** Hash of the join key of a right tuple, with the index of that tuple in build_tuples_ */
+  struct BuildEntry {
+    hash_t hash_;
+    uint32_t index_;
+  };
+
+  // 每个 partition 的目标 entry 数，16 KB
+  static constexpr size_t HJ_PARTITION_SIZE = 1024;
+  static constexpr size_t HJ_MAX_PARTITION_BITS = 12;
+  static constexpr size_t HJ_DEFAULT_MEMORY_BUDGET = 64 << 20;
+  // grace partition 用 hash 的最高 4 位，与 radix partition 用的低位无关
+  static constexpr size_t GRACE_NUM_PARTITIONS = 16;
+  static constexpr size_t GRACE_PARTITION_SHIFT = 60;
+
+  static inline std::atomic<size_t> memory_budget_{HJ_DEFAULT_MEMORY_BUDGET};
+
+  /** @return the hash of a join key, mixed so that both the low and the high bits are uniform */
+  static auto KeyHash(const Value &key) -> hash_t;
+
+  /** @return the grace partition of a join key hash */
+  static auto GracePartition(hash_t hash) -> size_t { return (hash >> GRACE_PARTITION_SHIFT) % GRACE_NUM_PARTITIONS; }
+
+  /** Drain the right child into build_tuples_ / build_keys_, spilling to grace partitions past the memory budget. */
+  void Build();
+
+  /** Move the buffered right tuples to the grace partitions, and from then on spill every right tuple. */
+  void StartSpilling();
+
+  /** Spill the left child, then load the first grace partition. */
+  void PartitionLeft();
+
+  /** Read the right tuples of grace partition `partition` into build_tuples_ / build_keys_ and build the table. */
+  void LoadPartition(size_t partition);
+
+  /** Radix partition the build entries of build_keys_ and sort each partition by hash. */
+  void BuildTable();
+
+  /** Fetch the next left tuple and find the entries of its partition with the same hash. */
+  auto NextLeftTuple() -> bool;
+
+  /** @return the range [begin, end) of entries_ from the first entry with `hash` to the end of its partition */
+  auto MatchRange(hash_t hash) const -> std::pair<size_t, size_t>;
+
+  /** Concatenate `left_tuple` with `right_tuple`, or with NULLs when it is nullptr. */
+  void MakeOutputTuple(const Tuple &left_tuple, const Tuple *right_tuple, Tuple *tuple) const;
+
+  /** The HashJoin plan node to be executed. */
   const HashJoinPlanNode *plan_;
+  std::unique_ptr<AbstractExecutor> left_executor_;
+  std::unique_ptr<AbstractExecutor> right_executor_;
+  // build side：right table 的 tuple 和 join key，NULL key 不会匹配，不放进 entries_
+  std::vector<Tuple> build_tuples_;
+  std::vector<Value> build_keys_;
+  // 按 partition 排列，partition 内按 hash 排序
+  std::vector<BuildEntry> entries_;
+  // partition i 为 entries_[partition_offsets_[i], partition_offsets_[i + 1])
+  std::vector<size_t> partition_offsets_;
+  hash_t partition_mask_{0};
+  // probe side：当前读到的 left batch，以及当前的 left tuple
+  TupleBatch left_batch_;
+  size_t left_index_{0};
+  Tuple left_tuple_;
+  Value left_key_;
+  hash_t left_hash_{0};
+  // 下一个要检查的 entry，以及所在 partition 的结尾
+  size_t match_pos_{0};
+  size_t match_end_{0};
+  bool has_left_tuple_{false};
+  bool left_matched_{false};
+  // ScanMorsels 已经读完 left child，或者 Next 已经开始读
+  bool left_done_{false};
+  bool probe_started_{false};
+  // grace hash join：为 true 时 left tuple 从 left_partitions_[grace_partition_] 读取
+  bool grace_{false};
+  size_t build_bytes_{0};
+  size_t peak_memory_bytes_{0};
+  std::vector<std::unique_ptr<SpillFile>> left_partitions_;
+  std::vector<std::unique_ptr<SpillFile>> right_partitions_;
+  size_t grace_partition_{0};
 };
 
 }  // namespace bustub
@@ -13,9 +13,12 @@
 #pragma once
 
 #include <memory>
+#include <optional>
+#include <utility>
 #include <vector>
 
 #include "common/rid.h"
+#include "concurrency/version_store.h"
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
 #include "execution/plans/index_scan_plan.h"
@@ -43,10 +46,41 @@ class IndexScanExecutor : public AbstractExecutor {
   auto Next(Tuple *tuple, RID *rid) -> bool override;
 
  private:
+  /**
+   * Read the next entries of the range into batch_. The iterator is dropped before returning, so no leaf stays latched
+   * or pinned while the parent works on the rows, e.g. a delete or update removing their keys from the same index.
+   */
+  void FillBatch();
+
+  /** @return whether the key of a row read from the heap is still in the range of the plan */
+  auto InRange(const Tuple &tuple) const -> bool;
+
+  /** Lock the row in shared mode if lock_rows_ and the txn holds no lock on it, as SeqScanExecutor does. */
+  auto LockRow(const RID &rid) -> bool;
+
+  /** Release the lock taken by LockRow() right after reading the row, under READ_COMMITTED. */
+  void UnlockRow(const RID &rid, bool locked);
+
+  /** Entries read from the index per FillBatch() */
+  static constexpr size_t INDEX_SCAN_BATCH_SIZE = 128;
+
   /** The index scan plan node to be executed. */
   const IndexScanPlanNode *plan_;
   TableHeap *table_heap_ptr_;
+  table_oid_t table_oid_;
+  /** The snapshot the rows are read in when MVCC is enabled, otherwise nullptr, see [MVCC_NOTE] */
+  std::shared_ptr<const Snapshot> snapshot_;
+  /** Whether rows are read under S row locks, i.e. no snapshot and no table lock covering every row */
+  bool lock_rows_{false};
   BPlusTreeIndexForOneIntegerColumn *index_ptr_;
-  std::unique_ptr<BPlusTreeIndexIteratorForOneIntegerColumn> index_iterator_;
+  /** The part of the range not read into a batch yet, narrowed after each FillBatch() */
+  std::optional<Value> low_key_;
+  std::optional<Value> high_key_;
+  bool range_done_{false};
+  std::vector<std::pair<IntegerKeyType, RID>> batch_;
+  size_t batch_idx_{0};
+  /** The key schema of the index and the table columns it is made of, used by index-only scans */
+  Schema *key_schema_;
+  std::vector<uint32_t> key_attrs_;
 };
 }  // namespace bustub
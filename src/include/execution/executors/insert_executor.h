@@ -14,6 +14,7 @@
 
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
@@ -24,7 +25,9 @@ namespace bustub {
 
 /**
  * InsertExecutor executes an insert on a table.
- * Inserted values are always pulled from a child executor.
+ * Inserted values are always pulled from a child executor, one TupleBatch at a time: the batch is inserted into the
+ * table heap, its rows are X locked with one LockManager::LockRows() call, and the index entries of the batch are
+ * inserted together.
  */
 class InsertExecutor : public AbstractExecutor {
  public:
@@ -55,6 +58,14 @@ class InsertExecutor : public AbstractExecutor {
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); };
 
  private:
+  /**
+   * Insert the buffered entries of every index, through BPlusTreeIndex::InsertEntries when the index is a B+ tree so
+   * that entries landing in the same leaf share one descent. Entries that were not inserted go through
+   * IndexVacuum::InsertEntry(), and a key held by a live row aborts the txn. The buffers are cleared afterwards.
+   */
+  void InsertIndexEntries(const std::vector<IndexInfo *> &indexes,
+                          std::vector<std::vector<std::pair<Tuple, RID>>> *index_entries);
+
   /** The insert plan node to be executed*/
   const InsertPlanNode *plan_;
   TableInfo *table_info_;
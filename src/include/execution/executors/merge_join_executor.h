@@ -0,0 +1,105 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// merge_join_executor.h
+//
+// Identification: src/include/execution/executors/merge_join_executor.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "execution/executor_context.h"
+#include "execution/executors/abstract_executor.h"
+#include "execution/executors/batch_executor.h"
+#include "execution/plans/merge_join_plan.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * MergeJoinExecutor executes an equi-JOIN of two children sorted in ascending order of their join keys.
+ *
+ * Both children are streamed once. The right tuples whose key equals the key of the current left tuple are buffered,
+ * so that the next left tuples with the same key join them again without going back in the right child; the memory
+ * used is the longest run of equal right keys, not the right table. NULL keys never match, wherever the child sorted
+ * them.
+ */
+class MergeJoinExecutor : public AbstractExecutor, public BatchExecutor {
+ public:
+  /**
+   * Construct a new MergeJoinExecutor instance.
+   * @param exec_ctx The executor context
+   * @param plan The merge join plan to be executed
+   * @param left_executor The child executor that produces tuples for the left side of join, sorted on the left key
+   * @param right_executor The child executor that produces tuples for the right side of join, sorted on the right key
+   */
+  MergeJoinExecutor(ExecutorContext *exec_ctx, const MergeJoinPlanNode *plan,
+                    std::unique_ptr<AbstractExecutor> &&left_executor,
+                    std::unique_ptr<AbstractExecutor> &&right_executor);
+
+  /** Initialize the join */
+  void Init() override;
+
+  /**
+   * Yield the next tuple from the join.
+   * @param[out] tuple The next tuple produced by the join
+   * @param[out] rid The next tuple RID produced, not used by merge join.
+   * @return `true` if a tuple was produced, `false` if there are no more tuples.
+   */
+  auto Next(Tuple *tuple, RID *rid) -> bool override;
+
+  /**
+   * Yield the next batch of tuples from the join.
+   * @param[out] batch The batch to fill
+   * @return `true` if at least one tuple was produced, `false` if there are no more tuples
+   */
+  auto NextBatch(TupleBatch *batch) -> bool override;
+
+  /** @return The output schema for the join */
+  auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); };
+
+ private:
+  /** Move to the next left tuple and compute its key. */
+  auto NextLeftTuple() -> bool;
+
+  /** Move to the next right tuple and compute its key. */
+  auto NextRightTuple() -> bool;
+
+  /** Make run_ the right tuples whose key equals left_key_, skipping the smaller right keys. */
+  void LoadRun();
+
+  /** Concatenate left_tuple_ with `right_tuple`, or with NULLs when it is nullptr. */
+  void MakeOutputTuple(const Tuple *right_tuple, Tuple *tuple) const;
+
+  /** The merge join plan node to be executed. */
+  const MergeJoinPlanNode *plan_;
+  std::unique_ptr<AbstractExecutor> left_executor_;
+  std::unique_ptr<AbstractExecutor> right_executor_;
+  bool is_inner_join_;
+  // 当前的 left tuple 和 key，以及它是否有匹配
+  TupleBatch left_batch_;
+  size_t left_index_{0};
+  const Tuple *left_tuple_{nullptr};
+  Value left_key_;
+  bool left_matched_{false};
+  // 下一个还没有放入 run 的 right tuple
+  TupleBatch right_batch_;
+  size_t right_index_{0};
+  const Tuple *right_tuple_{nullptr};
+  Value right_key_;
+  // key 为 run_key_ 的所有 right tuple，has_run_ 为 false 时为空；run_pos_ 是当前 left tuple 下一个要输出的
+  std::vector<Tuple> run_;
+  Value run_key_;
+  bool has_run_{false};
+  size_t run_pos_{0};
+};
+
+}  // namespace bustub
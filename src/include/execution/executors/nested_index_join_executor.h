@@ -48,11 +48,27 @@ class NestIndexJoinExecutor : public AbstractExecutor {
   auto Next(Tuple *tuple, RID *rid) -> bool override;
 
  private:
+  /**
+   * Pull up to NIJ_BATCH_SIZE tuples from the outer child and look up all their keys in the inner index at once, then
+   * read the matching inner tuples in RID order, so that each page of the inner table is visited once per batch.
+   * @return false if the outer child has no tuples left
+   */
+  auto FetchBatch() -> bool;
+
   /** The nested index join plan node. */
   const NestedIndexJoinPlanNode *plan_;
   bool is_inner_;
   std::unique_ptr<AbstractExecutor> child_executor_;
   IndexInfo *inner_index_info_;
   TableInfo *inner_table_info_;
+  /** The current batch of outer tuples, and the inner RIDs that match the key of each and their tuples */
+  std::vector<Tuple> outer_tuples_;
+  std::vector<std::vector<RID>> batch_results_;
+  std::vector<std::vector<Tuple>> batch_tuples_;
+  /** The outer tuple being joined and the next of its matches to emit */
+  size_t batch_pos_{0};
+  size_t match_pos_{0};
+  /** Number of outer tuples whose keys are probed in the index together */
+  static constexpr size_t NIJ_BATCH_SIZE = 128;
 };
 }  // namespace bustub
@@ -12,13 +12,19 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <utility>
 #include <vector>
 
+#include "execution/compiled_predicate.h"
 #include "execution/executor_context.h"
+#include "execution/executor_profile.h"
 #include "execution/executors/abstract_executor.h"
+#include "execution/executors/batch_executor.h"
+#include "execution/expressions/comparison_expression.h"
 #include "execution/plans/nested_loop_join_plan.h"
 #include "storage/table/tuple.h"
 
@@ -26,8 +32,18 @@ namespace bustub {
 
 /**
  * NestedLoopJoinExecutor executes a nested-loop JOIN on two tables.
+ *
+ * It is a block nested loop join: the left child is read in blocks of up to half the memory budget (see
+ * SetMemoryBudget()), and the right child is scanned once per block. The right tuples are cached during the first scan
+ * while they take less than the other half of the budget, and later blocks read the cache instead of scanning the
+ * right child again.
+ *
+ * The conjuncts of the predicate of the form `left column op right column` on numeric columns are evaluated for a
+ * right tuple against the whole block at once: the columns they read are copied out of the left tuples into arrays when
+ * the block is loaded, and each comparison is a loop over an array that the compiler vectorizes. The other conjuncts
+ * are compiled into a CompiledPredicate and checked only on the left tuples that passed.
  */
-class NestedLoopJoinExecutor : public AbstractExecutor {
+class NestedLoopJoinExecutor : public AbstractExecutor, public BatchExecutor, public MemoryConsumer {
  public:
   /**
    * Construct a new NestedLoopJoinExecutor instance.
@@ -51,29 +67,93 @@ class NestedLoopJoinExecutor : public AbstractExecutor {
    */
   auto Next(Tuple *tuple, RID *rid) -> bool override;
 
+  /**
+   * Yield the next batch of tuples from the join.
+   * @param[out] batch The batch to fill
+   * @return `true` if at least one tuple was produced, `false` if there are no more tuples
+   */
+  auto NextBatch(TupleBatch *batch) -> bool override;
+
   /** @return The output schema for the insert */
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); };
 
+  /** @return The largest number of bytes of a left block and the cached right tuples held at once */
+  auto PeakMemoryBytes() const -> size_t override { return peak_memory_bytes_; }
+
+  /** Set the number of bytes of left and cached right tuples a nested loop join keeps in memory. */
+  static void SetMemoryBudget(size_t bytes) { memory_budget_.store(bytes, std::memory_order_relaxed); }
+
  private:
+  /** A conjunct `left column op right column`, with the left column of the block in an array */
+  struct BlockComparison {
+    ComparisonType comp_type_;
+    uint32_t left_col_idx_;
+    uint32_t right_col_idx_;
+    // 任意一边是 DECIMAL 时按 double 比较，否则按 int64_t
+    bool is_decimal_;
+    std::vector<int64_t> ints_;
+    std::vector<double> decimals_;
+    // left column 不为 NULL 时为 1
+    std::vector<uint8_t> valid_;
+  };
+
+  static constexpr size_t NLJ_DEFAULT_MEMORY_BUDGET = 16 << 20;
+
+  static inline std::atomic<size_t> memory_budget_{NLJ_DEFAULT_MEMORY_BUDGET};
+
+  /** Split the predicate into block_comparisons_ and the residual predicate. */
+  void CompilePredicate();
+
+  /**
+   * Load the next block of left tuples and their columns, and restart the right side.
+   * @return `false` if the left child has no tuples left
+   */
+  auto NextLeftBlock() -> bool;
+
+  /** Move right_tuple_ to the next right tuple of the current scan, from the cache or the right child. */
+  auto NextRightTuple() -> bool;
+
+  /** Set mask_ to the left tuples of the block that pass every block comparison with right_tuple_. */
+  void ComputeMask();
+
+  /** Concatenate `left_tuple` with `right_tuple`, or with NULLs when it is nullptr. */
+  void MakeOutputTuple(const Tuple &left_tuple, const Tuple *right_tuple, Tuple *tuple);
+
   /** The NestedLoopJoin plan node to be executed. */
   const NestedLoopJoinPlanNode *plan_;
   std::unique_ptr<AbstractExecutor> left_executor_;
   std::unique_ptr<AbstractExecutor> right_executor_;
-  // 下次 right tuples 起始位置
-  size_t right_index_;
-  // all tuples in right table
-  std::vector<Tuple> right_tuples_;
-  // all columns in left table followed by right table
-  std::vector<Column> all_columns_;
   // inner join or left outer join
   bool is_inner_join_;
-  // 上一次的 left table tuple
-  Tuple left_tuple_;
   Schema left_schema_;
   Schema right_schema_;
-  // 该 left tuple 是否匹配成功
-  bool is_successful_;
-  bool need_next_left_tuple_;
+  std::vector<BlockComparison> block_comparisons_;
+  // 其余的 conjunct，没有时为 nullptr
+  AbstractExpressionRef residual_expr_;
+  std::unique_ptr<CompiledPredicate> residual_;
+  // 当前的 left block，每个 tuple 是否有匹配，以及与 right_tuple_ 的比较结果
+  std::vector<Tuple> left_block_;
+  std::vector<uint8_t> left_matched_;
+  std::vector<uint8_t> mask_;
+  // 从 left child 读到的 batch，前 left_index_ 个已经放入 block
+  TupleBatch left_batch_;
+  size_t left_index_{0};
+  bool left_done_{false};
+  // block 中下一个与 right_tuple_ 比较的，以及下一个检查是否需要输出 NULL 的 left tuple
+  size_t left_pos_{0};
+  size_t unmatched_pos_{0};
+  // right side：第一次 scan 时缓存 right tuple，right_cached_ 为 true 后从缓存读取
+  std::vector<Tuple> right_tuples_;
+  size_t right_cache_bytes_{0};
+  size_t left_block_bytes_{0};
+  size_t peak_memory_bytes_{0};
+  bool caching_{false};
+  bool right_cached_{false};
+  TupleBatch right_batch_;
+  size_t right_index_{0};
+  const Tuple *right_tuple_{nullptr};
+  // output tuple 的 values，在 tuple 之间复用
+  std::vector<Value> values_;
 };
 
 }  // namespace bustub
@@ -12,11 +12,15 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
+#include "concurrency/version_store.h"
+#include "execution/compiled_predicate.h"
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
+#include "execution/executors/batch_executor.h"
 #include "execution/plans/seq_scan_plan.h"
 #include "storage/table/tuple.h"
 
@@ -25,7 +29,7 @@ namespace bustub {
 /**
  * The SeqScanExecutor executor executes a sequential table scan.
  */
-class SeqScanExecutor : public AbstractExecutor {
+class SeqScanExecutor : public AbstractExecutor, public BatchExecutor, public MorselSource {
  public:
   /**
    * Construct a new SeqScanExecutor instance.
@@ -34,6 +38,9 @@ class SeqScanExecutor : public AbstractExecutor {
    */
   SeqScanExecutor(ExecutorContext *exec_ctx, const SeqScanPlanNode *plan);
 
+  /** Give back the table lock escalation of a scan that was not read to the end, e.g. under a LIMIT. */
+  ~SeqScanExecutor() override { ReleaseEscalation(); }
+
   /** Initialize the sequential scan */
   void Init() override;
 
@@ -45,14 +52,73 @@ class SeqScanExecutor : public AbstractExecutor {
    */
   auto Next(Tuple *tuple, RID *rid) -> bool override;
 
+  /**
+   * Yield the next batch of tuples from the sequential scan.
+   * @param[out] batch The batch to fill
+   * @return `true` if at least one tuple was produced, `false` if there are no more tuples
+   */
+  auto NextBatch(TupleBatch *batch) -> bool override;
+
+  /**
+   * Scan the table with `num_threads` workers, each taking the next SEQ_SCAN_MORSEL_PAGES pages of the page chain
+   * when it is done with its last morsel. Rows are locked or read in the snapshot as in Next(). Only possible before
+   * the first Next().
+   * @return `false` if Next() or NextBatch() was called since Init()
+   */
+  auto ScanMorsels(size_t num_threads, const MorselConsumer &consume) -> bool override;
+
   /** @return The output schema for the sequential scan */
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); }
 
  private:
+  /**
+   * Append the RIDs of the rows of table page `page_id`, and in a snapshot the versioned rows that are deleted in the
+   * heap, in slot order.
+   * @return the id of the next page of the table
+   */
+  auto ReadPageRids(page_id_t page_id, std::vector<RID> *rids) -> page_id_t;
+
+  /**
+   * Read a row of the table: in the snapshot, or under the lock taken by LockRow().
+   * @return `false` if the row does not exist, or does not satisfy the filter predicate of the plan
+   */
+  auto ReadRow(const RID &rid, Tuple *tuple) -> bool;
+
+  /** Lock the row in shared mode if the isolation level needs it and the txn holds no lock on it. */
+  auto LockRow(const RID &rid) -> bool;
+
+  /** Release the lock taken by LockRow() right after reading the row, under READ_COMMITTED. */
+  void UnlockRow(const RID &rid, bool locked);
+
+  /** Upgrade the IS table lock to S if no other txn is writing the table, so that rows need no lock any more. */
+  void TryEscalate();
+
+  /** Downgrade the S table lock of TryEscalate() back to IS, at the end of the scan. */
+  void ReleaseEscalation();
+
   /** The sequential scan plan node to be executed */
   const SeqScanPlanNode *plan_;
   TableHeap *table_heap_ptr_;
-  TableIterator table_iterator_ptr_;
-  TableIterator table_iterator_end_;
+  /** The filter predicate pushed into the scan, nullptr if none */
+  std::unique_ptr<CompiledPredicate> filter_;
+  /** Whether Next() was called since Init() */
+  bool started_{false};
+  /** Whether the txn holds a table lock covering every row, either from before the scan or from TryEscalate() */
+  std::atomic<bool> table_covered_{false};
+  /** Whether this scan upgraded the table lock to S, and row locks it took since Init() or the last try */
+  bool escalated_{false};
+  std::atomic<size_t> rows_locked_{0};
+  /** The snapshot the scan reads in without locks when MVCC is enabled, otherwise nullptr */
+  std::shared_ptr<const Snapshot> snapshot_;
+  /** RIDs of the current page of Next(), the next one to read, and the next page */
+  std::vector<RID> page_rids_;
+  size_t page_rid_pos_{0};
+  page_id_t next_page_id_{INVALID_PAGE_ID};
+  /** Number of table pages after the current one handed to the buffer pool for read-ahead */
+  static constexpr size_t SEQ_SCAN_PREFETCH_DEPTH = 8;
+  /** Number of table pages of a parallel scan morsel */
+  static constexpr size_t SEQ_SCAN_MORSEL_PAGES = 16;
+  /** Number of row locks taken under READ_COMMITTED before trying to lock the whole table in S mode */
+  static constexpr size_t SEQ_SCAN_ESCALATION_ROWS = 1024;
 };
 }  // namespace bustub
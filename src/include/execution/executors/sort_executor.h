@@ -12,21 +12,33 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
 #include "execution/executor_context.h"
+#include "execution/executor_profile.h"
 #include "execution/executors/abstract_executor.h"
 #include "execution/plans/seq_scan_plan.h"
 #include "execution/plans/sort_plan.h"
+#include "execution/sort_key.h"
+#include "execution/spill_file.h"
 #include "storage/table/tuple.h"
 
 namespace bustub {
 
 /**
  * The SortExecutor executor executes a sort.
+ *
+ * Tuples are sorted in memory while they take less than the memory budget (see SetMemoryBudget()). Past it, the
+ * executor becomes an external merge sort: each time the buffered tuples reach the budget they are sorted and written
+ * out as a run in a SpillFile, and Next() k-way merges the runs. When there are more than SORT_MAX_FAN_IN runs, Init()
+ * first merges them SORT_MAX_FAN_IN at a time into longer runs, so that the merge pins a bounded number of pages.
+ *
+ * The order by keys are evaluated once per tuple by a SortKeyEncoder. Normalized keys of at most 8 bytes, e.g. one or
+ * two integer columns, are sorted with a radix sort, other keys with std::sort.
  */
-class SortExecutor : public AbstractExecutor {
+class SortExecutor : public AbstractExecutor, public MemoryConsumer {
  public:
   /**
    * Construct a new SortExecutor instance.
@@ -49,11 +61,51 @@ class SortExecutor : public AbstractExecutor {
   /** @return The output schema for the sort */
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); }
 
+  /** @return The largest number of bytes of tuples sorted in memory at once, i.e. of the largest run */
+  auto PeakMemoryBytes() const -> size_t override { return peak_memory_bytes_; }
+
+  /** Set the number of bytes of tuples a sort keeps in memory before it spills sorted runs. */
+  static void SetMemoryBudget(size_t bytes) { memory_budget_.store(bytes, std::memory_order_relaxed); }
+
  private:
+  /** A tuple with its order by keys */
+  struct SortEntry {
+    SortKey key_;
+    Tuple tuple_;
+  };
+
+  static constexpr size_t SORT_DEFAULT_MEMORY_BUDGET = 64 << 20;
+  static constexpr size_t SORT_MAX_FAN_IN = 16;
+
+  static inline std::atomic<size_t> memory_budget_{SORT_DEFAULT_MEMORY_BUDGET};
+
+  /** @return `true` if entry `a` goes strictly before entry `b` */
+  auto EntryLess(const SortEntry &a, const SortEntry &b) const -> bool { return encoder_.Less(a.key_, b.key_); }
+
+  /** Sort sort_entries_ in memory. */
+  void SortEntries();
+
+  /** Sort sort_entries_ and move them to a new run. */
+  void SpillRun();
+
+  /** Load the first tuple of every run into the merge heap. */
+  void InitMerge();
+
+  /** Pop the smallest tuple of the runs. */
+  auto NextMerged(Tuple *tuple) -> bool;
+
   /** The sort plan node to be executed */
   const SortPlanNode *plan_;
   std::unique_ptr<AbstractExecutor> child_executor_;
-  std::vector<Tuple> sort_tuples_;
-  std::vector<Tuple>::iterator sort_tuples_iter_;
+  SortKeyEncoder encoder_;
+  // 在内存中排序的 tuple，没有 run 时直接按顺序输出
+  std::vector<SortEntry> sort_entries_;
+  size_t sort_pos_{0};
+  // external sort：已经排好序的 run，merge_heads_[i] 为 runs_[i] 当前最小的 tuple
+  std::vector<std::unique_ptr<SpillFile>> runs_;
+  std::vector<SortEntry> merge_heads_;
+  // runs_ 的下标，按 merge_heads_ 组成的最小堆
+  std::vector<size_t> merge_heap_;
+  size_t peak_memory_bytes_{0};
 };
 }  // namespace bustub
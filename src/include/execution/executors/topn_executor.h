@@ -16,17 +16,22 @@
 #include <vector>
 
 #include "execution/executor_context.h"
+#include "execution/executor_profile.h"
 #include "execution/executors/abstract_executor.h"
 #include "execution/plans/seq_scan_plan.h"
 #include "execution/plans/topn_plan.h"
+#include "execution/sort_key.h"
 #include "storage/table/tuple.h"
 
 namespace bustub {
 
 /**
  * The TopNExecutor executor executes a topn.
+ *
+ * It keeps a max-heap of the keys of the best N tuples seen so far, each pointing to a slot of tuples_. A child tuple
+ * whose key does not beat the worst of them is dropped right after its key is computed, without being copied.
  */
-class TopNExecutor : public AbstractExecutor {
+class TopNExecutor : public AbstractExecutor, public MemoryConsumer {
  public:
   /**
    * Construct a new TopNExecutor instance.
@@ -49,11 +54,25 @@ class TopNExecutor : public AbstractExecutor {
   /** @return The output schema for the topn */
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); }
 
+  /** @return The largest number of bytes of the N kept tuples and their keys */
+  auto PeakMemoryBytes() const -> size_t override { return peak_memory_bytes_; }
+
  private:
   /** The topn plan node to be executed */
   const TopNPlanNode *plan_;
   std::unique_ptr<AbstractExecutor> child_executor_;
+  /** The order by key of a tuple kept in tuples_[slot_] */
+  struct TopNEntry {
+    SortKey key_;
+    size_t slot_;
+  };
+
+  SortKeyEncoder encoder_;
+  // 最多 N 个 tuple，按读入顺序存放，被替换时原地覆盖
   std::vector<Tuple> tuples_;
-  std::vector<Tuple>::iterator tuples_iter_;
+  // Init 中是以 key 为序的最大堆，Init 结束后按 key 从小到大排序
+  std::vector<TopNEntry> entries_;
+  size_t entries_pos_{0};
+  size_t peak_memory_bytes_{0};
 };
 }  // namespace bustub
@@ -27,6 +27,12 @@ namespace bustub {
 /**
  * UpdateExecutor executes an update on a table.
  * Updated values are always pulled from a child.
+ *
+ * A row is updated in place with TableHeap::UpdateTuple(), keeping its RID, and only the indexes whose key changed get
+ * their entry moved. When the new tuple does not fit in the page of the old one, the old one is deleted and the new
+ * one inserted under a new RID, with every index entry moved. The RID every row ends up at is remembered, and the
+ * child reading it again (an index scan meeting the new key further on, or a scan reaching the reinserted tuple) is
+ * skipped, so no row is updated twice.
  */
 class UpdateExecutor : public AbstractExecutor {
   friend class UpdatePlanNode;
@@ -58,11 +64,22 @@ class UpdateExecutor : public AbstractExecutor {
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); }
 
  private:
+  /**
+   * Insert the entry of an updated row through IndexVacuum::InsertEntry(), which waits for the deleter of a dead row
+   * holding the key. Aborts the txn if a live row holds it.
+   */
+  void InsertIndexEntry(IndexInfo *index_info, const Tuple &key, const RID &rid);
+
   /** The update plan node to be executed */
   const UpdatePlanNode *plan_;
   /** Metadata identifying the table that should be updated */
   const TableInfo *table_info_;
   /** The child executor to obtain value from */
   std::unique_ptr<AbstractExecutor> child_executor_;
+  TableHeap *table_heap_ptr_;
+  /** Indexes of the table, and whether a target expression may change one of their key columns */
+  std::vector<IndexInfo *> indexes_;
+  std::vector<bool> index_may_change_;
+  bool done_{false};
 };
 }  // namespace bustub
@@ -0,0 +1,55 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// parameter_value_expression.h
+//
+// Identification: src/include/execution/expressions/parameter_value_expression.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/exception.h"
+#include "execution/expressions/abstract_expression.h"
+
+namespace bustub {
+
+/**
+ * ParameterValueExpression is the placeholder `$slot` of a prepared plan, see PlanCache. Its value is only known when
+ * the plan is bound, so the optimizer treats it as an unknown value of its type: it is not a ConstantValueExpression
+ * and rules that look at constants leave it alone. A plan is always bound before it is executed.
+ */
+class ParameterValueExpression : public AbstractExpression {
+ public:
+  /**
+   * @param slot the index of the parameter, starting at 0
+   * @param ret_type the type of the values bound to the parameter
+   */
+  ParameterValueExpression(size_t slot, TypeId ret_type) : AbstractExpression({}, ret_type), slot_(slot) {}
+
+  auto Evaluate(const Tuple *tuple, const Schema &schema) const -> Value override {
+    throw ExecutionException(fmt::format("parameter ${} is not bound", slot_ + 1));
+  }
+
+  auto EvaluateJoin(const Tuple *left_tuple, const Schema &left_schema, const Tuple *right_tuple,
+                    const Schema &right_schema) const -> Value override {
+    throw ExecutionException(fmt::format("parameter ${} is not bound", slot_ + 1));
+  }
+
+  /** @return the parameter as `$1`, `$2`... */
+  auto ToString() const -> std::string override { return fmt::format("${}", slot_ + 1); }
+
+  BUSTUB_EXPR_CLONE_WITH_CHILDREN(ParameterValueExpression);
+
+  /** The index of the parameter, starting at 0 */
+  size_t slot_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,59 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// exchange_plan.h
+//
+// Identification: src/include/execution/plans/exchange_plan.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <string>
+#include <utility>
+
+#include "execution/plans/abstract_plan.h"
+
+namespace bustub {
+
+/**
+ * ExchangePlanNode runs its child, a pipeline of scans, filters and hash join probes, on several threads and gathers
+ * the tuples of all of them. The order of the tuples is lost.
+ */
+class ExchangePlanNode : public AbstractPlanNode {
+ public:
+  /**
+   * Construct a new ExchangePlanNode instance.
+   * @param child The pipeline to run in parallel
+   * @param num_threads The number of threads the pipeline runs on
+   */
+  ExchangePlanNode(AbstractPlanNodeRef child, size_t num_threads)
+      : AbstractPlanNode(child->output_schema_, {child}), num_threads_(num_threads) {}
+
+  /** @return The type of the plan node */
+  auto GetType() const -> PlanType override { return PlanType::Exchange; }
+
+  /** @return The child plan node */
+  auto GetChildPlan() const -> AbstractPlanNodeRef {
+    BUSTUB_ASSERT(GetChildren().size() == 1, "Exchange should have exactly one child plan.");
+    return GetChildAt(0);
+  }
+
+  /** @return The number of threads the pipeline runs on */
+  auto GetNumThreads() const -> size_t { return num_threads_; }
+
+  BUSTUB_PLAN_NODE_CLONE_WITH_CHILDREN(ExchangePlanNode);
+
+  /** The number of threads the pipeline runs on */
+  size_t num_threads_;
+
+ protected:
+  auto PlanNodeToString() const -> std::string override {
+    return fmt::format("Exchange {{ num_threads={} }}", num_threads_);
+  }
+};
+
+}  // namespace bustub
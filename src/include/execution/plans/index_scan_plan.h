@@ -12,12 +12,14 @@
 
 #pragma once
 
+#include <optional>
 #include <string>
 #include <utility>
 
 #include "catalog/catalog.h"
 #include "execution/expressions/abstract_expression.h"
 #include "execution/plans/abstract_plan.h"
+#include "type/value.h"
 
 namespace bustub {
 /**
@@ -33,6 +35,24 @@ class IndexScanPlanNode : public AbstractPlanNode {
   IndexScanPlanNode(SchemaRef output, index_oid_t index_oid)
       : AbstractPlanNode(std::move(output), {}), index_oid_(index_oid) {}
 
+  /**
+   * Creates a new index range scan plan node.
+   * @param output the output format of this scan plan node
+   * @param index_oid the identifier of the index to be scanned
+   * @param table_name the name of the table the index belongs to
+   * @param low_key only keys at or above low_key are scanned, no lower bound if empty
+   * @param high_key only keys below high_key are scanned, no upper bound if empty
+   * @param reverse scan in descending key order
+   */
+  IndexScanPlanNode(SchemaRef output, index_oid_t index_oid, std::string table_name, std::optional<Value> low_key,
+                    std::optional<Value> high_key, bool reverse)
+      : AbstractPlanNode(std::move(output), {}),
+        index_oid_(index_oid),
+        table_name_(std::move(table_name)),
+        low_key_(std::move(low_key)),
+        high_key_(std::move(high_key)),
+        reverse_(reverse) {}
+
   auto GetType() const -> PlanType override { return PlanType::IndexScan; }
 
   /** @return the identifier of the table that should be scanned */
@@ -44,10 +64,37 @@ class IndexScanPlanNode : public AbstractPlanNode {
   index_oid_t index_oid_;
 
   // Add anything you want here for index lookup
+  /** The table of the index, empty when the planner did not record it. */
+  std::string table_name_;
+  /** The scanned keys are in [low_key_, high_key_), a missing bound leaves that side open. */
+  std::optional<Value> low_key_;
+  std::optional<Value> high_key_;
+  /**
+   * The conditions on the key column of a prepared plan whose bounds are parameters, see PlanCache. The range is
+   * computed from them by Optimizer::BindKeyRange() when the parameters are bound, low_key_ and high_key_ are unset
+   * until then.
+   */
+  AbstractExpressionRef key_predicate_;
+  /** Emit the tuples in descending key order. */
+  bool reverse_{false};
+  /**
+   * Build the output tuples from the index keys alone, without fetching them from the table heap. Only set when the
+   * plan above reads no column outside of the index key, the other columns of the output are NULL.
+   */
+  bool index_only_{false};
 
  protected:
   auto PlanNodeToString() const -> std::string override {
-    return fmt::format("IndexScan {{ index_oid={} }}", index_oid_);
+    if (key_predicate_ != nullptr) {
+      return fmt::format("IndexScan {{ index_oid={}, range={}, reverse={}, index_only={} }}", index_oid_,
+                         key_predicate_, reverse_, index_only_);
+    }
+    if (!low_key_.has_value() && !high_key_.has_value() && !reverse_ && !index_only_) {
+      return fmt::format("IndexScan {{ index_oid={} }}", index_oid_);
+    }
+    return fmt::format("IndexScan {{ index_oid={}, range=[{}, {}), reverse={}, index_only={} }}", index_oid_,
+                       low_key_.has_value() ? low_key_->ToString() : "-inf",
+                       high_key_.has_value() ? high_key_->ToString() : "+inf", reverse_, index_only_);
   }
 };
 
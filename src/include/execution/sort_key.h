@@ -0,0 +1,80 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// sort_key.h
+//
+// Identification: src/include/execution/sort_key.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "catalog/schema.h"
+#include "execution/expressions/abstract_expression.h"
+#include "execution/plans/sort_plan.h"
+#include "storage/table/tuple.h"
+#include "type/value.h"
+
+namespace bustub {
+
+/** The order by keys of one tuple, evaluated once. */
+struct SortKey {
+  /** normalized key, when the encoder is normalized */
+  std::string normalized_;
+  /** values of the order by expressions, otherwise */
+  std::vector<Value> values_;
+};
+
+/**
+ * SortKeyEncoder evaluates the order by expressions of a sort or a top-n once per tuple.
+ *
+ * When every expression returns a fixed-width type, the values are encoded into a normalized key: a byte string whose
+ * memcmp order is the order by order. Integers are stored big-endian with the sign bit flipped, decimals with the sign
+ * bit flipped or every bit flipped when negative, and every byte of a DESC key is inverted. NULL goes where the
+ * reserved NULL value of its type goes, i.e. first for ASC on everything but timestamps.
+ * With a VARCHAR key, the values are kept and compared with Value comparisons instead.
+ */
+class SortKeyEncoder {
+ public:
+  explicit SortKeyEncoder(const std::vector<std::pair<OrderByType, AbstractExpressionRef>> &order_bys);
+
+  /** @return `true` if keys are normalized, so that Less() is a memcmp */
+  auto IsNormalized() const -> bool { return normalized_; }
+
+  /** @return number of bytes of a normalized key */
+  auto GetKeySize() const -> size_t { return key_size_; }
+
+  /** Evaluate the order by expressions on `tuple`, with the schema of the child that produced it. */
+  auto MakeKey(const Tuple &tuple, const Schema &schema) const -> SortKey;
+
+  /** @return `true` if key `a` goes strictly before key `b` */
+  auto Less(const SortKey &a, const SortKey &b) const -> bool {
+    return normalized_ ? a.normalized_.compare(b.normalized_) < 0 : ValuesLess(a.values_, b.values_);
+  }
+
+  /** @return the first 8 bytes of a normalized key as a big-endian integer, for radix sorting short keys */
+  static auto KeyPrefix(const SortKey &key) -> uint64_t;
+
+ private:
+  auto ValuesLess(const std::vector<Value> &a, const std::vector<Value> &b) const -> bool;
+
+  const std::vector<std::pair<OrderByType, AbstractExpressionRef>> &order_bys_;
+  bool normalized_{true};
+  size_t key_size_{0};
+};
+
+/**
+ * Sort (key, index) pairs by key with an LSD radix sort over the low `key_bytes` bytes, 8 bits per pass. A pass is
+ * skipped when all keys have the same byte at that position.
+ */
+void RadixSortKeys(std::vector<std::pair<uint64_t, uint32_t>> *keys, size_t key_bytes);
+
+}  // namespace bustub
@@ -0,0 +1,76 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// spill_file.h
+//
+// Identification: src/include/execution/spill_file.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "storage/page/page.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * SpillFile is an append-only run of tuples kept in temporary pages of the buffer pool, for executors whose state
+ * does not fit in their memory budget. Only the page being written and the page being read are pinned, the others
+ * can be evicted to disk like any other page. The pages are deleted with the file.
+ *
+ * Page layout: | num_tuples (4) | tuple_size (4) | tuple_data | tuple_size (4) | tuple_data | ... |
+ */
+class SpillFile {
+ public:
+  explicit SpillFile(BufferPoolManager *bpm) : bpm_(bpm) {}
+  ~SpillFile();
+
+  SpillFile(const SpillFile &) = delete;
+  auto operator=(const SpillFile &) -> SpillFile & = delete;
+
+  /** Append a tuple, its RID is not kept. Throws ExecutionException when the buffer pool has no free frame. */
+  void Append(const Tuple &tuple);
+
+  /** Stop appending and make Next() start again from the first tuple. */
+  void Rewind();
+
+  /**
+   * Read the next tuple, in the order they were appended.
+   * @return false once all the tuples have been read
+   */
+  auto Next(Tuple *tuple) -> bool;
+
+  /** @return number of tuples appended */
+  auto GetNumTuples() const -> size_t { return num_tuples_; }
+
+  /** @return number of temporary pages used */
+  auto GetNumPages() const -> size_t { return page_ids_.size(); }
+
+ private:
+  static constexpr size_t SPILL_PAGE_HEADER_SIZE = sizeof(uint32_t);
+
+  /** Unpin the page being written, if any. */
+  void FinishWritePage();
+
+  BufferPoolManager *bpm_;
+  std::vector<page_id_t> page_ids_;
+  size_t num_tuples_{0};
+  // 正在写的 page（最后一个 page），以及写入位置
+  Page *write_page_{nullptr};
+  size_t write_offset_{0};
+  // 正在读的 page 在 page_ids_ 中的下标，该 page 中已经读过的 tuple 数和读取位置
+  Page *read_page_{nullptr};
+  size_t read_page_index_{0};
+  uint32_t read_count_{0};
+  size_t read_offset_{0};
+};
+
+}  // namespace bustub
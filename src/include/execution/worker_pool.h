@@ -0,0 +1,81 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// worker_pool.h
+//
+// Identification: src/include/execution/worker_pool.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace bustub {
+
+/**
+ * WorkerPool is the set of threads shared by the parallel parts of all queries, instead of each executor starting its
+ * own threads.
+ *
+ * RunParallel() runs a number of tasks and returns when they are all done. The calling thread runs tasks too, and the
+ * pool threads join in when they are free, taking the next task not yet started. So a RunParallel() called from a task
+ * of another one, or while the pool is busy with other queries, always makes progress, at worst on the calling thread
+ * alone.
+ */
+class WorkerPool {
+ public:
+  /** Start `num_threads` pool threads. */
+  explicit WorkerPool(size_t num_threads);
+
+  ~WorkerPool();
+
+  /** @return the pool shared by all executors, with one thread per hardware thread */
+  static auto Get() -> WorkerPool &;
+
+  /** @return number of pool threads */
+  auto Size() const -> size_t { return threads_.size(); }
+
+  /**
+   * Run `task(i)` for every i in [0, num_tasks) on the pool and the calling thread, and wait for all of them. An
+   * exception thrown by a task is rethrown here once all the tasks are done, the other tasks still run.
+   */
+  void RunParallel(size_t num_tasks, const std::function<void(size_t)> &task);
+
+ private:
+  /** The tasks of one RunParallel() call */
+  struct TaskGroup {
+    const std::function<void(size_t)> *task_;
+    size_t num_tasks_;
+    std::atomic<size_t> next_{0};
+    size_t done_{0};
+    std::exception_ptr error_;
+    std::mutex latch_;
+    std::condition_variable done_cv_;
+  };
+
+  /** Run the tasks of `group` not yet started, until there are none left. */
+  static void RunTasks(TaskGroup *group);
+
+  void RunWorker();
+
+  std::vector<std::thread> threads_;
+  // 还有未开始的 task 的 group，一个 group 可能出现多次，每次由一个 pool thread 取走
+  std::deque<std::shared_ptr<TaskGroup>> queue_;
+  bool stopped_{false};
+  std::mutex latch_;
+  std::condition_variable queue_cv_;
+};
+
+}  // namespace bustub
@@ -11,6 +11,8 @@
 #include "concurrency/transaction.h"
 #include "execution/expressions/abstract_expression.h"
 #include "execution/plans/abstract_plan.h"
+#include "execution/plans/index_scan_plan.h"
+#include "execution/plans/seq_scan_plan.h"
 
 #define BUSTUB_OPTIMIZER_HACK_REMOVE_AFTER_2022_FALL
 
@@ -28,6 +30,12 @@ class Optimizer {
 
   auto OptimizeCustom(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
 
+  /**
+   * @brief compute the range of an index scan of a prepared plan from its key_predicate_, once the parameters in it
+   * are bound to constants.
+   */
+  static void BindKeyRange(IndexScanPlanNode *plan);
+
  private:
   /**
    * @brief merge projections that do identical project.
@@ -43,6 +51,24 @@ class Optimizer {
    */
   auto OptimizeMergeFilterNLJ(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
 
+  /**
+   * @brief reorder trees of inner joins by estimated cost, and choose the algorithm of each join.
+   * The inputs of a tree of inner NLJs and the conjuncts of their predicates are collected, and the cheapest bushy
+   * order is found by dynamic programming over the subsets of the inputs (greedily for large trees). The cost of a
+   * plan is the sum of the estimated output rows of its joins plus the cost of each join: hash join (building on the
+   * right side) or index join on an equi-condition, NLJ otherwise. A projection restores the original column order.
+   */
+  auto OptimizeJoinOrder(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
+
+  /**
+   * @brief estimate the number of rows a plan outputs, from the statistics of the tables it scans (see
+   * StatisticsCatalog), or EstimatedCardinality() and default selectivities for tables that were not analyzed.
+   */
+  auto EstimateRows(const AbstractPlanNode &plan) -> double;
+
+  /** @brief estimate the fraction of the rows of a seq scan that satisfy `predicate` */
+  auto EstimateSelectivity(const AbstractExpressionRef &predicate, const SeqScanPlanNode &scan_plan) -> double;
+
   /**
    * @brief optimize nested loop join into hash join.
    * In the starter code, we will check NLJs with exactly one equal condition. You can further support optimizing joins
@@ -60,6 +86,14 @@ class Optimizer {
    */
   auto OptimizeEliminateTrueFilter(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
 
+  /**
+   * @brief push the conjuncts of filters and join predicates down to the join input they read. Under an inner join a
+   * conjunct of either side moves into a filter on that side; under a left join, only the conjuncts of the filter above
+   * on the left side and the ones of the join predicate on the right side. The pushed filters reach the scans, where
+   * MergeFilterScan and FilterAsIndexRangeScan take them.
+   */
+  auto OptimizePredicatePushdown(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
+
   /**
    * @brief merge filter into filter_predicate of seq scan plan node
    */
@@ -85,6 +119,39 @@ class Optimizer {
    */
   auto OptimizeOrderByAsIndexScan(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
 
+  /**
+   * @brief optimize filter + seq scan as an index range scan when the filter compares an indexed integer column with
+   * constants. The comparisons on that column become the [low, high) range of the scan, the rest stays in a filter.
+   */
+  auto OptimizeFilterAsIndexRangeScan(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
+
+  /**
+   * @brief optimize order by (ASC or DESC) on an indexed column over a seq scan, possibly below a filter, as an index
+   * scan in that direction, so that the sort is not needed. Comparisons of the filter on the column become the range.
+   */
+  auto OptimizeOrderByAsIndexRangeScan(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
+
+  /**
+   * @brief optimize a hash join whose children both produce their tuples in ascending order of their join keys, e.g.
+   * index scans on the key columns, as a merge join, which needs no hash table.
+   */
+  auto OptimizeHashJoinAsMergeJoin(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
+
+  /**
+   * @brief mark an index scan as index-only when the projection or aggregation above it, and the filters, sorts and
+   * limits in between, read no column outside of the index key, so that the scan skips the table heap.
+   */
+  auto OptimizeIndexOnlyScan(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
+
+  /**
+   * @brief wrap pipelines that can run per morsel on several threads (a seq scan, filters above it and hash joins
+   * probing with it) in an exchange, when the scan is estimated to read at least EXCHANGE_MIN_ROWS rows.
+   */
+  auto OptimizeParallelExchange(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
+
+  /** @brief apply OptimizeParallelExchange to the build sides of the hash joins of a pipeline */
+  auto OptimizeBuildSides(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
+
   /** @brief check if the index can be matched */
   auto MatchIndex(const std::string &table_name, uint32_t index_key_idx)
       -> std::optional<std::tuple<index_oid_t, std::string>>;
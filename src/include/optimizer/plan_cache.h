@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "catalog/catalog.h"
+#include "execution/plans/abstract_plan.h"
+#include "type/value.h"
+
+namespace bustub {
+
+/** A statement whose literals were replaced by parameters, see PlanCache::Prepare(). */
+struct PreparedPlan {
+  /** The normalized plan as text and the types of the parameters, statements with the same key share a template */
+  std::string key_;
+  /** The plan from the binder with its literals replaced by ParameterValueExpression */
+  AbstractPlanNodeRef plan_;
+  std::vector<TypeId> param_types_;
+  /** `false` if the plan has a node whose literals are unknown, the statement is then optimized every time */
+  bool cacheable_;
+};
+
+/**
+ * PlanCache keeps the optimized plans of prepared statements, so that a statement repeated with other literals skips
+ * the optimizer.
+ *
+ * Prepare() replaces each literal of the plan from the binder by a ParameterValueExpression `$1`, `$2`... in the order
+ * the plan is walked, and returns the literals as the parameters. Boolean and NULL literals are kept: the optimizer
+ * uses them to drop `true` predicates. Statements that differ only in their literals normalize to the same plan and
+ * share a key; numbers that are not expressions, such as the count of a LIMIT, stay in the key.
+ *
+ * On a miss the normalized plan itself is optimized and cached as a template. The rules see a parameter as an unknown
+ * value of its type, so the template is a generic plan that is correct for any parameters: a condition on an index key
+ * with a parameter still becomes an index scan, whose range is computed when the plan is bound. Bind() replaces each
+ * `$i` of the template by the i-th parameter, so the binding is exact.
+ *
+ * A template records the tables it reads and writes and their number of indexes. It is dropped when one of these
+ * tables is gone or has gained an index, so a new index is used by the next statement. Invalidate() drops every
+ * template; it should be called after ANALYZE, as a generic plan keeps the join order chosen with the old statistics.
+ */
+class PlanCache {
+ public:
+  using OptimizeFn = std::function<AbstractPlanNodeRef(const AbstractPlanNodeRef &)>;
+
+  explicit PlanCache(const Catalog &catalog, size_t capacity = PLAN_CACHE_CAPACITY)
+      : catalog_(catalog), capacity_(capacity) {}
+
+  /**
+   * @param bound_plan the plan of the statement from the binder, before optimization
+   * @param[out] params the literals of the statement, in slot order
+   * @return the statement with its literals replaced by parameters
+   */
+  static auto Prepare(const AbstractPlanNodeRef &bound_plan, std::vector<Value> *params) -> PreparedPlan;
+
+  /**
+   * Get the plan of a prepared statement with the given parameters, optimizing and caching its template on a miss.
+   * @param params the parameters, of the types in prepared.param_types_
+   * @param optimize the optimizer, only called on a miss
+   * @return the optimized plan with the parameters bound, ready to execute
+   */
+  auto Bind(const PreparedPlan &prepared, const std::vector<Value> &params, const OptimizeFn &optimize)
+      -> AbstractPlanNodeRef;
+
+  /** @return the optimized plan of a statement from the binder, through its template if it has one */
+  auto GetPlan(const AbstractPlanNodeRef &bound_plan, const OptimizeFn &optimize) -> AbstractPlanNodeRef;
+
+  /** Drop every cached template. */
+  void Invalidate();
+
+  /** @return the number of Bind() calls that found a valid template */
+  auto GetHits() const -> uint64_t { return hits_.load(); }
+
+  /** @return the number of Bind() calls that had to optimize */
+  auto GetMisses() const -> uint64_t { return misses_.load(); }
+
+ private:
+  struct Template {
+    AbstractPlanNodeRef plan_;
+    /** The tables in the plan and their number of indexes when it was optimized */
+    std::vector<std::string> tables_;
+    std::vector<size_t> index_counts_;
+    /** `false` if the optimized plan has a node that cannot be bound, the statement is then optimized every time */
+    bool bindable_;
+    uint64_t epoch_;
+  };
+
+  static constexpr size_t PLAN_CACHE_CAPACITY = 1024;
+
+  /** @return the plan with each parameter replaced by its value, nullptr if it has a node that cannot be bound */
+  static auto BindParams(const AbstractPlanNodeRef &plan, const std::vector<Value> &params) -> AbstractPlanNodeRef;
+
+  /** @return the names of the tables a plan reads or writes */
+  auto TablesOf(const AbstractPlanNodeRef &plan) const -> std::vector<std::string>;
+
+  /** @return the number of indexes of each table, SIZE_MAX for a table that does not exist */
+  auto IndexCounts(const std::vector<std::string> &tables) const -> std::vector<size_t>;
+
+  const Catalog &catalog_;
+  size_t capacity_;
+  std::atomic<uint64_t> epoch_{0};
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  /** LRU order of the keys, most recent first */
+  std::list<std::string> lru_;
+  std::unordered_map<std::string, std::pair<Template, std::list<std::string>::iterator>> templates_;
+  std::mutex latch_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,342 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// art_node.h
+//
+// Identification: src/include/primer/art_node.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace bustub {
+
+/** The node types of the adaptive radix tree behind Trie. Inner nodes are sized by their number of children. */
+enum class ArtNodeType : uint8_t { Leaf = 0, Node4, Node16, Node48, Node256 };
+
+/** Type-erased value of a leaf, so that a Trie holds values of different types. */
+class ArtValueBase {
+ public:
+  virtual ~ArtValueBase() = default;
+};
+
+template <typename T>
+class ArtValue : public ArtValueBase {
+ public:
+  explicit ArtValue(T value) : value_(std::move(value)) {}
+
+  auto GetValue() const -> const T & { return value_; }
+
+ private:
+  T value_;
+};
+
+/** Common header of all nodes. Nodes have no virtual destructor, ArtFreeNode() deletes them by type. */
+struct ArtNode {
+  explicit ArtNode(ArtNodeType type) : type_(type) {}
+
+  auto IsLeaf() const -> bool { return type_ == ArtNodeType::Leaf; }
+
+  const ArtNodeType type_;
+};
+
+/** A key and its value. The full key is kept so that lookups can skip the prefix bytes inner nodes do not store. */
+struct ArtLeaf : public ArtNode {
+  ArtLeaf(std::string key, std::unique_ptr<ArtValueBase> value)
+      : ArtNode(ArtNodeType::Leaf), key_(std::move(key)), value_(std::move(value)) {}
+
+  const std::string key_;
+  const std::unique_ptr<ArtValueBase> value_;
+};
+
+/**
+ * Header of inner nodes. prefix_len_ bytes of the key are consumed by this node (path compression) before the byte
+ * that picks the child; only the first ART_MAX_PREFIX of them are stored, the rest are read from any leaf below.
+ * leaf_ holds the key that ends right after the prefix.
+ *
+ * Once published, the prefix, the type and, for Node4 and Node16, the keys never change: a writer replaces the node
+ * with a modified copy instead. Child slots, leaf_ and the child index of Node48 are atomics that writers store into
+ * in place.
+ */
+struct ArtInner : public ArtNode {
+  static constexpr uint32_t ART_MAX_PREFIX = 8;
+
+  explicit ArtInner(ArtNodeType type) : ArtNode(type) {}
+
+  void SetPrefix(const char *prefix, uint32_t prefix_len) {
+    prefix_len_ = prefix_len;
+    memcpy(prefix_.data(), prefix, std::min(prefix_len, ART_MAX_PREFIX));
+  }
+
+  uint16_t num_children_{0};
+  uint32_t prefix_len_{0};
+  std::array<char, ART_MAX_PREFIX> prefix_{};
+  std::atomic<ArtLeaf *> leaf_{nullptr};
+};
+
+/** Up to 4 children, keys sorted. */
+struct ArtNode4 : public ArtInner {
+  ArtNode4() : ArtInner(ArtNodeType::Node4) {}
+  std::array<uint8_t, 4> keys_{};
+  std::array<std::atomic<ArtNode *>, 4> children_{};
+};
+
+/** Up to 16 children, keys sorted. */
+struct ArtNode16 : public ArtInner {
+  ArtNode16() : ArtInner(ArtNodeType::Node16) {}
+  std::array<uint8_t, 16> keys_{};
+  std::array<std::atomic<ArtNode *>, 16> children_{};
+};
+
+/** Up to 48 children, child_index_[byte] is the slot of the child plus one, 0 when there is none. */
+struct ArtNode48 : public ArtInner {
+  ArtNode48() : ArtInner(ArtNodeType::Node48) {}
+  std::array<std::atomic<uint8_t>, 256> child_index_{};
+  std::array<std::atomic<ArtNode *>, 48> children_{};
+};
+
+/** One slot per byte. */
+struct ArtNode256 : public ArtInner {
+  ArtNode256() : ArtInner(ArtNodeType::Node256) {}
+  std::array<std::atomic<ArtNode *>, 256> children_{};
+};
+
+/** @return max number of children of an inner node type */
+inline auto ArtCapacity(ArtNodeType type) -> size_t {
+  switch (type) {
+    case ArtNodeType::Node4:
+      return 4;
+    case ArtNodeType::Node16:
+      return 16;
+    case ArtNodeType::Node48:
+      return 48;
+    default:
+      return 256;
+  }
+}
+
+/** @return a new empty inner node of the smallest type holding `num_children` children */
+inline auto ArtNewInner(size_t num_children) -> ArtInner * {
+  if (num_children <= 4) {
+    return new ArtNode4();
+  }
+  if (num_children <= 16) {
+    return new ArtNode16();
+  }
+  if (num_children <= 48) {
+    return new ArtNode48();
+  }
+  return new ArtNode256();
+}
+
+/** @return the slot of the child for `byte`, nullptr if there is none. The slot may still hold nullptr. */
+inline auto ArtFindChild(ArtInner *node, uint8_t byte) -> std::atomic<ArtNode *> * {
+  switch (node->type_) {
+    case ArtNodeType::Node4: {
+      auto n = static_cast<ArtNode4 *>(node);
+      for (size_t i = 0; i < n->num_children_; i++) {
+        if (n->keys_[i] == byte) {
+          return &n->children_[i];
+        }
+      }
+      return nullptr;
+    }
+    case ArtNodeType::Node16: {
+      auto n = static_cast<ArtNode16 *>(node);
+      auto end = n->keys_.begin() + n->num_children_;
+      auto it = std::lower_bound(n->keys_.begin(), end, byte);
+      return it != end && *it == byte ? &n->children_[it - n->keys_.begin()] : nullptr;
+    }
+    case ArtNodeType::Node48: {
+      auto n = static_cast<ArtNode48 *>(node);
+      auto index = n->child_index_[byte].load();
+      return index == 0 ? nullptr : &n->children_[index - 1];
+    }
+    case ArtNodeType::Node256:
+      return &static_cast<ArtNode256 *>(node)->children_[byte];
+    default:
+      return nullptr;
+  }
+}
+
+/** Call `f(byte, child)` for every child of `node` in byte order. */
+template <typename F>
+void ArtForEachChild(ArtInner *node, F &&f) {
+  switch (node->type_) {
+    case ArtNodeType::Node4: {
+      auto n = static_cast<ArtNode4 *>(node);
+      for (size_t i = 0; i < n->num_children_; i++) {
+        f(n->keys_[i], n->children_[i].load());
+      }
+      break;
+    }
+    case ArtNodeType::Node16: {
+      auto n = static_cast<ArtNode16 *>(node);
+      for (size_t i = 0; i < n->num_children_; i++) {
+        f(n->keys_[i], n->children_[i].load());
+      }
+      break;
+    }
+    case ArtNodeType::Node48: {
+      auto n = static_cast<ArtNode48 *>(node);
+      for (size_t byte = 0; byte < 256; byte++) {
+        if (auto index = n->child_index_[byte].load(); index != 0) {
+          if (auto child = n->children_[index - 1].load(); child != nullptr) {
+            f(static_cast<uint8_t>(byte), child);
+          }
+        }
+      }
+      break;
+    }
+    case ArtNodeType::Node256: {
+      auto n = static_cast<ArtNode256 *>(node);
+      for (size_t byte = 0; byte < 256; byte++) {
+        if (auto child = n->children_[byte].load(); child != nullptr) {
+          f(static_cast<uint8_t>(byte), child);
+        }
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/**
+ * Add a child for a byte that has none. Node4 and Node16 must not be published yet; Node48 and Node256 may be, the
+ * child is stored before it is made reachable. The node must not be full.
+ */
+inline void ArtAddChild(ArtInner *node, uint8_t byte, ArtNode *child) {
+  switch (node->type_) {
+    case ArtNodeType::Node4:
+    case ArtNodeType::Node16: {
+      auto keys = node->type_ == ArtNodeType::Node4 ? static_cast<ArtNode4 *>(node)->keys_.data()
+                                                    : static_cast<ArtNode16 *>(node)->keys_.data();
+      auto children = node->type_ == ArtNodeType::Node4 ? static_cast<ArtNode4 *>(node)->children_.data()
+                                                        : static_cast<ArtNode16 *>(node)->children_.data();
+      size_t pos = node->num_children_;
+      for (; pos > 0 && keys[pos - 1] > byte; pos--) {
+        keys[pos] = keys[pos - 1];
+        children[pos].store(children[pos - 1].load());
+      }
+      keys[pos] = byte;
+      children[pos].store(child);
+      break;
+    }
+    case ArtNodeType::Node48: {
+      auto n = static_cast<ArtNode48 *>(node);
+      size_t slot = 0;
+      while (n->children_[slot].load() != nullptr) {
+        slot++;
+      }
+      n->children_[slot].store(child);
+      n->child_index_[byte].store(static_cast<uint8_t>(slot + 1));
+      break;
+    }
+    case ArtNodeType::Node256:
+      static_cast<ArtNode256 *>(node)->children_[byte].store(child);
+      break;
+    default:
+      return;
+  }
+  node->num_children_++;
+}
+
+/**
+ * @return a new, unpublished inner node with the leaf and the children of `node` except the one for `exclude` (pass
+ * a value above 255 to keep all), of the smallest type holding `num_children`, with the given prefix
+ */
+inline auto ArtCopyInner(ArtInner *node, size_t num_children, const char *prefix, uint32_t prefix_len,
+                         uint32_t exclude = 256) -> ArtInner * {
+  auto copy = ArtNewInner(num_children);
+  copy->SetPrefix(prefix, prefix_len);
+  copy->leaf_.store(node->leaf_.load());
+  ArtForEachChild(node, [&](uint8_t byte, ArtNode *child) {
+    if (byte != exclude) {
+      ArtAddChild(copy, byte, child);
+    }
+  });
+  return copy;
+}
+
+/** @return some leaf of the subtree of `node`, nullptr if it has none */
+inline auto ArtAnyLeaf(ArtNode *node) -> ArtLeaf * {
+  while (node != nullptr && !node->IsLeaf()) {
+    auto inner = static_cast<ArtInner *>(node);
+    if (auto leaf = inner->leaf_.load(); leaf != nullptr) {
+      return leaf;
+    }
+    ArtNode *first = nullptr;
+    ArtForEachChild(inner, [&](uint8_t byte, ArtNode *child) {
+      if (first == nullptr) {
+        first = child;
+      }
+    });
+    node = first;
+  }
+  return static_cast<ArtLeaf *>(node);
+}
+
+/** Call `f(leaf)` for every leaf of the subtree of `node`, in key order. */
+template <typename F>
+void ArtForEachLeaf(ArtNode *node, F &&f) {
+  if (node->IsLeaf()) {
+    f(static_cast<ArtLeaf *>(node));
+    return;
+  }
+  auto inner = static_cast<ArtInner *>(node);
+  if (auto leaf = inner->leaf_.load(); leaf != nullptr) {
+    f(leaf);
+  }
+  ArtForEachChild(inner, [&](uint8_t byte, ArtNode *child) { ArtForEachLeaf(child, f); });
+}
+
+/** Delete `node` alone, not its children nor its leaf_. */
+inline void ArtFreeNode(ArtNode *node) {
+  switch (node->type_) {
+    case ArtNodeType::Leaf:
+      delete static_cast<ArtLeaf *>(node);
+      break;
+    case ArtNodeType::Node4:
+      delete static_cast<ArtNode4 *>(node);
+      break;
+    case ArtNodeType::Node16:
+      delete static_cast<ArtNode16 *>(node);
+      break;
+    case ArtNodeType::Node48:
+      delete static_cast<ArtNode48 *>(node);
+      break;
+    case ArtNodeType::Node256:
+      delete static_cast<ArtNode256 *>(node);
+      break;
+  }
+}
+
+/** Delete the whole subtree of `node`. */
+inline void ArtFreeTree(ArtNode *node) {
+  if (node == nullptr) {
+    return;
+  }
+  if (!node->IsLeaf()) {
+    auto inner = static_cast<ArtInner *>(node);
+    if (auto leaf = inner->leaf_.load(); leaf != nullptr) {
+      ArtFreeNode(leaf);
+    }
+    ArtForEachChild(inner, [](uint8_t byte, ArtNode *child) { ArtFreeTree(child); });
+  }
+  ArtFreeNode(node);
+}
+
+}  // namespace bustub
@@ -12,17 +12,23 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <stack>
 #include <stdexcept>
 #include <string>
-#include <tuple>
+#include <thread>  // NOLINT
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "common/exception.h"
-#include "common/rwlatch.h"
+#include "primer/art_node.h"
 
 namespace bustub {
 
@@ -247,28 +253,33 @@ class TrieNodeWithValue : public TrieNode {
 /**
  * Trie is a concurrent key-value store. Each key is string and its corresponding
  * value can be any type.
+ *
+ * Keys live in an adaptive radix tree (see art_node.h): inner nodes grow from 4 to 16, 48 and 256 children as needed,
+ * and chains of single-child nodes are collapsed into the prefix of the node below. A key is stored once, in its
+ * leaf, instead of one node per character.
+ *
+ * Readers take no latch. Writers are serialized by write_latch_ and never modify a node in a way a reader could see
+ * half done: a node whose keys or prefix change is replaced by a modified copy, published with one atomic store into
+ * its parent's slot. Replaced nodes are retired and freed once no reader that may still hold them is active, tracked
+ * with two reader epochs.
  */
 class Trie {
- private:
-  /* Root node of the trie */
-  std::unique_ptr<TrieNode> root_;
-  /* Read-write lock for the trie */
-  ReaderWriterLatch latch_;
-  /* root 默认的 char */
-  char default_char_ = 0;
-
  public:
-  /**
-   * TODO(P0): Add implementation
-   *
-   * @brief Construct a new Trie object. Initialize the root node with '\0'
-   * character.
-   */
-  Trie() { root_ = std::make_unique<TrieNode>(default_char_); }
+  Trie() = default;
+
+  ~Trie() {
+    ArtFreeTree(root_.load());
+    for (auto &retired : retired_) {
+      for (auto node : retired) {
+        ArtFreeNode(node);
+      }
+    }
+  }
+
+  Trie(const Trie &) = delete;
+  auto operator=(const Trie &) -> Trie & = delete;
 
   /**
-   * TODO(P0): Add implementation
-   *
    * @brief Insert key-value pair into the trie.
    *
    * If key is empty string, return false immediately.
@@ -276,18 +287,6 @@ class Trie {
    * If key alreadys exists, return false. Duplicated keys are not allowed and
    * you should never overwrite value of an existing key.
    *
-   * When you reach the ending character of a key:
-   * 1. If TrieNode with this ending character does not exist, create new TrieNodeWithValue
-   * and add it to parent node's children_ map.
-   * 2. If the terminal node is a TrieNode, then convert it into TrieNodeWithValue by
-   * invoking the appropriate constructor.
-   * 3. If it is already a TrieNodeWithValue,
-   * then insertion fails and return false. Do not overwrite existing data with new data.
-   *
-   * You can quickly check whether a TrieNode pointer holds TrieNode or TrieNodeWithValue
-   * by checking the is_end_ flag. If is_end_ == false, then it points to TrieNode. If
-   * is_end_ == true, it points to TrieNodeWithValue.
-   *
    * @param key Key used to traverse the trie and find correct node
    * @param value Value to be inserted
    * @return True if insertion succeeds, false if key already exists
@@ -298,49 +297,16 @@ class Trie {
     if (key.empty()) {
       return false;
     }
-    latch_.WLock();
-    TrieNode *p = &*root_;
-    int last_idx = key.size() - 1;
-    int idx = 0;
-    char ch;
-    // 把 key[0, lastIdx) 加到 root 下
-    while (idx < last_idx) {
-      ch = key[idx++];
-      if (!p->HasChild(ch)) {
-        p = &**(p->InsertChildNode(ch, std::make_unique<TrieNode>(ch)));
-      } else {
-        p = &**(p->GetChildNode(ch));
-      }
-    }
-    ch = key[idx];
-    auto child = p->GetChildNode(ch);
-    if (child != nullptr) {
-      if ((*child)->IsEndNode()) {
-        latch_.WUnlock();
-        return false;
-      }
-      // 如果 key[lastIdx] 不是终端节点，将其变为终端节点
-      child->reset(new TrieNodeWithValue<T>(std::move(**child), value));
-    } else {
-      p->InsertChildNode(ch, std::make_unique<TrieNodeWithValue<T>>(ch, value));
-    }
-    latch_.WUnlock();
-    return true;
+    auto leaf = std::make_unique<ArtLeaf>(key, std::make_unique<ArtValue<T>>(std::move(value)));
+    std::scoped_lock<std::mutex> lock(write_latch_);
+    bool inserted = InsertLeaf(std::move(leaf));
+    TryReclaim();
+    return inserted;
   }
 
   /**
-   * TODO(P0): Add implementation
-   *
-   * @brief Remove key value pair from the trie.
-   * This function should also remove nodes that are no longer part of another
-   * key. If key is empty or not found, return false.
-   *
-   * You should:
-   * 1) Find the terminal node for the given key.
-   * 2) If this terminal node does not have any children, remove it from its
-   * parent's children_ map.
-   * 3) Recursively remove nodes that have no children and is not terminal node
-   * of another key.
+   * @brief Remove key value pair from the trie. Nodes left with a single child are merged into it.
+   * If key is empty or not found, return false.
    *
    * @param key Key used to traverse the trie and find correct node
    * @return True if key exists and is removed, false otherwise
@@ -349,48 +315,20 @@ class Trie {
     if (key.empty()) {
       return false;
     }
-    latch_.WLock();
-    std::vector<std::tuple<char, std::unique_ptr<TrieNode> *>> v;
-    auto pre = &root_;
-    for (char ch : key) {
-      auto node = pre->get()->GetChildNode(ch);
-      if (node == nullptr) {
-        latch_.WUnlock();
-        return false;
-      }
-      v.emplace_back(std::make_tuple(ch, pre));
-      pre = node;
-    }
-    while (!v.empty()) {
-      auto tmp = v.back();
-      v.pop_back();
-      char ch = std::get<0>(tmp);
-      auto pre = std::get<1>(tmp);
-      auto child = pre->get()->GetChildNode(ch);
-      // 如果被删除的节点有附属节点，则不删除
-      if (child != nullptr && child->get()->HasChildren()) {
-        break;
-      }
-      pre->get()->RemoveChildNode(ch);
-    }
-    latch_.WUnlock();
-    return true;
+    std::scoped_lock<std::mutex> lock(write_latch_);
+    bool removed = RemoveLeaf(key);
+    TryReclaim();
+    return removed;
   }
 
   /**
-   * TODO(P0): Add implementation
-   *
    * @brief Get the corresponding value of type T given its key.
    * If key is empty, set success to false.
    * If key does not exist in trie, set success to false.
-   * If given type T is not the same as the value type stored in TrieNodeWithValue
-   * (ie. GetValue<int> is called but terminal node holds std::string),
+   * If given type T is not the same as the value type stored for the key
+   * (ie. GetValue<int> is called but the key holds std::string),
    * set success to false.
    *
-   * To check whether the two types are the same, dynamic_cast
-   * the terminal TrieNode to TrieNodeWithValue<T>. If the casted result
-   * is not nullptr, then type T is the correct type.
-   *
    * @param key Key used to traverse the trie and find correct node
    * @param success Whether GetValue is successful or not
    * @return Value of type T if type matches
@@ -401,29 +339,339 @@ class Trie {
     if (key.empty()) {
       return {};
     }
-    latch_.RLock();
-    auto p = &*root_;
-    for (char ch : key) {
-      auto child = p->GetChildNode(ch);
-      if (child == nullptr) {
-        latch_.RUnlock();
-        return {};
-      }
-      p = &**child;
-    }
-    if (!p->IsEndNode()) {
-      latch_.RUnlock();
+    ReadGuard guard(this);
+    auto leaf = FindLeaf(key);
+    if (leaf == nullptr) {
       return {};
     }
-    auto node = dynamic_cast<TrieNodeWithValue<T> *>(p);
-    if (node == nullptr) {
-      latch_.RUnlock();
+    auto value = dynamic_cast<const ArtValue<T> *>(leaf->value_.get());
+    if (value == nullptr) {
       return {};
     }
     *success = true;
-    T res = node->GetValue();
-    latch_.RUnlock();
-    return res;
+    return value->GetValue();
+  }
+
+  /**
+   * @brief Call `callback(const std::string &key, const T &value)` for every key that starts with `prefix` and holds a
+   * value of type T, in key order. Keys inserted or removed during the scan may or may not be seen.
+   */
+  template <typename T, typename F>
+  void ScanPrefix(const std::string &prefix, F &&callback) {
+    ReadGuard guard(this);
+    auto node = root_.load();
+    size_t depth = 0;
+    while (node != nullptr && !node->IsLeaf() && depth < prefix.size()) {
+      auto inner = static_cast<ArtInner *>(node);
+      auto stored = std::min<size_t>({inner->prefix_len_, ArtInner::ART_MAX_PREFIX, prefix.size() - depth});
+      if (prefix.compare(depth, stored, inner->prefix_.data(), stored) != 0) {
+        return;
+      }
+      if (depth + inner->prefix_len_ >= prefix.size()) {
+        break;
+      }
+      depth += inner->prefix_len_;
+      auto child = ArtFindChild(inner, static_cast<uint8_t>(prefix[depth++]));
+      node = child == nullptr ? nullptr : child->load();
+    }
+    // 没有保存在节点中的 prefix 字节在任意一个 leaf 上检查
+    auto any_leaf = node == nullptr ? nullptr : ArtAnyLeaf(node);
+    if (any_leaf == nullptr || any_leaf->key_.compare(0, prefix.size(), prefix) != 0) {
+      return;
+    }
+    ArtForEachLeaf(node, [&](ArtLeaf *leaf) {
+      if (auto value = dynamic_cast<const ArtValue<T> *>(leaf->value_.get()); value != nullptr) {
+        callback(leaf->key_, value->GetValue());
+      }
+    });
+  }
+
+ private:
+  static constexpr size_t TRIE_READER_SLOTS = 32;
+
+  /** Readers active in each epoch parity, spread over slots by thread to avoid sharing one cache line */
+  struct alignas(64) ReaderSlot {
+    std::array<std::atomic<uint64_t>, 2> active_{};
+  };
+
+  /** Registers the calling thread as a reader of the current epoch for its lifetime. */
+  class ReadGuard {
+   public:
+    explicit ReadGuard(Trie *trie)
+        : slot_(&trie->readers_[std::hash<std::thread::id>{}(std::this_thread::get_id()) % TRIE_READER_SLOTS]) {
+      // 登记之后 epoch 仍未变化，writer 才一定能看到这个 reader
+      while (true) {
+        auto epoch = trie->epoch_.load();
+        parity_ = epoch & 1;
+        slot_->active_[parity_].fetch_add(1);
+        if (trie->epoch_.load() == epoch) {
+          break;
+        }
+        slot_->active_[parity_].fetch_sub(1);
+      }
+    }
+
+    ~ReadGuard() { slot_->active_[parity_].fetch_sub(1); }
+
+    ReadGuard(const ReadGuard &) = delete;
+    auto operator=(const ReadGuard &) -> ReadGuard & = delete;
+
+   private:
+    ReaderSlot *slot_;
+    size_t parity_{0};
+  };
+
+  /** @return the leaf of `key`, nullptr if there is none. The caller must hold a ReadGuard or write_latch_. */
+  auto FindLeaf(const std::string &key) -> ArtLeaf * {
+    auto node = root_.load();
+    size_t depth = 0;
+    while (node != nullptr && !node->IsLeaf()) {
+      auto inner = static_cast<ArtInner *>(node);
+      if (depth + inner->prefix_len_ > key.size()) {
+        return nullptr;
+      }
+      // 只比较保存在节点中的 prefix 字节，其余的在 leaf 上比较完整的 key
+      auto stored = std::min(inner->prefix_len_, ArtInner::ART_MAX_PREFIX);
+      if (key.compare(depth, stored, inner->prefix_.data(), stored) != 0) {
+        return nullptr;
+      }
+      depth += inner->prefix_len_;
+      if (depth == key.size()) {
+        node = inner->leaf_.load();
+        break;
+      }
+      auto child = ArtFindChild(inner, static_cast<uint8_t>(key[depth++]));
+      node = child == nullptr ? nullptr : child->load();
+    }
+    auto leaf = static_cast<ArtLeaf *>(node);
+    return leaf != nullptr && leaf->key_ == key ? leaf : nullptr;
   }
+
+  /** @return the whole prefix of `node`, which starts at byte `depth` of its keys */
+  static auto FullPrefix(ArtInner *node, size_t depth) -> std::string {
+    if (node->prefix_len_ <= ArtInner::ART_MAX_PREFIX) {
+      return {node->prefix_.data(), node->prefix_len_};
+    }
+    return ArtAnyLeaf(node)->key_.substr(depth, node->prefix_len_);
+  }
+
+  /** Put `leaf` in `node`, unpublished, whose prefix ends before byte `depth` of the key. */
+  static void PlaceLeaf(ArtInner *node, ArtLeaf *leaf, size_t depth) {
+    if (leaf->key_.size() == depth) {
+      node->leaf_.store(leaf);
+    } else {
+      ArtAddChild(node, static_cast<uint8_t>(leaf->key_[depth]), leaf);
+    }
+  }
+
+  auto InsertLeaf(std::unique_ptr<ArtLeaf> leaf) -> bool {
+    const auto &key = leaf->key_;
+    std::atomic<ArtNode *> *ref = &root_;
+    size_t depth = 0;
+    while (true) {
+      auto node = ref->load();
+      if (node == nullptr) {
+        ref->store(leaf.release());
+        return true;
+      }
+      if (node->IsLeaf()) {
+        auto old_leaf = static_cast<ArtLeaf *>(node);
+        if (old_leaf->key_ == key) {
+          return false;
+        }
+        // 两个 key 在 depth 之后的公共部分成为新节点的 prefix
+        size_t common = 0;
+        while (depth + common < key.size() && depth + common < old_leaf->key_.size() &&
+               key[depth + common] == old_leaf->key_[depth + common]) {
+          common++;
+        }
+        auto inner = new ArtNode4();
+        inner->SetPrefix(key.data() + depth, common);
+        PlaceLeaf(inner, old_leaf, depth + common);
+        PlaceLeaf(inner, leaf.release(), depth + common);
+        ref->store(inner);
+        return true;
+      }
+      auto inner = static_cast<ArtInner *>(node);
+      auto prefix = FullPrefix(inner, depth);
+      size_t mismatch = 0;
+      while (mismatch < prefix.size() && depth + mismatch < key.size() && key[depth + mismatch] == prefix[mismatch]) {
+        mismatch++;
+      }
+      if (mismatch < prefix.size()) {
+        // key 在 prefix 中间分叉，拆成一个新的 Node4 和 prefix 变短的旧节点
+        auto split = new ArtNode4();
+        split->SetPrefix(prefix.data(), mismatch);
+        auto rest = ArtCopyInner(inner, inner->num_children_, prefix.data() + mismatch + 1,
+                                 prefix.size() - mismatch - 1);
+        ArtAddChild(split, static_cast<uint8_t>(prefix[mismatch]), rest);
+        PlaceLeaf(split, leaf.release(), depth + mismatch);
+        ref->store(split);
+        Retire(inner);
+        return true;
+      }
+      depth += prefix.size();
+      if (depth == key.size()) {
+        if (inner->leaf_.load() != nullptr) {
+          return false;
+        }
+        inner->leaf_.store(leaf.release());
+        return true;
+      }
+      auto byte = static_cast<uint8_t>(key[depth]);
+      if (auto child = ArtFindChild(inner, byte); child != nullptr && child->load() != nullptr) {
+        ref = child;
+        depth++;
+        continue;
+      }
+      // Node48 和 Node256 原地加入，其余复制一份（可能换成更大的类型）再替换
+      bool in_place = inner->type_ == ArtNodeType::Node48 || inner->type_ == ArtNodeType::Node256;
+      if (in_place && inner->num_children_ < ArtCapacity(inner->type_)) {
+        ArtAddChild(inner, byte, leaf.release());
+        return true;
+      }
+      auto copy = ArtCopyInner(inner, inner->num_children_ + 1, prefix.data(), prefix.size());
+      ArtAddChild(copy, byte, leaf.release());
+      ref->store(copy);
+      Retire(inner);
+      return true;
+    }
+  }
+
+  auto RemoveLeaf(const std::string &key) -> bool {
+    std::atomic<ArtNode *> *ref = &root_;
+    std::atomic<ArtNode *> *parent_ref = nullptr;
+    size_t depth = 0;
+    size_t parent_depth = 0;
+    while (true) {
+      auto node = ref->load();
+      if (node == nullptr) {
+        return false;
+      }
+      if (node->IsLeaf()) {
+        if (static_cast<ArtLeaf *>(node)->key_ != key) {
+          return false;
+        }
+        if (parent_ref == nullptr) {
+          root_.store(nullptr);
+        } else {
+          RemoveChild(parent_ref, parent_depth, static_cast<uint8_t>(key[depth - 1]));
+        }
+        Retire(node);
+        return true;
+      }
+      auto inner = static_cast<ArtInner *>(node);
+      auto prefix = FullPrefix(inner, depth);
+      if (key.compare(depth, prefix.size(), prefix) != 0) {
+        return false;
+      }
+      auto child_depth = depth + prefix.size();
+      if (child_depth == key.size()) {
+        auto leaf = inner->leaf_.load();
+        if (leaf == nullptr) {
+          return false;
+        }
+        inner->leaf_.store(nullptr);
+        Retire(leaf);
+        Shrink(ref, depth);
+        return true;
+      }
+      auto child = ArtFindChild(inner, static_cast<uint8_t>(key[child_depth]));
+      if (child == nullptr || child->load() == nullptr) {
+        return false;
+      }
+      parent_ref = ref;
+      parent_depth = depth;
+      ref = child;
+      depth = child_depth + 1;
+    }
+  }
+
+  /** Remove the child for `byte` of the inner node in `ref`, whose prefix starts at byte `depth`. */
+  void RemoveChild(std::atomic<ArtNode *> *ref, size_t depth, uint8_t byte) {
+    auto node = static_cast<ArtInner *>(ref->load());
+    if (node->type_ == ArtNodeType::Node256) {
+      static_cast<ArtNode256 *>(node)->children_[byte].store(nullptr);
+      node->num_children_--;
+    } else {
+      // Node48 的空 slot 不原地复用，否则 reader 可能经过旧的 child index 读到别的 child
+      auto prefix = FullPrefix(node, depth);
+      ref->store(ArtCopyInner(node, node->num_children_ - 1, prefix.data(), prefix.size(), byte));
+      Retire(node);
+    }
+    Shrink(ref, depth);
+  }
+
+  /**
+   * After a removal from the inner node in `ref`, merge it into its only remaining leaf or child, or replace it with
+   * a smaller type once it has few enough children.
+   */
+  void Shrink(std::atomic<ArtNode *> *ref, size_t depth) {
+    auto node = static_cast<ArtInner *>(ref->load());
+    auto leaf = node->leaf_.load();
+    if (node->num_children_ == 0) {
+      ref->store(leaf);
+      Retire(node);
+      return;
+    }
+    if (node->num_children_ == 1 && leaf == nullptr) {
+      uint8_t byte = 0;
+      ArtNode *child = nullptr;
+      ArtForEachChild(node, [&](uint8_t b, ArtNode *c) {
+        byte = b;
+        child = c;
+      });
+      if (!child->IsLeaf()) {
+        // 把 node 的 prefix 和 byte 接到 child 的 prefix 前面
+        auto inner_child = static_cast<ArtInner *>(child);
+        auto prefix = FullPrefix(node, depth);
+        prefix += static_cast<char>(byte);
+        prefix += FullPrefix(inner_child, depth + prefix.size());
+        child = ArtCopyInner(inner_child, inner_child->num_children_, prefix.data(), prefix.size());
+        Retire(inner_child);
+      }
+      ref->store(child);
+      Retire(node);
+      return;
+    }
+    // 留一些余量，避免在边界上反复增长和收缩
+    auto shrink_below = node->type_ == ArtNodeType::Node16 ? 4 : node->type_ == ArtNodeType::Node48 ? 13 : 38;
+    if (node->type_ != ArtNodeType::Node4 && node->num_children_ < shrink_below) {
+      auto prefix = FullPrefix(node, depth);
+      ref->store(ArtCopyInner(node, node->num_children_, prefix.data(), prefix.size()));
+      Retire(node);
+    }
+  }
+
+  /** Free `node` once no reader can hold it. Caller must hold write_latch_. */
+  void Retire(ArtNode *node) { retired_[epoch_.load() & 1].emplace_back(node); }
+
+  /**
+   * Advance the epoch if no reader of the previous epoch is left, and free the nodes retired in it: readers of the
+   * current epoch started after those nodes were unlinked. Caller must hold write_latch_.
+   */
+  void TryReclaim() {
+    auto epoch = epoch_.load();
+    auto previous = (epoch + 1) & 1;
+    for (const auto &slot : readers_) {
+      if (slot.active_[previous].load() != 0) {
+        return;
+      }
+    }
+    for (auto node : retired_[previous]) {
+      ArtFreeNode(node);
+    }
+    retired_[previous].clear();
+    epoch_.store(epoch + 1);
+  }
+
+  /* Root node of the trie, a leaf when it holds a single key */
+  std::atomic<ArtNode *> root_{nullptr};
+  /* Serializes the writers */
+  std::mutex write_latch_;
+  std::atomic<uint64_t> epoch_{0};
+  std::array<ReaderSlot, TRIE_READER_SLOTS> readers_;
+  // 在 epoch 奇偶为 i 时被替换下来的节点，由 write_latch_ 保护
+  std::array<std::vector<ArtNode *>, 2> retired_;
 };
 }  // namespace bustub
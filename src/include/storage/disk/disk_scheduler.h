@@ -0,0 +1,89 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_scheduler.h
+//
+// Identification: src/include/storage/disk/disk_scheduler.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <cstddef>
+#include <deque>
+#include <future>  // NOLINT
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/config.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/** One page read or write submitted to a DiskScheduler. */
+struct DiskRequest {
+  /** true to write `data_` to the page, false to read the page into `data_` */
+  bool is_write_;
+  /** BUSTUB_PAGE_SIZE bytes, which must stay valid until the request completes */
+  char *data_;
+  page_id_t page_id_;
+  /** Set when the request completes, with the exception of the DiskManager if it failed */
+  std::promise<void> callback_;
+};
+
+/**
+ * DiskScheduler runs the page reads and writes of a buffer pool asynchronously on a few I/O threads over a
+ * DiskManager, so that a caller can overlap several I/Os with each other and with its own work.
+ *
+ * Requests are submitted to a queue, alone or in batches, and complete through the future returned for each one. An
+ * I/O thread takes up to DISK_SCHEDULER_BATCH_SIZE queued requests at once and issues them in page id order, so that
+ * the adjacent pages of a write-back batch reach the DiskManager back to back. Requests for the same page are issued in
+ * submission order only if they are in the same batch; a caller that writes and then reads a page waits for the write
+ * first, as the buffer pool already does.
+ */
+class DiskScheduler {
+ public:
+  static constexpr size_t DISK_SCHEDULER_NUM_WORKERS = 2;
+  static constexpr size_t DISK_SCHEDULER_BATCH_SIZE = 32;
+
+  /**
+   * Start the I/O threads.
+   * @param disk_manager the disk manager the requests are run on, which must outlive the scheduler
+   * @param num_workers the number of I/O threads
+   */
+  explicit DiskScheduler(DiskManager *disk_manager, size_t num_workers = DISK_SCHEDULER_NUM_WORKERS);
+
+  /** Run the requests still queued and stop the I/O threads. */
+  ~DiskScheduler();
+
+  /** @return a future set once `data` holds the content of the page */
+  auto ScheduleRead(page_id_t page_id, char *data) -> std::future<void>;
+
+  /** @return a future set once `data` has been written to the page; `data` is not copied */
+  auto ScheduleWrite(page_id_t page_id, const char *data) -> std::future<void>;
+
+  /**
+   * Submit several requests at once, with one acquisition of the queue latch.
+   * @return the futures of the requests, in the same order
+   */
+  auto Schedule(std::vector<DiskRequest> *requests) -> std::vector<std::future<void>>;
+
+ private:
+  /** Main loop of an I/O thread. */
+  void RunWorker();
+
+  DiskManager *disk_manager_;
+  std::vector<std::thread> workers_;
+  /** Protects queue_ and stopped_ */
+  std::mutex latch_;
+  std::condition_variable queue_cv_;
+  std::deque<DiskRequest> queue_;
+  bool stopped_{false};
+};
+
+}  // namespace bustub
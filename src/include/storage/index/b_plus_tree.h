@@ -10,8 +10,16 @@
 //===----------------------------------------------------------------------===//
 #pragma once
 
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <functional>
+#include <memory>
+#include <optional>
 #include <queue>
 #include <string>
+#include <thread>  // NOLINT
+#include <utility>
 #include <vector>
 
 #include "concurrency/transaction.h"
@@ -33,15 +41,34 @@ enum Operation { READ, INSERT, REMOVE };
  * (2) support insert & remove
  * (3) The structure should shrink and grow dynamically
  * (4) Implement index iterator for range scan
+ *
+ * With use_olc, point lookups (and the leaf-only fast path of Insert/Remove) use optimistic lock coupling: they go
+ * down the tree without taking page latches, reading a version counter of every node before and after looking at it
+ * and restarting from the root when a writer got in between. Writers still latch pages and bump the version of every
+ * page they write-latch. After OLC_MAX_RESTARTS conflicts a lookup falls back to latch crabbing.
+ *
+ * With compress_keys, leaf pages store the common prefix of their keys once (see BPlusTreeLeafPage), so a leaf can
+ * hold up to about twice LEAF_PAGE_SIZE entries when its keys share enough leading bytes; leaf_max_size is then the
+ * fan-out limit of a compressed leaf. A leaf that runs out of room earlier is split before the insert.
+ *
+ * With lazy_merge, Remove() takes only the write latch of the leaf in the common case and removes the key even if
+ * that leaves the leaf below its min size, as long as the leaf does not become empty. Such leaves are recorded and
+ * merged or redistributed later by CompactUnderfullLeaves(), called directly or from the thread started by
+ * StartBackgroundCompaction(). Until then lookups, inserts and scans work as usual on the underfull leaves.
  */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTree {
   using InternalPage = BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator>;
   using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>;
+  // 反向扫描时 iterator 需要重新从 root 查找前一个 leaf
+  friend class IndexIterator<KeyType, ValueType, KeyComparator>;
 
  public:
   explicit BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE);
+                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE,
+                     bool use_olc = false, bool compress_keys = false, bool lazy_merge = false);
+
+  ~BPlusTree();
 
   // Returns true if this B+ tree has no keys and values.
   auto IsEmpty() const -> bool;
@@ -49,20 +76,78 @@ class BPlusTree {
   // Insert a key-value pair into this B+ tree.
   auto Insert(const KeyType &key, const ValueType &value, Transaction *transaction = nullptr) -> bool;
 
+  /**
+   * Insert a batch of key-value pairs. The pairs are sorted by key in place and inserted in that order: the leaf of
+   * the previous pair stays write-latched while the next key falls inside it and fits without a split, so a run of
+   * keys that land in one leaf costs a single descent. Pairs that need a split go through Insert().
+   * @return number of pairs inserted, pairs with a duplicate key are skipped
+   */
+  auto InsertBatch(std::vector<std::pair<KeyType, ValueType>> *pairs, Transaction *transaction = nullptr) -> size_t;
+
+  /**
+   * Build an empty B+ tree bottom-up from num_pairs key-value pairs, without going through Insert().
+   *
+   * next() is called num_pairs times and must return the pairs in strictly increasing key order. Every node is packed
+   * with about fill_factor * max size entries, and the sizes of the nodes of one level are evened out so that none of
+   * them ends up below the min size. Pages are created in key order and each one is written once, the parent of a
+   * node being created right before its first child.
+   *
+   * @param num_pairs number of pairs next() will return
+   * @param next fills in the next pair, returns false if there is none left
+   * @param fill_factor fraction of the max size of a node to fill, in (0, 1]
+   * @return false if the tree is not empty
+   */
+  auto BulkLoad(size_t num_pairs, const std::function<bool(KeyType *, ValueType *)> &next, double fill_factor = 1.0)
+      -> bool;
+
   // Remove a key and its value from this B+ tree.
   void Remove(const KeyType &key, Transaction *transaction = nullptr);
 
+  /**
+   * Merge or redistribute the leaves that lazy removes left below their min size, taking the latches of the
+   * pessimistic remove path for each of them. Leaves that were refilled in the meantime are left as they are.
+   * @return number of leaves looked at
+   */
+  auto CompactUnderfullLeaves() -> size_t;
+
+  /** Start a thread calling CompactUnderfullLeaves() every interval while there are underfull leaves. */
+  void StartBackgroundCompaction(std::chrono::milliseconds interval = std::chrono::milliseconds(100));
+
+  /** Stop the compaction thread, leaves still underfull stay recorded. */
+  void StopBackgroundCompaction();
+
   // return the value associated with a given key
+  // with use_olc the lookup does not latch pages, transaction is then only used by the latched fallback
   auto GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction = nullptr) -> bool;
 
+  /**
+   * Look up a batch of keys. The keys are probed in sorted order and the leaf of the previous key stays read-latched,
+   * so keys that fall into the same leaf share one descent. When the next key is past the leaf the lookup goes down
+   * from the root again rather than along the leaf chain, latching a sibling while holding a leaf could deadlock with
+   * Remove().
+   * @param keys keys to look up, in any order
+   * @param[out] results resized to keys.size(), (*results)[i] receives the value of keys[i] if it exists
+   * @return number of keys found
+   */
+  auto GetValues(const std::vector<KeyType> &keys, std::vector<std::vector<ValueType>> *results) -> size_t;
+
   // return the page id of the root node
   auto GetRootPageId() -> page_id_t;
 
   // index iterator
   auto Begin() -> INDEXITERATOR_TYPE;
+  // 从第一个不小于 key 的 entry 开始
   auto Begin(const KeyType &key) -> INDEXITERATOR_TYPE;
   auto End() -> INDEXITERATOR_TYPE;
 
+  /**
+   * Iterator over the entries whose keys are in [low, high), in ascending key order or, with reverse, in descending
+   * key order. A side without a key is unbounded. The iterator becomes End() as soon as it passes the bound, so a
+   * range scan only reads the leaves that overlap the range.
+   */
+  auto BeginRange(const std::optional<KeyType> &low, const std::optional<KeyType> &high, bool reverse = false)
+      -> INDEXITERATOR_TYPE;
+
   // print the B+ tree
   void Print(BufferPoolManager *bpm);
 
@@ -79,6 +164,35 @@ class BPlusTree {
   void UpdateRootPageId(int insert_record = 0);
   void UnpinFromBottomToRoot(page_id_t page_id, BufferPoolManager *buffer_pool_manager_, Operation op);
   auto OptmisticLock(const KeyType &key) -> Page *;
+  // 悲观删除：锁住整条路径，remove_key 为 false 时只对 key 所在的 leaf 做 merge / redistribute
+  // 返回 true 表示合并后的 leaf 仍然少于 min size，此时 underfull_key 为该 leaf 中的一个 key；
+  // remove_key 为 true 时 redistribute 后仍然少于 min size 的 leaf 也会返回
+  auto RemoveAndRebalance(const KeyType &key, Transaction *transaction, bool remove_key,
+                          KeyType *underfull_key = nullptr) -> bool;
+  void BackgroundCompaction();
+
+  /**
+   * 乐观锁耦合：不加 page 锁从 root 找到 key 所在的 leaf，每个节点在读之前和读之后检查 version，冲突时从 root 重新开始
+   * 途中的 page 在进入 child 后就 unpin，返回的 leaf 仍然 pin 住
+   *
+   * @param write 为 true 时返回的 leaf 已经加上写锁，否则不加锁
+   * @param[out] leaf_version write 为 false 时为读 leaf 之前的 version，调用者读完 leaf 后需要再 ValidateVersion
+   * @return 树为空、fetch page 失败或者重试 OLC_MAX_RESTARTS 次后仍然冲突时返回 nullptr
+   */
+  auto FindLeafPageOptimistic(const KeyType &key, bool write, uint64_t *leaf_version) -> Page *;
+
+  // OLC 的 GetValue，返回 false 表示冲突太多，需要退回加锁的方式
+  auto GetValueOptimistic(const KeyType &key, std::vector<ValueType> *result, bool *found) -> bool;
+
+  // 给 page 加写锁并让其 version 处于 locked 状态，修改完后用 WUnlatchPage 释放，version 随之增加
+  void WLatchPage(Page *page);
+  void WUnlatchPage(Page *page);
+
+  // 读取 page 的 version，page 正在被修改时返回 false
+  auto ReadVersion(page_id_t page_id, uint64_t *version) const -> bool;
+
+  // 检查 page 在 ReadVersion 之后是否被修改过（或者正在被修改）
+  auto ValidateVersion(page_id_t page_id, uint64_t version) const -> bool;
 
   /**
    * 从 root page id 开始寻找 key 对应的 leaf node page，
@@ -94,17 +208,79 @@ class BPlusTree {
    */
   auto FindLeafPage(const KeyType &key, Transaction *transaction, Operation op) -> Page *;
 
+  /**
+   * 加锁从 root 找到 key 所在的 leaf，同时返回 leaf 的 upper fence，即 leaf 中（以及之后插入的）key 都小于它
+   * 途中的 page 在进入 child 后就释放，返回的 leaf 仍然 pin 住
+   *
+   * @param write 为 true 时返回的 leaf 加写锁（WLatchPage），否则加读锁
+   * @param[out] bounded 为 false 时 leaf 是最右边的 leaf，没有 upper fence
+   * @return 树为空或者 fetch page 失败时返回 nullptr
+   */
+  auto FindLeafPageWithFence(const KeyType &key, bool write, KeyType *upper_fence, bool *bounded) -> Page *;
+
+  /**
+   * 加读锁从 root 找到比 key 小的最大 key 所在的 leaf，key 为空时找最大的 key
+   * leaf 中可能没有比 key 小的 key（删除时 separator 不会更新），此时从该 leaf 的 lower fence 重新找
+   *
+   * @param[out] index 该 key 在 leaf 中的位置
+   * @return 加了读锁并 pin 住的 leaf，这样的 key 不存在时返回 nullptr
+   */
+  auto FindLastLeafBefore(const std::optional<KeyType> &key, int *index) -> Page *;
+
   // 检查 node 是否安全，即：不会进行 split 或者 merge 操作
   auto IsSafe(const InternalPage *node_ptr, Operation op) -> bool;
 
   // 释放相应 page
   void UnpinAndUnlock(Transaction *transaction, Operation op);
 
+  /**
+   * BulkLoad 中的一层：该层 num_nodes_ 个节点的大小，以及正在填充的节点
+   * 前 num_large_ 个节点有 base_size_ + 1 个 entry，其余节点有 base_size_ 个
+   */
+  struct BulkLoadLevel {
+    size_t num_nodes_;
+    size_t base_size_;
+    size_t num_large_;
+    // 已经创建的节点数，page_ 是其中最后一个
+    size_t num_started_{0};
+    Page *page_{nullptr};
+
+    auto NodeSize(size_t index) const -> int { return static_cast<int>(base_size_ + (index < num_large_ ? 1 : 0)); }
+    auto IsNodeFull() const -> bool {
+      return page_ == nullptr ||
+             reinterpret_cast<BPlusTreePage *>(page_->GetData())->GetSize() == NodeSize(num_started_ - 1);
+    }
+  };
+
+  // 将 num_entries 个 entry 尽量平均地分到大小在 [min_size, max_size] 之间的节点中
+  static auto PlanBulkLoadLevel(size_t num_entries, double fill_factor, int min_size, int max_size) -> BulkLoadLevel;
+
+  // 在 levels[level] 开始一个新节点，first_key 为该节点的第一个 key，需要时递归地在上一层开始新节点
+  auto StartBulkLoadNode(std::vector<BulkLoadLevel> *levels, size_t level, const KeyType &first_key,
+                         std::vector<page_id_t> *created) -> Page *;
+
   /* Debug Routines for FREE!! */
   void ToGraph(BPlusTreePage *page, BufferPoolManager *bpm, std::ofstream &out) const;
 
   void ToString(BPlusTreePage *page, BufferPoolManager *bpm) const;
 
+  /**
+   * page 的 version 不放在 page 中，而是按 page id 放在 OLC_VERSION_SLOTS 个 slot 中，
+   * 两个 page 共用一个 slot 只会带来多余的重试。
+   * 低 VERSION_LOCK_BITS 位为持有该 slot 中 page 写锁的 writer 数，其余位为 version
+   */
+  struct alignas(64) VersionSlot {
+    std::atomic<uint64_t> word_{0};
+  };
+  static constexpr size_t OLC_VERSION_SLOTS = 1024;
+  static constexpr int OLC_MAX_RESTARTS = 16;
+  static constexpr uint64_t VERSION_LOCK_BITS = 16;
+  static constexpr uint64_t VERSION_LOCK_MASK = (1ULL << VERSION_LOCK_BITS) - 1;
+
+  auto SlotOf(page_id_t page_id) const -> std::atomic<uint64_t> & {
+    return versions_[static_cast<size_t>(page_id) % OLC_VERSION_SLOTS].word_;
+  }
+
   // member variable
   std::string index_name_;
   page_id_t root_page_id_;
@@ -115,6 +291,18 @@ class BPlusTree {
   // 保护 root page id
   // 只在新增 root page id 时候上锁，其余时间更改时是给 root page 上锁来保护 root page id
   std::mutex latch_;
+  bool use_olc_;
+  std::unique_ptr<VersionSlot[]> versions_;
+  bool compress_keys_;
+  bool lazy_merge_;
+  // lazy remove 后低于 min size 的 leaf 中的某个 key，由 CompactUnderfullLeaves 处理
+  std::vector<KeyType> underfull_keys_;
+  // 保护 underfull_keys_ 和 compaction thread 的状态
+  std::mutex compaction_latch_;
+  std::condition_variable compaction_cv_;
+  std::thread compaction_thread_;
+  std::chrono::milliseconds compaction_interval_{100};
+  bool compaction_stop_{false};
 };
 
 }  // namespace bustub
@@ -0,0 +1,81 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// b_plus_tree_index.h
+//
+// Identification: src/include/storage/index/b_plus_tree_index.h
+//
+// Copyright (c) 2018, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "container/hash/hash_function.h"
+#include "storage/index/b_plus_tree.h"
+#include "storage/index/index.h"
+
+namespace bustub {
+
+#define BPLUSTREE_INDEX_TYPE BPlusTreeIndex<KeyType, ValueType, KeyComparator>
+
+INDEX_TEMPLATE_ARGUMENTS
+class BPlusTreeIndex : public Index {
+ public:
+  BPlusTreeIndex(std::unique_ptr<IndexMetadata> &&metadata, BufferPoolManager *buffer_pool_manager);
+
+  void InsertEntry(const Tuple &key, RID rid, Transaction *transaction) override;
+
+  void DeleteEntry(const Tuple &key, RID rid, Transaction *transaction) override;
+
+  void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) override;
+
+  /**
+   * Look up a batch of keys with BPlusTree::GetValues, keys that fall into the same leaf share one descent.
+   * @param keys key tuples, in any order
+   * @param[out] results resized to keys.size(), (*results)[i] receives the RIDs of keys[i]
+   */
+  void ScanKeys(const std::vector<Tuple> &keys, std::vector<std::vector<RID>> *results, Transaction *transaction);
+
+  /**
+   * Insert a batch of entries with BPlusTree::InsertBatch, in key order rather than in the order given.
+   * @return number of entries inserted, entries with a duplicate key are skipped
+   */
+  auto InsertEntries(const std::vector<std::pair<Tuple, RID>> &entries, Transaction *transaction) -> size_t;
+
+  auto GetBeginIterator() -> INDEXITERATOR_TYPE;
+
+  auto GetBeginIterator(const KeyType &key) -> INDEXITERATOR_TYPE;
+
+  auto GetEndIterator() -> INDEXITERATOR_TYPE;
+
+  /** Iterator over the entries with keys in [low, high), see BPlusTree::BeginRange. */
+  auto GetRangeIterator(const std::optional<KeyType> &low, const std::optional<KeyType> &high, bool reverse)
+      -> INDEXITERATOR_TYPE;
+
+ protected:
+  // comparator for key
+  KeyComparator comparator_;
+  // container
+  BPlusTree<KeyType, ValueType, KeyComparator> container_;
+};
+
+/** We only support index table with one integer key for now in BusTub. Hardcode everything here. */
+
+constexpr static const auto INTEGER_SIZE = 8;
+using IntegerKeyType = GenericKey<INTEGER_SIZE>;
+using IntegerValueType = RID;
+using IntegerComparatorType = GenericComparator<INTEGER_SIZE>;
+using BPlusTreeIndexForOneIntegerColumn = BPlusTreeIndex<IntegerKeyType, IntegerValueType, IntegerComparatorType>;
+using BPlusTreeIndexIteratorForOneIntegerColumn =
+    IndexIterator<IntegerKeyType, IntegerValueType, IntegerComparatorType>;
+using IntegerHashFunctionType = HashFunction<IntegerKeyType>;
+
+}  // namespace bustub
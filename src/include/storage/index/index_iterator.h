@@ -13,6 +13,8 @@
  * For range scan of b+ tree
  */
 #pragma once
+#include <optional>
+
 #include "common/config.h"
 #include "storage/page/b_plus_tree_leaf_page.h"
 
@@ -20,11 +22,37 @@ namespace bustub {
 
 #define INDEXITERATOR_TYPE IndexIterator<KeyType, ValueType, KeyComparator>
 
+INDEX_TEMPLATE_ARGUMENTS
+class BPlusTree;
+
+/**
+ * Iterator over the entries of the leaf pages. The current leaf stays read-latched and pinned until the iterator moves
+ * past it, reaches its stop key or is destroyed, so an iterator can be dropped before it reaches End().
+ *
+ * A forward iterator follows the next page ids of the leaves. The leaves are not linked backwards, and latching the
+ * left sibling while holding a leaf could deadlock with Remove(), so a reverse iterator releases its leaf and goes down
+ * from the root again to find the leaf holding the largest key below the current one.
+ */
 INDEX_TEMPLATE_ARGUMENTS
 class IndexIterator {
  public:
   // you may define your own constructor based on your member variables
   explicit IndexIterator(Page *page_ptr, const int &index, BufferPoolManager *bufferPoolManager);
+
+  /**
+   * Iterator of a range scan, starting at entry index of the read-latched leaf page_ptr.
+   * @param stop_key with reverse, the iterator ends at the first key below stop_key, otherwise at the first key at or
+   * above stop_key; the scan runs to the end of the tree when there is none
+   * @param reverse move towards smaller keys
+   */
+  IndexIterator(BPlusTree<KeyType, ValueType, KeyComparator> *tree, Page *page_ptr, int index,
+                std::optional<KeyType> stop_key, bool reverse);
+
+  IndexIterator(IndexIterator &&other) noexcept;
+  auto operator=(IndexIterator &&other) noexcept -> IndexIterator &;
+  IndexIterator(const IndexIterator &) = delete;
+  auto operator=(const IndexIterator &) -> IndexIterator & = delete;
+
   ~IndexIterator();  // NOLINT
 
   auto IsEnd() -> bool;
@@ -38,6 +66,15 @@ class IndexIterator {
   auto operator!=(const IndexIterator &itr) const -> bool { return page_id_ != itr.page_id_ || index_ != itr.index_; }
 
  private:
+  // 读取当前位置的 entry，index_ 超出当前 leaf 时先移动到下一个 leaf，越过 stop key 时结束
+  void Load();
+
+  // 释放当前 leaf，iterator 变为 End()
+  void Release();
+
+  // 正向扫描时移动到下一个 leaf 的第一个 entry
+  void NextLeaf();
+
   // add your own private member variables here
   page_id_t page_id_;
   Page *page_ptr_;
@@ -45,6 +82,10 @@ class IndexIterator {
   BufferPoolManager *buffer_pool_manager_;
   // 判断当前处于该 leaf node 的第几个 key
   int index_;
+  // range scan 的 B+ 树，反向扫描时用来查找前一个 leaf
+  BPlusTree<KeyType, ValueType, KeyComparator> *tree_{nullptr};
+  std::optional<KeyType> stop_key_;
+  bool reverse_{false};
 };
 
 }  // namespace bustub
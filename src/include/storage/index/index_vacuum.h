@@ -0,0 +1,112 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// index_vacuum.h
+//
+// Identification: src/include/storage/index/index_vacuum.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <thread>              // NOLINT
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/config.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+#include "storage/index/index.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+class LockManager;
+
+/**
+ * IndexVacuum removes the index entries of deleted rows off the critical path of the deleting transaction.
+ *
+ * With the vacuum enabled, DeleteExecutor only marks the tuple deleted in the heap and records the index keys of the
+ * row here. The row is dead from then on: readers that find its RID through an index skip it (see IsDead()). A
+ * background thread removes the entries every VACUUM_INTERVAL, sorted by key per index, once the deleting
+ * transaction has committed; the heap space is reclaimed at commit as before. When it aborted instead, its entries
+ * are kept, since the delete has been rolled back.
+ *
+ * An insert into a table with dead rows first runs Vacuum() itself, so that the key or the RID of a dead row can be
+ * used again. The entries of a dead row whose deleter is still running stay, so writers insert their entries through
+ * InsertEntry(), which waits for that deleter when the key collides with such an entry.
+ */
+class IndexVacuum {
+ public:
+  IndexVacuum() = default;
+
+  ~IndexVacuum() { SetEnabled(false); }
+
+  /** Turn deferred index cleanup on or off, starting or stopping the background thread. */
+  void SetEnabled(bool enabled);
+
+  auto IsEnabled() const -> bool { return enabled_.load(std::memory_order_relaxed); }
+
+  /**
+   * Record the index entries of a row `txn` has deleted, to be removed once it commits.
+   * @param keys the index and the key of each entry of the row
+   */
+  void RecordDelete(Transaction *txn, table_oid_t oid, const RID &rid, std::vector<std::pair<Index *, Tuple>> &&keys);
+
+  /** @return `true` if table `oid` has dead rows whose index entries have not been removed yet */
+  auto HasDeadRows(table_oid_t oid) -> bool;
+
+  /** @return `true` if the row has been deleted and its index entries are waiting for the vacuum */
+  auto IsDead(table_oid_t oid, const RID &rid) -> bool;
+
+  /**
+   * Remove the index entries of the rows deleted by committed transactions, and by `txn` if not nullptr, which can
+   * then insert the same keys again.
+   */
+  void Vacuum(Transaction *txn = nullptr);
+
+  /**
+   * Insert the index entry of a row `txn` has written. If the key is taken, the dead rows holding it are locked in X
+   * mode, which waits for their deleters to finish; the entries of the committed ones are then vacuumed and the
+   * insert is tried again.
+   * @return `false` if the key is held by a live row, or a lock could not be taken because `txn` was aborted
+   */
+  auto InsertEntry(Transaction *txn, LockManager *lock_manager, table_oid_t oid, Index *index, const Tuple &key,
+                   const RID &rid) -> bool;
+
+ private:
+  /** A deleted row whose index entries are still in the indexes */
+  struct DeadRow {
+    txn_id_t deleter_;
+    std::vector<std::pair<Index *, Tuple>> keys_;
+  };
+
+  static constexpr std::chrono::milliseconds VACUUM_INTERVAL{50};
+
+  void RunVacuum();
+
+  /** Insert an entry into `index`. @return whether `index` now maps `key` to `rid` */
+  static auto TryInsert(Transaction *txn, Index *index, const Tuple &key, const RID &rid) -> bool;
+
+  std::atomic<bool> enabled_{false};
+  /** table oid -> dead rows of the table */
+  std::unordered_map<table_oid_t, std::unordered_map<RID, DeadRow>> dead_rows_;
+  std::atomic<size_t> num_dead_rows_{0};
+  std::mutex latch_;
+  /** 同时只有一个 Vacuum() 删除 index entry */
+  std::mutex vacuum_latch_;
+
+  std::thread vacuum_thread_;
+  std::condition_variable stop_cv_;
+  std::mutex thread_latch_;
+};
+
+}  // namespace bustub
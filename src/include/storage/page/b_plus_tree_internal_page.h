@@ -49,6 +49,8 @@ class BPlusTreeInternalPage : public BPlusTreePage {
   auto FindChildIndex(const ValueType &value) -> int;
   // 找 key 应该属于的 child
   auto FindChild(const KeyType &key, const KeyComparator &keyComparator) -> ValueType;
+  // [1, size) 中第一个 >= key 的 index，所有 key 都小于 key 时返回 size
+  auto LowerBound(const KeyType &key, const KeyComparator &keyComparator) const -> int;
   // 将 kv 插入到最后一个
   void InsertLast(const KeyType &key, const ValueType &value);
   // 将 kv 插入到第一个，也就是 array_[0]
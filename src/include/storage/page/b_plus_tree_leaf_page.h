@@ -20,7 +20,7 @@
 namespace bustub {
 
 #define B_PLUS_TREE_LEAF_PAGE_TYPE BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>
-#define LEAF_PAGE_HEADER_SIZE 28
+#define LEAF_PAGE_HEADER_SIZE 32
 #define LEAF_PAGE_SIZE ((BUSTUB_PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / sizeof(MappingType))
 
 /**
@@ -33,26 +33,37 @@ namespace bustub {
  * | HEADER | KEY(1) + RID(1) | KEY(2) + RID(2) | ... | KEY(n) + RID(n)
  *  ----------------------------------------------------------------------
  *
- *  Header format (size in byte, 28 bytes in total):
+ *  Header format (size in byte, 32 bytes in total):
  *  ---------------------------------------------------------------------
  * | PageType (4) | LSN (4) | CurrentSize (4) | MaxSize (4) |
  *  ---------------------------------------------------------------------
- *  -----------------------------------------------
- * | ParentPageId (4) | PageId (4) | NextPageId (4)
- *  -----------------------------------------------
+ *  ----------------------------------------------------------------
+ * | ParentPageId (4) | PageId (4) | NextPageId (4) | KeyPrefixLen (4)
+ *  ----------------------------------------------------------------
+ *
+ * A page initialized with compress_keys stores the bytes all of its keys have in common only once, in the last
+ * sizeof(KeyType) bytes of the page, and every entry keeps the rest of its key:
+ *  --------------------------------------------------------------------------------------
+ * | HEADER | SUFFIX(1) + RID(1) | ... | SUFFIX(n) + RID(n) | ... free ... | KEY PREFIX |
+ *  --------------------------------------------------------------------------------------
+ * Inserting a key that does not share the whole prefix shortens it, so a compressed page can run out of room before
+ * it reaches its max size; callers check HasRoomFor() first and split the page instead.
  */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeLeafPage : public BPlusTreePage {
  public:
   // After creating a new leaf page from buffer pool, must call initialize
   // method to set default values
-  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID, int max_size = LEAF_PAGE_SIZE - 1);
+  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID, int max_size = LEAF_PAGE_SIZE - 1,
+            bool compress_keys = false);
   // helper methods
   auto GetNextPageId() const -> page_id_t;
   void SetNextPageId(page_id_t next_page_id);
   auto KeyAt(int index) const -> KeyType;
   auto ValueAt(int index) const -> ValueType;
 
+  // 第一个 >= key 的 index，所有 key 都小于 key 时返回 size
+  auto LowerBound(const KeyType &key, const KeyComparator &keyComparator) const -> int;
   // 找 key 的 index, INVALID_PAGE_ID if non-exist
   auto KeyIndexOf(const KeyType &key, const KeyComparator &keyComparator) -> int;
 
@@ -83,9 +94,46 @@ class BPlusTreeLeafPage : public BPlusTreePage {
   // 调用前需要获取该 page lock
   auto IsDuplicateKeyL(const KeyType &key, const KeyComparator &keyComparator) -> bool;
 
+  auto IsKeyCompressed() const -> bool { return key_prefix_len_ >= 0; }
+  // 所有 key 共同前缀的长度，不压缩时为 0
+  auto GetKeyPrefixLen() const -> int { return key_prefix_len_ > 0 ? key_prefix_len_ : 0; }
+  // 插入 key 之后 page 仍然放得下（key 可能使共同前缀变短）
+  auto HasRoomFor(const KeyType &key) const -> bool;
+  // 插入任意 key 之后 page 都放得下
+  auto HasRoomForAnyKey() const -> bool;
+  // 把 other 的所有 entry 合并进来之后 page 仍然放得下
+  auto CanAbsorb(const BPlusTreeLeafPage *other) const -> bool;
+
+  // 压缩的 page 在共同前缀为空时最多能放下的 entry 数
+  static constexpr int COMPRESSED_MIN_CAPACITY =
+      (BUSTUB_PAGE_SIZE - LEAF_PAGE_HEADER_SIZE - sizeof(KeyType)) / (sizeof(KeyType) + sizeof(ValueType));
+
  private:
+  static constexpr int KEY_SIZE = sizeof(KeyType);
+
+  // 共同前缀为 prefix_len 时一个 entry 的大小和 page 能放下的 entry 数
+  auto EntrySize(int prefix_len) const -> int { return KEY_SIZE - prefix_len + static_cast<int>(sizeof(ValueType)); }
+  auto Capacity(int prefix_len) const -> int;
+  auto EntryAt(int index) -> char *;
+  auto EntryAt(int index) const -> const char *;
+  auto PrefixData() -> char *;
+  auto PrefixData() const -> const char *;
+  // 当前前缀与 key 的共同前缀长度
+  auto CommonPrefixLen(const KeyType &key) const -> int;
+  // 插入 key 之前调用，必要时缩短共同前缀
+  void PrepareFor(const KeyType &key);
+  // 将共同前缀缩短到 prefix_len，把多出来的字节放回每个 entry
+  void ShrinkPrefix(int prefix_len);
+  // 删除 entry 之后共同前缀可能变长，重新计算并压缩
+  void ExtendPrefix();
+  void WriteEntry(int index, const KeyType &key, const ValueType &value);
+  // 将 [from, size) 的 entry 移到 to 开始的位置
+  void MoveEntries(int from, int to);
+
   page_id_t next_page_id_;
-  // Flexible array member for page data.
+  // 不压缩时为 -1
+  int key_prefix_len_;
+  // Flexible array member for page data, entries are packed as key suffix + value.
   MappingType array_[1];
 };
 }  // namespace bustub
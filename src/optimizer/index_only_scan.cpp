@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "execution/expressions/column_value_expression.h"
+#include "execution/plans/aggregation_plan.h"
+#include "execution/plans/filter_plan.h"
+#include "execution/plans/index_scan_plan.h"
+#include "execution/plans/projection_plan.h"
+#include "execution/plans/sort_plan.h"
+#include "execution/plans/topn_plan.h"
+#include "optimizer/optimizer.h"
+
+namespace bustub {
+
+namespace {
+
+// 收集 expression 中读取的列
+void CollectColumns(const AbstractExpressionRef &expr, std::vector<uint32_t> *columns) {
+  if (const auto *column_expr = dynamic_cast<const ColumnValueExpression *>(expr.get()); column_expr != nullptr) {
+    columns->emplace_back(column_expr->GetColIdx());
+  }
+  for (const auto &child : expr->GetChildren()) {
+    CollectColumns(child, columns);
+  }
+}
+
+/**
+ * 沿着 filter / sort / top n / limit 向下找到 index scan，columns 中收集途中读取的列，这些节点都不改变列的位置
+ * @return 所有读取的列都在 index key 中时，返回 index scan 改为 index-only 后的 plan，否则返回 nullptr
+ */
+auto MakeIndexOnly(const Catalog &catalog, const AbstractPlanNodeRef &plan, std::vector<uint32_t> *columns)
+    -> AbstractPlanNodeRef {
+  switch (plan->GetType()) {
+    case PlanType::Filter:
+      CollectColumns(dynamic_cast<const FilterPlanNode &>(*plan).GetPredicate(), columns);
+      break;
+    case PlanType::Sort:
+      for (const auto &[order_by_type, expr] : dynamic_cast<const SortPlanNode &>(*plan).GetOrderBy()) {
+        CollectColumns(expr, columns);
+      }
+      break;
+    case PlanType::TopN:
+      for (const auto &[order_by_type, expr] : dynamic_cast<const TopNPlanNode &>(*plan).GetOrderBy()) {
+        CollectColumns(expr, columns);
+      }
+      break;
+    case PlanType::Limit:
+      break;
+    case PlanType::IndexScan: {
+      const auto &index_scan_plan = dynamic_cast<const IndexScanPlanNode &>(*plan);
+      if (index_scan_plan.index_only_ || index_scan_plan.table_name_.empty()) {
+        return nullptr;
+      }
+      for (const auto *index_info : catalog.GetTableIndexes(index_scan_plan.table_name_)) {
+        if (index_info->index_oid_ != index_scan_plan.GetIndexOid()) {
+          continue;
+        }
+        const auto &key_attrs = index_info->index_->GetKeyAttrs();
+        for (auto col_idx : *columns) {
+          if (std::find(key_attrs.begin(), key_attrs.end(), col_idx) == key_attrs.end()) {
+            return nullptr;
+          }
+        }
+        auto index_only_plan = std::make_shared<IndexScanPlanNode>(index_scan_plan);
+        index_only_plan->index_only_ = true;
+        return index_only_plan;
+      }
+      return nullptr;
+    }
+    default:
+      return nullptr;
+  }
+  auto child = MakeIndexOnly(catalog, plan->GetChildAt(0), columns);
+  if (child == nullptr) {
+    return nullptr;
+  }
+  return plan->CloneWithChildren({child});
+}
+
+}  // namespace
+
+auto Optimizer::OptimizeIndexOnlyScan(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef {
+  std::vector<AbstractPlanNodeRef> children;
+  for (const auto &child : plan->GetChildren()) {
+    children.emplace_back(OptimizeIndexOnlyScan(child));
+  }
+  auto optimized_plan = plan->CloneWithChildren(std::move(children));
+
+  // 只有 projection 和 aggregation 会丢掉列，它们之下的 scan 才可能不需要完整的 tuple
+  std::vector<uint32_t> columns;
+  if (optimized_plan->GetType() == PlanType::Projection) {
+    for (const auto &expr : dynamic_cast<const ProjectionPlanNode &>(*optimized_plan).GetExpressions()) {
+      CollectColumns(expr, &columns);
+    }
+  } else if (optimized_plan->GetType() == PlanType::Aggregation) {
+    const auto &aggregation_plan = dynamic_cast<const AggregationPlanNode &>(*optimized_plan);
+    for (const auto &expr : aggregation_plan.GetGroupBys()) {
+      CollectColumns(expr, &columns);
+    }
+    for (const auto &expr : aggregation_plan.GetAggregates()) {
+      CollectColumns(expr, &columns);
+    }
+  } else {
+    return optimized_plan;
+  }
+  auto child = MakeIndexOnly(catalog_, optimized_plan->GetChildAt(0), &columns);
+  if (child == nullptr) {
+    return optimized_plan;
+  }
+  return optimized_plan->CloneWithChildren({child});
+}
+
+}  // namespace bustub
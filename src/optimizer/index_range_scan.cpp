@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#include "execution/expressions/column_value_expression.h"
+#include "execution/expressions/comparison_expression.h"
+#include "execution/expressions/constant_value_expression.h"
+#include "execution/expressions/logic_expression.h"
+#include "execution/expressions/parameter_value_expression.h"
+#include "execution/plans/filter_plan.h"
+#include "execution/plans/index_scan_plan.h"
+#include "execution/plans/seq_scan_plan.h"
+#include "execution/plans/sort_plan.h"
+#include "optimizer/optimizer.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+namespace {
+
+/** `column op constant` on the scanned table, with the constant moved to the right. */
+struct ColumnBound {
+  uint32_t col_idx_;
+  ComparisonType comp_type_;
+  /** Empty when the constant is a parameter of a prepared plan */
+  std::optional<int64_t> value_;
+};
+
+// 把 AND 连接的条件拆开
+void SplitConjuncts(const AbstractExpressionRef &expr, std::vector<AbstractExpressionRef> *conjuncts) {
+  if (const auto *logic_expr = dynamic_cast<const LogicExpression *>(expr.get());
+      logic_expr != nullptr && logic_expr->logic_type_ == LogicType::And) {
+    SplitConjuncts(logic_expr->GetChildAt(0), conjuncts);
+    SplitConjuncts(logic_expr->GetChildAt(1), conjuncts);
+    return;
+  }
+  conjuncts->emplace_back(expr);
+}
+
+// 只处理 integer 列与 integer 常量或 integer 参数的比较
+auto MatchColumnBound(const AbstractExpression &expr, const Schema &schema) -> std::optional<ColumnBound> {
+  const auto *comp_expr = dynamic_cast<const ComparisonExpression *>(&expr);
+  if (comp_expr == nullptr || comp_expr->comp_type_ == ComparisonType::NotEqual) {
+    return std::nullopt;
+  }
+  auto comp_type = comp_expr->comp_type_;
+  const auto *column_expr = dynamic_cast<const ColumnValueExpression *>(comp_expr->GetChildAt(0).get());
+  const auto *other_expr = comp_expr->GetChildAt(1).get();
+  if (column_expr == nullptr) {
+    // constant op column
+    column_expr = dynamic_cast<const ColumnValueExpression *>(comp_expr->GetChildAt(1).get());
+    other_expr = comp_expr->GetChildAt(0).get();
+    switch (comp_type) {
+      case ComparisonType::LessThan:
+        comp_type = ComparisonType::GreaterThan;
+        break;
+      case ComparisonType::LessThanOrEqual:
+        comp_type = ComparisonType::GreaterThanOrEqual;
+        break;
+      case ComparisonType::GreaterThan:
+        comp_type = ComparisonType::LessThan;
+        break;
+      case ComparisonType::GreaterThanOrEqual:
+        comp_type = ComparisonType::LessThanOrEqual;
+        break;
+      default:
+        break;
+    }
+  }
+  if (column_expr == nullptr || column_expr->GetTupleIdx() != 0 ||
+      schema.GetColumn(column_expr->GetColIdx()).GetType() != TypeId::INTEGER) {
+    return std::nullopt;
+  }
+  if (const auto *param_expr = dynamic_cast<const ParameterValueExpression *>(other_expr);
+      param_expr != nullptr && param_expr->GetReturnType() == TypeId::INTEGER) {
+    return ColumnBound{column_expr->GetColIdx(), comp_type, std::nullopt};
+  }
+  const auto *constant_expr = dynamic_cast<const ConstantValueExpression *>(other_expr);
+  if (constant_expr == nullptr || constant_expr->val_.GetTypeId() != TypeId::INTEGER || constant_expr->val_.IsNull()) {
+    return std::nullopt;
+  }
+  return ColumnBound{column_expr->GetColIdx(), comp_type, constant_expr->val_.GetAs<int32_t>()};
+}
+
+/** The range of the index key implied by the conjuncts on the key column, and the conjuncts left for a filter. */
+struct KeyRange {
+  std::optional<Value> low_;
+  std::optional<Value> high_;
+  /** The conjuncts on the key column when one of them has a parameter, low_ and high_ are then computed at binding */
+  AbstractExpressionRef key_predicate_;
+  AbstractExpressionRef rest_;
+};
+
+auto AppendConjunct(const AbstractExpressionRef &expr, const AbstractExpressionRef &conjunct) -> AbstractExpressionRef {
+  return expr == nullptr ? conjunct : std::make_shared<LogicExpression>(expr, conjunct, LogicType::And);
+}
+
+// 合并 key 列上的所有条件，得到 [low, high)，剩下的条件仍然由 filter 检查
+auto ExtractKeyRange(const std::vector<AbstractExpressionRef> &conjuncts,
+                     const std::vector<std::optional<ColumnBound>> &bounds, uint32_t key_col_idx) -> KeyRange {
+  std::optional<int64_t> low;
+  std::optional<int64_t> high;
+  auto raise_low = [&](int64_t v) { low = low.has_value() ? std::max(*low, v) : v; };
+  auto lower_high = [&](int64_t v) { high = high.has_value() ? std::min(*high, v) : v; };
+  KeyRange range;
+  bool has_param = false;
+  for (size_t i = 0; i < conjuncts.size(); i++) {
+    if (!bounds[i].has_value() || bounds[i]->col_idx_ != key_col_idx) {
+      range.rest_ = AppendConjunct(range.rest_, conjuncts[i]);
+      continue;
+    }
+    range.key_predicate_ = AppendConjunct(range.key_predicate_, conjuncts[i]);
+    if (!bounds[i]->value_.has_value()) {
+      has_param = true;
+      continue;
+    }
+    auto v = *bounds[i]->value_;
+    switch (bounds[i]->comp_type_) {
+      case ComparisonType::Equal:
+        raise_low(v);
+        lower_high(v + 1);
+        break;
+      case ComparisonType::LessThan:
+        lower_high(v);
+        break;
+      case ComparisonType::LessThanOrEqual:
+        lower_high(v + 1);
+        break;
+      case ComparisonType::GreaterThan:
+        raise_low(v + 1);
+        break;
+      case ComparisonType::GreaterThanOrEqual:
+        raise_low(v);
+        break;
+      default:
+        break;
+    }
+  }
+  if (has_param) {
+    return range;
+  }
+  range.key_predicate_ = nullptr;
+  // key 是 int32，超出范围的 high 相当于没有上界；low 超出范围时 range 为空
+  constexpr int64_t int32_max = std::numeric_limits<int32_t>::max();
+  if (high.has_value() && *high > int32_max) {
+    high = std::nullopt;
+  }
+  if (low.has_value() && *low > int32_max) {
+    low = int32_max;
+    high = int32_max;
+  }
+  if (low.has_value()) {
+    range.low_ = ValueFactory::GetIntegerValue(static_cast<int32_t>(*low));
+  }
+  if (high.has_value()) {
+    range.high_ = ValueFactory::GetIntegerValue(static_cast<int32_t>(*high));
+  }
+  return range;
+}
+
+}  // namespace
+
+auto Optimizer::OptimizeFilterAsIndexRangeScan(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef {
+  std::vector<AbstractPlanNodeRef> children;
+  for (const auto &child : plan->GetChildren()) {
+    children.emplace_back(OptimizeFilterAsIndexRangeScan(child));
+  }
+  auto optimized_plan = plan->CloneWithChildren(std::move(children));
+
+  if (optimized_plan->GetType() != PlanType::Filter) {
+    return optimized_plan;
+  }
+  const auto &filter_plan = dynamic_cast<const FilterPlanNode &>(*optimized_plan);
+  BUSTUB_ASSERT(filter_plan.children_.size() == 1, "must have exactly one children");
+  if (filter_plan.GetChildPlan()->GetType() != PlanType::SeqScan) {
+    return optimized_plan;
+  }
+  const auto &seq_scan_plan = dynamic_cast<const SeqScanPlanNode &>(*filter_plan.GetChildPlan());
+
+  std::vector<AbstractExpressionRef> conjuncts;
+  SplitConjuncts(filter_plan.GetPredicate(), &conjuncts);
+  std::vector<std::optional<ColumnBound>> bounds;
+  for (const auto &conjunct : conjuncts) {
+    bounds.emplace_back(MatchColumnBound(*conjunct, seq_scan_plan.OutputSchema()));
+  }
+  // 使用第一个有 index 的 key 列
+  for (const auto &bound : bounds) {
+    if (!bound.has_value()) {
+      continue;
+    }
+    auto index = MatchIndex(seq_scan_plan.table_name_, bound->col_idx_);
+    if (!index.has_value()) {
+      continue;
+    }
+    auto range = ExtractKeyRange(conjuncts, bounds, bound->col_idx_);
+    auto index_scan_plan = std::make_shared<IndexScanPlanNode>(
+        seq_scan_plan.output_schema_, std::get<0>(*index), seq_scan_plan.table_name_, range.low_, range.high_, false);
+    index_scan_plan->key_predicate_ = range.key_predicate_;
+    if (range.rest_ == nullptr) {
+      return index_scan_plan;
+    }
+    return std::make_shared<FilterPlanNode>(filter_plan.output_schema_, range.rest_, index_scan_plan);
+  }
+  return optimized_plan;
+}
+
+auto Optimizer::OptimizeOrderByAsIndexRangeScan(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef {
+  std::vector<AbstractPlanNodeRef> children;
+  for (const auto &child : plan->GetChildren()) {
+    children.emplace_back(OptimizeOrderByAsIndexRangeScan(child));
+  }
+  auto optimized_plan = plan->CloneWithChildren(std::move(children));
+
+  if (optimized_plan->GetType() != PlanType::Sort) {
+    return optimized_plan;
+  }
+  const auto &sort_plan = dynamic_cast<const SortPlanNode &>(*optimized_plan);
+  const auto &order_bys = sort_plan.GetOrderBy();
+  // index 的 key 是唯一的，按第一个 order by 列排好序后其余的 order by 不起作用
+  if (order_bys.empty() || order_bys[0].first == OrderByType::INVALID) {
+    return optimized_plan;
+  }
+  const auto *column_expr = dynamic_cast<const ColumnValueExpression *>(order_bys[0].second.get());
+  if (column_expr == nullptr || column_expr->GetTupleIdx() != 0) {
+    return optimized_plan;
+  }
+  bool reverse = order_bys[0].first == OrderByType::DESC;
+
+  // filter 不改变顺序，可以穿过 filter 找到 scan，并把 filter 中 key 列上的条件变成 range
+  auto scan_plan = sort_plan.GetChildPlan();
+  const FilterPlanNode *filter_plan = nullptr;
+  if (scan_plan->GetType() == PlanType::Filter) {
+    filter_plan = dynamic_cast<const FilterPlanNode *>(scan_plan.get());
+    scan_plan = filter_plan->GetChildPlan();
+  }
+  if (scan_plan->GetType() != PlanType::SeqScan) {
+    return optimized_plan;
+  }
+  const auto &seq_scan_plan = dynamic_cast<const SeqScanPlanNode &>(*scan_plan);
+  auto index = MatchIndex(seq_scan_plan.table_name_, column_expr->GetColIdx());
+  if (!index.has_value()) {
+    return optimized_plan;
+  }
+  KeyRange range;
+  if (filter_plan != nullptr) {
+    std::vector<AbstractExpressionRef> conjuncts;
+    SplitConjuncts(filter_plan->GetPredicate(), &conjuncts);
+    std::vector<std::optional<ColumnBound>> bounds;
+    for (const auto &conjunct : conjuncts) {
+      bounds.emplace_back(MatchColumnBound(*conjunct, seq_scan_plan.OutputSchema()));
+    }
+    range = ExtractKeyRange(conjuncts, bounds, column_expr->GetColIdx());
+  }
+  auto index_scan_plan =
+      std::make_shared<IndexScanPlanNode>(seq_scan_plan.output_schema_, std::get<0>(*index), seq_scan_plan.table_name_,
+                                          range.low_, range.high_, reverse);
+  index_scan_plan->key_predicate_ = range.key_predicate_;
+  if (range.rest_ == nullptr) {
+    return index_scan_plan;
+  }
+  return std::make_shared<FilterPlanNode>(filter_plan->output_schema_, range.rest_, index_scan_plan);
+}
+
+void Optimizer::BindKeyRange(IndexScanPlanNode *plan) {
+  if (plan->key_predicate_ == nullptr) {
+    return;
+  }
+  std::vector<AbstractExpressionRef> conjuncts;
+  SplitConjuncts(plan->key_predicate_, &conjuncts);
+  std::vector<std::optional<ColumnBound>> bounds;
+  bool matched = true;
+  for (const auto &conjunct : conjuncts) {
+    bounds.emplace_back(MatchColumnBound(*conjunct, plan->OutputSchema()));
+    if (bounds.back().has_value() && !bounds.back()->value_.has_value()) {
+      // 还有没绑定的参数
+      return;
+    }
+    matched = matched && bounds.back().has_value();
+  }
+  plan->key_predicate_ = nullptr;
+  if (!matched) {
+    // 参数是 NULL 时比较不会为 true，range 为空
+    constexpr int32_t int32_max = std::numeric_limits<int32_t>::max();
+    plan->low_key_ = ValueFactory::GetIntegerValue(int32_max);
+    plan->high_key_ = ValueFactory::GetIntegerValue(int32_max);
+    return;
+  }
+  auto range = ExtractKeyRange(conjuncts, bounds, bounds[0]->col_idx_);
+  plan->low_key_ = range.low_;
+  plan->high_key_ = range.high_;
+}
+
+}  // namespace bustub
@@ -0,0 +1,690 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "binder/table_ref/bound_join_ref.h"
+#include "catalog/table_statistics.h"
+#include "execution/expressions/column_value_expression.h"
+#include "execution/expressions/comparison_expression.h"
+#include "execution/expressions/constant_value_expression.h"
+#include "execution/expressions/logic_expression.h"
+#include "execution/plans/filter_plan.h"
+#include "execution/plans/hash_join_plan.h"
+#include "execution/plans/index_scan_plan.h"
+#include "execution/plans/limit_plan.h"
+#include "execution/plans/nested_index_join_plan.h"
+#include "execution/plans/nested_loop_join_plan.h"
+#include "execution/plans/projection_plan.h"
+#include "execution/plans/seq_scan_plan.h"
+#include "execution/plans/values_plan.h"
+#include "optimizer/optimizer.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+namespace {
+
+/** Row count of a table the optimizer knows nothing about */
+constexpr double JOIN_DEFAULT_TABLE_ROWS = 1000;
+/** Selectivity of an equality whose columns have no known distinct count, and of any other comparison */
+constexpr double JOIN_DEFAULT_EQ_SELECTIVITY = 0.1;
+constexpr double JOIN_DEFAULT_SELECTIVITY = 1.0 / 3;
+/** Cost per tuple of inserting into the hash table, of probing it, and of one index lookup */
+constexpr double JOIN_HASH_BUILD_COST = 2;
+constexpr double JOIN_HASH_PROBE_COST = 1;
+constexpr double JOIN_INDEX_LOOKUP_COST = 4;
+/** Joins of up to this many inputs are ordered by dynamic programming over all subsets, larger ones greedily */
+constexpr size_t JOIN_DP_MAX_LEAVES = 10;
+constexpr size_t JOIN_MAX_LEAVES = 64;
+
+/** An input of a tree of inner joins, reading the columns [offset_, offset_ + column_count_) of the join output. */
+struct JoinLeaf {
+  AbstractPlanNodeRef plan_;
+  uint32_t offset_;
+  uint32_t column_count_;
+  double rows_;
+  /** Distinct count of each column, when known */
+  std::vector<std::optional<double>> distinct_;
+};
+
+/** A conjunct of the join predicates, its columns numbered in the output of the whole join tree */
+struct JoinConjunct {
+  AbstractExpressionRef expr_;
+  /** Bitmap of the leaves it reads */
+  uint64_t leaves_;
+  double selectivity_;
+  /** For `column = column` on two leaves, the two columns */
+  std::optional<std::pair<uint32_t, uint32_t>> equi_;
+};
+
+/** A single-column index (oid, name) on a column, as returned by Optimizer::MatchIndex() */
+using ColumnIndex = std::optional<std::tuple<index_oid_t, std::string>>;
+
+enum class JoinMethod { NestedLoop, Hash, NestedIndex };
+
+/** The cheapest way found to join a set of leaves */
+struct JoinEntry {
+  double rows_;
+  double cost_;
+  /** The two sides of the join, 0 for a leaf */
+  uint64_t left_{0};
+  uint64_t right_{0};
+  JoinMethod method_{JoinMethod::NestedLoop};
+  /** The conjunct used as hash or index key */
+  size_t key_conjunct_{0};
+};
+
+/** The plan of a set of leaves, and the column of the join output at each column of it */
+struct JoinBuild {
+  AbstractPlanNodeRef plan_;
+  std::vector<uint32_t> columns_;
+};
+
+auto IsTrue(const AbstractExpressionRef &expr) -> bool {
+  const auto *constant_expr = dynamic_cast<const ConstantValueExpression *>(expr.get());
+  return constant_expr != nullptr && constant_expr->val_.CastAs(TypeId::BOOLEAN).GetAs<bool>();
+}
+
+void SplitAnd(const AbstractExpressionRef &expr, std::vector<AbstractExpressionRef> *conjuncts) {
+  if (const auto *logic_expr = dynamic_cast<const LogicExpression *>(expr.get());
+      logic_expr != nullptr && logic_expr->logic_type_ == LogicType::And) {
+    SplitAnd(logic_expr->GetChildAt(0), conjuncts);
+    SplitAnd(logic_expr->GetChildAt(1), conjuncts);
+    return;
+  }
+  if (!IsTrue(expr)) {
+    conjuncts->emplace_back(expr);
+  }
+}
+
+auto MakeAnd(const std::vector<AbstractExpressionRef> &conjuncts) -> AbstractExpressionRef {
+  AbstractExpressionRef expr;
+  for (const auto &conjunct : conjuncts) {
+    expr = expr == nullptr ? conjunct : std::make_shared<LogicExpression>(expr, conjunct, LogicType::And);
+  }
+  return expr;
+}
+
+/** 用 remap(tuple_idx, col_idx) 返回的 (tuple_idx, col_idx) 替换 expression 中所有的列 */
+template <typename F>
+auto RemapColumns(const AbstractExpressionRef &expr, const F &remap) -> AbstractExpressionRef {
+  if (const auto *column_expr = dynamic_cast<const ColumnValueExpression *>(expr.get()); column_expr != nullptr) {
+    auto [tuple_idx, col_idx] = remap(column_expr->GetTupleIdx(), column_expr->GetColIdx());
+    return std::make_shared<ColumnValueExpression>(tuple_idx, col_idx, column_expr->GetReturnType());
+  }
+  std::vector<AbstractExpressionRef> children;
+  for (const auto &child : expr->GetChildren()) {
+    children.emplace_back(RemapColumns(child, remap));
+  }
+  return expr->CloneWithChildren(std::move(children));
+}
+
+template <typename F>
+void ForEachColumn(const AbstractExpressionRef &expr, const F &f) {
+  if (const auto *column_expr = dynamic_cast<const ColumnValueExpression *>(expr.get()); column_expr != nullptr) {
+    f(column_expr->GetColIdx());
+  }
+  for (const auto &child : expr->GetChildren()) {
+    ForEachColumn(child, f);
+  }
+}
+
+auto IsInnerJoin(const AbstractPlanNode &plan) -> bool {
+  return plan.GetType() == PlanType::NestedLoopJoin &&
+         dynamic_cast<const NestedLoopJoinPlanNode &>(plan).GetJoinType() == JoinType::INNER;
+}
+
+/**
+ * 把一棵 inner NLJ 树拆成 leaf 和条件，条件中的列改为整棵树输出中的列 (tuple_idx 都是 0)
+ * @param offset plan 的第一列在整棵树输出中的位置
+ */
+void FlattenJoins(const AbstractPlanNodeRef &plan, uint32_t offset, std::vector<AbstractPlanNodeRef> *leaves,
+                  std::vector<AbstractExpressionRef> *conjuncts) {
+  if (!IsInnerJoin(*plan)) {
+    leaves->emplace_back(plan);
+    return;
+  }
+  const auto &join_plan = dynamic_cast<const NestedLoopJoinPlanNode &>(*plan);
+  auto left_count = static_cast<uint32_t>(join_plan.GetLeftPlan()->OutputSchema().GetColumnCount());
+  FlattenJoins(join_plan.GetLeftPlan(), offset, leaves, conjuncts);
+  FlattenJoins(join_plan.GetRightPlan(), offset + left_count, leaves, conjuncts);
+  std::vector<AbstractExpressionRef> own;
+  SplitAnd(join_plan.Predicate(), &own);
+  for (const auto &conjunct : own) {
+    conjuncts->emplace_back(RemapColumns(conjunct, [&](uint32_t tuple_idx, uint32_t col_idx) {
+      return std::make_pair(0U, offset + (tuple_idx == 0 ? col_idx : left_count + col_idx));
+    }));
+  }
+}
+
+/** Join ordering of one tree of inner joins, see Optimizer::OptimizeJoinOrder(). */
+class JoinOrderer {
+ public:
+  JoinOrderer(const Catalog &catalog, std::vector<JoinLeaf> leaves, std::vector<JoinConjunct> conjuncts,
+              std::vector<std::vector<ColumnIndex>> column_indexes)
+      : catalog_(catalog),
+        leaves_(std::move(leaves)),
+        conjuncts_(std::move(conjuncts)),
+        column_indexes_(std::move(column_indexes)) {
+    for (size_t i = 0; i < leaves_.size(); i++) {
+      leaf_of_column_.insert(leaf_of_column_.end(), leaves_[i].column_count_, static_cast<uint32_t>(i));
+    }
+  }
+
+  /** Find the cheapest order and return its plan, with the column of the original join output at each column. */
+  auto Order() -> JoinBuild {
+    uint64_t all = leaves_.size() == 64 ? ~0ULL : (1ULL << leaves_.size()) - 1;
+    for (size_t i = 0; i < leaves_.size(); i++) {
+      entries_[1ULL << i] = JoinEntry{Rows(1ULL << i), 0};
+    }
+    if (leaves_.size() <= JOIN_DP_MAX_LEAVES) {
+      OrderDP(all);
+    } else {
+      OrderGreedy();
+    }
+    return Build(all);
+  }
+
+ private:
+  /** 估算 leaf 集合 join 之后的行数，只与集合有关，与 join 的顺序无关 */
+  auto Rows(uint64_t mask) -> double {
+    auto it = rows_.find(mask);
+    if (it != rows_.end()) {
+      return it->second;
+    }
+    double rows = 1;
+    for (size_t i = 0; i < leaves_.size(); i++) {
+      if ((mask >> i & 1) != 0) {
+        rows *= leaves_[i].rows_;
+      }
+    }
+    for (const auto &conjunct : conjuncts_) {
+      if ((conjunct.leaves_ & ~mask) == 0) {
+        rows *= conjunct.selectivity_;
+      }
+    }
+    rows = std::max(rows, 1.0);
+    rows_.emplace(mask, rows);
+    return rows;
+  }
+
+  /** 条件在 left 和 right join 时检查：之前的 join 中还没有检查过，并且 join 之后它读的 leaf 都有了 */
+  auto AppliesAt(const JoinConjunct &conjunct, uint64_t left, uint64_t right) const -> bool {
+    auto covered = [&](uint64_t side) { return (conjunct.leaves_ & ~side) == 0 && (side & (side - 1)) != 0; };
+    return (conjunct.leaves_ & ~(left | right)) == 0 && !covered(left) && !covered(right);
+  }
+
+  /** @return the leaf `side` holds, if it holds a single one */
+  auto SingleLeaf(uint64_t side) const -> std::optional<size_t> {
+    if ((side & (side - 1)) != 0) {
+      return std::nullopt;
+    }
+    size_t i = 0;
+    while ((side >> i & 1) == 0) {
+      i++;
+    }
+    return i;
+  }
+
+  /** 估算 left 与 right join 的代价，选择 join 的算法 */
+  auto Evaluate(uint64_t left, uint64_t right) -> JoinEntry {
+    const auto &l = entries_.at(left);
+    const auto &r = entries_.at(right);
+    JoinEntry entry{Rows(left | right), 0, left, right};
+    double join_cost = l.rows_ * r.rows_;
+    for (size_t i = 0; i < conjuncts_.size(); i++) {
+      const auto &conjunct = conjuncts_[i];
+      if (!conjunct.equi_.has_value() || !AppliesAt(conjunct, left, right)) {
+        continue;
+      }
+      auto [a, b] = *conjunct.equi_;
+      if ((left >> leaf_of_column_[a] & 1) == 0) {
+        std::swap(a, b);
+      }
+      if ((left >> leaf_of_column_[a] & 1) == 0 || (right >> leaf_of_column_[b] & 1) == 0) {
+        continue;
+      }
+      // hash join 用 right 建 hash table
+      double hash_cost = r.rows_ * JOIN_HASH_BUILD_COST + l.rows_ * JOIN_HASH_PROBE_COST;
+      if (hash_cost < join_cost) {
+        join_cost = hash_cost;
+        entry.method_ = JoinMethod::Hash;
+        entry.key_conjunct_ = i;
+      }
+      // right 是直接扫描的表，并且 key 列上有 index 时，可以对每个 left tuple 查找 index
+      auto leaf = SingleLeaf(right);
+      if (leaf.has_value() && column_indexes_[*leaf][b - leaves_[*leaf].offset_].has_value()) {
+        double index_cost = l.rows_ * JOIN_INDEX_LOOKUP_COST;
+        if (index_cost < join_cost) {
+          join_cost = index_cost;
+          entry.method_ = JoinMethod::NestedIndex;
+          entry.key_conjunct_ = i;
+        }
+      }
+    }
+    // 每个 join 输出的行数也计入代价，中间结果越小越好
+    entry.cost_ = l.cost_ + r.cost_ + join_cost + entry.rows_;
+    return entry;
+  }
+
+  void Consider(uint64_t left, uint64_t right) {
+    auto entry = Evaluate(left, right);
+    auto it = entries_.find(left | right);
+    if (it == entries_.end() || entry.cost_ < it->second.cost_) {
+      entries_[left | right] = entry;
+    }
+  }
+
+  // 从小到大枚举所有子集，每个子集按所有的拆分方式 join
+  void OrderDP(uint64_t all) {
+    for (uint64_t mask = 1; mask <= all; mask++) {
+      if ((mask & (mask - 1)) == 0) {
+        continue;
+      }
+      for (uint64_t left = (mask - 1) & mask; left != 0; left = (left - 1) & mask) {
+        Consider(left, mask ^ left);
+      }
+    }
+  }
+
+  // 每次 join 代价最小的两个集合，直到只剩一个
+  void OrderGreedy() {
+    std::vector<uint64_t> sets;
+    for (size_t i = 0; i < leaves_.size(); i++) {
+      sets.emplace_back(1ULL << i);
+    }
+    while (sets.size() > 1) {
+      std::optional<JoinEntry> best;
+      size_t best_i = 0;
+      size_t best_j = 0;
+      for (size_t i = 0; i < sets.size(); i++) {
+        for (size_t j = 0; j < sets.size(); j++) {
+          if (i == j) {
+            continue;
+          }
+          auto entry = Evaluate(sets[i], sets[j]);
+          // 选择 join 之后总代价最小的一对
+          if (!best.has_value() || entry.cost_ < best->cost_) {
+            best = entry;
+            best_i = i;
+            best_j = j;
+          }
+        }
+      }
+      entries_[best->left_ | best->right_] = *best;
+      sets[best_i] = best->left_ | best->right_;
+      sets.erase(sets.begin() + static_cast<std::ptrdiff_t>(best_j));
+    }
+  }
+
+  auto Build(uint64_t mask) -> JoinBuild {
+    const auto &entry = entries_.at(mask);
+    if (entry.left_ == 0) {
+      const auto &leaf = leaves_[*SingleLeaf(mask)];
+      JoinBuild build{leaf.plan_, {}};
+      for (uint32_t i = 0; i < leaf.column_count_; i++) {
+        build.columns_.emplace_back(leaf.offset_ + i);
+      }
+      return build;
+    }
+    auto left = Build(entry.left_);
+    auto right = entry.method_ == JoinMethod::NestedIndex ? JoinBuild{} : Build(entry.right_);
+    std::unordered_map<uint32_t, uint32_t> left_pos;
+    for (uint32_t i = 0; i < left.columns_.size(); i++) {
+      left_pos[left.columns_[i]] = i;
+    }
+    JoinBuild build;
+    build.columns_ = left.columns_;
+    if (entry.method_ == JoinMethod::NestedIndex) {
+      const auto &leaf = leaves_[*SingleLeaf(entry.right_)];
+      for (uint32_t i = 0; i < leaf.column_count_; i++) {
+        build.columns_.emplace_back(leaf.offset_ + i);
+      }
+    } else {
+      build.columns_.insert(build.columns_.end(), right.columns_.begin(), right.columns_.end());
+    }
+    std::unordered_map<uint32_t, uint32_t> pos;
+    for (uint32_t i = 0; i < build.columns_.size(); i++) {
+      pos[build.columns_[i]] = i;
+    }
+    auto left_count = static_cast<uint32_t>(left.columns_.size());
+
+    std::vector<AbstractExpressionRef> predicates;
+    for (size_t i = 0; i < conjuncts_.size(); i++) {
+      if ((entry.method_ == JoinMethod::NestedLoop || i != entry.key_conjunct_) &&
+          AppliesAt(conjuncts_[i], entry.left_, entry.right_)) {
+        predicates.emplace_back(conjuncts_[i].expr_);
+      }
+    }
+    std::optional<std::pair<uint32_t, uint32_t>> key;
+    if (entry.method_ != JoinMethod::NestedLoop) {
+      auto [a, b] = *conjuncts_[entry.key_conjunct_].equi_;
+      if (left_pos.count(a) == 0) {
+        std::swap(a, b);
+      }
+      key = std::make_pair(a, b);
+    }
+    auto key_expr = [&](uint32_t column, uint32_t tuple_idx, uint32_t col_idx) {
+      const auto &column_info = leaves_[leaf_of_column_[column]].plan_->OutputSchema().GetColumn(
+          column - leaves_[leaf_of_column_[column]].offset_);
+      return std::make_shared<ColumnValueExpression>(tuple_idx, col_idx, column_info.GetType());
+    };
+
+    switch (entry.method_) {
+      case JoinMethod::NestedLoop: {
+        auto schema = std::make_shared<Schema>(NestedLoopJoinPlanNode::InferJoinSchema(*left.plan_, *right.plan_));
+        AbstractExpressionRef predicate = MakeAnd(predicates);
+        if (predicate == nullptr) {
+          predicate = std::make_shared<ConstantValueExpression>(ValueFactory::GetBooleanValue(true));
+        } else {
+          predicate = RemapColumns(predicate, [&](uint32_t, uint32_t col_idx) {
+            auto p = pos.at(col_idx);
+            return p < left_count ? std::make_pair(0U, p) : std::make_pair(1U, p - left_count);
+          });
+        }
+        build.plan_ = std::make_shared<NestedLoopJoinPlanNode>(std::move(schema), left.plan_, right.plan_,
+                                                               std::move(predicate), JoinType::INNER);
+        return build;
+      }
+      case JoinMethod::Hash: {
+        auto schema = std::make_shared<Schema>(NestedLoopJoinPlanNode::InferJoinSchema(*left.plan_, *right.plan_));
+        auto right_pos = pos.at(key->second) - left_count;
+        build.plan_ = std::make_shared<HashJoinPlanNode>(
+            schema, left.plan_, right.plan_, key_expr(key->first, 0, left_pos.at(key->first)),
+            key_expr(key->second, 1, right_pos), JoinType::INNER);
+        break;
+      }
+      case JoinMethod::NestedIndex: {
+        auto leaf_idx = *SingleLeaf(entry.right_);
+        const auto &leaf = leaves_[leaf_idx];
+        const auto &scan_plan = dynamic_cast<const SeqScanPlanNode &>(*leaf.plan_);
+        const auto &[index_oid, index_name] = *column_indexes_[leaf_idx][key->second - leaf.offset_];
+        auto schema = std::make_shared<Schema>(NestedLoopJoinPlanNode::InferJoinSchema(*left.plan_, *leaf.plan_));
+        SchemaRef key_schema;
+        for (const auto *index_info : catalog_.GetTableIndexes(scan_plan.table_name_)) {
+          if (index_info->index_oid_ == index_oid) {
+            key_schema = std::make_shared<Schema>(index_info->key_schema_);
+          }
+        }
+        build.plan_ = std::make_shared<NestedIndexJoinPlanNode>(
+            schema, left.plan_, key_expr(key->first, 0, left_pos.at(key->first)), scan_plan.GetTableOid(),
+            index_oid, index_name, scan_plan.table_name_, std::move(key_schema), scan_plan.output_schema_,
+            JoinType::INNER);
+        break;
+      }
+    }
+    // hash join 和 index join 只检查 key，其余的条件放在上面的 filter 中
+    if (!predicates.empty()) {
+      auto predicate = RemapColumns(MakeAnd(predicates), [&](uint32_t, uint32_t col_idx) {
+        return std::make_pair(0U, pos.at(col_idx));
+      });
+      build.plan_ = std::make_shared<FilterPlanNode>(build.plan_->output_schema_, predicate, build.plan_);
+    }
+    return build;
+  }
+
+  const Catalog &catalog_;
+  std::vector<JoinLeaf> leaves_;
+  std::vector<JoinConjunct> conjuncts_;
+  /** For each leaf that is a seq scan, the single-column index on each of its columns */
+  std::vector<std::vector<ColumnIndex>> column_indexes_;
+  std::vector<uint32_t> leaf_of_column_;
+  std::unordered_map<uint64_t, JoinEntry> entries_;
+  std::unordered_map<uint64_t, double> rows_;
+};
+
+}  // namespace
+
+auto Optimizer::EstimateSelectivity(const AbstractExpressionRef &predicate, const SeqScanPlanNode &scan_plan)
+    -> double {
+  std::vector<AbstractExpressionRef> conjuncts;
+  SplitAnd(predicate, &conjuncts);
+  auto statistics = StatisticsCatalog::GetTableStatistics(&catalog_, scan_plan.GetTableOid());
+  double selectivity = 1;
+  for (const auto &conjunct : conjuncts) {
+    // 只估算 column op constant，其余的用默认值
+    const auto *comp_expr = dynamic_cast<const ComparisonExpression *>(conjunct.get());
+    const ColumnValueExpression *column_expr = nullptr;
+    const ConstantValueExpression *constant_expr = nullptr;
+    auto comp_type = ComparisonType::Equal;
+    if (comp_expr != nullptr) {
+      comp_type = comp_expr->comp_type_;
+      column_expr = dynamic_cast<const ColumnValueExpression *>(comp_expr->GetChildAt(0).get());
+      constant_expr = dynamic_cast<const ConstantValueExpression *>(comp_expr->GetChildAt(1).get());
+      if (column_expr == nullptr) {
+        column_expr = dynamic_cast<const ColumnValueExpression *>(comp_expr->GetChildAt(1).get());
+        constant_expr = dynamic_cast<const ConstantValueExpression *>(comp_expr->GetChildAt(0).get());
+        // constant op column 改为 column op constant
+        switch (comp_type) {
+          case ComparisonType::LessThan:
+            comp_type = ComparisonType::GreaterThan;
+            break;
+          case ComparisonType::LessThanOrEqual:
+            comp_type = ComparisonType::GreaterThanOrEqual;
+            break;
+          case ComparisonType::GreaterThan:
+            comp_type = ComparisonType::LessThan;
+            break;
+          case ComparisonType::GreaterThanOrEqual:
+            comp_type = ComparisonType::LessThanOrEqual;
+            break;
+          default:
+            break;
+        }
+      }
+    }
+    if (statistics == nullptr || column_expr == nullptr || constant_expr == nullptr) {
+      selectivity *= comp_expr != nullptr && comp_expr->comp_type_ == ComparisonType::Equal
+                         ? JOIN_DEFAULT_EQ_SELECTIVITY
+                         : JOIN_DEFAULT_SELECTIVITY;
+      continue;
+    }
+    auto col_idx = column_expr->GetColIdx();
+    const auto &value = constant_expr->val_;
+    switch (comp_type) {
+      case ComparisonType::Equal:
+        selectivity *= statistics->EstimateEqual(col_idx, value);
+        break;
+      case ComparisonType::NotEqual:
+        selectivity *= 1 - statistics->GetNullFraction(col_idx) - statistics->EstimateEqual(col_idx, value);
+        break;
+      case ComparisonType::LessThan:
+      case ComparisonType::LessThanOrEqual:
+        selectivity *= statistics->EstimateRange(col_idx, std::nullopt, value);
+        break;
+      case ComparisonType::GreaterThan:
+      case ComparisonType::GreaterThanOrEqual:
+        selectivity *= statistics->EstimateRange(col_idx, value, std::nullopt);
+        break;
+    }
+  }
+  return std::clamp(selectivity, 0.0, 1.0);
+}
+
+auto Optimizer::EstimateRows(const AbstractPlanNode &plan) -> double {
+  switch (plan.GetType()) {
+    case PlanType::SeqScan: {
+      const auto &scan_plan = dynamic_cast<const SeqScanPlanNode &>(plan);
+      double rows = JOIN_DEFAULT_TABLE_ROWS;
+      if (auto statistics = StatisticsCatalog::GetTableStatistics(&catalog_, scan_plan.GetTableOid());
+          statistics != nullptr) {
+        rows = statistics->GetRows();
+      } else if (auto cardinality = EstimatedCardinality(scan_plan.table_name_); cardinality.has_value()) {
+        rows = static_cast<double>(*cardinality);
+      }
+      if (scan_plan.filter_predicate_ != nullptr) {
+        rows *= EstimateSelectivity(scan_plan.filter_predicate_, scan_plan);
+      }
+      return std::max(rows, 1.0);
+    }
+    case PlanType::IndexScan: {
+      const auto &index_scan_plan = dynamic_cast<const IndexScanPlanNode &>(plan);
+      if (index_scan_plan.table_name_.empty()) {
+        return JOIN_DEFAULT_TABLE_ROWS;
+      }
+      const auto *table_info = catalog_.GetTable(index_scan_plan.table_name_);
+      auto statistics = StatisticsCatalog::GetTableStatistics(&catalog_, table_info->oid_);
+      double rows = JOIN_DEFAULT_TABLE_ROWS;
+      if (statistics != nullptr) {
+        rows = statistics->GetRows();
+      } else if (auto cardinality = EstimatedCardinality(index_scan_plan.table_name_); cardinality.has_value()) {
+        rows = static_cast<double>(*cardinality);
+      }
+      if (!index_scan_plan.low_key_.has_value() && !index_scan_plan.high_key_.has_value() &&
+          index_scan_plan.key_predicate_ == nullptr) {
+        return rows;
+      }
+      // range 的边界是参数时不知道它的大小
+      double selectivity = JOIN_DEFAULT_SELECTIVITY;
+      for (const auto *index_info : catalog_.GetTableIndexes(index_scan_plan.table_name_)) {
+        if (statistics != nullptr && index_info->index_oid_ == index_scan_plan.GetIndexOid() &&
+            index_scan_plan.key_predicate_ == nullptr) {
+          selectivity = statistics->EstimateRange(index_info->index_->GetKeyAttrs()[0], index_scan_plan.low_key_,
+                                                  index_scan_plan.high_key_);
+        }
+      }
+      return std::max(rows * selectivity, 1.0);
+    }
+    case PlanType::Filter: {
+      const auto &filter_plan = dynamic_cast<const FilterPlanNode &>(plan);
+      auto rows = EstimateRows(*filter_plan.GetChildPlan());
+      if (filter_plan.GetChildPlan()->GetType() == PlanType::SeqScan) {
+        rows *= EstimateSelectivity(filter_plan.GetPredicate(),
+                                    dynamic_cast<const SeqScanPlanNode &>(*filter_plan.GetChildPlan()));
+      } else {
+        rows *= JOIN_DEFAULT_SELECTIVITY;
+      }
+      return std::max(rows, 1.0);
+    }
+    case PlanType::Limit:
+      return std::min(EstimateRows(*plan.GetChildAt(0)),
+                      static_cast<double>(dynamic_cast<const LimitPlanNode &>(plan).GetLimit()));
+    case PlanType::Values:
+      return static_cast<double>(dynamic_cast<const ValuesPlanNode &>(plan).GetValues().size());
+    default:
+      break;
+  }
+  if (plan.GetChildren().empty()) {
+    return JOIN_DEFAULT_TABLE_ROWS;
+  }
+  double rows = 1;
+  for (const auto &child : plan.GetChildren()) {
+    rows *= EstimateRows(*child);
+  }
+  return rows;
+}
+
+auto Optimizer::OptimizeJoinOrder(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef {
+  if (!IsInnerJoin(*plan)) {
+    std::vector<AbstractPlanNodeRef> children;
+    for (const auto &child : plan->GetChildren()) {
+      children.emplace_back(OptimizeJoinOrder(child));
+    }
+    return plan->CloneWithChildren(std::move(children));
+  }
+
+  std::vector<AbstractPlanNodeRef> leaf_plans;
+  std::vector<AbstractExpressionRef> exprs;
+  FlattenJoins(plan, 0, &leaf_plans, &exprs);
+  if (leaf_plans.size() > JOIN_MAX_LEAVES) {
+    return plan;
+  }
+
+  // 列的 distinct 数来自 ANALYZE 的统计信息，没有统计信息时有 index 的列的 key 是唯一的
+  std::vector<JoinLeaf> leaves;
+  std::vector<std::vector<ColumnIndex>> column_indexes;
+  std::vector<uint32_t> leaf_of_column;
+  uint32_t offset = 0;
+  for (auto &leaf_plan : leaf_plans) {
+    leaf_plan = OptimizeJoinOrder(leaf_plan);
+    JoinLeaf leaf{leaf_plan, offset, static_cast<uint32_t>(leaf_plan->OutputSchema().GetColumnCount()),
+                  EstimateRows(*leaf_plan), {}};
+    leaf.distinct_.resize(leaf.column_count_);
+    column_indexes.emplace_back(leaf.column_count_);
+    if (leaf_plan->GetType() == PlanType::SeqScan) {
+      const auto &scan_plan = dynamic_cast<const SeqScanPlanNode &>(*leaf_plan);
+      for (uint32_t i = 0; i < leaf.column_count_; i++) {
+        column_indexes.back()[i] = MatchIndex(scan_plan.table_name_, i);
+        if (column_indexes.back()[i].has_value()) {
+          leaf.distinct_[i] = leaf.rows_;
+        }
+      }
+    }
+    // filter 之下的 scan 的列与 leaf 的列相同
+    const auto *scan_plan = leaf_plan.get();
+    while (scan_plan->GetType() == PlanType::Filter) {
+      scan_plan = scan_plan->GetChildAt(0).get();
+    }
+    if (scan_plan->GetType() == PlanType::SeqScan) {
+      auto statistics = StatisticsCatalog::GetTableStatistics(
+          &catalog_, dynamic_cast<const SeqScanPlanNode &>(*scan_plan).GetTableOid());
+      for (uint32_t i = 0; statistics != nullptr && i < leaf.column_count_; i++) {
+        leaf.distinct_[i] = std::min(statistics->GetDistinct(i), leaf.rows_);
+      }
+    }
+    leaf_of_column.insert(leaf_of_column.end(), leaf.column_count_, static_cast<uint32_t>(leaves.size()));
+    offset += leaf.column_count_;
+    leaves.emplace_back(std::move(leaf));
+  }
+
+  std::vector<JoinConjunct> conjuncts;
+  for (const auto &expr : exprs) {
+    JoinConjunct conjunct{expr, 0, JOIN_DEFAULT_SELECTIVITY, std::nullopt};
+    ForEachColumn(expr, [&](uint32_t col_idx) { conjunct.leaves_ |= 1ULL << leaf_of_column[col_idx]; });
+    const auto *comp_expr = dynamic_cast<const ComparisonExpression *>(expr.get());
+    if (comp_expr != nullptr && comp_expr->comp_type_ == ComparisonType::Equal) {
+      // 选择率是 1 / 两边 distinct 数中较大的一个
+      auto distinct = [&](const AbstractExpressionRef &side) -> std::optional<double> {
+        const auto *column_expr = dynamic_cast<const ColumnValueExpression *>(side.get());
+        if (column_expr == nullptr) {
+          return std::nullopt;
+        }
+        const auto &leaf = leaves[leaf_of_column[column_expr->GetColIdx()]];
+        return leaf.distinct_[column_expr->GetColIdx() - leaf.offset_];
+      };
+      auto l = distinct(comp_expr->GetChildAt(0));
+      auto r = distinct(comp_expr->GetChildAt(1));
+      conjunct.selectivity_ = l.has_value() || r.has_value()
+                                  ? 1.0 / std::max({l.value_or(1.0), r.value_or(1.0), 1.0})
+                                  : JOIN_DEFAULT_EQ_SELECTIVITY;
+      const auto *l_column = dynamic_cast<const ColumnValueExpression *>(comp_expr->GetChildAt(0).get());
+      const auto *r_column = dynamic_cast<const ColumnValueExpression *>(comp_expr->GetChildAt(1).get());
+      if (l_column != nullptr && r_column != nullptr &&
+          leaf_of_column[l_column->GetColIdx()] != leaf_of_column[r_column->GetColIdx()] &&
+          l_column->GetReturnType() == r_column->GetReturnType()) {
+        conjunct.equi_ = std::make_pair(l_column->GetColIdx(), r_column->GetColIdx());
+      }
+    }
+    conjuncts.emplace_back(std::move(conjunct));
+  }
+
+  JoinOrderer orderer(catalog_, std::move(leaves), std::move(conjuncts), std::move(column_indexes));
+  auto build = orderer.Order();
+  // 恢复原来 join 输出中列的顺序
+  bool same_order = true;
+  for (uint32_t i = 0; i < build.columns_.size(); i++) {
+    same_order = same_order && build.columns_[i] == i;
+  }
+  if (same_order) {
+    return build.plan_;
+  }
+  std::vector<uint32_t> pos(build.columns_.size());
+  for (uint32_t i = 0; i < build.columns_.size(); i++) {
+    pos[build.columns_[i]] = i;
+  }
+  std::vector<AbstractExpressionRef> exprs_out;
+  for (uint32_t i = 0; i < pos.size(); i++) {
+    exprs_out.emplace_back(
+        std::make_shared<ColumnValueExpression>(0, pos[i], plan->OutputSchema().GetColumn(i).GetType()));
+  }
+  return std::make_shared<ProjectionPlanNode>(plan->output_schema_, std::move(exprs_out), build.plan_);
+}
+
+}  // namespace bustub
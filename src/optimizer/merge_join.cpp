@@ -0,0 +1,104 @@
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "binder/bound_order_by.h"
+#include "execution/expressions/column_value_expression.h"
+#include "execution/plans/hash_join_plan.h"
+#include "execution/plans/index_scan_plan.h"
+#include "execution/plans/merge_join_plan.h"
+#include "execution/plans/projection_plan.h"
+#include "execution/plans/sort_plan.h"
+#include "execution/plans/topn_plan.h"
+#include "optimizer/optimizer.h"
+
+namespace bustub {
+
+namespace {
+
+auto ColumnOf(const AbstractExpression &expr) -> std::optional<uint32_t> {
+  if (const auto *column_expr = dynamic_cast<const ColumnValueExpression *>(&expr); column_expr != nullptr) {
+    return column_expr->GetColIdx();
+  }
+  return std::nullopt;
+}
+
+auto AscendingColumn(const std::vector<std::pair<OrderByType, AbstractExpressionRef>> &order_bys)
+    -> std::optional<uint32_t> {
+  if (order_bys.empty() || order_bys[0].first == OrderByType::DESC) {
+    return std::nullopt;
+  }
+  return ColumnOf(*order_bys[0].second);
+}
+
+/** @return the output column in ascending order of which the plan produces its tuples, nullopt if there is none */
+auto SortedColumn(const Catalog &catalog, const AbstractPlanNode &plan) -> std::optional<uint32_t> {
+  switch (plan.GetType()) {
+    case PlanType::IndexScan: {
+      // index scan 输出 table 的所有列，按 index 的第一个 key 列排序
+      const auto &index_scan_plan = dynamic_cast<const IndexScanPlanNode &>(plan);
+      if (index_scan_plan.reverse_ || index_scan_plan.table_name_.empty()) {
+        return std::nullopt;
+      }
+      for (const auto *index_info : catalog.GetTableIndexes(index_scan_plan.table_name_)) {
+        if (index_info->index_oid_ == index_scan_plan.GetIndexOid()) {
+          return index_info->index_->GetKeyAttrs()[0];
+        }
+      }
+      return std::nullopt;
+    }
+    case PlanType::Sort:
+      return AscendingColumn(dynamic_cast<const SortPlanNode &>(plan).GetOrderBy());
+    case PlanType::TopN:
+      return AscendingColumn(dynamic_cast<const TopNPlanNode &>(plan).GetOrderBy());
+    case PlanType::Filter:
+    case PlanType::Limit:
+      return SortedColumn(catalog, *plan.GetChildAt(0));
+    case PlanType::Projection: {
+      auto col_idx = SortedColumn(catalog, *plan.GetChildAt(0));
+      const auto &exprs = dynamic_cast<const ProjectionPlanNode &>(plan).GetExpressions();
+      for (uint32_t i = 0; col_idx.has_value() && i < exprs.size(); i++) {
+        if (ColumnOf(*exprs[i]) == col_idx) {
+          return i;
+        }
+      }
+      return std::nullopt;
+    }
+    case PlanType::MergeJoin: {
+      // left 的列在输出的最前面
+      const auto &merge_join_plan = dynamic_cast<const MergeJoinPlanNode &>(plan);
+      return ColumnOf(merge_join_plan.LeftJoinKeyExpression());
+    }
+    default:
+      return std::nullopt;
+  }
+}
+
+}  // namespace
+
+auto Optimizer::OptimizeHashJoinAsMergeJoin(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef {
+  std::vector<AbstractPlanNodeRef> children;
+  for (const auto &child : plan->GetChildren()) {
+    children.emplace_back(OptimizeHashJoinAsMergeJoin(child));
+  }
+  auto optimized_plan = plan->CloneWithChildren(std::move(children));
+  if (optimized_plan->GetType() != PlanType::HashJoin) {
+    return optimized_plan;
+  }
+
+  // 两边都已经按 join key 升序输出时，merge 两边即可，不需要建 hash table
+  const auto &hash_join_plan = dynamic_cast<const HashJoinPlanNode &>(*optimized_plan);
+  auto left_col_idx = ColumnOf(hash_join_plan.LeftJoinKeyExpression());
+  auto right_col_idx = ColumnOf(hash_join_plan.RightJoinKeyExpression());
+  if (!left_col_idx.has_value() || !right_col_idx.has_value() ||
+      SortedColumn(catalog_, *hash_join_plan.GetLeftPlan()) != left_col_idx ||
+      SortedColumn(catalog_, *hash_join_plan.GetRightPlan()) != right_col_idx) {
+    return optimized_plan;
+  }
+  return std::make_shared<MergeJoinPlanNode>(hash_join_plan.output_schema_, hash_join_plan.GetLeftPlan(),
+                                             hash_join_plan.GetRightPlan(), hash_join_plan.left_key_expression_,
+                                             hash_join_plan.right_key_expression_, hash_join_plan.GetJoinType());
+}
+
+}  // namespace bustub
@@ -11,10 +11,19 @@ auto Optimizer::OptimizeCustom(const AbstractPlanNodeRef &plan) -> AbstractPlanN
   auto p = plan;
   p = OptimizeMergeProjection(p);
   p = OptimizeMergeFilterNLJ(p);
+  p = OptimizePredicatePushdown(p);
+  p = OptimizeJoinOrder(p);
   p = OptimizeNLJAsIndexJoin(p);
-  // p = OptimizeNLJAsHashJoin(p);  // Enable this rule after you have implemented hash join.
+  p = OptimizeNLJAsHashJoin(p);
+  p = OptimizeOrderByAsIndexRangeScan(p);
+  p = OptimizeFilterAsIndexRangeScan(p);
   p = OptimizeOrderByAsIndexScan(p);
+  p = OptimizeHashJoinAsMergeJoin(p);
   p = OptimizeSortLimitAsTopN(p);
+  // 剩下的 filter + seq scan 不能变成 index scan，在 scan 中检查 filter
+  p = OptimizeMergeFilterScan(p);
+  p = OptimizeIndexOnlyScan(p);
+  p = OptimizeParallelExchange(p);
   return p;
 }
 
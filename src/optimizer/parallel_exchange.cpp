@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <memory>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "execution/plans/exchange_plan.h"
+#include "execution/plans/hash_join_plan.h"
+#include "optimizer/optimizer.h"
+
+namespace bustub {
+
+namespace {
+
+/** Estimated input rows below which a pipeline runs on the calling thread only */
+constexpr double EXCHANGE_MIN_ROWS = 100000;
+/** Estimated input rows per thread of an exchange */
+constexpr double EXCHANGE_ROWS_PER_THREAD = 50000;
+
+/**
+ * @return the seq scan that drives `plan`, if the whole plan runs per morsel on the threads of that scan: a seq scan,
+ * filters above it, and hash joins probing with it on the left side. nullptr otherwise.
+ */
+auto PipelineScan(const AbstractPlanNode &plan) -> const AbstractPlanNode * {
+  switch (plan.GetType()) {
+    case PlanType::SeqScan:
+      return &plan;
+    case PlanType::Filter:
+      return PipelineScan(*plan.GetChildAt(0));
+    case PlanType::HashJoin:
+      return PipelineScan(*dynamic_cast<const HashJoinPlanNode &>(plan).GetLeftPlan());
+    default:
+      return nullptr;
+  }
+}
+
+}  // namespace
+
+auto Optimizer::OptimizeParallelExchange(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef {
+  switch (plan->GetType()) {
+    case PlanType::Insert:
+    case PlanType::Delete:
+    case PlanType::Update:
+      // 修改 table 的 plan 在一个线程上读 child，scan 不会与修改交错
+      return plan;
+    default:
+      break;
+  }
+
+  const auto *scan = PipelineScan(*plan);
+  auto num_threads = static_cast<size_t>(std::max<unsigned>(std::thread::hardware_concurrency(), 1));
+  auto rows = scan == nullptr ? 0 : EstimateRows(*scan);
+  if (scan == nullptr || num_threads == 1 || rows < EXCHANGE_MIN_ROWS) {
+    std::vector<AbstractPlanNodeRef> children;
+    for (const auto &child : plan->GetChildren()) {
+      children.emplace_back(OptimizeParallelExchange(child));
+    }
+    return plan->CloneWithChildren(std::move(children));
+  }
+
+  auto pipeline = OptimizeBuildSides(plan);
+  num_threads = std::clamp<size_t>(static_cast<size_t>(rows / EXCHANGE_ROWS_PER_THREAD), 2, num_threads);
+  return std::make_shared<ExchangePlanNode>(pipeline, num_threads);
+}
+
+auto Optimizer::OptimizeBuildSides(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef {
+  switch (plan->GetType()) {
+    case PlanType::Filter:
+      return plan->CloneWithChildren({OptimizeBuildSides(plan->GetChildAt(0))});
+    case PlanType::HashJoin:
+      // build 一侧在 Init 中由一个线程读完，它本身可以是另一个并行的 pipeline
+      return plan->CloneWithChildren(
+          {OptimizeBuildSides(plan->GetChildAt(0)), OptimizeParallelExchange(plan->GetChildAt(1))});
+    default:
+      return plan;
+  }
+}
+
+}  // namespace bustub
@@ -0,0 +1,335 @@
+#include "optimizer/plan_cache.h"
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/exception.h"
+#include "execution/expressions/constant_value_expression.h"
+#include "execution/expressions/parameter_value_expression.h"
+#include "execution/plans/aggregation_plan.h"
+#include "execution/plans/delete_plan.h"
+#include "execution/plans/filter_plan.h"
+#include "execution/plans/hash_join_plan.h"
+#include "execution/plans/index_scan_plan.h"
+#include "execution/plans/insert_plan.h"
+#include "execution/plans/merge_join_plan.h"
+#include "execution/plans/nested_index_join_plan.h"
+#include "execution/plans/nested_loop_join_plan.h"
+#include "execution/plans/projection_plan.h"
+#include "execution/plans/seq_scan_plan.h"
+#include "execution/plans/sort_plan.h"
+#include "execution/plans/topn_plan.h"
+#include "execution/plans/update_plan.h"
+#include "execution/plans/values_plan.h"
+#include "optimizer/optimizer.h"
+#include "type/type.h"
+
+namespace bustub {
+
+namespace {
+
+/** Maps a leaf of an expression to the expression that replaces it, nullptr to keep it */
+using ExprMap = std::function<AbstractExpressionRef(const AbstractExpression &)>;
+
+auto MapExpression(const AbstractExpressionRef &expr, const ExprMap &map) -> AbstractExpressionRef {
+  if (expr == nullptr) {
+    return nullptr;
+  }
+  if (expr->GetChildren().empty()) {
+    auto mapped = map(*expr);
+    return mapped == nullptr ? expr : mapped;
+  }
+  std::vector<AbstractExpressionRef> children;
+  for (const auto &child : expr->GetChildren()) {
+    children.emplace_back(MapExpression(child, map));
+  }
+  return expr->CloneWithChildren(std::move(children));
+}
+
+template <typename ExprList>
+void MapExpressions(ExprList *exprs, const ExprMap &map) {
+  for (auto &expr : *exprs) {
+    expr = MapExpression(expr, map);
+  }
+}
+
+template <typename OrderBys>
+void MapOrderBys(OrderBys *order_bys, const ExprMap &map) {
+  for (auto &order_by : *order_bys) {
+    order_by.second = MapExpression(order_by.second, map);
+  }
+}
+
+template <typename PlanNode>
+auto CopyPlan(const AbstractPlanNode &plan, std::vector<AbstractPlanNodeRef> &&children) -> std::shared_ptr<PlanNode> {
+  auto node = std::make_shared<PlanNode>(dynamic_cast<const PlanNode &>(plan));
+  node->children_ = std::move(children);
+  return node;
+}
+
+/**
+ * 对 plan 中所有的 expression 应用 map，children 先于父节点，每个节点内按字段的顺序
+ * @param[out] ok set to `false` if the plan has a node whose expressions are unknown
+ */
+auto MapPlan(const AbstractPlanNodeRef &plan, const ExprMap &map, bool *ok) -> AbstractPlanNodeRef {
+  std::vector<AbstractPlanNodeRef> children;
+  for (const auto &child : plan->GetChildren()) {
+    children.emplace_back(MapPlan(child, map, ok));
+  }
+  switch (plan->GetType()) {
+    case PlanType::SeqScan: {
+      auto node = CopyPlan<SeqScanPlanNode>(*plan, std::move(children));
+      node->filter_predicate_ = MapExpression(node->filter_predicate_, map);
+      return node;
+    }
+    case PlanType::IndexScan: {
+      auto node = CopyPlan<IndexScanPlanNode>(*plan, std::move(children));
+      node->key_predicate_ = MapExpression(node->key_predicate_, map);
+      // 参数都绑定之后才能算出 range
+      Optimizer::BindKeyRange(node.get());
+      return node;
+    }
+    case PlanType::Filter: {
+      auto node = CopyPlan<FilterPlanNode>(*plan, std::move(children));
+      node->predicate_ = MapExpression(node->predicate_, map);
+      return node;
+    }
+    case PlanType::Projection: {
+      auto node = CopyPlan<ProjectionPlanNode>(*plan, std::move(children));
+      MapExpressions(&node->expressions_, map);
+      return node;
+    }
+    case PlanType::NestedLoopJoin: {
+      auto node = CopyPlan<NestedLoopJoinPlanNode>(*plan, std::move(children));
+      node->predicate_ = MapExpression(node->predicate_, map);
+      return node;
+    }
+    case PlanType::NestedIndexJoin: {
+      auto node = CopyPlan<NestedIndexJoinPlanNode>(*plan, std::move(children));
+      node->key_predicate_ = MapExpression(node->key_predicate_, map);
+      return node;
+    }
+    case PlanType::HashJoin: {
+      auto node = CopyPlan<HashJoinPlanNode>(*plan, std::move(children));
+      node->left_key_expression_ = MapExpression(node->left_key_expression_, map);
+      node->right_key_expression_ = MapExpression(node->right_key_expression_, map);
+      return node;
+    }
+    case PlanType::MergeJoin: {
+      auto node = CopyPlan<MergeJoinPlanNode>(*plan, std::move(children));
+      node->left_key_expression_ = MapExpression(node->left_key_expression_, map);
+      node->right_key_expression_ = MapExpression(node->right_key_expression_, map);
+      return node;
+    }
+    case PlanType::Aggregation: {
+      auto node = CopyPlan<AggregationPlanNode>(*plan, std::move(children));
+      MapExpressions(&node->group_bys_, map);
+      MapExpressions(&node->aggregates_, map);
+      return node;
+    }
+    case PlanType::Sort: {
+      auto node = CopyPlan<SortPlanNode>(*plan, std::move(children));
+      MapOrderBys(&node->order_bys_, map);
+      return node;
+    }
+    case PlanType::TopN: {
+      auto node = CopyPlan<TopNPlanNode>(*plan, std::move(children));
+      MapOrderBys(&node->order_bys_, map);
+      return node;
+    }
+    case PlanType::Values: {
+      auto node = CopyPlan<ValuesPlanNode>(*plan, std::move(children));
+      for (auto &row : node->values_) {
+        MapExpressions(&row, map);
+      }
+      return node;
+    }
+    case PlanType::Update: {
+      auto node = CopyPlan<UpdatePlanNode>(*plan, std::move(children));
+      MapExpressions(&node->target_expressions_, map);
+      return node;
+    }
+    case PlanType::Insert:
+    case PlanType::Delete:
+    case PlanType::Limit:
+    case PlanType::MockScan:
+    case PlanType::Exchange:
+      return plan->CloneWithChildren(std::move(children));
+    default:
+      *ok = false;
+      return plan;
+  }
+}
+
+}  // namespace
+
+auto PlanCache::Prepare(const AbstractPlanNodeRef &bound_plan, std::vector<Value> *params) -> PreparedPlan {
+  params->clear();
+  PreparedPlan prepared{"", nullptr, {}, true};
+  prepared.plan_ = MapPlan(
+      bound_plan,
+      [&](const AbstractExpression &expr) -> AbstractExpressionRef {
+        const auto *constant_expr = dynamic_cast<const ConstantValueExpression *>(&expr);
+        // boolean 常量决定了 plan 的形状（例如 `true` 的 predicate 会被去掉），保留在 plan 中
+        if (constant_expr == nullptr || constant_expr->val_.IsNull() ||
+            constant_expr->val_.GetTypeId() == TypeId::BOOLEAN) {
+          return nullptr;
+        }
+        params->emplace_back(constant_expr->val_);
+        prepared.param_types_.emplace_back(constant_expr->val_.GetTypeId());
+        return std::make_shared<ParameterValueExpression>(params->size() - 1, constant_expr->val_.GetTypeId());
+      },
+      &prepared.cacheable_);
+  if (!prepared.cacheable_) {
+    params->clear();
+    prepared.param_types_.clear();
+    prepared.plan_ = bound_plan;
+    return prepared;
+  }
+  prepared.key_ = prepared.plan_->ToString();
+  for (auto type : prepared.param_types_) {
+    prepared.key_ += "\n" + Type::TypeIdToString(type);
+  }
+  return prepared;
+}
+
+auto PlanCache::BindParams(const AbstractPlanNodeRef &plan, const std::vector<Value> &params) -> AbstractPlanNodeRef {
+  bool ok = true;
+  auto bind = [&](const AbstractExpression &expr) -> AbstractExpressionRef {
+    const auto *param_expr = dynamic_cast<const ParameterValueExpression *>(&expr);
+    if (param_expr == nullptr) {
+      return nullptr;
+    }
+    return std::make_shared<ConstantValueExpression>(params[param_expr->slot_]);
+  };
+  auto bound = MapPlan(plan, bind, &ok);
+  return ok ? bound : nullptr;
+}
+
+auto PlanCache::TablesOf(const AbstractPlanNodeRef &plan) const -> std::vector<std::string> {
+  std::vector<std::string> tables;
+  switch (plan->GetType()) {
+    case PlanType::SeqScan:
+      tables.emplace_back(dynamic_cast<const SeqScanPlanNode &>(*plan).table_name_);
+      break;
+    case PlanType::IndexScan: {
+      const auto *index_info = catalog_.GetIndex(dynamic_cast<const IndexScanPlanNode &>(*plan).GetIndexOid());
+      tables.emplace_back(index_info == nullptr ? "" : index_info->table_name_);
+      break;
+    }
+    case PlanType::NestedIndexJoin:
+      tables.emplace_back(dynamic_cast<const NestedIndexJoinPlanNode &>(*plan).index_table_name_);
+      break;
+    case PlanType::Insert:
+    case PlanType::Delete:
+    case PlanType::Update: {
+      auto oid = plan->GetType() == PlanType::Insert   ? dynamic_cast<const InsertPlanNode &>(*plan).TableOid()
+                 : plan->GetType() == PlanType::Delete ? dynamic_cast<const DeletePlanNode &>(*plan).TableOid()
+                                                       : dynamic_cast<const UpdatePlanNode &>(*plan).TableOid();
+      const auto *table_info = catalog_.GetTable(oid);
+      tables.emplace_back(table_info == nullptr ? "" : table_info->name_);
+      break;
+    }
+    default:
+      break;
+  }
+  for (const auto &child : plan->GetChildren()) {
+    auto child_tables = TablesOf(child);
+    tables.insert(tables.end(), child_tables.begin(), child_tables.end());
+  }
+  return tables;
+}
+
+auto PlanCache::IndexCounts(const std::vector<std::string> &tables) const -> std::vector<size_t> {
+  std::vector<size_t> counts;
+  for (const auto &table : tables) {
+    counts.emplace_back(catalog_.GetTable(table) == nullptr ? std::numeric_limits<size_t>::max()
+                                                            : catalog_.GetTableIndexes(table).size());
+  }
+  return counts;
+}
+
+auto PlanCache::Bind(const PreparedPlan &prepared, const std::vector<Value> &params, const OptimizeFn &optimize)
+    -> AbstractPlanNodeRef {
+  if (params.size() != prepared.param_types_.size()) {
+    throw Exception(ExceptionType::INVALID, fmt::format("expected {} parameters, got {}",
+                                                        prepared.param_types_.size(), params.size()));
+  }
+  for (size_t i = 0; i < params.size(); i++) {
+    if (params[i].GetTypeId() != prepared.param_types_[i]) {
+      throw Exception(ExceptionType::INVALID, fmt::format("parameter ${} has type {}, expected {}", i + 1,
+                                                          Type::TypeIdToString(params[i].GetTypeId()),
+                                                          Type::TypeIdToString(prepared.param_types_[i])));
+    }
+  }
+  if (!prepared.cacheable_) {
+    misses_++;
+    return optimize(prepared.plan_);
+  }
+
+  std::unique_lock<std::mutex> lock(latch_);
+  auto it = templates_.find(prepared.key_);
+  if (it != templates_.end() && it->second.first.epoch_ == epoch_.load()) {
+    auto &[entry, lru_it] = it->second;
+    lru_.splice(lru_.begin(), lru_, lru_it);
+    // template 不会被修改，检查 catalog 和绑定参数都在 latch 外进行
+    auto plan = entry.plan_;
+    auto tables = entry.tables_;
+    auto index_counts = entry.index_counts_;
+    bool bindable = entry.bindable_;
+    lock.unlock();
+    if (IndexCounts(tables) == index_counts) {
+      if (!bindable) {
+        misses_++;
+        return optimize(BindParams(prepared.plan_, params));
+      }
+      hits_++;
+      return BindParams(plan, params);
+    }
+  } else {
+    lock.unlock();
+  }
+
+  misses_++;
+  auto epoch = epoch_.load();
+  Template entry{optimize(prepared.plan_), {}, {}, true, epoch};
+  entry.tables_ = TablesOf(entry.plan_);
+  entry.index_counts_ = IndexCounts(entry.tables_);
+  auto plan = BindParams(entry.plan_, params);
+  if (plan == nullptr) {
+    entry.bindable_ = false;
+    plan = optimize(BindParams(prepared.plan_, params));
+  }
+
+  lock.lock();
+  it = templates_.find(prepared.key_);
+  if (it != templates_.end()) {
+    lru_.erase(it->second.second);
+    templates_.erase(it);
+  }
+  lru_.push_front(prepared.key_);
+  templates_.emplace(prepared.key_, std::make_pair(std::move(entry), lru_.begin()));
+  if (templates_.size() > capacity_) {
+    templates_.erase(lru_.back());
+    lru_.pop_back();
+  }
+  return plan;
+}
+
+auto PlanCache::GetPlan(const AbstractPlanNodeRef &bound_plan, const OptimizeFn &optimize) -> AbstractPlanNodeRef {
+  std::vector<Value> params;
+  auto prepared = Prepare(bound_plan, &params);
+  return Bind(prepared, params, optimize);
+}
+
+void PlanCache::Invalidate() {
+  std::scoped_lock<std::mutex> lock(latch_);
+  epoch_++;
+  templates_.clear();
+  lru_.clear();
+}
+
+}  // namespace bustub
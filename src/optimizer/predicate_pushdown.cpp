@@ -0,0 +1,174 @@
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "binder/table_ref/bound_join_ref.h"
+#include "execution/expressions/column_value_expression.h"
+#include "execution/expressions/constant_value_expression.h"
+#include "execution/expressions/logic_expression.h"
+#include "execution/plans/filter_plan.h"
+#include "execution/plans/nested_loop_join_plan.h"
+#include "optimizer/optimizer.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+namespace {
+
+/** The side of a join a conjunct reads */
+enum class JoinSide { None, Left, Right, Both };
+
+// 把 AND 连接的条件拆开，去掉恒为 true 的条件
+void SplitPredicate(const AbstractExpressionRef &expr, std::vector<AbstractExpressionRef> *conjuncts) {
+  if (const auto *logic_expr = dynamic_cast<const LogicExpression *>(expr.get());
+      logic_expr != nullptr && logic_expr->logic_type_ == LogicType::And) {
+    SplitPredicate(logic_expr->GetChildAt(0), conjuncts);
+    SplitPredicate(logic_expr->GetChildAt(1), conjuncts);
+    return;
+  }
+  const auto *constant_expr = dynamic_cast<const ConstantValueExpression *>(expr.get());
+  if (constant_expr != nullptr && constant_expr->val_.CastAs(TypeId::BOOLEAN).GetAs<bool>()) {
+    return;
+  }
+  conjuncts->emplace_back(expr);
+}
+
+auto MakeConjunction(const std::vector<AbstractExpressionRef> &conjuncts) -> AbstractExpressionRef {
+  AbstractExpressionRef expr;
+  for (const auto &conjunct : conjuncts) {
+    expr = expr == nullptr ? conjunct : std::make_shared<LogicExpression>(expr, conjunct, LogicType::And);
+  }
+  return expr;
+}
+
+/**
+ * @param left_column_cnt for a condition on the join output, the number of columns of the left child; 0 for a join
+ * predicate, whose columns say their side by tuple_idx
+ */
+auto SideOf(const AbstractExpression &expr, uint32_t left_column_cnt) -> JoinSide {
+  if (const auto *column_expr = dynamic_cast<const ColumnValueExpression *>(&expr); column_expr != nullptr) {
+    bool left = left_column_cnt == 0 ? column_expr->GetTupleIdx() == 0 : column_expr->GetColIdx() < left_column_cnt;
+    return left ? JoinSide::Left : JoinSide::Right;
+  }
+  auto side = JoinSide::None;
+  for (const auto &child : expr.GetChildren()) {
+    auto child_side = SideOf(*child, left_column_cnt);
+    if (side == JoinSide::None) {
+      side = child_side;
+    } else if (child_side != JoinSide::None && child_side != side) {
+      return JoinSide::Both;
+    }
+  }
+  return side;
+}
+
+/** 把条件中的列改为 join 一边的 child 中的列 (tuple_idx 为 0)，offset 是这一边在 join 输出中的第一列 */
+auto ToChildColumns(const AbstractExpressionRef &expr, uint32_t offset, bool by_tuple_idx) -> AbstractExpressionRef {
+  if (const auto *column_expr = dynamic_cast<const ColumnValueExpression *>(expr.get()); column_expr != nullptr) {
+    return std::make_shared<ColumnValueExpression>(0, by_tuple_idx ? column_expr->GetColIdx()
+                                                                   : column_expr->GetColIdx() - offset,
+                                                   column_expr->GetReturnType());
+  }
+  std::vector<AbstractExpressionRef> children;
+  for (const auto &child : expr->GetChildren()) {
+    children.emplace_back(ToChildColumns(child, offset, by_tuple_idx));
+  }
+  return expr->CloneWithChildren(std::move(children));
+}
+
+/** 把 join 输出上的条件改为 join predicate，列按左右分为 tuple_idx 0 和 1 */
+auto ToJoinColumns(const AbstractExpressionRef &expr, uint32_t left_column_cnt) -> AbstractExpressionRef {
+  if (const auto *column_expr = dynamic_cast<const ColumnValueExpression *>(expr.get()); column_expr != nullptr) {
+    auto col_idx = column_expr->GetColIdx();
+    return col_idx < left_column_cnt
+               ? std::make_shared<ColumnValueExpression>(0, col_idx, column_expr->GetReturnType())
+               : std::make_shared<ColumnValueExpression>(1, col_idx - left_column_cnt, column_expr->GetReturnType());
+  }
+  std::vector<AbstractExpressionRef> children;
+  for (const auto &child : expr->GetChildren()) {
+    children.emplace_back(ToJoinColumns(child, left_column_cnt));
+  }
+  return expr->CloneWithChildren(std::move(children));
+}
+
+auto WithFilter(const AbstractPlanNodeRef &plan, const std::vector<AbstractExpressionRef> &conjuncts)
+    -> AbstractPlanNodeRef {
+  if (conjuncts.empty()) {
+    return plan;
+  }
+  return std::make_shared<FilterPlanNode>(plan->output_schema_, MakeConjunction(conjuncts), plan);
+}
+
+/**
+ * 把 conjuncts 尽量向下推，return 检查了 conjuncts 的 plan
+ * @param conjuncts conditions on the output of `plan`
+ */
+auto PushDown(const AbstractPlanNodeRef &plan, std::vector<AbstractExpressionRef> conjuncts) -> AbstractPlanNodeRef {
+  if (plan->GetType() == PlanType::Filter) {
+    SplitPredicate(dynamic_cast<const FilterPlanNode &>(*plan).GetPredicate(), &conjuncts);
+    return PushDown(plan->GetChildAt(0), std::move(conjuncts));
+  }
+  if (plan->GetType() != PlanType::NestedLoopJoin) {
+    std::vector<AbstractPlanNodeRef> children;
+    for (const auto &child : plan->GetChildren()) {
+      children.emplace_back(PushDown(child, {}));
+    }
+    return WithFilter(plan->CloneWithChildren(std::move(children)), conjuncts);
+  }
+
+  const auto &join_plan = dynamic_cast<const NestedLoopJoinPlanNode &>(*plan);
+  auto join_type = join_plan.GetJoinType();
+  bool inner = join_type == JoinType::INNER;
+  if (!inner && join_type != JoinType::LEFT) {
+    std::vector<AbstractPlanNodeRef> children{PushDown(join_plan.GetLeftPlan(), {}),
+                                              PushDown(join_plan.GetRightPlan(), {})};
+    return WithFilter(plan->CloneWithChildren(std::move(children)), conjuncts);
+  }
+  auto left_column_cnt = static_cast<uint32_t>(join_plan.GetLeftPlan()->OutputSchema().GetColumnCount());
+  std::vector<AbstractExpressionRef> left;
+  std::vector<AbstractExpressionRef> right;
+  std::vector<AbstractExpressionRef> predicate;
+  std::vector<AbstractExpressionRef> above;
+  // join 之上的条件：left join 中右边的行可能是补的 NULL，只有左边的条件可以下推
+  for (const auto &conjunct : conjuncts) {
+    auto side = SideOf(*conjunct, left_column_cnt);
+    if (side == JoinSide::Left) {
+      left.emplace_back(ToChildColumns(conjunct, 0, false));
+    } else if (inner && side == JoinSide::Right) {
+      right.emplace_back(ToChildColumns(conjunct, left_column_cnt, false));
+    } else if (inner) {
+      predicate.emplace_back(ToJoinColumns(conjunct, left_column_cnt));
+    } else {
+      above.emplace_back(conjunct);
+    }
+  }
+  // join predicate：left join 中左边的行不论是否满足都会输出，只有右边的条件可以下推
+  std::vector<AbstractExpressionRef> own;
+  SplitPredicate(join_plan.Predicate(), &own);
+  for (const auto &conjunct : own) {
+    auto side = SideOf(*conjunct, 0);
+    if (inner && side == JoinSide::Left) {
+      left.emplace_back(ToChildColumns(conjunct, 0, true));
+    } else if (side == JoinSide::Right) {
+      right.emplace_back(ToChildColumns(conjunct, 0, true));
+    } else {
+      predicate.emplace_back(conjunct);
+    }
+  }
+  auto join_predicate = MakeConjunction(predicate);
+  if (join_predicate == nullptr) {
+    join_predicate = std::make_shared<ConstantValueExpression>(ValueFactory::GetBooleanValue(true));
+  }
+  AbstractPlanNodeRef pushed = std::make_shared<NestedLoopJoinPlanNode>(
+      join_plan.output_schema_, PushDown(join_plan.GetLeftPlan(), std::move(left)),
+      PushDown(join_plan.GetRightPlan(), std::move(right)), std::move(join_predicate), join_type);
+  return WithFilter(pushed, above);
+}
+
+}  // namespace
+
+auto Optimizer::OptimizePredicatePushdown(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef {
+  return PushDown(plan, {});
+}
+
+}  // namespace bustub
@@ -0,0 +1,110 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_scheduler.cpp
+//
+// Identification: src/storage/disk/disk_scheduler.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/disk_scheduler.h"
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+#include "common/macros.h"
+
+namespace bustub {
+
+DiskScheduler::DiskScheduler(DiskManager *disk_manager, size_t num_workers) : disk_manager_(disk_manager) {
+  BUSTUB_ASSERT(num_workers > 0, "DiskScheduler needs at least one I/O thread");
+  workers_.reserve(num_workers);
+  for (size_t i = 0; i < num_workers; i++) {
+    workers_.emplace_back(&DiskScheduler::RunWorker, this);
+  }
+}
+
+DiskScheduler::~DiskScheduler() {
+  {
+    std::scoped_lock<std::mutex> lock(latch_);
+    stopped_ = true;
+  }
+  queue_cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+auto DiskScheduler::ScheduleRead(page_id_t page_id, char *data) -> std::future<void> {
+  std::vector<DiskRequest> requests;
+  requests.push_back({false, data, page_id, {}});
+  return std::move(Schedule(&requests)[0]);
+}
+
+auto DiskScheduler::ScheduleWrite(page_id_t page_id, const char *data) -> std::future<void> {
+  std::vector<DiskRequest> requests;
+  // 写请求只读 data_
+  requests.push_back({true, const_cast<char *>(data), page_id, {}});  // NOLINT
+  return std::move(Schedule(&requests)[0]);
+}
+
+auto DiskScheduler::Schedule(std::vector<DiskRequest> *requests) -> std::vector<std::future<void>> {
+  std::vector<std::future<void>> futures;
+  futures.reserve(requests->size());
+  for (auto &request : *requests) {
+    futures.emplace_back(request.callback_.get_future());
+  }
+  {
+    std::scoped_lock<std::mutex> lock(latch_);
+    for (auto &request : *requests) {
+      queue_.emplace_back(std::move(request));
+    }
+  }
+  requests->clear();
+  if (futures.size() == 1) {
+    queue_cv_.notify_one();
+  } else {
+    queue_cv_.notify_all();
+  }
+  return futures;
+}
+
+void DiskScheduler::RunWorker() {
+  std::vector<DiskRequest> batch;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(latch_);
+      queue_cv_.wait(lock, [&] { return stopped_ || !queue_.empty(); });
+      // 停止时也先把队列中剩下的请求做完
+      if (queue_.empty()) {
+        return;
+      }
+      auto n = std::min(queue_.size(), DISK_SCHEDULER_BATCH_SIZE);
+      for (size_t i = 0; i < n; i++) {
+        batch.emplace_back(std::move(queue_.front()));
+        queue_.pop_front();
+      }
+    }
+    // 同一个 page 的请求保持提交顺序
+    std::stable_sort(batch.begin(), batch.end(),
+                     [](const DiskRequest &a, const DiskRequest &b) { return a.page_id_ < b.page_id_; });
+    for (auto &request : batch) {
+      try {
+        if (request.is_write_) {
+          disk_manager_->WritePage(request.page_id_, request.data_);
+        } else {
+          disk_manager_->ReadPage(request.page_id_, request.data_);
+        }
+        request.callback_.set_value();
+      } catch (...) {
+        request.callback_.set_exception(std::current_exception());
+      }
+    }
+    batch.clear();
+  }
+}
+
+}  // namespace bustub
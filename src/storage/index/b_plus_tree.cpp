@@ -1,5 +1,11 @@
 #include <unistd.h>
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <numeric>
 #include <string>
+#include <thread>  // NOLINT
+#include <utility>
 
 #include "common/config.h"
 #include "common/exception.h"
@@ -11,16 +17,25 @@
 namespace bustub {
 INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_TYPE::BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                          int leaf_max_size, int internal_max_size)
+                          int leaf_max_size, int internal_max_size, bool use_olc, bool compress_keys, bool lazy_merge)
     : index_name_(std::move(name)),
       root_page_id_(INVALID_PAGE_ID),
       buffer_pool_manager_(buffer_pool_manager),
       comparator_(comparator),
-      leaf_max_size_(std::min(leaf_max_size, static_cast<int>(LEAF_PAGE_SIZE - 3))),
-      internal_max_size_(std::min(internal_max_size, static_cast<int>(INTERNAL_PAGE_SIZE - 3))) {
+      // 压缩时 min size 不超过前缀为空时的容量，保证 redistribute 和 split 后插入的 leaf 一定放得下
+      leaf_max_size_(std::min(leaf_max_size, compress_keys ? 2 * LeafPage::COMPRESSED_MIN_CAPACITY - 3
+                                                           : static_cast<int>(LEAF_PAGE_SIZE - 3))),
+      internal_max_size_(std::min(internal_max_size, static_cast<int>(INTERNAL_PAGE_SIZE - 3))),
+      use_olc_(use_olc),
+      versions_(std::make_unique<VersionSlot[]>(OLC_VERSION_SLOTS)),
+      compress_keys_(compress_keys),
+      lazy_merge_(lazy_merge) {
   // UpdateRootPageId(true);
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+BPLUSTREE_TYPE::~BPlusTree() { StopBackgroundCompaction(); }
+
 /*
  * Helper function to decide whether current b+tree is empty
  */
@@ -37,11 +52,18 @@ auto BPLUSTREE_TYPE::IsEmpty() const -> bool { return root_page_id_ == INVALID_P
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction) -> bool {
   // std::scoped_lock<std::mutex> lock(latch_);
+  if (use_olc_) {
+    bool found = false;
+    if (GetValueOptimistic(key, result, &found)) {
+      return found;
+    }
+    // 冲突太多，退回到加锁的方式
+  }
   if (IsEmpty()) {
     return false;
   }
   // fetch page
-  auto cur_page_ptr = buffer_pool_manager_->FetchPage(root_page_id_);
+  auto cur_page_ptr = buffer_pool_manager_->FetchPage(root_page_id_, AccessType::Index);
   if (cur_page_ptr == nullptr) {
     return false;
   }
@@ -55,7 +77,7 @@ auto BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result
   auto cur_node_ptr = reinterpret_cast<InternalPage *>(cur_page_ptr->GetData());
   while (!cur_node_ptr->IsLeafPage()) {
     // fetch page
-    auto next_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->FindChild(key, comparator_));
+    auto next_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->FindChild(key, comparator_), AccessType::Index);
     if (next_page_ptr == nullptr) {
       if (transaction != nullptr) {
         transaction->GetPageSet()->pop_front();
@@ -101,11 +123,14 @@ auto BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result
 
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::OptmisticLock(const KeyType &key) -> Page * {
+  if (use_olc_) {
+    return FindLeafPageOptimistic(key, true, nullptr);
+  }
   if (IsEmpty()) {
     return nullptr;
   }
   // fetch page
-  auto cur_page_ptr = buffer_pool_manager_->FetchPage(root_page_id_);
+  auto cur_page_ptr = buffer_pool_manager_->FetchPage(root_page_id_, AccessType::Index);
   if (cur_page_ptr == nullptr) {
     return nullptr;
   }
@@ -113,7 +138,7 @@ auto BPLUSTREE_TYPE::OptmisticLock(const KeyType &key) -> Page * {
   auto cur_node_ptr = reinterpret_cast<InternalPage *>(cur_page_ptr->GetData());
   while (!cur_node_ptr->IsLeafPage()) {
     // fetch page
-    auto next_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->FindChild(key, comparator_));
+    auto next_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->FindChild(key, comparator_), AccessType::Index);
     if (next_page_ptr == nullptr) {
       cur_page_ptr->RUnlatch();
       buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
@@ -124,7 +149,7 @@ auto BPLUSTREE_TYPE::OptmisticLock(const KeyType &key) -> Page * {
     auto next_node_ptr = reinterpret_cast<InternalPage *>(next_page_ptr->GetData());
     if (next_node_ptr->IsLeafPage()) {
       next_page_ptr->RUnlatch();
-      next_page_ptr->WLatch();
+      WLatchPage(next_page_ptr);
       cur_page_ptr->RUnlatch();
       buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
       return next_page_ptr;
@@ -135,7 +160,236 @@ auto BPLUSTREE_TYPE::OptmisticLock(const KeyType &key) -> Page * {
     cur_page_ptr = next_page_ptr;
   }
   cur_page_ptr->RUnlatch();
-  cur_page_ptr->WLatch();
+  WLatchPage(cur_page_ptr);
+  return cur_page_ptr;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::FindLeafPageOptimistic(const KeyType &key, bool write, uint64_t *leaf_version) -> Page * {
+  for (int restart = 0; restart < OLC_MAX_RESTARTS; restart++) {
+    if (restart > 0) {
+      std::this_thread::yield();
+    }
+    if (IsEmpty()) {
+      return nullptr;
+    }
+    // root 分裂和合并时 root page id 都不变，所以这里不需要保护 root page id
+    auto cur_page_ptr = buffer_pool_manager_->FetchPage(root_page_id_, AccessType::Index);
+    if (cur_page_ptr == nullptr) {
+      return nullptr;
+    }
+    uint64_t cur_version = 0;
+    if (!ReadVersion(cur_page_ptr->GetPageId(), &cur_version)) {
+      buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
+      continue;
+    }
+    auto parent_page_id = INVALID_PAGE_ID;
+    uint64_t parent_version = 0;
+    bool conflict = false;
+    // 读到的内容可能是 writer 修改到一半的，只有通过 ValidateVersion 之后才能使用
+    while (!reinterpret_cast<BPlusTreePage *>(cur_page_ptr->GetData())->IsLeafPage()) {
+      auto cur_node_ptr = reinterpret_cast<InternalPage *>(cur_page_ptr->GetData());
+      auto child_page_id = cur_node_ptr->FindChild(key, comparator_);
+      if (!ValidateVersion(cur_page_ptr->GetPageId(), cur_version)) {
+        conflict = true;
+        break;
+      }
+      auto child_page_ptr = buffer_pool_manager_->FetchPage(child_page_id, AccessType::Index);
+      if (child_page_ptr == nullptr) {
+        buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
+        return nullptr;
+      }
+      // 先读 child 的 version 再检查 cur，保证 child 在读 version 时仍然是 cur 的 child
+      uint64_t child_version = 0;
+      if (!ReadVersion(child_page_id, &child_version) || !ValidateVersion(cur_page_ptr->GetPageId(), cur_version)) {
+        buffer_pool_manager_->UnpinPage(child_page_id, false);
+        conflict = true;
+        break;
+      }
+      parent_page_id = cur_page_ptr->GetPageId();
+      parent_version = cur_version;
+      buffer_pool_manager_->UnpinPage(parent_page_id, false);
+      cur_page_ptr = child_page_ptr;
+      cur_version = child_version;
+    }
+    if (conflict) {
+      buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
+      continue;
+    }
+    if (!write) {
+      *leaf_version = cur_version;
+      return cur_page_ptr;
+    }
+    // 加锁之后 parent 没有变化，说明 leaf 在此期间没有 split / merge，仍然是 key 所在的 leaf
+    WLatchPage(cur_page_ptr);
+    if (reinterpret_cast<BPlusTreePage *>(cur_page_ptr->GetData())->IsLeafPage() &&
+        (parent_page_id == INVALID_PAGE_ID || ValidateVersion(parent_page_id, parent_version))) {
+      return cur_page_ptr;
+    }
+    WUnlatchPage(cur_page_ptr);
+    buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
+  }
+  return nullptr;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::GetValueOptimistic(const KeyType &key, std::vector<ValueType> *result, bool *found) -> bool {
+  for (int restart = 0; restart < OLC_MAX_RESTARTS; restart++) {
+    if (IsEmpty()) {
+      *found = false;
+      return true;
+    }
+    uint64_t leaf_version = 0;
+    auto leaf_page_ptr = FindLeafPageOptimistic(key, false, &leaf_version);
+    if (leaf_page_ptr == nullptr) {
+      return false;
+    }
+    auto leaf_node_ptr = reinterpret_cast<LeafPage *>(leaf_page_ptr->GetData());
+    auto index = leaf_node_ptr->KeyIndexOf(key, comparator_);
+    ValueType value{};
+    if (index != INVALID_PAGE_ID) {
+      value = leaf_node_ptr->ValueAt(index);
+    }
+    bool valid = ValidateVersion(leaf_page_ptr->GetPageId(), leaf_version);
+    buffer_pool_manager_->UnpinPage(leaf_page_ptr->GetPageId(), false);
+    if (!valid) {
+      std::this_thread::yield();
+      continue;
+    }
+    *found = index != INVALID_PAGE_ID;
+    if (*found) {
+      result->emplace_back(value);
+    }
+    return true;
+  }
+  return false;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::WLatchPage(Page *page) {
+  page->WLatch();
+  // 先让 version 进入 locked 状态，再修改 page
+  SlotOf(page->GetPageId()).fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::WUnlatchPage(Page *page) {
+  // 释放一个 writer 的同时增加 version
+  SlotOf(page->GetPageId()).fetch_add((1ULL << VERSION_LOCK_BITS) - 1, std::memory_order_release);
+  page->WUnlatch();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::ReadVersion(page_id_t page_id, uint64_t *version) const -> bool {
+  *version = SlotOf(page_id).load(std::memory_order_acquire);
+  return (*version & VERSION_LOCK_MASK) == 0;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::ValidateVersion(page_id_t page_id, uint64_t version) const -> bool {
+  // 保证之前对 page 的读取不会被重排到检查之后
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return SlotOf(page_id).load(std::memory_order_relaxed) == version;
+}
+
+/*
+ * Look up a batch of keys in key order. The leaf of the previous key stays
+ * read-latched, and a key below its upper fence is searched in it directly
+ * instead of going down from the root again.
+ * @return : number of keys found
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::GetValues(const std::vector<KeyType> &keys, std::vector<std::vector<ValueType>> *results)
+    -> size_t {
+  results->assign(keys.size(), {});
+  std::vector<size_t> order(keys.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return comparator_(keys[a], keys[b]) < 0; });
+  size_t num_found = 0;
+  Page *leaf_page_ptr = nullptr;
+  KeyType upper_fence;
+  bool bounded = false;
+  for (auto i : order) {
+    const auto &key = keys[i];
+    // key 已经超出当前 leaf 的范围
+    if (leaf_page_ptr != nullptr && bounded && comparator_(key, upper_fence) >= 0) {
+      leaf_page_ptr->RUnlatch();
+      buffer_pool_manager_->UnpinPage(leaf_page_ptr->GetPageId(), false);
+      leaf_page_ptr = nullptr;
+    }
+    if (leaf_page_ptr == nullptr) {
+      leaf_page_ptr = FindLeafPageWithFence(key, false, &upper_fence, &bounded);
+      if (leaf_page_ptr == nullptr) {
+        break;
+      }
+    }
+    auto leaf_node_ptr = reinterpret_cast<LeafPage *>(leaf_page_ptr->GetData());
+    auto index = leaf_node_ptr->KeyIndexOf(key, comparator_);
+    if (index != INVALID_PAGE_ID) {
+      (*results)[i].emplace_back(leaf_node_ptr->ValueAt(index));
+      num_found++;
+    }
+  }
+  if (leaf_page_ptr != nullptr) {
+    leaf_page_ptr->RUnlatch();
+    buffer_pool_manager_->UnpinPage(leaf_page_ptr->GetPageId(), false);
+  }
+  return num_found;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::FindLeafPageWithFence(const KeyType &key, bool write, KeyType *upper_fence, bool *bounded)
+    -> Page * {
+  *bounded = false;
+  if (IsEmpty()) {
+    return nullptr;
+  }
+  auto cur_page_ptr = buffer_pool_manager_->FetchPage(root_page_id_, AccessType::Index);
+  if (cur_page_ptr == nullptr) {
+    return nullptr;
+  }
+  cur_page_ptr->RLatch();
+  auto cur_node_ptr = reinterpret_cast<InternalPage *>(cur_page_ptr->GetData());
+  while (!cur_node_ptr->IsLeafPage()) {
+    // 与 FindChild 相同地找到 child，同时记下它右边的 key 作为 upper fence
+    int index = cur_node_ptr->LowerBound(key, comparator_);
+    if (index >= cur_node_ptr->GetSize() || comparator_(cur_node_ptr->KeyAt(index), key) != 0) {
+      index--;
+    }
+    if (index + 1 < cur_node_ptr->GetSize()) {
+      *upper_fence = cur_node_ptr->KeyAt(index + 1);
+      *bounded = true;
+    }
+    auto next_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->ValueAt(index), AccessType::Index);
+    if (next_page_ptr == nullptr) {
+      cur_page_ptr->RUnlatch();
+      buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
+      return nullptr;
+    }
+    next_page_ptr->RLatch();
+    auto next_node_ptr = reinterpret_cast<InternalPage *>(next_page_ptr->GetData());
+    // 与 OptmisticLock 相同，在 parent 的读锁保护下把 leaf 的读锁换成写锁
+    if (write && next_node_ptr->IsLeafPage()) {
+      next_page_ptr->RUnlatch();
+      WLatchPage(next_page_ptr);
+    }
+    cur_page_ptr->RUnlatch();
+    buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
+    cur_node_ptr = next_node_ptr;
+    cur_page_ptr = next_page_ptr;
+  }
+  // root 就是 leaf
+  if (write && cur_page_ptr->GetPageId() == root_page_id_) {
+    cur_page_ptr->RUnlatch();
+    WLatchPage(cur_page_ptr);
+    // 换锁的间隙中 root 可能已经 split
+    if (!cur_node_ptr->IsLeafPage()) {
+      WUnlatchPage(cur_page_ptr);
+      buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
+      return nullptr;
+    }
+  }
   return cur_page_ptr;
 }
 
@@ -154,13 +408,14 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
   auto tmp_page_ptr = OptmisticLock(key);
   if (tmp_page_ptr != nullptr) {
     auto leaf_node_ptr = reinterpret_cast<LeafPage *>(tmp_page_ptr->GetData());
-    if (leaf_node_ptr->IsLeafPage() && leaf_node_ptr->GetSize() < leaf_node_ptr->GetMaxSize()) {
+    if (leaf_node_ptr->IsLeafPage() && leaf_node_ptr->GetSize() < leaf_node_ptr->GetMaxSize() &&
+        leaf_node_ptr->HasRoomFor(key)) {
       bool not_duplicate = leaf_node_ptr->InsertL(key, value, comparator_);
-      tmp_page_ptr->WUnlatch();
+      WUnlatchPage(tmp_page_ptr);
       buffer_pool_manager_->UnpinPage(tmp_page_ptr->GetPageId(), true);
       return not_duplicate;
     }
-    tmp_page_ptr->WUnlatch();
+    WUnlatchPage(tmp_page_ptr);
     buffer_pool_manager_->UnpinPage(tmp_page_ptr->GetPageId(), false);
   }
   // std::scoped_lock<std::mutex> lock(latch_);
@@ -176,7 +431,7 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
         throw Exception("Insert failed: can not get a new Page\n");
       }
       auto node_ptr = reinterpret_cast<LeafPage *>(page_ptr->GetData());
-      node_ptr->Init(page_id, INVALID_PAGE_ID, leaf_max_size_);
+      node_ptr->Init(page_id, INVALID_PAGE_ID, leaf_max_size_, compress_keys_);
       buffer_pool_manager_->UnpinPage(page_id, true);
       root_page_id_ = page_id;
       // 改变 root page id
@@ -189,7 +444,10 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
   // std::cout << "Insert start: k: " << key << " | v: " << value << std::endl;
   // insert before split
   auto leaf_node_ptr = reinterpret_cast<LeafPage *>(leaf_page_ptr->GetData());
-  bool not_duplicate = leaf_node_ptr->InsertL(key, value, comparator_);
+  // 压缩的 leaf 放不下 key 时先 split，再把 key 插入分裂后的一半
+  bool pending = !leaf_node_ptr->HasRoomFor(key);
+  bool not_duplicate =
+      pending ? !leaf_node_ptr->IsDuplicateKeyL(key, comparator_) : leaf_node_ptr->InsertL(key, value, comparator_);
   // duplicate key
   if (!not_duplicate) {
     if (transaction == nullptr) {
@@ -203,7 +461,7 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
   while (true) {
     auto cur_node_ptr = reinterpret_cast<InternalPage *>(cur_page_ptr->GetData());
     // no split
-    if (cur_node_ptr->GetSize() <= cur_node_ptr->GetMaxSize()) {
+    if (!pending && cur_node_ptr->GetSize() <= cur_node_ptr->GetMaxSize()) {
       break;
     }
     // 如果当前节点是 root node，则创建一个新的 root page
@@ -214,7 +472,7 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
         throw Exception("new page failed\n");
       }
       if (transaction != nullptr) {
-        new_page_ptr->WLatch();
+        WLatchPage(new_page_ptr);
         transaction->GetPageSet()->emplace_back(new_page_ptr);
       }
       auto new_node_ptr = reinterpret_cast<InternalPage *>(new_page_ptr->GetData());
@@ -222,7 +480,7 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
       if (cur_node_ptr->IsLeafPage()) {
         auto tmp_new_node_ptr = reinterpret_cast<LeafPage *>(new_node_ptr);
         auto tmp_cur_node_ptr = reinterpret_cast<LeafPage *>(cur_node_ptr);
-        tmp_new_node_ptr->Init(new_page_id, root_page_id_, leaf_max_size_);
+        tmp_new_node_ptr->Init(new_page_id, root_page_id_, leaf_max_size_, compress_keys_);
         for (int i = 0, sz = cur_node_ptr->GetSize(); i < sz; i++) {
           tmp_new_node_ptr->InsertLast(tmp_cur_node_ptr->KeyAt(i), tmp_cur_node_ptr->ValueAt(i));
         }
@@ -251,6 +509,11 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
       auto tmp_leaf_node_ptr = reinterpret_cast<LeafPage *>(cur_node_ptr);
       new_page_ptr = tmp_leaf_node_ptr->SplitL(comparator_, buffer_pool_manager_);
       auto new_node_ptr = reinterpret_cast<LeafPage *>(new_page_ptr->GetData());
+      if (pending) {
+        auto target_node_ptr = comparator_(key, new_node_ptr->KeyAt(0)) < 0 ? tmp_leaf_node_ptr : new_node_ptr;
+        target_node_ptr->InsertL(key, value, comparator_);
+        pending = false;
+      }
       new_key = new_node_ptr->KeyAt(0);
     } else {
       new_page_ptr = cur_node_ptr->SplitL(comparator_, buffer_pool_manager_);
@@ -260,10 +523,10 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
     Page *parent_page_ptr = nullptr;
     if (transaction != nullptr) {
       transaction->GetPageSet()->pop_back();
-      cur_page_ptr->WUnlatch();
+      WUnlatchPage(cur_page_ptr);
       parent_page_ptr = transaction->GetPageSet()->back();
     } else {
-      parent_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->GetParentPageId());
+      parent_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->GetParentPageId(), AccessType::Index);
       buffer_pool_manager_->UnpinPage(cur_node_ptr->GetParentPageId(), false);
     }
     buffer_pool_manager_->UnpinPage(cur_node_ptr->GetPageId(), true);
@@ -286,10 +549,173 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transact
   return true;
 }
 
+/*
+ * Insert a batch of pairs in key order. The leaf of the previous pair stays
+ * write-latched while the next key falls below its upper fence and fits
+ * without a split; any other pair goes through Insert().
+ * @return : number of pairs inserted, duplicate keys are skipped
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::InsertBatch(std::vector<std::pair<KeyType, ValueType>> *pairs, Transaction *transaction)
+    -> size_t {
+  std::sort(pairs->begin(), pairs->end(),
+            [&](const auto &a, const auto &b) { return comparator_(a.first, b.first) < 0; });
+  size_t num_inserted = 0;
+  Page *leaf_page_ptr = nullptr;
+  bool dirty = false;
+  KeyType upper_fence;
+  bool bounded = false;
+  auto release_leaf = [&] {
+    WUnlatchPage(leaf_page_ptr);
+    buffer_pool_manager_->UnpinPage(leaf_page_ptr->GetPageId(), dirty);
+    leaf_page_ptr = nullptr;
+    dirty = false;
+  };
+  for (const auto &[key, value] : *pairs) {
+    if (leaf_page_ptr != nullptr && bounded && comparator_(key, upper_fence) >= 0) {
+      release_leaf();
+    }
+    if (leaf_page_ptr == nullptr) {
+      leaf_page_ptr = FindLeafPageWithFence(key, true, &upper_fence, &bounded);
+    }
+    if (leaf_page_ptr != nullptr) {
+      auto leaf_node_ptr = reinterpret_cast<LeafPage *>(leaf_page_ptr->GetData());
+      if (leaf_node_ptr->GetSize() < leaf_node_ptr->GetMaxSize() && leaf_node_ptr->HasRoomFor(key)) {
+        if (leaf_node_ptr->InsertL(key, value, comparator_)) {
+          num_inserted++;
+          dirty = true;
+        }
+        continue;
+      }
+      // leaf 需要 split，交给 Insert
+      release_leaf();
+    }
+    if (Insert(key, value, transaction)) {
+      num_inserted++;
+    }
+  }
+  if (leaf_page_ptr != nullptr) {
+    release_leaf();
+  }
+  return num_inserted;
+}
+
+/*****************************************************************************
+ * BULK LOAD
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::BulkLoad(size_t num_pairs, const std::function<bool(KeyType *, ValueType *)> &next,
+                              double fill_factor) -> bool {
+  std::scoped_lock<std::mutex> lock(latch_);
+  if (!IsEmpty()) {
+    return false;
+  }
+  if (num_pairs == 0) {
+    return true;
+  }
+  // 先确定每一层的节点数和每个节点的大小，这样在创建节点时就能知道它的 parent
+  std::vector<BulkLoadLevel> levels;
+  // 压缩的 leaf 按前缀为空时的容量规划，保证每个节点都放得下
+  auto leaf_max_size =
+      compress_keys_ ? std::min(leaf_max_size_, LeafPage::COMPRESSED_MIN_CAPACITY - 1) : leaf_max_size_;
+  levels.emplace_back(PlanBulkLoadLevel(num_pairs, fill_factor, (leaf_max_size + 1) >> 1, leaf_max_size));
+  while (levels.back().num_nodes_ > 1) {
+    levels.emplace_back(
+        PlanBulkLoadLevel(levels.back().num_nodes_, fill_factor, (internal_max_size_ + 1) >> 1, internal_max_size_));
+  }
+  std::vector<page_id_t> created;
+  try {
+    KeyType key;
+    ValueType value;
+    KeyType last_key;
+    for (size_t i = 0; i < num_pairs; i++) {
+      if (!next(&key, &value)) {
+        throw Exception("BulkLoad failed: fewer pairs than num_pairs\n");
+      }
+      if (i > 0 && comparator_(last_key, key) >= 0) {
+        throw Exception("BulkLoad failed: keys are not strictly increasing\n");
+      }
+      last_key = key;
+      auto &leaves = levels[0];
+      if (leaves.IsNodeFull()) {
+        StartBulkLoadNode(&levels, 0, key, &created);
+      }
+      reinterpret_cast<LeafPage *>(leaves.page_->GetData())->InsertLast(key, value);
+    }
+  } catch (...) {
+    for (auto &level : levels) {
+      if (level.page_ != nullptr) {
+        buffer_pool_manager_->UnpinPage(level.page_->GetPageId(), false);
+      }
+    }
+    for (auto page_id : created) {
+      buffer_pool_manager_->DeletePage(page_id);
+    }
+    throw;
+  }
+  for (auto &level : levels) {
+    buffer_pool_manager_->UnpinPage(level.page_->GetPageId(), true);
+  }
+  root_page_id_ = levels.back().page_->GetPageId();
+  UpdateRootPageId(true);
+  return true;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::PlanBulkLoadLevel(size_t num_entries, double fill_factor, int min_size, int max_size)
+    -> BulkLoadLevel {
+  auto fill = static_cast<size_t>(std::clamp<double>(fill_factor * max_size, 1, max_size));
+  auto num_nodes = (num_entries + fill - 1) / fill;
+  // 节点太小时减少节点数，此时每个节点最多 2 * min_size - 1 个 entry，不会超过 max_size
+  while (num_nodes > 1 && num_entries / num_nodes < static_cast<size_t>(min_size)) {
+    num_nodes--;
+  }
+  return BulkLoadLevel{num_nodes, num_entries / num_nodes, num_entries % num_nodes};
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::StartBulkLoadNode(std::vector<BulkLoadLevel> *levels, size_t level, const KeyType &first_key,
+                                       std::vector<page_id_t> *created) -> Page * {
+  page_id_t page_id = INVALID_PAGE_ID;
+  auto page_ptr = buffer_pool_manager_->NewPage(&page_id);
+  if (page_ptr == nullptr) {
+    throw Exception("BulkLoad failed: can not get a new Page\n");
+  }
+  created->emplace_back(page_id);
+  auto &cur = (*levels)[level];
+  // 前一个节点已经填满，写完 leaf 链表指针后就不再需要了
+  if (cur.page_ != nullptr) {
+    if (level == 0) {
+      reinterpret_cast<LeafPage *>(cur.page_->GetData())->SetNextPageId(page_id);
+    }
+    buffer_pool_manager_->UnpinPage(cur.page_->GetPageId(), true);
+  }
+  cur.page_ = page_ptr;
+  cur.num_started_++;
+  // 新节点是上一层某个节点的 child
+  auto parent_page_id = INVALID_PAGE_ID;
+  if (level + 1 < levels->size()) {
+    auto &parent = (*levels)[level + 1];
+    if (parent.IsNodeFull()) {
+      StartBulkLoadNode(levels, level + 1, first_key, created);
+    }
+    auto parent_node_ptr = reinterpret_cast<InternalPage *>(parent.page_->GetData());
+    parent_node_ptr->InsertLast(first_key, page_id);
+    parent_page_id = parent_node_ptr->GetPageId();
+  }
+  if (level == 0) {
+    reinterpret_cast<LeafPage *>(page_ptr->GetData())->Init(page_id, parent_page_id, leaf_max_size_, compress_keys_);
+  } else {
+    reinterpret_cast<InternalPage *>(page_ptr->GetData())->Init(page_id, parent_page_id, internal_max_size_);
+  }
+  return page_ptr;
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::UnpinFromBottomToRoot(page_id_t page_id, BufferPoolManager *buffer_pool_manager_, Operation op) {
   while (page_id != INVALID_PAGE_ID) {
-    auto node_ptr = reinterpret_cast<InternalPage *>(buffer_pool_manager_->FetchPage(page_id)->GetData());
+    auto node_ptr =
+        reinterpret_cast<InternalPage *>(buffer_pool_manager_->FetchPage(page_id, AccessType::Index)->GetData());
     buffer_pool_manager_->UnpinPage(page_id, false);
     if (op == READ) {
       buffer_pool_manager_->UnpinPage(page_id, false);
@@ -307,7 +733,7 @@ auto BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, Transaction *transaction,
     return nullptr;
   }
   // fetch page
-  auto cur_page_ptr = buffer_pool_manager_->FetchPage(root_page_id_);
+  auto cur_page_ptr = buffer_pool_manager_->FetchPage(root_page_id_, AccessType::Index);
   if (cur_page_ptr == nullptr) {
     return nullptr;
   }
@@ -316,14 +742,14 @@ auto BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, Transaction *transaction,
     if (op == READ) {
       cur_page_ptr->RLatch();
     } else {
-      cur_page_ptr->WLatch();
+      WLatchPage(cur_page_ptr);
     }
     transaction->AddIntoPageSet(cur_page_ptr);
   }
   auto cur_node_ptr = reinterpret_cast<InternalPage *>(cur_page_ptr->GetData());
   while (!cur_node_ptr->IsLeafPage()) {
     // fetch page
-    auto next_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->FindChild(key, comparator_));
+    auto next_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->FindChild(key, comparator_), AccessType::Index);
     if (next_page_ptr == nullptr) {
       if (transaction == nullptr) {
         UnpinFromBottomToRoot(cur_page_ptr->GetPageId(), buffer_pool_manager_, op);
@@ -338,7 +764,7 @@ auto BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, Transaction *transaction,
       if (op == READ) {
         next_page_ptr->RLatch();
       } else {
-        next_page_ptr->WLatch();
+        WLatchPage(next_page_ptr);
       }
     }
     auto next_node_ptr = reinterpret_cast<InternalPage *>(next_page_ptr->GetData());
@@ -352,7 +778,7 @@ auto BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, Transaction *transaction,
         if (op == READ) {
           page_ptr->RUnlatch();
         } else {
-          page_ptr->WUnlatch();
+          WUnlatchPage(page_ptr);
         }
         buffer_pool_manager_->UnpinPage(page_ptr->GetPageId(), false);
         transaction->GetPageSet()->pop_front();
@@ -374,7 +800,7 @@ void BPLUSTREE_TYPE::UnpinAndUnlock(Transaction *transaction, Operation op) {
       page_ptr->RUnlatch();
       buffer_pool_manager_->UnpinPage(page_ptr->GetPageId(), false);
     } else {
-      page_ptr->WUnlatch();
+      WUnlatchPage(page_ptr);
       buffer_pool_manager_->UnpinPage(page_ptr->GetPageId(), true);
     }
   }
@@ -395,6 +821,10 @@ auto BPLUSTREE_TYPE::IsSafe(const InternalPage *node_ptr, Operation op) -> bool
       (op == INSERT && node_ptr->GetSize() >= node_ptr->GetMaxSize())) {
     return false;
   }
+  // 压缩的 leaf 在 size 没有到 max size 时也可能因为放不下新的 key 而 split
+  if (op == INSERT && node_ptr->IsLeafPage() && !reinterpret_cast<const LeafPage *>(node_ptr)->HasRoomForAnyKey()) {
+    return false;
+  }
   return true;
 }
 
@@ -413,25 +843,51 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
   auto tmp_page_ptr = OptmisticLock(key);
   if (tmp_page_ptr != nullptr) {
     auto leaf_node_ptr = reinterpret_cast<LeafPage *>(tmp_page_ptr->GetData());
-    if (leaf_node_ptr->IsLeafPage() && leaf_node_ptr->GetSize() > leaf_node_ptr->GetMinSize()) {
+    // lazy merge 时只要 leaf 删除后不为空就只在 leaf 上删除，不够 min size 的 leaf 留给 CompactUnderfullLeaves 处理
+    auto min_size = lazy_merge_ ? 1 : leaf_node_ptr->GetMinSize();
+    if (leaf_node_ptr->IsLeafPage() && leaf_node_ptr->GetSize() > min_size) {
       leaf_node_ptr->Remove(key, comparator_);
-      tmp_page_ptr->WUnlatch();
+      // 记录 leaf 中现有的 key，之后不管 leaf 怎么变化都能用它找到这个 key 所在的 leaf
+      std::optional<KeyType> underfull_key;
+      if (!leaf_node_ptr->IsRootPage() && leaf_node_ptr->GetSize() < leaf_node_ptr->GetMinSize()) {
+        underfull_key = leaf_node_ptr->KeyAt(0);
+      }
+      WUnlatchPage(tmp_page_ptr);
       buffer_pool_manager_->UnpinPage(tmp_page_ptr->GetPageId(), true);
+      if (underfull_key.has_value()) {
+        std::scoped_lock<std::mutex> lock(compaction_latch_);
+        underfull_keys_.emplace_back(*underfull_key);
+      }
       return;
     }
-    tmp_page_ptr->WUnlatch();
+    WUnlatchPage(tmp_page_ptr);
     buffer_pool_manager_->UnpinPage(tmp_page_ptr->GetPageId(), false);
   }
+  // lazy merge 时 merge 或 redistribute 后的 leaf 也可能不够 min size
+  auto underfull_key = key;
+  if (RemoveAndRebalance(key, transaction, true, &underfull_key)) {
+    std::scoped_lock<std::mutex> lock(compaction_latch_);
+    underfull_keys_.emplace_back(underfull_key);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::RemoveAndRebalance(const KeyType &key, Transaction *transaction, bool remove_key,
+                                        KeyType *underfull_key) -> bool {
   // std::scoped_lock<std::mutex> lock(latch_);
   auto leaf_page_ptr = FindLeafPage(key, transaction, REMOVE);
   if (leaf_page_ptr == nullptr) {
-    return;
+    return false;
   }
   // std::cout << "====================================" << std::endl;
   // std::cout << "Remove start: k: " << key << std::endl;
   // remove before merge
   auto leaf_node_ptr = reinterpret_cast<LeafPage *>(leaf_page_ptr->GetData());
-  leaf_node_ptr->Remove(key, comparator_);
+  if (remove_key) {
+    leaf_node_ptr->Remove(key, comparator_);
+  }
+  // 两个 lazy 删除后的 leaf 合并后仍可能不够 min size
+  bool merged_underfull = false;
 
   auto cur_page_ptr = leaf_page_ptr;
   while (true) {
@@ -452,13 +908,13 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
       }
       // internal node，需要将 child 的 kv 复制到 root node，并删除该 child
       // child -> root
-      auto child_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->ValueAt(0));
-      child_page_ptr->WLatch();
+      auto child_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->ValueAt(0), AccessType::Index);
+      WLatchPage(child_page_ptr);
       auto tmp_child_node_ptr = reinterpret_cast<LeafPage *>(child_page_ptr->GetData());
       if (tmp_child_node_ptr->IsLeafPage()) {
         auto child_node_ptr = tmp_child_node_ptr;
         auto tmp_cur_node_ptr = reinterpret_cast<LeafPage *>(cur_node_ptr);
-        tmp_cur_node_ptr->Init(root_page_id_, INVALID_PAGE_ID, leaf_max_size_);
+        tmp_cur_node_ptr->Init(root_page_id_, INVALID_PAGE_ID, leaf_max_size_, compress_keys_);
         for (int i = 0, sz = child_node_ptr->GetSize(); i < sz; i++) {
           tmp_cur_node_ptr->InsertLast(child_node_ptr->KeyAt(i), child_node_ptr->ValueAt(i));
         }
@@ -467,17 +923,17 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
         cur_node_ptr->SetSize(0);
         for (int i = 0, sz = child_node_ptr->GetSize(); i < sz; i++) {
           cur_node_ptr->InsertLast(child_node_ptr->KeyAt(i), child_node_ptr->ValueAt(i));
-          auto grandson_page_ptr = buffer_pool_manager_->FetchPage(child_node_ptr->ValueAt(i));
+          auto grandson_page_ptr = buffer_pool_manager_->FetchPage(child_node_ptr->ValueAt(i), AccessType::Index);
           auto grandson_node_ptr = reinterpret_cast<InternalPage *>(grandson_page_ptr->GetData());
-          grandson_page_ptr->WLatch();
+          WLatchPage(grandson_page_ptr);
           grandson_node_ptr->SetParentPageId(cur_node_ptr->GetPageId());
-          grandson_page_ptr->WUnlatch();
+          WUnlatchPage(grandson_page_ptr);
           buffer_pool_manager_->UnpinPage(grandson_page_ptr->GetPageId(), true);
         }
         cur_node_ptr->SetPageType(IndexPageType::INTERNAL_PAGE);
         cur_node_ptr->SetMaxSize(internal_max_size_);
       }
-      child_page_ptr->WUnlatch();
+      WUnlatchPage(child_page_ptr);
       buffer_pool_manager_->UnpinPage(child_page_ptr->GetPageId(), false);
       buffer_pool_manager_->DeletePage(child_page_ptr->GetPageId());
       // if (transaction != nullptr) {
@@ -490,14 +946,14 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
     // 释放 cur_page lock
     if (transaction != nullptr) {
       transaction->GetPageSet()->pop_back();
-      cur_page_ptr->WUnlatch();
+      WUnlatchPage(cur_page_ptr);
     }
 
     Page *parent_page_ptr = nullptr;
     if (transaction != nullptr) {
       parent_page_ptr = transaction->GetPageSet()->back();
     } else {
-      parent_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->GetParentPageId());
+      parent_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->GetParentPageId(), AccessType::Index);
       buffer_pool_manager_->UnpinPage(cur_node_ptr->GetParentPageId(), false);
     }
     auto parent_node_ptr = reinterpret_cast<InternalPage *>(parent_page_ptr->GetData());
@@ -513,35 +969,49 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
     } else {
       index = cur_node_index;
     }
-    auto left_page_ptr = buffer_pool_manager_->FetchPage(parent_node_ptr->ValueAt(index));
-    auto right_page_ptr = buffer_pool_manager_->FetchPage(parent_node_ptr->ValueAt(index + 1));
-    left_page_ptr->WLatch();
-    right_page_ptr->WLatch();
+    auto left_page_ptr = buffer_pool_manager_->FetchPage(parent_node_ptr->ValueAt(index), AccessType::Index);
+    auto right_page_ptr = buffer_pool_manager_->FetchPage(parent_node_ptr->ValueAt(index + 1), AccessType::Index);
+    WLatchPage(left_page_ptr);
+    WLatchPage(right_page_ptr);
     auto tmp_left_node_ptr = reinterpret_cast<InternalPage *>(left_page_ptr->GetData());
     auto tmp_right_node_ptr = reinterpret_cast<InternalPage *>(right_page_ptr->GetData());
     // 左边保留 [0, min_size)，右边保留 [min_size, left_size + right_size)
     auto left_size = tmp_left_node_ptr->GetSize();
     auto right_size = tmp_right_node_ptr->GetSize();
     // auto min_size = (left_size + right_size + 1) >> 1;
-    // 不需要合并
-    if (left_size + right_size >= tmp_left_node_ptr->GetMinSize() * 2) {
+    // 不需要合并，或者压缩的 leaf 合并后放不下
+    if (left_size + right_size >= tmp_left_node_ptr->GetMinSize() * 2 ||
+        (tmp_left_node_ptr->IsLeafPage() && !reinterpret_cast<LeafPage *>(tmp_left_node_ptr)
+                                                 ->CanAbsorb(reinterpret_cast<LeafPage *>(tmp_right_node_ptr)))) {
       // leaf node
       if (tmp_left_node_ptr->IsLeafPage()) {
         auto left_node_ptr = reinterpret_cast<LeafPage *>(tmp_left_node_ptr);
         auto right_node_ptr = reinterpret_cast<LeafPage *>(tmp_right_node_ptr);
-        // right -> left
-        if (left_size < right_size) {
-          auto key = right_node_ptr->KeyAt(0);
-          auto val = right_node_ptr->ValueAt(0);
-          left_node_ptr->InsertLast(key, val);
-          right_node_ptr->Remove(key, comparator_);
-        } else {
-          // left -> right
-          auto sz = left_node_ptr->GetSize();
-          auto key = left_node_ptr->KeyAt(sz - 1);
-          auto val = left_node_ptr->ValueAt(sz - 1);
-          right_node_ptr->InsertFirst(key, val);
-          left_node_ptr->Remove(key, comparator_);
+        // lazy merge 时 leaf 可能比 min size 少很多，一直移动到两边都不少于 min size
+        auto min_size = left_node_ptr->GetMinSize();
+        do {
+          // right -> left
+          if (left_size < right_size) {
+            auto key = right_node_ptr->KeyAt(0);
+            auto val = right_node_ptr->ValueAt(0);
+            left_node_ptr->InsertLast(key, val);
+            right_node_ptr->Remove(key, comparator_);
+          } else {
+            // left -> right
+            auto sz = left_node_ptr->GetSize();
+            auto key = left_node_ptr->KeyAt(sz - 1);
+            auto val = left_node_ptr->ValueAt(sz - 1);
+            right_node_ptr->InsertFirst(key, val);
+            left_node_ptr->Remove(key, comparator_);
+          }
+          left_size = left_node_ptr->GetSize();
+          right_size = right_node_ptr->GetSize();
+        } while (std::min(left_size, right_size) < min_size && std::abs(left_size - right_size) > 1);
+        // 压缩的 leaf 放不下时两边可能仍有一个不够 min size。compaction 中不再报告，重试同一对 leaf 不会有进展
+        if (std::min(left_size, right_size) < min_size && std::min(left_size, right_size) > 0 && remove_key &&
+            underfull_key != nullptr) {
+          merged_underfull = true;
+          *underfull_key = left_size < right_size ? left_node_ptr->KeyAt(0) : right_node_ptr->KeyAt(0);
         }
         auto index = parent_node_ptr->FindChildIndex(right_node_ptr->GetPageId());
         parent_node_ptr->SetKeyAt(index, right_node_ptr->KeyAt(0));
@@ -554,9 +1024,9 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
           auto key = right_node_ptr->KeyAt(0);
           auto val = right_node_ptr->ValueAt(0);
           left_node_ptr->InsertLast(key, val);
-          auto child_page_ptr = buffer_pool_manager_->FetchPage(val);
+          auto child_page_ptr = buffer_pool_manager_->FetchPage(val, AccessType::Index);
           auto child_node_ptr = reinterpret_cast<InternalPage *>(child_page_ptr->GetData());
-          child_page_ptr->WLatch();
+          WLatchPage(child_page_ptr);
           if (child_node_ptr->IsLeafPage()) {
             auto tmp_child_node_ptr = reinterpret_cast<LeafPage *>(child_node_ptr);
             right_node_ptr->SetKeyAt(0, tmp_child_node_ptr->KeyAt(0));
@@ -564,7 +1034,7 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
             right_node_ptr->SetKeyAt(0, child_node_ptr->KeyAt(0));
           }
           child_node_ptr->SetParentPageId(left_node_ptr->GetPageId());
-          child_page_ptr->WUnlatch();
+          WUnlatchPage(child_page_ptr);
           buffer_pool_manager_->UnpinPage(child_page_ptr->GetPageId(), true);
           right_node_ptr->RemoveIndex(0);
         } else {
@@ -573,19 +1043,19 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
           auto key = left_node_ptr->KeyAt(sz - 1);
           auto val = left_node_ptr->ValueAt(sz - 1);
           right_node_ptr->InsertFirst(key, val);
-          auto child_page_ptr = buffer_pool_manager_->FetchPage(val);
+          auto child_page_ptr = buffer_pool_manager_->FetchPage(val, AccessType::Index);
           auto child_node_ptr = reinterpret_cast<InternalPage *>(child_page_ptr->GetData());
-          child_page_ptr->WLatch();
+          WLatchPage(child_page_ptr);
           child_node_ptr->SetParentPageId(right_node_ptr->GetPageId());
-          child_page_ptr->WUnlatch();
+          WUnlatchPage(child_page_ptr);
           buffer_pool_manager_->UnpinPage(child_page_ptr->GetPageId(), true);
           left_node_ptr->RemoveIndex(sz - 1);
         }
         auto index = parent_node_ptr->FindChildIndex(right_node_ptr->GetPageId());
         parent_node_ptr->SetKeyAt(index, right_node_ptr->KeyAt(0));
       }
-      left_page_ptr->WUnlatch();
-      right_page_ptr->WUnlatch();
+      WUnlatchPage(left_page_ptr);
+      WUnlatchPage(right_page_ptr);
       buffer_pool_manager_->UnpinPage(left_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(right_page_ptr->GetPageId(), true);
     } else {
@@ -599,15 +1069,19 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
         for (int i = 0; i < right_size; i++) {
           left_node_ptr->InsertLast(right_node_ptr->KeyAt(i), right_node_ptr->ValueAt(i));
         }
+        if (left_node_ptr->GetSize() < left_node_ptr->GetMinSize() && underfull_key != nullptr) {
+          merged_underfull = true;
+          *underfull_key = left_node_ptr->KeyAt(0);
+        }
         parent_node_ptr->RemoveIndex(parent_node_ptr->FindChildIndex(right_node_ptr->GetPageId()));
       } else {
         // internal node
         auto left_node_ptr = tmp_left_node_ptr;
         auto right_node_ptr = tmp_right_node_ptr;
         for (int i = 0; i < right_size; i++) {
-          auto child_page_ptr = buffer_pool_manager_->FetchPage(right_node_ptr->ValueAt(i));
+          auto child_page_ptr = buffer_pool_manager_->FetchPage(right_node_ptr->ValueAt(i), AccessType::Index);
           auto child_node_ptr = reinterpret_cast<InternalPage *>(child_page_ptr->GetData());
-          child_page_ptr->WLatch();
+          WLatchPage(child_page_ptr);
           if (child_node_ptr->IsLeafPage()) {
             auto tmp_child_node_ptr = reinterpret_cast<LeafPage *>(child_node_ptr);
             right_node_ptr->SetKeyAt(i, tmp_child_node_ptr->KeyAt(0));
@@ -616,13 +1090,13 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
           }
           left_node_ptr->InsertLast(right_node_ptr->KeyAt(i), right_node_ptr->ValueAt(i));
           child_node_ptr->SetParentPageId(left_node_ptr->GetPageId());
-          child_page_ptr->WUnlatch();
+          WUnlatchPage(child_page_ptr);
           buffer_pool_manager_->UnpinPage(child_page_ptr->GetPageId(), true);
         }
         parent_node_ptr->RemoveIndex(parent_node_ptr->FindChildIndex(right_node_ptr->GetPageId()));
       }
-      left_page_ptr->WUnlatch();
-      right_page_ptr->WUnlatch();
+      WUnlatchPage(left_page_ptr);
+      WUnlatchPage(right_page_ptr);
       buffer_pool_manager_->UnpinPage(right_page_ptr->GetPageId(), true);
       buffer_pool_manager_->UnpinPage(left_page_ptr->GetPageId(), true);
       // 移除 right node
@@ -646,6 +1120,74 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
   } else {
     UnpinAndUnlock(transaction, REMOVE);
   }
+  return merged_underfull;
+}
+
+/*
+ * Rebalance the leaves left underfull by lazy removes, going through the
+ * latched remove path with a key of each of them but without removing it
+ * @return : number of leaves looked at
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::CompactUnderfullLeaves() -> size_t {
+  std::vector<KeyType> keys;
+  {
+    std::scoped_lock<std::mutex> lock(compaction_latch_);
+    keys.swap(underfull_keys_);
+  }
+  // 同一个 leaf 可能被记录多次，排序后去重
+  std::sort(keys.begin(), keys.end(), [&](const KeyType &a, const KeyType &b) { return comparator_(a, b) < 0; });
+  keys.erase(std::unique(keys.begin(), keys.end(),
+                         [&](const KeyType &a, const KeyType &b) { return comparator_(a, b) == 0; }),
+             keys.end());
+  for (const auto &key : keys) {
+    // 两个不够 min size 的 leaf 合并后可能仍然不够，每次合并都会少一个 leaf，所以最终会停下
+    auto cur_key = key;
+    bool underfull = true;
+    while (underfull) {
+      Transaction transaction(INVALID_TXN_ID);
+      underfull = RemoveAndRebalance(cur_key, &transaction, false, &cur_key);
+    }
+  }
+  return keys.size();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::StartBackgroundCompaction(std::chrono::milliseconds interval) {
+  std::scoped_lock<std::mutex> lock(compaction_latch_);
+  if (compaction_thread_.joinable()) {
+    return;
+  }
+  compaction_interval_ = interval;
+  compaction_stop_ = false;
+  compaction_thread_ = std::thread([this] { BackgroundCompaction(); });
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::StopBackgroundCompaction() {
+  {
+    std::scoped_lock<std::mutex> lock(compaction_latch_);
+    if (!compaction_thread_.joinable()) {
+      return;
+    }
+    compaction_stop_ = true;
+  }
+  compaction_cv_.notify_one();
+  compaction_thread_.join();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BackgroundCompaction() {
+  std::unique_lock<std::mutex> lock(compaction_latch_);
+  while (!compaction_stop_) {
+    compaction_cv_.wait_for(lock, compaction_interval_, [&] { return compaction_stop_; });
+    if (compaction_stop_ || underfull_keys_.empty()) {
+      continue;
+    }
+    lock.unlock();
+    CompactUnderfullLeaves();
+    lock.lock();
+  }
 }
 
 /*****************************************************************************
@@ -657,31 +1199,7 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
  * @return : index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
-auto BPLUSTREE_TYPE::Begin() -> INDEXITERATOR_TYPE {
-  if (IsEmpty()) {
-    return INDEXITERATOR_TYPE(nullptr, INVALID_PAGE_ID, buffer_pool_manager_);
-  }
-  auto cur_page_ptr = buffer_pool_manager_->FetchPage(root_page_id_);
-  cur_page_ptr->RLatch();
-  auto cur_node_ptr = reinterpret_cast<InternalPage *>(cur_page_ptr->GetData());
-  while (!cur_node_ptr->IsLeafPage()) {
-    auto next_page_id = cur_node_ptr->ValueAt(0);
-    auto next_page_ptr = buffer_pool_manager_->FetchPage(next_page_id);
-    auto next_node_ptr = reinterpret_cast<InternalPage *>(next_page_ptr->GetData());
-    next_page_ptr->RLatch();
-    cur_page_ptr->RUnlatch();
-    buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
-    cur_node_ptr = next_node_ptr;
-    cur_page_ptr = next_page_ptr;
-  }
-  // 如果 tree 为空
-  if (cur_node_ptr->GetSize() == 0) {
-    cur_page_ptr->RUnlatch();
-    buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
-    return End();
-  }
-  return INDEXITERATOR_TYPE(cur_page_ptr, 0, buffer_pool_manager_);
-}
+auto BPLUSTREE_TYPE::Begin() -> INDEXITERATOR_TYPE { return BeginRange(std::nullopt, std::nullopt); }
 
 /*
  * Input parameter is low key, find the leaf page that contains the input key
@@ -689,32 +1207,102 @@ auto BPLUSTREE_TYPE::Begin() -> INDEXITERATOR_TYPE {
  * @return : index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
-auto BPLUSTREE_TYPE::Begin(const KeyType &key) -> INDEXITERATOR_TYPE {
-  // 下面类似 FindLeafPage
-  auto cur_page_ptr = buffer_pool_manager_->FetchPage(root_page_id_);
+auto BPLUSTREE_TYPE::Begin(const KeyType &key) -> INDEXITERATOR_TYPE { return BeginRange(key, std::nullopt); }
+
+/*
+ * Ascending scans start at the first key not below low, descending scans at
+ * the last key below high
+ * @return : index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::BeginRange(const std::optional<KeyType> &low, const std::optional<KeyType> &high, bool reverse)
+    -> INDEXITERATOR_TYPE {
+  if (reverse) {
+    int index = INVALID_PAGE_ID;
+    auto leaf_page_ptr = FindLastLeafBefore(high, &index);
+    return INDEXITERATOR_TYPE(this, leaf_page_ptr, index, low, true);
+  }
+  if (low.has_value()) {
+    KeyType upper_fence;
+    bool bounded = false;
+    auto leaf_page_ptr = FindLeafPageWithFence(*low, false, &upper_fence, &bounded);
+    if (leaf_page_ptr == nullptr) {
+      return End();
+    }
+    auto leaf_node_ptr = reinterpret_cast<LeafPage *>(leaf_page_ptr->GetData());
+    // 超出 leaf 末尾时 iterator 会移动到下一个 leaf
+    return INDEXITERATOR_TYPE(this, leaf_page_ptr, leaf_node_ptr->LowerBound(*low, comparator_), high, false);
+  }
+  if (IsEmpty()) {
+    return End();
+  }
+  auto cur_page_ptr = buffer_pool_manager_->FetchPage(root_page_id_, AccessType::Index);
   if (cur_page_ptr == nullptr) {
-    return INDEXITERATOR_TYPE(nullptr, INVALID_PAGE_ID, buffer_pool_manager_);
+    return End();
   }
   cur_page_ptr->RLatch();
   auto cur_node_ptr = reinterpret_cast<InternalPage *>(cur_page_ptr->GetData());
   while (!cur_node_ptr->IsLeafPage()) {
-    // fetch page
-    auto next_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->FindChild(key, comparator_));
+    auto next_page_id = cur_node_ptr->ValueAt(0);
+    auto next_page_ptr = buffer_pool_manager_->FetchPage(next_page_id, AccessType::Index);
+    if (next_page_ptr == nullptr) {
+      cur_page_ptr->RUnlatch();
+      buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
+      return End();
+    }
+    auto next_node_ptr = reinterpret_cast<InternalPage *>(next_page_ptr->GetData());
     next_page_ptr->RLatch();
     cur_page_ptr->RUnlatch();
     buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
-    auto next_node_ptr = reinterpret_cast<InternalPage *>(next_page_ptr->GetData());
     cur_node_ptr = next_node_ptr;
     cur_page_ptr = next_page_ptr;
   }
-  auto leaf_node_ptr = reinterpret_cast<LeafPage *>(cur_node_ptr);
-  // 如果 tree 为空
-  if (cur_node_ptr->GetSize() == 0) {
+  // tree 为空时 leaf 中没有 entry，iterator 直接变为 End()
+  return INDEXITERATOR_TYPE(this, cur_page_ptr, 0, high, false);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::FindLastLeafBefore(const std::optional<KeyType> &key, int *index) -> Page * {
+  auto bound = key;
+  while (!IsEmpty()) {
+    auto cur_page_ptr = buffer_pool_manager_->FetchPage(root_page_id_, AccessType::Index);
+    if (cur_page_ptr == nullptr) {
+      return nullptr;
+    }
+    cur_page_ptr->RLatch();
+    auto cur_node_ptr = reinterpret_cast<InternalPage *>(cur_page_ptr->GetData());
+    std::optional<KeyType> lower_fence;
+    while (!cur_node_ptr->IsLeafPage()) {
+      // 最后一个 separator 小于 bound 的 child
+      int child = bound.has_value() ? cur_node_ptr->LowerBound(*bound, comparator_) - 1 : cur_node_ptr->GetSize() - 1;
+      if (child > 0) {
+        lower_fence = cur_node_ptr->KeyAt(child);
+      }
+      auto next_page_ptr = buffer_pool_manager_->FetchPage(cur_node_ptr->ValueAt(child), AccessType::Index);
+      if (next_page_ptr == nullptr) {
+        cur_page_ptr->RUnlatch();
+        buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
+        return nullptr;
+      }
+      next_page_ptr->RLatch();
+      cur_page_ptr->RUnlatch();
+      buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
+      cur_page_ptr = next_page_ptr;
+      cur_node_ptr = reinterpret_cast<InternalPage *>(cur_page_ptr->GetData());
+    }
+    auto leaf_node_ptr = reinterpret_cast<LeafPage *>(cur_node_ptr);
+    *index = bound.has_value() ? leaf_node_ptr->LowerBound(*bound, comparator_) - 1 : leaf_node_ptr->GetSize() - 1;
+    if (*index >= 0) {
+      return cur_page_ptr;
+    }
     cur_page_ptr->RUnlatch();
     buffer_pool_manager_->UnpinPage(cur_page_ptr->GetPageId(), false);
-    return End();
+    if (!lower_fence.has_value()) {
+      return nullptr;
+    }
+    bound = lower_fence;
   }
-  return INDEXITERATOR_TYPE(cur_page_ptr, leaf_node_ptr->KeyIndexOf(key, comparator_), buffer_pool_manager_);
+  return nullptr;
 }
 
 /*
@@ -746,7 +1334,7 @@ auto BPLUSTREE_TYPE::GetRootPageId() -> page_id_t { return root_page_id_; }
  */
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record) {
-  auto *header_page = static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
+  auto *header_page = static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID, AccessType::Index));
   if (insert_record != 0) {
     // create a new record<index_name + root_page_id> in header_page
     header_page->InsertRecord(index_name_, root_page_id_);
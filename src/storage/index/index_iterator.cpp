@@ -5,6 +5,7 @@
 #include <utility>
 
 #include "common/config.h"
+#include "storage/index/b_plus_tree.h"
 #include "storage/index/index_iterator.h"
 
 namespace bustub {
@@ -16,18 +17,58 @@ namespace bustub {
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::IndexIterator(Page *page_ptr, const int &index, BufferPoolManager *bufferPoolManager)
     : page_ptr_(page_ptr), buffer_pool_manager_(bufferPoolManager), index_(index) {
-  if (page_ptr == nullptr) {
-    page_id_ = INVALID_PAGE_ID;
-    index_ = INVALID_PAGE_ID;
-    return;
+  Load();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE::IndexIterator(BPlusTree<KeyType, ValueType, KeyComparator> *tree, Page *page_ptr, int index,
+                                  std::optional<KeyType> stop_key, bool reverse)
+    : page_ptr_(page_ptr),
+      buffer_pool_manager_(tree->buffer_pool_manager_),
+      index_(index),
+      tree_(tree),
+      stop_key_(std::move(stop_key)),
+      reverse_(reverse) {
+  Load();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE::IndexIterator(IndexIterator &&other) noexcept
+    : page_id_(other.page_id_),
+      page_ptr_(other.page_ptr_),
+      pair_(other.pair_),
+      buffer_pool_manager_(other.buffer_pool_manager_),
+      index_(other.index_),
+      tree_(other.tree_),
+      stop_key_(std::move(other.stop_key_)),
+      reverse_(other.reverse_) {
+  // leaf 的锁和 pin 交给新的 iterator
+  other.page_ptr_ = nullptr;
+  other.page_id_ = INVALID_PAGE_ID;
+  other.index_ = INVALID_PAGE_ID;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto INDEXITERATOR_TYPE::operator=(IndexIterator &&other) noexcept -> INDEXITERATOR_TYPE & {
+  if (this != &other) {
+    Release();
+    page_id_ = other.page_id_;
+    page_ptr_ = other.page_ptr_;
+    pair_ = other.pair_;
+    buffer_pool_manager_ = other.buffer_pool_manager_;
+    index_ = other.index_;
+    tree_ = other.tree_;
+    stop_key_ = std::move(other.stop_key_);
+    reverse_ = other.reverse_;
+    other.page_ptr_ = nullptr;
+    other.page_id_ = INVALID_PAGE_ID;
+    other.index_ = INVALID_PAGE_ID;
   }
-  page_id_ = page_ptr->GetPageId();
-  auto cur_leaf_node_ptr = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page_ptr_->GetData());
-  pair_ = std::make_pair(cur_leaf_node_ptr->KeyAt(index_), cur_leaf_node_ptr->ValueAt(index_));
+  return *this;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE::~IndexIterator() = default;  // NOLINT
+INDEXITERATOR_TYPE::~IndexIterator() { Release(); }  // NOLINT
 
 INDEX_TEMPLATE_ARGUMENTS
 auto INDEXITERATOR_TYPE::IsEnd() -> bool { return page_id_ == INVALID_PAGE_ID; }
@@ -36,42 +77,92 @@ INDEX_TEMPLATE_ARGUMENTS
 auto INDEXITERATOR_TYPE::operator*() -> const MappingType & { return pair_; }
 
 INDEX_TEMPLATE_ARGUMENTS
-auto INDEXITERATOR_TYPE::operator++() -> INDEXITERATOR_TYPE & {
-  // 已经结束了
-  if (page_id_ == INVALID_PAGE_ID) {
-    return *this;
+void INDEXITERATOR_TYPE::Release() {
+  if (page_ptr_ != nullptr) {
+    page_ptr_->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page_ptr_->GetPageId(), false);
+  }
+  page_id_ = INVALID_PAGE_ID;
+  page_ptr_ = nullptr;
+  index_ = INVALID_PAGE_ID;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::Load() {
+  if (page_ptr_ == nullptr) {
+    Release();
+    return;
   }
+  page_id_ = page_ptr_->GetPageId();
   auto cur_leaf_node_ptr = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page_ptr_->GetData());
-  // 需要获取下一个 page
+  // Begin(key) 时 key 可能比 leaf 中所有的 key 都大
+  if (index_ >= cur_leaf_node_ptr->GetSize()) {
+    NextLeaf();
+    return;
+  }
+  pair_ = std::make_pair(cur_leaf_node_ptr->KeyAt(index_), cur_leaf_node_ptr->ValueAt(index_));
+  if (stop_key_.has_value()) {
+    auto cmp = tree_->comparator_(pair_.first, *stop_key_);
+    if (reverse_ ? cmp < 0 : cmp >= 0) {
+      Release();
+    }
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::NextLeaf() {
   // ===========================
   // 这里应该尝试获取 lock，失败则 restart 或 throw exception，
   // 但是该 lab 并没有测试这个点
   // ===========================
-  if (index_ == cur_leaf_node_ptr->GetSize() - 1) {
-    auto next_leaf_page_id = cur_leaf_node_ptr->GetNextPageId();
-    // 当前是最后一个节点
-    if (next_leaf_page_id == INVALID_PAGE_ID) {
-      page_ptr_->RUnlatch();
-      buffer_pool_manager_->UnpinPage(page_id_, false);
-      page_id_ = INVALID_PAGE_ID;
-      page_ptr_ = nullptr;
-      index_ = INVALID_PAGE_ID;
-      return *this;
-    }
+  auto cur_leaf_node_ptr = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page_ptr_->GetData());
+  auto next_leaf_page_id = cur_leaf_node_ptr->GetNextPageId();
+  // 当前是最后一个节点
+  if (next_leaf_page_id == INVALID_PAGE_ID) {
+    Release();
+    return;
+  }
+  auto next_page_ptr = buffer_pool_manager_->FetchPage(next_leaf_page_id, AccessType::Scan);
+  if (next_page_ptr == nullptr) {
+    Release();
+    return;
+  }
+  auto next_leaf_node_ptr = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(next_page_ptr->GetData());
+  next_page_ptr->RLatch();
+  Release();
+  // 读当前 leaf 的同时预取下一个 leaf
+  buffer_pool_manager_->PrefetchPages(next_leaf_node_ptr->GetNextPageId(), 1);
+  page_ptr_ = next_page_ptr;
+  index_ = 0;
+  Load();
+}
 
-    auto next_page_ptr = buffer_pool_manager_->FetchPage(next_leaf_page_id);
-    auto next_leaf_node_ptr = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(next_page_ptr->GetData());
-    next_page_ptr->RLatch();
-    page_ptr_->RUnlatch();
-    buffer_pool_manager_->UnpinPage(page_id_, false);
-    index_ = 0;
-    page_id_ = next_page_ptr->GetPageId();
-    page_ptr_ = next_page_ptr;
-    pair_ = std::make_pair(next_leaf_node_ptr->KeyAt(index_), next_leaf_node_ptr->ValueAt(index_));
+INDEX_TEMPLATE_ARGUMENTS
+auto INDEXITERATOR_TYPE::operator++() -> INDEXITERATOR_TYPE & {
+  // 已经结束了
+  if (page_id_ == INVALID_PAGE_ID) {
     return *this;
   }
-  index_++;
-  pair_ = std::make_pair(cur_leaf_node_ptr->KeyAt(index_), cur_leaf_node_ptr->ValueAt(index_));
+  auto cur_leaf_node_ptr = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page_ptr_->GetData());
+  if (!reverse_) {
+    if (index_ == cur_leaf_node_ptr->GetSize() - 1) {
+      NextLeaf();
+    } else {
+      index_++;
+      Load();
+    }
+    return *this;
+  }
+  if (index_ > 0) {
+    index_--;
+    Load();
+    return *this;
+  }
+  // 放开当前 leaf 后从 root 找比它第一个 key 小的最大 key
+  auto first_key = cur_leaf_node_ptr->KeyAt(0);
+  Release();
+  page_ptr_ = tree_->FindLastLeafBefore(first_key, &index_);
+  Load();
   return *this;
 }
 
@@ -0,0 +1,175 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// index_vacuum.cpp
+//
+// Identification: src/storage/index/index_vacuum.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/index/index_vacuum.h"
+#include <algorithm>
+#include <map>
+#include <mutex>  // NOLINT
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "storage/index/b_plus_tree_index.h"
+
+namespace bustub {
+
+void IndexVacuum::SetEnabled(bool enabled) {
+  std::unique_lock<std::mutex> lock(thread_latch_);
+  if (enabled_.exchange(enabled) == enabled) {
+    return;
+  }
+  if (enabled) {
+    vacuum_thread_ = std::thread(&IndexVacuum::RunVacuum, this);
+    return;
+  }
+  lock.unlock();
+  stop_cv_.notify_all();
+  vacuum_thread_.join();
+  // 关闭之后不会再有 dead row，删除剩下的 entry
+  Vacuum();
+}
+
+void IndexVacuum::RunVacuum() {
+  std::unique_lock<std::mutex> lock(thread_latch_);
+  while (!stop_cv_.wait_for(lock, VACUUM_INTERVAL, [this] { return !enabled_.load(); })) {
+    lock.unlock();
+    Vacuum();
+    lock.lock();
+  }
+}
+
+void IndexVacuum::RecordDelete(Transaction *txn, table_oid_t oid, const RID &rid,
+                               std::vector<std::pair<Index *, Tuple>> &&keys) {
+  std::scoped_lock<std::mutex> lock(latch_);
+  // 已有的 dead row 来自一个已经 rollback 的 delete
+  auto [it, inserted] = dead_rows_[oid].insert_or_assign(rid, DeadRow{txn->GetTransactionId(), std::move(keys)});
+  if (inserted) {
+    num_dead_rows_.fetch_add(1);
+  }
+}
+
+auto IndexVacuum::HasDeadRows(table_oid_t oid) -> bool {
+  if (num_dead_rows_.load() == 0) {
+    return false;
+  }
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto it = dead_rows_.find(oid);
+  return it != dead_rows_.end() && !it->second.empty();
+}
+
+auto IndexVacuum::IsDead(table_oid_t oid, const RID &rid) -> bool {
+  if (num_dead_rows_.load() == 0) {
+    return false;
+  }
+  std::scoped_lock<std::mutex> lock(latch_);
+  auto it = dead_rows_.find(oid);
+  return it != dead_rows_.end() && it->second.count(rid) != 0;
+}
+
+void IndexVacuum::Vacuum(Transaction *txn) {
+  if (num_dead_rows_.load() == 0) {
+    return;
+  }
+  std::scoped_lock<std::mutex> vacuum_lock(vacuum_latch_);
+  // 每个 index 要删除的 key，entry 删除之前 row 仍然是 dead
+  std::map<Index *, std::vector<std::pair<Tuple, RID>>> removed;
+  std::vector<std::tuple<table_oid_t, RID, txn_id_t>> removed_rows;
+  {
+    std::scoped_lock<std::mutex> lock(latch_);
+    for (auto &[oid, rows] : dead_rows_) {
+      for (auto it = rows.begin(); it != rows.end();) {
+        auto state = TransactionManager::GetTransaction(it->second.deleter_)->GetState();
+        // abort 之后 delete 已经被 rollback，index entry 仍然有效
+        if (state == TransactionState::ABORTED) {
+          it = rows.erase(it);
+          num_dead_rows_.fetch_sub(1);
+          continue;
+        }
+        auto deleter = it->second.deleter_;
+        if (state == TransactionState::COMMITTED || (txn != nullptr && deleter == txn->GetTransactionId())) {
+          for (auto &[index, key] : it->second.keys_) {
+            removed[index].emplace_back(key, it->first);
+          }
+          removed_rows.emplace_back(oid, it->first, deleter);
+        }
+        it++;
+      }
+    }
+  }
+  for (auto &[index, entries] : removed) {
+    // 按 key 的顺序删除，相邻的 key 在同一个 leaf 中
+    const auto *key_schema = index->GetKeySchema();
+    std::sort(entries.begin(), entries.end(), [key_schema](const auto &a, const auto &b) {
+      for (uint32_t i = 0; i < key_schema->GetColumnCount(); i++) {
+        auto va = a.first.GetValue(key_schema, i);
+        auto vb = b.first.GetValue(key_schema, i);
+        if (va.CompareNotEquals(vb) == CmpBool::CmpTrue) {
+          return va.CompareLessThan(vb) == CmpBool::CmpTrue;
+        }
+      }
+      return false;
+    });
+    for (const auto &[key, rid] : entries) {
+      index->DeleteEntry(key, rid, txn);
+    }
+  }
+  std::scoped_lock<std::mutex> lock(latch_);
+  for (const auto &[oid, rid, deleter] : removed_rows) {
+    // 删除 entry 期间同一个 RID 可能又被其他 txn 删除
+    auto &rows = dead_rows_[oid];
+    auto it = rows.find(rid);
+    if (it != rows.end() && it->second.deleter_ == deleter) {
+      rows.erase(it);
+      num_dead_rows_.fetch_sub(1);
+    }
+  }
+}
+
+auto IndexVacuum::TryInsert(Transaction *txn, Index *index, const Tuple &key, const RID &rid) -> bool {
+  if (auto *tree_index = dynamic_cast<BPlusTreeIndexForOneIntegerColumn *>(index); tree_index != nullptr) {
+    return tree_index->InsertEntries({{key, rid}}, txn) == 1;
+  }
+  // 其他 index 的 InsertEntry 不返回结果，插入之后再查一次
+  index->InsertEntry(key, rid, txn);
+  std::vector<RID> rids;
+  index->ScanKey(key, &rids, txn);
+  return std::find(rids.begin(), rids.end(), rid) != rids.end();
+}
+
+auto IndexVacuum::InsertEntry(Transaction *txn, LockManager *lock_manager, table_oid_t oid, Index *index,
+                              const Tuple &key, const RID &rid) -> bool {
+  if (TryInsert(txn, index, key, rid)) {
+    return true;
+  }
+  std::vector<RID> holders;
+  index->ScanKey(key, &holders, txn);
+  for (const auto &holder : holders) {
+    if (holder == rid) {
+      return true;
+    }
+    if (!IsDead(oid, holder)) {
+      return false;
+    }
+    // deleter 在结束之前一直持有 dead row 的 X lock，拿到锁时它已经 commit 或 abort
+    if (!txn->IsRowExclusiveLocked(oid, holder) &&
+        !lock_manager->LockRow(txn, LockManager::LockMode::EXCLUSIVE, oid, holder)) {
+      return false;
+    }
+  }
+  // commit 的 delete 的 entry 在这里删除；abort 的 delete 已经 rollback，key 仍被原来的行占用
+  Vacuum(txn);
+  return TryInsert(txn, index, key, rid);
+}
+
+}  // namespace bustub
@@ -71,13 +71,28 @@ auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::FindChildIndex(const ValueType &value) -> i
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::FindChild(const KeyType &key, const KeyComparator &keyComparator) -> ValueType {
-  for (int i = GetSize() - 1; i > 0; i--) {
-    if (keyComparator(key, KeyAt(i)) >= 0) {
-      return ValueAt(i);
+auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::LowerBound(const KeyType &key, const KeyComparator &keyComparator) const -> int {
+  // array_[0] 的 key 无效，只在 [1, size) 中二分
+  int left = 1;
+  int right = GetSize();
+  while (left < right) {
+    int mid = left + (right - left) / 2;
+    if (keyComparator(array_[mid].first, key) < 0) {
+      left = mid + 1;
+    } else {
+      right = mid;
     }
   }
-  return ValueAt(0);
+  return left;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::FindChild(const KeyType &key, const KeyComparator &keyComparator) -> ValueType {
+  int index = LowerBound(key, keyComparator);
+  if (index < GetSize() && keyComparator(array_[index].first, key) == 0) {
+    return ValueAt(index);
+  }
+  return ValueAt(index - 1);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -117,7 +132,7 @@ auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::SplitL(const KeyComparator &keyComparator,
   SetSize(split_index);
   // 更新 children 的 parent id
   for (int i = 0, sz = new_node_ptr->GetSize(); i < sz; i++) {
-    auto tmp_page_ptr = buffer_pool_manager_->FetchPage(ValueAt(i));
+    auto tmp_page_ptr = buffer_pool_manager_->FetchPage(ValueAt(i), AccessType::Index);
     tmp_page_ptr->WLatch();
     auto tmp_node_ptr = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE_TYPE *>(tmp_page_ptr->GetData());
     tmp_node_ptr->SetParentPageId(new_page_id);
@@ -130,14 +145,11 @@ auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::SplitL(const KeyComparator &keyComparator,
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertL(const KeyType &key, const ValueType &value,
                                              const KeyComparator &keyComparator) {
-  int i = GetSize();
-  for (; i > 1; i--) {
-    if (keyComparator(KeyAt(i - 1), key) < 0) {
-      break;
-    }
+  int index = LowerBound(key, keyComparator);
+  for (int i = GetSize(); i > index; i--) {
     array_[i] = array_[i - 1];
   }
-  array_[std::max(1, i)] = std::make_pair(key, value);
+  array_[index] = std::make_pair(key, value);
   IncreaseSize(1);
 }
 
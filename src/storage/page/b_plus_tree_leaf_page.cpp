@@ -9,12 +9,15 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 #include <utility>
 
 #include "common/config.h"
 #include "common/exception.h"
 #include "common/logger.h"
+#include "common/macros.h"
 #include "common/rid.h"
 #include "storage/page/b_plus_tree_leaf_page.h"
 #include "type/integer_parent_type.h"
@@ -31,7 +34,7 @@ namespace bustub {
  * next page id and set max size
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, int max_size) {
+void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, int max_size, bool compress_keys) {
   SetParentPageId(parent_id);
   SetPageId(page_id);
   SetMaxSize(max_size);
@@ -39,6 +42,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, in
   SetNextPageId(INVALID_PAGE_ID);
   SetSize(0);
   SetLSN(INVALID_LSN);
+  key_prefix_len_ = compress_keys ? 0 : -1;
 }
 
 /**
@@ -56,35 +60,62 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) { next_pa
  */
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const -> KeyType {
-  // std::cout << index << std::endl;
-  return array_[index].first;
+  // 前缀 + entry 中的后缀
+  KeyType key;
+  auto prefix_len = GetKeyPrefixLen();
+  auto key_data = reinterpret_cast<char *>(&key);
+  memcpy(key_data, PrefixData(), prefix_len);
+  memcpy(key_data + prefix_len, EntryAt(index), KEY_SIZE - prefix_len);
+  return key;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-auto B_PLUS_TREE_LEAF_PAGE_TYPE::ValueAt(int index) const -> ValueType { return array_[index].second; }
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::ValueAt(int index) const -> ValueType {
+  ValueType value;
+  memcpy(&value, EntryAt(index) + KEY_SIZE - GetKeyPrefixLen(), sizeof(ValueType));
+  return value;
+}
 
 INDEX_TEMPLATE_ARGUMENTS
-auto B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndexOf(const KeyType &key, const KeyComparator &keyComparator) -> int {
-  for (int i = GetSize() - 1; i >= 0; i--) {
-    if (keyComparator(KeyAt(i), key) == 0) {
-      return i;
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::LowerBound(const KeyType &key, const KeyComparator &keyComparator) const -> int {
+  // 二分查找，没有前缀时直接比较 page 中的 key，避免 KeyAt 的拷贝
+  bool in_place = GetKeyPrefixLen() == 0;
+  int left = 0;
+  int right = GetSize();
+  while (left < right) {
+    int mid = left + (right - left) / 2;
+    auto cmp = in_place ? keyComparator(*reinterpret_cast<const KeyType *>(EntryAt(mid)), key)
+                        : keyComparator(KeyAt(mid), key);
+    if (cmp < 0) {
+      left = mid + 1;
+    } else {
+      right = mid;
     }
   }
+  return left;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndexOf(const KeyType &key, const KeyComparator &keyComparator) -> int {
+  int index = LowerBound(key, keyComparator);
+  if (index < GetSize() && keyComparator(KeyAt(index), key) == 0) {
+    return index;
+  }
   return INVALID_PAGE_ID;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::InsertLast(const KeyType &key, const ValueType &value) {
-  array_[GetSize()] = std::make_pair(key, value);
+  PrepareFor(key);
+  WriteEntry(GetSize(), key, value);
   IncreaseSize(1);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::InsertFirst(const KeyType &key, const ValueType &value) {
-  for (int i = GetSize() - 1; i >= 0; i--) {
-    array_[i + 1] = array_[i];
-  }
-  array_[0] = std::make_pair(key, value);
+  PrepareFor(key);
+  MoveEntries(0, 1);
+  WriteEntry(0, key, value);
   IncreaseSize(1);
 }
 
@@ -99,7 +130,7 @@ auto B_PLUS_TREE_LEAF_PAGE_TYPE::SplitL(const KeyComparator &keyComparator, Buff
   }
   new_page_ptr->WLatch();
   auto new_node_ptr = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(new_page_ptr->GetData());
-  new_node_ptr->Init(new_page_id, GetParentPageId(), GetMaxSize());
+  new_node_ptr->Init(new_page_id, GetParentPageId(), GetMaxSize(), IsKeyCompressed());
   // 将 (min_size, size) 移到新的 page
   int split_index = GetMinSize();
   for (int i = split_index, sz = GetSize(); i < sz; i++) {
@@ -109,27 +140,22 @@ auto B_PLUS_TREE_LEAF_PAGE_TYPE::SplitL(const KeyComparator &keyComparator, Buff
   SetNextPageId(new_page_id);
   // buffer_pool_manager_->UnpinPage(new_page_id, true);
   SetSize(split_index);
+  // 剩下的 key 范围变小了，共同前缀可能变长
+  ExtendPrefix();
   return new_page_ptr;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_LEAF_PAGE_TYPE::InsertL(const KeyType &key, const ValueType &value, const KeyComparator &keyComparator)
     -> bool {
+  int index = LowerBound(key, keyComparator);
   // duplicate key
-  if (IsDuplicateKeyL(key, keyComparator)) {
+  if (index < GetSize() && keyComparator(KeyAt(index), key) == 0) {
     return false;
   }
-  int i = GetSize();
-  for (; i > 0; i--) {
-    if (keyComparator(KeyAt(i - 1), key) < 0) {
-      break;
-    }
-    if (keyComparator(KeyAt(i - 1), key) == 0) {
-      return false;
-    }
-    array_[i] = array_[i - 1];
-  }
-  array_[i] = std::make_pair(key, value);
+  PrepareFor(key);
+  MoveEntries(index, index + 1);
+  WriteEntry(index, key, value);
   IncreaseSize(1);
   return true;
 }
@@ -140,20 +166,153 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::Remove(const KeyType &key, const KeyComparator
   if (idx == INVALID_PAGE_ID) {
     return;
   }
-  for (int i = idx, sz = GetSize() - 1; i < sz; i++) {
-    array_[i] = array_[i + 1];
-  }
+  MoveEntries(idx + 1, idx);
   IncreaseSize(-1);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_LEAF_PAGE_TYPE::IsDuplicateKeyL(const KeyType &key, const KeyComparator &keyComparator) -> bool {
-  for (int i = 0, sz = GetSize(); i < sz; i++) {
-    if (keyComparator(KeyAt(i), key) == 0) {
-      return true;
+  return KeyIndexOf(key, keyComparator) != INVALID_PAGE_ID;
+}
+
+/*****************************************************************************
+ * KEY PREFIX COMPRESSION
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::HasRoomFor(const KeyType &key) const -> bool {
+  int prefix_len = 0;
+  if (IsKeyCompressed()) {
+    prefix_len = GetSize() == 0 ? KEY_SIZE : CommonPrefixLen(key);
+  }
+  return GetSize() < Capacity(prefix_len);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::HasRoomForAnyKey() const -> bool { return GetSize() < Capacity(0); }
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::CanAbsorb(const BPlusTreeLeafPage *other) const -> bool {
+  if (other->GetSize() == 0) {
+    return true;
+  }
+  int prefix_len = 0;
+  if (IsKeyCompressed()) {
+    // other 中所有 key 都有 other 的前缀，所以合并后的共同前缀至少为二者的较小值
+    prefix_len = other->GetKeyPrefixLen();
+    if (GetSize() > 0) {
+      prefix_len = std::min(prefix_len, CommonPrefixLen(other->KeyAt(0)));
+    }
+  }
+  return GetSize() + other->GetSize() <= Capacity(prefix_len);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::Capacity(int prefix_len) const -> int {
+  // 压缩时 page 末尾留出 sizeof(KeyType) 字节保存前缀
+  int space = BUSTUB_PAGE_SIZE - LEAF_PAGE_HEADER_SIZE - (IsKeyCompressed() ? KEY_SIZE : 0);
+  return space / EntrySize(prefix_len);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::EntryAt(int index) -> char * {
+  return reinterpret_cast<char *>(array_) + index * EntrySize(GetKeyPrefixLen());
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::EntryAt(int index) const -> const char * {
+  return reinterpret_cast<const char *>(array_) + index * EntrySize(GetKeyPrefixLen());
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::PrefixData() -> char * {
+  return reinterpret_cast<char *>(this) + BUSTUB_PAGE_SIZE - KEY_SIZE;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::PrefixData() const -> const char * {
+  return reinterpret_cast<const char *>(this) + BUSTUB_PAGE_SIZE - KEY_SIZE;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::CommonPrefixLen(const KeyType &key) const -> int {
+  auto key_data = reinterpret_cast<const char *>(&key);
+  auto prefix_data = PrefixData();
+  int len = 0;
+  for (int prefix_len = GetKeyPrefixLen(); len < prefix_len && key_data[len] == prefix_data[len]; len++) {
+  }
+  return len;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::PrepareFor(const KeyType &key) {
+  if (IsKeyCompressed()) {
+    if (GetSize() == 0) {
+      // 只有一个 key 时整个 key 都是前缀
+      memcpy(PrefixData(), &key, KEY_SIZE);
+      key_prefix_len_ = KEY_SIZE;
+    } else if (auto len = CommonPrefixLen(key); len < key_prefix_len_) {
+      ShrinkPrefix(len);
     }
   }
-  return false;
+  BUSTUB_ASSERT(GetSize() < Capacity(GetKeyPrefixLen()), "leaf page has no room for the key");
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::ShrinkPrefix(int prefix_len) {
+  auto old_size = EntrySize(key_prefix_len_);
+  auto new_size = EntrySize(prefix_len);
+  auto delta = key_prefix_len_ - prefix_len;
+  auto base = reinterpret_cast<char *>(array_);
+  // entry 变大，从后往前移才不会覆盖还没移动的 entry
+  for (int i = GetSize() - 1; i >= 0; i--) {
+    memmove(base + i * new_size + delta, base + i * old_size, old_size);
+    memcpy(base + i * new_size, PrefixData() + prefix_len, delta);
+  }
+  key_prefix_len_ = prefix_len;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::ExtendPrefix() {
+  if (!IsKeyCompressed() || GetSize() == 0) {
+    return;
+  }
+  // 所有后缀与第一个后缀的最短共同前缀
+  int extra = KEY_SIZE - key_prefix_len_;
+  auto first = EntryAt(0);
+  for (int i = 1, sz = GetSize(); i < sz && extra > 0; i++) {
+    auto entry = EntryAt(i);
+    int len = 0;
+    while (len < extra && entry[len] == first[len]) {
+      len++;
+    }
+    extra = len;
+  }
+  if (extra == 0) {
+    return;
+  }
+  memcpy(PrefixData() + key_prefix_len_, first, extra);
+  auto old_size = EntrySize(key_prefix_len_);
+  auto new_size = EntrySize(key_prefix_len_ + extra);
+  auto base = reinterpret_cast<char *>(array_);
+  for (int i = 0, sz = GetSize(); i < sz; i++) {
+    memmove(base + i * new_size, base + i * old_size + extra, new_size);
+  }
+  key_prefix_len_ += extra;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::WriteEntry(int index, const KeyType &key, const ValueType &value) {
+  auto prefix_len = GetKeyPrefixLen();
+  auto entry = EntryAt(index);
+  memcpy(entry, reinterpret_cast<const char *>(&key) + prefix_len, KEY_SIZE - prefix_len);
+  memcpy(entry + KEY_SIZE - prefix_len, &value, sizeof(ValueType));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveEntries(int from, int to) {
+  if (from < GetSize()) {
+    memmove(EntryAt(to), EntryAt(from), (GetSize() - from) * EntrySize(GetKeyPrefixLen()));
+  }
 }
 
 template class BPlusTreeLeafPage<GenericKey<4>, RID, GenericComparator<4>>;
@@ -0,0 +1,177 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// bpm_bench.cpp
+//
+// Identification: tools/bpm_bench/bpm_bench.cpp
+//
+// Multi-threaded fetch/unpin benchmark comparing a single BufferPoolManagerInstance
+// against a ParallelBufferPoolManager with the same total number of frames.
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "argparse/argparse.hpp"
+#include "buffer/buffer_pool_manager_instance.h"
+#include "buffer/parallel_buffer_pool_manager.h"
+#include "fmt/core.h"
+#include "storage/disk/disk_manager.h"
+
+namespace {
+
+struct BenchConfig {
+  size_t pool_size_{4096};
+  size_t num_instances_{16};
+  size_t max_threads_{32};
+  size_t num_pages_{4096};
+  uint64_t duration_ms_{2000};
+};
+
+/** Run `num_threads` workers doing FetchPage/UnpinPage on random pages, return the number of ops per second. */
+auto RunWorkers(bustub::BufferPoolManager *bpm, const std::vector<bustub::page_id_t> &page_ids, size_t num_threads,
+                uint64_t duration_ms) -> double {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> total_ops{0};
+  std::atomic<uint64_t> total_fails{0};
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t thread_id = 0; thread_id < num_threads; thread_id++) {
+    threads.emplace_back([&, thread_id] {
+      std::mt19937_64 gen(thread_id);
+      std::uniform_int_distribution<size_t> dist(0, page_ids.size() - 1);
+      uint64_t ops = 0;
+      uint64_t fails = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        auto page_id = page_ids[dist(gen)];
+        auto page = bpm->FetchPage(page_id);
+        if (page == nullptr) {
+          fails++;
+          continue;
+        }
+        page->RLatch();
+        volatile char c = page->GetData()[0];
+        (void)c;
+        page->RUnlatch();
+        bpm->UnpinPage(page_id, false);
+        ops++;
+      }
+      total_ops += ops;
+      total_fails += fails;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  if (total_fails > 0) {
+    fmt::print(stderr, "warning: {} fetches failed because all frames were pinned\n", total_fails.load());
+  }
+  return static_cast<double>(total_ops) * 1000.0 / static_cast<double>(duration_ms);
+}
+
+void RunBench(const std::string &name, bustub::BufferPoolManager *bpm, const BenchConfig &config) {
+  // 先创建 working set 中的所有 page
+  std::vector<bustub::page_id_t> page_ids;
+  page_ids.reserve(config.num_pages_);
+  for (size_t i = 0; i < config.num_pages_; i++) {
+    bustub::page_id_t page_id;
+    auto page = bpm->NewPage(&page_id);
+    if (page == nullptr) {
+      throw std::runtime_error("bpm_bench: cannot create page, the pool is too small");
+    }
+    snprintf(page->GetData(), bustub::BUSTUB_PAGE_SIZE, "page %d", page_id);
+    bpm->UnpinPage(page_id, true);
+    page_ids.emplace_back(page_id);
+  }
+
+  double base = 0;
+  for (size_t num_threads = 1; num_threads <= config.max_threads_; num_threads <<= 1) {
+    auto throughput = RunWorkers(bpm, page_ids, num_threads, config.duration_ms_);
+    if (num_threads == 1) {
+      base = throughput;
+    }
+    fmt::print("bpm={:<14} threads={:<3} ops/s={:<12.0f} speedup={:.2f}x\n", name, num_threads, throughput,
+               base > 0 ? throughput / base : 0.0);
+  }
+  auto stats = bpm->GetStats();
+  fmt::print("bpm={:<14} hit_ratio={:.4f} evictions={} latch_contentions={}/{} latch_wait={:.1f}ms\n", name,
+             stats.HitRatio(), stats.evictions_, stats.latch_contentions_, stats.latch_acquisitions_,
+             static_cast<double>(stats.latch_wait_ns_) / 1e6);
+}
+
+}  // namespace
+
+// NOLINTNEXTLINE
+auto main(int argc, char **argv) -> int {
+  argparse::ArgumentParser program("bustub-bpm-bench");
+  program.add_argument("--pool-size").help("total number of frames over all instances");
+  program.add_argument("--instances").help("number of BufferPoolManagerInstances in the parallel BPM");
+  program.add_argument("--threads").help("max number of worker threads, doubled from 1");
+  program.add_argument("--pages").help("number of distinct pages touched (<= pool size for a pure hit workload)");
+  program.add_argument("--duration").help("run each thread count for n milliseconds");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+  BenchConfig config;
+  if (program.present("--pool-size")) {
+    config.pool_size_ = std::stoul(program.get("--pool-size"));
+  }
+  if (program.present("--instances")) {
+    config.num_instances_ = std::stoul(program.get("--instances"));
+  }
+  if (program.present("--threads")) {
+    config.max_threads_ = std::stoul(program.get("--threads"));
+  }
+  config.num_pages_ = config.pool_size_;
+  if (program.present("--pages")) {
+    config.num_pages_ = std::stoul(program.get("--pages"));
+  }
+  if (program.present("--duration")) {
+    config.duration_ms_ = std::stoull(program.get("--duration"));
+  }
+  if (config.num_instances_ == 0 || config.pool_size_ < config.num_instances_) {
+    std::cerr << "bpm_bench: pool size must be at least the number of instances" << std::endl;
+    return 1;
+  }
+
+  fmt::print("pool_size={} instances={} pages={} duration={}ms\n", config.pool_size_, config.num_instances_,
+             config.num_pages_, config.duration_ms_);
+
+  const std::string db_name = "bpm_bench.db";
+  {
+    auto disk_manager = std::make_unique<bustub::DiskManager>(db_name);
+    auto bpm = std::make_unique<bustub::BufferPoolManagerInstance>(config.pool_size_, disk_manager.get());
+    RunBench("instance", bpm.get(), config);
+    bpm.reset();
+    disk_manager->ShutDown();
+  }
+  std::remove(db_name.c_str());
+  {
+    auto disk_manager = std::make_unique<bustub::DiskManager>(db_name);
+    auto bpm = std::make_unique<bustub::ParallelBufferPoolManager>(
+        config.num_instances_, config.pool_size_ / config.num_instances_, disk_manager.get());
+    RunBench(fmt::format("parallel({})", config.num_instances_), bpm.get(), config);
+    bpm.reset();
+    disk_manager->ShutDown();
+  }
+  std::remove(db_name.c_str());
+  std::remove("bpm_bench.log");
+  return 0;
+}
@@ -0,0 +1,194 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// btree_bench.cpp
+//
+// Identification: tools/btree_bench/btree_bench.cpp
+//
+// Multi-threaded read/write-mix benchmark for the B+ tree, comparing latch crabbing against optimistic lock
+// coupling. The tree is bulk loaded with the even keys of [0, 2 * keys), readers look up random keys and writers
+// insert or remove random odd keys, so the size of the tree stays about the same during a run.
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "argparse/argparse.hpp"
+#include "buffer/buffer_pool_manager_instance.h"
+#include "catalog/schema.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+#include "fmt/core.h"
+#include "storage/disk/disk_manager.h"
+#include "storage/index/b_plus_tree.h"
+#include "storage/index/generic_key.h"
+
+namespace {
+
+using KeyType = bustub::GenericKey<8>;
+using Comparator = bustub::GenericComparator<8>;
+using Tree = bustub::BPlusTree<KeyType, bustub::RID, Comparator>;
+
+// 与 LEAF_PAGE_SIZE / INTERNAL_PAGE_SIZE 相同，即一个 page 能放下的最多 entry 数
+constexpr int LEAF_MAX_SIZE =
+    (bustub::BUSTUB_PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / sizeof(std::pair<KeyType, bustub::RID>);
+constexpr int INTERNAL_MAX_SIZE =
+    (bustub::BUSTUB_PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE) / sizeof(std::pair<KeyType, bustub::page_id_t>);
+
+struct BenchConfig {
+  size_t num_keys_{1000000};
+  size_t pool_size_{16384};
+  size_t max_threads_{16};
+  uint64_t duration_ms_{2000};
+  std::vector<size_t> read_percents_{100, 95, 50};
+};
+
+struct RunResult {
+  double ops_per_sec_{0};
+  uint64_t failed_reads_{0};
+};
+
+/** Run `num_threads` workers for duration_ms, read_percent of the operations being point lookups. */
+auto RunWorkers(Tree *tree, const BenchConfig &config, size_t num_threads, size_t read_percent) -> RunResult {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> total_ops{0};
+  std::atomic<uint64_t> failed_reads{0};
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t thread_id = 0; thread_id < num_threads; thread_id++) {
+    threads.emplace_back([&, thread_id] {
+      std::mt19937_64 gen(thread_id);
+      std::uniform_int_distribution<int64_t> key_dist(0, static_cast<int64_t>(2 * config.num_keys_) - 1);
+      std::uniform_int_distribution<size_t> op_dist(0, 99);
+      std::vector<bustub::RID> result;
+      KeyType key;
+      uint64_t ops = 0;
+      uint64_t fails = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        auto k = key_dist(gen);
+        if (op_dist(gen) < read_percent) {
+          key.SetFromInteger(k);
+          result.clear();
+          // 偶数 key 一直在树中
+          if (!tree->GetValue(key, &result) && k % 2 == 0) {
+            fails++;
+          }
+        } else {
+          key.SetFromInteger(k | 1);
+          bustub::Transaction transaction(0);
+          if ((k >> 1) % 2 == 0) {
+            tree->Insert(key, bustub::RID(k | 1), &transaction);
+          } else {
+            tree->Remove(key, &transaction);
+          }
+        }
+        ops++;
+      }
+      total_ops += ops;
+      failed_reads += fails;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(config.duration_ms_));
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return {static_cast<double>(total_ops) * 1000.0 / static_cast<double>(config.duration_ms_), failed_reads};
+}
+
+void RunBench(const std::string &name, bool use_olc, const BenchConfig &config) {
+  const std::string db_name = "btree_bench.db";
+  auto disk_manager = std::make_unique<bustub::DiskManager>(db_name);
+  auto bpm = std::make_unique<bustub::BufferPoolManagerInstance>(config.pool_size_, disk_manager.get());
+  // header page 必须是第 0 个 page
+  bustub::page_id_t header_page_id;
+  bpm->NewPage(&header_page_id);
+  bpm->UnpinPage(header_page_id, true);
+
+  bustub::Schema key_schema({bustub::Column("key", bustub::TypeId::BIGINT)});
+  Tree tree("btree_bench", bpm.get(), Comparator(&key_schema), LEAF_MAX_SIZE, INTERNAL_MAX_SIZE, use_olc);
+  int64_t next_key = 0;
+  tree.BulkLoad(config.num_keys_, [&](KeyType *key, bustub::RID *value) {
+    key->SetFromInteger(next_key);
+    *value = bustub::RID(next_key);
+    next_key += 2;
+    return true;
+  });
+
+  for (auto read_percent : config.read_percents_) {
+    double base = 0;
+    for (size_t num_threads = 1; num_threads <= config.max_threads_; num_threads <<= 1) {
+      auto result = RunWorkers(&tree, config, num_threads, read_percent);
+      if (num_threads == 1) {
+        base = result.ops_per_sec_;
+      }
+      fmt::print("tree={:<8} reads={:>3}% threads={:<3} ops/s={:<12.0f} speedup={:.2f}x\n", name, read_percent,
+                 num_threads, result.ops_per_sec_, base > 0 ? result.ops_per_sec_ / base : 0.0);
+      if (result.failed_reads_ > 0) {
+        fmt::print(stderr, "warning: {} lookups of existing keys failed\n", result.failed_reads_);
+      }
+    }
+  }
+  bpm.reset();
+  disk_manager->ShutDown();
+  std::remove(db_name.c_str());
+  std::remove("btree_bench.log");
+}
+
+}  // namespace
+
+// NOLINTNEXTLINE
+auto main(int argc, char **argv) -> int {
+  argparse::ArgumentParser program("bustub-btree-bench");
+  program.add_argument("--keys").help("number of keys bulk loaded into the tree");
+  program.add_argument("--pool-size").help("number of frames of the buffer pool");
+  program.add_argument("--threads").help("max number of worker threads, doubled from 1");
+  program.add_argument("--duration").help("run each thread count for n milliseconds");
+  program.add_argument("--reads").help("comma separated percentages of lookups to run (default: 100,95,50)");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+  BenchConfig config;
+  if (program.present("--keys")) {
+    config.num_keys_ = std::stoul(program.get("--keys"));
+  }
+  if (program.present("--pool-size")) {
+    config.pool_size_ = std::stoul(program.get("--pool-size"));
+  }
+  if (program.present("--threads")) {
+    config.max_threads_ = std::stoul(program.get("--threads"));
+  }
+  if (program.present("--duration")) {
+    config.duration_ms_ = std::stoull(program.get("--duration"));
+  }
+  if (program.present("--reads")) {
+    config.read_percents_.clear();
+    std::istringstream reads(program.get("--reads"));
+    std::string percent;
+    while (std::getline(reads, percent, ',')) {
+      config.read_percents_.emplace_back(std::stoul(percent));
+    }
+  }
+
+  fmt::print("keys={} pool_size={} duration={}ms\n", config.num_keys_, config.pool_size_, config.duration_ms_);
+  RunBench("latched", false, config);
+  RunBench("olc", true, config);
+  return 0;
+}
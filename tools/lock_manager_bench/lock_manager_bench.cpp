@@ -0,0 +1,169 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_manager_bench.cpp
+//
+// Identification: tools/lock_manager_bench/lock_manager_bench.cpp
+//
+// Multi-threaded lock / unlock throughput of the LockManager. Every worker runs short READ_COMMITTED transactions:
+// IX on a table, X on rows_per_txn consecutive rows of its own range, then unlocks them all. The rows of different
+// threads never conflict, so the throughput is bounded by the lock table latches and queue allocations only.
+// With --hot-rows, all threads lock rows_per_txn of the same hot_rows rows instead, in row order so that they never
+// deadlock, which measures the queueing and wakeups of contended rows. --escalation turns on lock escalation (see
+// LockManager::SetEscalationThreshold()), which is off by default.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "argparse/argparse.hpp"
+#include "common/config.h"
+#include "common/rid.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction.h"
+#include "fmt/core.h"
+
+namespace {
+
+using bustub::LockManager;
+using bustub::RID;
+
+struct BenchConfig {
+  size_t max_threads_{64};
+  uint64_t duration_ms_{1000};
+  /** Number of rows each thread locks from, i.e. number of distinct lock queues per thread */
+  size_t rows_per_thread_{16384};
+  size_t rows_per_txn_{16};
+  size_t num_tables_{1};
+  /** If not 0, number of rows shared by all threads */
+  size_t hot_rows_{0};
+  /** If not 0, row locks per table past which a txn's row locks are escalated */
+  size_t escalation_threshold_{0};
+};
+
+/** Slots per page of the row ids, so that consecutive rows share a page the way a scan does */
+constexpr uint32_t SLOTS_PER_PAGE = 64;
+
+/** Run `num_threads` workers, return the number of lock and unlock calls per second. */
+auto RunWorkers(LockManager *lock_manager, size_t num_threads, const BenchConfig &config) -> double {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> total_ops{0};
+  std::atomic<bustub::txn_id_t> next_txn_id{0};
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t thread_id = 0; thread_id < num_threads; thread_id++) {
+    threads.emplace_back([&, thread_id] {
+      std::mt19937_64 gen(thread_id);
+      const size_t num_rows = config.hot_rows_ > 0 ? config.hot_rows_ : config.rows_per_thread_;
+      std::uniform_int_distribution<size_t> row_dist(0, num_rows - 1);
+      std::uniform_int_distribution<size_t> table_dist(0, config.num_tables_ - 1);
+      const size_t first_row = config.hot_rows_ > 0 ? 0 : thread_id * config.rows_per_thread_;
+      std::vector<RID> rids(config.rows_per_txn_);
+      uint64_t ops = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        auto oid = static_cast<bustub::table_oid_t>(table_dist(gen));
+        auto start = row_dist(gen);
+        for (size_t i = 0; i < config.rows_per_txn_; i++) {
+          auto row = first_row + (start + i) % num_rows;
+          rids[i] =
+              RID(static_cast<bustub::page_id_t>(row / SLOTS_PER_PAGE), static_cast<uint32_t>(row % SLOTS_PER_PAGE));
+        }
+        // 按 row 的顺序加锁，hot rows 上不会 deadlock
+        std::sort(rids.begin(), rids.end(), [](const RID &a, const RID &b) { return a.Get() < b.Get(); });
+        bustub::Transaction txn(next_txn_id.fetch_add(1, std::memory_order_relaxed),
+                                bustub::IsolationLevel::READ_COMMITTED);
+        lock_manager->LockTable(&txn, LockManager::LockMode::INTENTION_EXCLUSIVE, oid);
+        for (const auto &rid : rids) {
+          lock_manager->LockRow(&txn, LockManager::LockMode::EXCLUSIVE, oid, rid);
+        }
+        for (const auto &rid : rids) {
+          lock_manager->UnlockRow(&txn, oid, rid);
+        }
+        lock_manager->UnlockTable(&txn, oid);
+        ops += 2 * config.rows_per_txn_ + 2;
+      }
+      total_ops += ops;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(config.duration_ms_));
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return static_cast<double>(total_ops) * 1000.0 / static_cast<double>(config.duration_ms_);
+}
+
+}  // namespace
+
+// NOLINTNEXTLINE
+auto main(int argc, char **argv) -> int {
+  argparse::ArgumentParser program("bustub-lock-manager-bench");
+  program.add_argument("--threads").help("max number of worker threads, doubled from 1");
+  program.add_argument("--duration").help("run each thread count for n milliseconds");
+  program.add_argument("--rows").help("number of rows each thread locks from");
+  program.add_argument("--rows-per-txn").help("number of row locks per transaction");
+  program.add_argument("--tables").help("number of tables the transactions lock");
+  program.add_argument("--hot-rows").help("if set, number of rows that all threads lock");
+  program.add_argument("--escalation").help("if set, escalate a txn's row locks past n rows of a table");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+  BenchConfig config;
+  if (program.present("--threads")) {
+    config.max_threads_ = std::stoul(program.get("--threads"));
+  }
+  if (program.present("--duration")) {
+    config.duration_ms_ = std::stoull(program.get("--duration"));
+  }
+  if (program.present("--rows")) {
+    config.rows_per_thread_ = std::stoul(program.get("--rows"));
+  }
+  if (program.present("--rows-per-txn")) {
+    config.rows_per_txn_ = std::stoul(program.get("--rows-per-txn"));
+  }
+  if (program.present("--tables")) {
+    config.num_tables_ = std::stoul(program.get("--tables"));
+  }
+  if (program.present("--hot-rows")) {
+    config.hot_rows_ = std::stoul(program.get("--hot-rows"));
+  }
+  if (program.present("--escalation")) {
+    config.escalation_threshold_ = std::stoul(program.get("--escalation"));
+  }
+  auto num_rows = config.hot_rows_ > 0 ? config.hot_rows_ : config.rows_per_thread_;
+  if (num_rows == 0 || config.num_tables_ == 0 || config.rows_per_txn_ > num_rows) {
+    std::cerr << "lock_manager_bench: need rows > 0, tables > 0 and rows-per-txn <= rows" << std::endl;
+    return 1;
+  }
+
+  fmt::print("rows_per_thread={} hot_rows={} rows_per_txn={} tables={} escalation={} duration={}ms\n",
+             config.rows_per_thread_, config.hot_rows_, config.rows_per_txn_, config.num_tables_,
+             config.escalation_threshold_, config.duration_ms_);
+  auto lock_manager = std::make_unique<LockManager>();
+  lock_manager->SetEscalationThreshold(config.escalation_threshold_);
+  double base = 0;
+  for (size_t num_threads = 1; num_threads <= config.max_threads_; num_threads <<= 1) {
+    auto throughput = RunWorkers(lock_manager.get(), num_threads, config);
+    if (num_threads == 1) {
+      base = throughput;
+    }
+    fmt::print("threads={:<3} ops/s={:<12.0f} speedup={:.2f}x\n", num_threads, throughput,
+               base > 0 ? throughput / base : 0.0);
+  }
+  return 0;
+}
@@ -0,0 +1,627 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// micro_bench.cpp
+//
+// Identification: tools/micro_bench/micro_bench.cpp
+//
+// The standard microbenchmark suite: buffer pool fetch/unpin at several hit ratios and thread counts, LRU-K evict,
+// extendible hash table insert/find, B+ tree insert/lookup/scan/delete and read/write mixes, lock manager throughput
+// and end-to-end executor pipelines run through SQL. Each benchmark is named like `group/case/param:value` and can be
+// selected with --filter. Results are printed as a table and, with --out, written as JSON in the layout of Google
+// Benchmark's --benchmark_format=json, so that its compare.py and other gating scripts read them unchanged.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <regex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "argparse/argparse.hpp"
+#include "buffer/buffer_pool_manager_instance.h"
+#include "buffer/lru_k_replacer.h"
+#include "catalog/schema.h"
+#include "common/bustub_instance.h"
+#include "common/config.h"
+#include "common/rid.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction.h"
+#include "container/hash/extendible_hash_table.h"
+#include "fmt/core.h"
+#include "fmt/format.h"
+#include "storage/disk/disk_manager.h"
+#include "storage/index/b_plus_tree.h"
+#include "storage/index/generic_key.h"
+
+namespace {
+
+using KeyType = bustub::GenericKey<8>;
+using Comparator = bustub::GenericComparator<8>;
+using Tree = bustub::BPlusTree<KeyType, bustub::RID, Comparator>;
+
+// 与 LEAF_PAGE_SIZE / INTERNAL_PAGE_SIZE 相同，即一个 page 能放下的最多 entry 数
+constexpr int LEAF_MAX_SIZE =
+    (bustub::BUSTUB_PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / sizeof(std::pair<KeyType, bustub::RID>);
+constexpr int INTERNAL_MAX_SIZE =
+    (bustub::BUSTUB_PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE) / sizeof(std::pair<KeyType, bustub::page_id_t>);
+
+const char *const DB_NAME = "micro_bench.db";
+const char *const LOG_NAME = "micro_bench.log";
+
+struct BenchConfig {
+  uint64_t duration_ms_{1000};
+  size_t max_threads_{16};
+  size_t pool_size_{4096};
+  /** Number of keys of the hash table and B+ tree benchmarks */
+  size_t num_keys_{200000};
+  /** Number of rows of each table of the executor benchmarks */
+  size_t num_rows_{10000};
+};
+
+/** One line of the report, the fields of a Google Benchmark JSON entry. Times are per iteration. */
+struct BenchResult {
+  std::string name_;
+  uint64_t iterations_{0};
+  double real_time_ns_{0};
+  double cpu_time_ns_{0};
+  double items_per_second_{0};
+  std::vector<std::pair<std::string, double>> counters_;
+};
+
+/**
+ * Passed to each benchmark. Setup runs before StartTimer() and is not measured. CPU time is the CPU time of the whole
+ * process, so for a multi-threaded benchmark it is the sum over the workers.
+ */
+class BenchState {
+ public:
+  BenchState(std::string name, const BenchConfig &config) : config_(config) { result_.name_ = std::move(name); }
+
+  auto Config() const -> const BenchConfig & { return config_; }
+
+  void StartTimer() {
+    real_start_ = std::chrono::steady_clock::now();
+    cpu_start_ = std::clock();
+  }
+
+  /** Stop the timer after `iterations` operations. */
+  void StopTimer(uint64_t iterations) {
+    auto real_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - real_start_).count();
+    auto cpu_ns = static_cast<double>(std::clock() - cpu_start_) * 1e9 / CLOCKS_PER_SEC;
+    result_.iterations_ = std::max<uint64_t>(iterations, 1);
+    result_.real_time_ns_ = real_ns / static_cast<double>(result_.iterations_);
+    result_.cpu_time_ns_ = cpu_ns / static_cast<double>(result_.iterations_);
+    result_.items_per_second_ = real_ns > 0 ? static_cast<double>(iterations) * 1e9 / real_ns : 0;
+  }
+
+  /**
+   * Time `num_threads` workers for duration_ms. A worker runs `body(thread_id, stop)`, which loops until `stop` is set
+   * and returns the number of operations it did.
+   */
+  template <typename F>
+  void RunThreads(size_t num_threads, F &&body) {
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> total_ops{0};
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    StartTimer();
+    for (size_t thread_id = 0; thread_id < num_threads; thread_id++) {
+      threads.emplace_back([&, thread_id] { total_ops += body(thread_id, stop); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(config_.duration_ms_));
+    stop = true;
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    StopTimer(total_ops);
+  }
+
+  /** Report an extra value, e.g. the measured hit ratio. */
+  void AddCounter(const std::string &name, double value) { result_.counters_.emplace_back(name, value); }
+
+  auto Result() -> BenchResult & { return result_; }
+
+ private:
+  const BenchConfig &config_;
+  BenchResult result_;
+  std::chrono::steady_clock::time_point real_start_;
+  std::clock_t cpu_start_{0};
+};
+
+struct Benchmark {
+  std::string name_;
+  std::function<void(BenchState *)> run_;
+};
+
+/** @return 1, 4, 16, ... up to max_threads */
+auto ThreadCounts(const BenchConfig &config) -> std::vector<size_t> {
+  std::vector<size_t> counts;
+  for (size_t num_threads = 1; num_threads <= config.max_threads_; num_threads *= 4) {
+    counts.emplace_back(num_threads);
+  }
+  return counts;
+}
+
+/** A buffer pool on a fresh db file, removed when it goes out of scope. */
+struct BenchPool {
+  explicit BenchPool(size_t pool_size)
+      : disk_manager_(std::make_unique<bustub::DiskManager>(DB_NAME)),
+        bpm_(std::make_unique<bustub::BufferPoolManagerInstance>(pool_size, disk_manager_.get())) {}
+
+  ~BenchPool() {
+    bpm_.reset();
+    disk_manager_->ShutDown();
+    std::remove(DB_NAME);
+    std::remove(LOG_NAME);
+  }
+
+  std::unique_ptr<bustub::DiskManager> disk_manager_;
+  std::unique_ptr<bustub::BufferPoolManagerInstance> bpm_;
+};
+
+/*****************************************************************************
+ * Buffer pool and replacer
+ *****************************************************************************/
+
+/** Random FetchPage/UnpinPage over pool_size * 100 / hit_percent pages, so about hit_percent% of fetches hit. */
+void BenchFetchUnpin(BenchState *state, size_t hit_percent, size_t num_threads) {
+  const auto &config = state->Config();
+  BenchPool pool(config.pool_size_);
+  auto bpm = pool.bpm_.get();
+  const size_t num_pages = config.pool_size_ * 100 / hit_percent;
+  for (size_t i = 0; i < num_pages; i++) {
+    bustub::page_id_t page_id;
+    bpm->NewPage(&page_id);
+    bpm->UnpinPage(page_id, true);
+  }
+  bpm->FlushAllPages();
+  auto before = bpm->GetStats();
+  state->RunThreads(num_threads, [&](size_t thread_id, const std::atomic<bool> &stop) {
+    std::mt19937_64 gen(thread_id);
+    std::uniform_int_distribution<bustub::page_id_t> page_dist(0, static_cast<bustub::page_id_t>(num_pages) - 1);
+    uint64_t ops = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+      auto page_id = page_dist(gen);
+      if (bpm->FetchPage(page_id) != nullptr) {
+        bpm->UnpinPage(page_id, false);
+      }
+      ops++;
+    }
+    return ops;
+  });
+  auto after = bpm->GetStats();
+  auto hits = after.Hits() - before.Hits();
+  auto fetches = hits + after.Misses() - before.Misses();
+  state->AddCounter("hit_ratio", fetches > 0 ? static_cast<double>(hits) / static_cast<double>(fetches) : 0);
+}
+
+/** Evict a frame and access it again, as the buffer pool does on every miss of a full pool. */
+void BenchLruKEvict(BenchState *state) {
+  const auto num_frames = state->Config().pool_size_;
+  bustub::LRUKReplacer replacer(num_frames, 2);
+  for (size_t i = 0; i < num_frames; i++) {
+    auto frame_id = static_cast<bustub::frame_id_t>(i);
+    replacer.RecordAccess(frame_id);
+    replacer.SetEvictable(frame_id, true);
+  }
+  state->RunThreads(1, [&](size_t thread_id, const std::atomic<bool> &stop) {
+    uint64_t ops = 0;
+    bustub::frame_id_t frame_id;
+    while (!stop.load(std::memory_order_relaxed)) {
+      replacer.Evict(&frame_id);
+      replacer.RecordAccess(frame_id);
+      replacer.SetEvictable(frame_id, true);
+      ops++;
+    }
+    return ops;
+  });
+}
+
+/*****************************************************************************
+ * Extendible hash table
+ *****************************************************************************/
+
+void BenchHashInsert(BenchState *state) {
+  const auto num_keys = state->Config().num_keys_;
+  std::vector<int64_t> keys(num_keys);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937_64(0));
+  bustub::ExtendibleHashTable<int64_t, int64_t> table(8);
+  state->StartTimer();
+  for (auto key : keys) {
+    table.Insert(key, key);
+  }
+  state->StopTimer(num_keys);
+}
+
+void BenchHashFind(BenchState *state, size_t num_threads) {
+  const auto num_keys = state->Config().num_keys_;
+  bustub::ExtendibleHashTable<int64_t, int64_t> table(8);
+  for (size_t key = 0; key < num_keys; key++) {
+    table.Insert(key, key);
+  }
+  state->RunThreads(num_threads, [&](size_t thread_id, const std::atomic<bool> &stop) {
+    std::mt19937_64 gen(thread_id);
+    // 一半的 key 不在表中
+    std::uniform_int_distribution<int64_t> key_dist(0, static_cast<int64_t>(2 * num_keys) - 1);
+    uint64_t ops = 0;
+    int64_t value;
+    while (!stop.load(std::memory_order_relaxed)) {
+      table.Find(key_dist(gen), value);
+      ops++;
+    }
+    return ops;
+  });
+}
+
+/*****************************************************************************
+ * B+ tree
+ *****************************************************************************/
+
+/** A B+ tree on a fresh buffer pool, holding the even keys of [0, 2 * num_keys) unless `load` is false. */
+struct BenchTree {
+  BenchTree(const BenchConfig &config, bool load) : pool_(std::max<size_t>(config.pool_size_, 1024)) {
+    // header page 必须是第 0 个 page
+    bustub::page_id_t header_page_id;
+    pool_.bpm_->NewPage(&header_page_id);
+    pool_.bpm_->UnpinPage(header_page_id, true);
+    tree_ = std::make_unique<Tree>("micro_bench", pool_.bpm_.get(), Comparator(&key_schema_), LEAF_MAX_SIZE,
+                                   INTERNAL_MAX_SIZE);
+    if (load) {
+      int64_t next_key = 0;
+      tree_->BulkLoad(config.num_keys_, [&](KeyType *key, bustub::RID *value) {
+        key->SetFromInteger(next_key);
+        *value = bustub::RID(next_key);
+        next_key += 2;
+        return true;
+      });
+    }
+  }
+
+  BenchPool pool_;
+  bustub::Schema key_schema_{{bustub::Column("key", bustub::TypeId::BIGINT)}};
+  std::unique_ptr<Tree> tree_;
+};
+
+auto ShuffledKeys(size_t num_keys) -> std::vector<int64_t> {
+  std::vector<int64_t> keys(num_keys);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937_64(0));
+  return keys;
+}
+
+void BenchTreeInsert(BenchState *state) {
+  BenchTree bench_tree(state->Config(), false);
+  auto keys = ShuffledKeys(state->Config().num_keys_);
+  KeyType key;
+  bustub::Transaction transaction(0);
+  state->StartTimer();
+  for (auto k : keys) {
+    key.SetFromInteger(k);
+    bench_tree.tree_->Insert(key, bustub::RID(k), &transaction);
+  }
+  state->StopTimer(keys.size());
+}
+
+void BenchTreeDelete(BenchState *state) {
+  BenchTree bench_tree(state->Config(), true);
+  auto keys = ShuffledKeys(state->Config().num_keys_);
+  KeyType key;
+  bustub::Transaction transaction(0);
+  state->StartTimer();
+  for (auto k : keys) {
+    key.SetFromInteger(2 * k);
+    bench_tree.tree_->Remove(key, &transaction);
+  }
+  state->StopTimer(keys.size());
+}
+
+void BenchTreeScan(BenchState *state) {
+  BenchTree bench_tree(state->Config(), true);
+  uint64_t entries = 0;
+  state->StartTimer();
+  for (auto it = bench_tree.tree_->Begin(); !it.IsEnd(); ++it) {
+    static_cast<void>(*it);
+    entries++;
+  }
+  state->StopTimer(entries);
+}
+
+/** read_percent% point lookups, the rest inserts or removes of odd keys, so the size of the tree stays the same. */
+void BenchTreeMix(BenchState *state, size_t read_percent, size_t num_threads) {
+  const auto &config = state->Config();
+  BenchTree bench_tree(config, true);
+  auto tree = bench_tree.tree_.get();
+  state->RunThreads(num_threads, [&](size_t thread_id, const std::atomic<bool> &stop) {
+    std::mt19937_64 gen(thread_id);
+    std::uniform_int_distribution<int64_t> key_dist(0, static_cast<int64_t>(2 * config.num_keys_) - 1);
+    std::uniform_int_distribution<size_t> op_dist(0, 99);
+    std::vector<bustub::RID> result;
+    KeyType key;
+    uint64_t ops = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+      auto k = key_dist(gen);
+      if (op_dist(gen) < read_percent) {
+        key.SetFromInteger(k);
+        result.clear();
+        tree->GetValue(key, &result);
+      } else {
+        key.SetFromInteger(k | 1);
+        bustub::Transaction transaction(0);
+        if ((k >> 1) % 2 == 0) {
+          tree->Insert(key, bustub::RID(k | 1), &transaction);
+        } else {
+          tree->Remove(key, &transaction);
+        }
+      }
+      ops++;
+    }
+    return ops;
+  });
+}
+
+/*****************************************************************************
+ * Lock manager
+ *****************************************************************************/
+
+/** Transactions locking 16 rows each, from rows of their own thread; every lock and unlock call is one item. */
+void BenchLockRows(BenchState *state, size_t num_threads) {
+  constexpr size_t rows_per_thread = 16384;
+  constexpr size_t rows_per_txn = 16;
+  bustub::LockManager lock_manager;
+  std::atomic<bustub::txn_id_t> next_txn_id{0};
+  state->RunThreads(num_threads, [&](size_t thread_id, const std::atomic<bool> &stop) {
+    std::mt19937_64 gen(thread_id);
+    std::uniform_int_distribution<size_t> row_dist(0, rows_per_thread - 1);
+    uint64_t ops = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+      auto start = row_dist(gen);
+      bustub::Transaction txn(next_txn_id.fetch_add(1, std::memory_order_relaxed),
+                              bustub::IsolationLevel::READ_COMMITTED);
+      lock_manager.LockTable(&txn, bustub::LockManager::LockMode::INTENTION_EXCLUSIVE, 0);
+      std::vector<bustub::RID> rids;
+      for (size_t i = 0; i < rows_per_txn; i++) {
+        auto row = thread_id * rows_per_thread + (start + i) % rows_per_thread;
+        rids.emplace_back(static_cast<bustub::page_id_t>(row / 64), static_cast<uint32_t>(row % 64));
+        lock_manager.LockRow(&txn, bustub::LockManager::LockMode::EXCLUSIVE, 0, rids.back());
+      }
+      for (const auto &rid : rids) {
+        lock_manager.UnlockRow(&txn, 0, rid);
+      }
+      lock_manager.UnlockTable(&txn, 0);
+      ops += 2 * rows_per_txn + 2;
+    }
+    return ops;
+  });
+}
+
+/*****************************************************************************
+ * Executors
+ *****************************************************************************/
+
+/** Counts the rows of a result and drops them. */
+class CountingWriter : public bustub::ResultWriter {
+ public:
+  void WriteCell(const std::string &cell) override {}
+  void WriteHeaderCell(const std::string &cell) override {}
+  void BeginHeader() override {}
+  void EndHeader() override {}
+  void BeginRow() override { rows_++; }
+  void EndRow() override {}
+  void BeginTable(bool simplified_output) override {}
+  void EndTable() override {}
+
+  uint64_t rows_{0};
+};
+
+/** A database with t1(a, b) and t2(a, c) of num_rows rows each, t1.b having 100 distinct values. */
+struct BenchDatabase {
+  explicit BenchDatabase(const BenchConfig &config) : instance_(std::make_unique<bustub::BustubInstance>(DB_NAME)) {
+    Execute("CREATE TABLE t1(a INT, b INT);");
+    Execute("CREATE TABLE t2(a INT, c INT);");
+    constexpr size_t rows_per_insert = 1000;
+    for (size_t first = 0; first < config.num_rows_; first += rows_per_insert) {
+      std::string t1_values;
+      std::string t2_values;
+      for (size_t row = first; row < std::min(first + rows_per_insert, config.num_rows_); row++) {
+        auto sep = row == first ? "" : ",";
+        t1_values += fmt::format("{}({},{})", sep, row, (row * 7919) % 100);
+        t2_values += fmt::format("{}({},{})", sep, (row * 104729) % config.num_rows_, row);
+      }
+      Execute("INSERT INTO t1 VALUES " + t1_values + ";");
+      Execute("INSERT INTO t2 VALUES " + t2_values + ";");
+    }
+  }
+
+  ~BenchDatabase() {
+    instance_.reset();
+    std::remove(DB_NAME);
+    std::remove(LOG_NAME);
+  }
+
+  /** @return the number of rows of the result */
+  auto Execute(const std::string &sql) -> uint64_t {
+    CountingWriter writer;
+    instance_->ExecuteSql(sql, writer);
+    return writer.rows_;
+  }
+
+  std::unique_ptr<bustub::BustubInstance> instance_;
+};
+
+/** Run `sql` repeatedly for duration_ms; an iteration is one query, the items are the rows of t1 it reads. */
+void BenchQuery(BenchState *state, const std::string &sql) {
+  const auto &config = state->Config();
+  BenchDatabase database(config);
+  uint64_t queries = 0;
+  uint64_t result_rows = 0;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config.duration_ms_);
+  state->StartTimer();
+  do {
+    result_rows = database.Execute(sql);
+    queries++;
+  } while (std::chrono::steady_clock::now() < deadline);
+  state->StopTimer(queries);
+  auto &result = state->Result();
+  result.items_per_second_ *= static_cast<double>(config.num_rows_);
+  state->AddCounter("result_rows", static_cast<double>(result_rows));
+}
+
+/*****************************************************************************
+ * Registry and report
+ *****************************************************************************/
+
+auto RegisterBenchmarks(const BenchConfig &config) -> std::vector<Benchmark> {
+  std::vector<Benchmark> benchmarks;
+  auto add = [&](std::string name, std::function<void(BenchState *)> run) {
+    benchmarks.push_back({std::move(name), std::move(run)});
+  };
+  for (size_t hit_percent : {100, 90, 50}) {
+    for (auto num_threads : ThreadCounts(config)) {
+      add(fmt::format("bpm/fetch_unpin/hit:{}/threads:{}", hit_percent, num_threads),
+          [=](BenchState *state) { BenchFetchUnpin(state, hit_percent, num_threads); });
+    }
+  }
+  add("replacer/lru_k/evict", BenchLruKEvict);
+  add("hash_table/extendible/insert", BenchHashInsert);
+  for (auto num_threads : ThreadCounts(config)) {
+    add(fmt::format("hash_table/extendible/find/threads:{}", num_threads),
+        [=](BenchState *state) { BenchHashFind(state, num_threads); });
+  }
+  add("btree/insert", BenchTreeInsert);
+  add("btree/delete", BenchTreeDelete);
+  add("btree/scan", BenchTreeScan);
+  for (size_t read_percent : {100, 95, 50}) {
+    for (auto num_threads : ThreadCounts(config)) {
+      add(fmt::format("btree/mix/reads:{}/threads:{}", read_percent, num_threads),
+          [=](BenchState *state) { BenchTreeMix(state, read_percent, num_threads); });
+    }
+  }
+  for (auto num_threads : ThreadCounts(config)) {
+    add(fmt::format("lock_manager/lock_rows/threads:{}", num_threads),
+        [=](BenchState *state) { BenchLockRows(state, num_threads); });
+  }
+  const std::vector<std::pair<std::string, std::string>> queries{
+      {"scan_filter_agg", "SELECT b, COUNT(*), SUM(a) FROM t1 WHERE a % 3 = 0 GROUP BY b;"},
+      {"hash_join", "SELECT t1.b, t2.c FROM t1 INNER JOIN t2 ON t1.a = t2.a;"},
+      {"join_agg", "SELECT t1.b, COUNT(*) FROM t1 INNER JOIN t2 ON t1.a = t2.a GROUP BY t1.b;"},
+      {"sort", "SELECT a, b FROM t1 ORDER BY b, a DESC;"},
+      {"topn", "SELECT a, b FROM t1 ORDER BY b DESC, a LIMIT 10;"},
+  };
+  for (const auto &[name, sql] : queries) {
+    add("executor/" + name, [sql = sql](BenchState *state) { BenchQuery(state, sql); });
+  }
+  return benchmarks;
+}
+
+auto ToJson(const BenchConfig &config, const std::vector<BenchResult> &results) -> std::string {
+  std::string json = "{\n  \"context\": {\n";
+  json += "    \"executable\": \"bustub-micro-bench\",\n";
+  json += fmt::format("    \"num_cpus\": {},\n", std::thread::hardware_concurrency());
+  json += fmt::format("    \"duration_ms\": {},\n", config.duration_ms_);
+  json += fmt::format("    \"pool_size\": {},\n", config.pool_size_);
+  json += fmt::format("    \"num_keys\": {},\n", config.num_keys_);
+  json += fmt::format("    \"num_rows\": {}\n", config.num_rows_);
+  json += "  },\n  \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const auto &result = results[i];
+    json += i == 0 ? "\n" : ",\n";
+    json += fmt::format(
+        "    {{\n      \"name\": \"{0}\",\n      \"run_name\": \"{0}\",\n      \"run_type\": \"iteration\",\n"
+        "      \"repetitions\": 1,\n      \"threads\": 1,\n      \"iterations\": {1},\n"
+        "      \"real_time\": {2:.3f},\n      \"cpu_time\": {3:.3f},\n      \"time_unit\": \"ns\",\n"
+        "      \"items_per_second\": {4:.3f}",
+        result.name_, result.iterations_, result.real_time_ns_, result.cpu_time_ns_, result.items_per_second_);
+    for (const auto &[name, value] : result.counters_) {
+      json += fmt::format(",\n      \"{}\": {:.6f}", name, value);
+    }
+    json += "\n    }";
+  }
+  json += "\n  ]\n}\n";
+  return json;
+}
+
+}  // namespace
+
+// NOLINTNEXTLINE
+auto main(int argc, char **argv) -> int {
+  argparse::ArgumentParser program("bustub-micro-bench");
+  program.add_argument("--filter").help("regex, run only the benchmarks whose name it matches (default: all)");
+  program.add_argument("--list").help("list the benchmarks and exit").default_value(false).implicit_value(true);
+  program.add_argument("--out").help("write the results as JSON to this file");
+  program.add_argument("--duration").help("run each timed benchmark for n milliseconds");
+  program.add_argument("--threads").help("max number of worker threads, multiplied by 4 from 1");
+  program.add_argument("--pool-size").help("number of frames of the buffer pool");
+  program.add_argument("--keys").help("number of keys of the hash table and B+ tree benchmarks");
+  program.add_argument("--rows").help("number of rows of each table of the executor benchmarks");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+  BenchConfig config;
+  if (program.present("--duration")) {
+    config.duration_ms_ = std::stoull(program.get("--duration"));
+  }
+  if (program.present("--threads")) {
+    config.max_threads_ = std::stoul(program.get("--threads"));
+  }
+  if (program.present("--pool-size")) {
+    config.pool_size_ = std::stoul(program.get("--pool-size"));
+  }
+  if (program.present("--keys")) {
+    config.num_keys_ = std::stoul(program.get("--keys"));
+  }
+  if (program.present("--rows")) {
+    config.num_rows_ = std::stoul(program.get("--rows"));
+  }
+  std::regex filter(program.present("--filter") ? program.get("--filter") : ".*");
+
+  std::vector<BenchResult> results;
+  for (const auto &benchmark : RegisterBenchmarks(config)) {
+    if (!std::regex_search(benchmark.name_, filter)) {
+      continue;
+    }
+    if (program.get<bool>("--list")) {
+      fmt::print("{}\n", benchmark.name_);
+      continue;
+    }
+    BenchState state(benchmark.name_, config);
+    benchmark.run_(&state);
+    const auto &result = state.Result();
+    std::string counters;
+    for (const auto &[name, value] : result.counters_) {
+      counters += fmt::format(" {}={:.4f}", name, value);
+    }
+    fmt::print("{:<44} {:>12.1f} ns {:>12.1f} ns_cpu {:>10} iters {:>14.0f} items/s{}\n", result.name_,
+               result.real_time_ns_, result.cpu_time_ns_, result.iterations_, result.items_per_second_, counters);
+    results.emplace_back(result);
+  }
+
+  if (program.present("--out")) {
+    std::ofstream out(program.get("--out"));
+    out << ToJson(config, results);
+    if (!out) {
+      std::cerr << "micro_bench: cannot write " << program.get("--out") << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,157 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_table_bench.cpp
+//
+// Identification: tools/page_table_bench/page_table_bench.cpp
+//
+// Multi-threaded microbenchmark of the buffer pool page table, comparing the ExtendibleHashTable with the
+// StripedHashTable on a fixed set of pool_size page ids. Most operations are lookups, the rest replace one page id by
+// another the way an eviction does.
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "argparse/argparse.hpp"
+#include "common/config.h"
+#include "container/hash/extendible_hash_table.h"
+#include "container/hash/striped_hash_table.h"
+#include "fmt/core.h"
+
+namespace {
+
+using bustub::frame_id_t;
+using bustub::page_id_t;
+
+struct BenchConfig {
+  size_t pool_size_{4096};
+  size_t max_threads_{64};
+  uint64_t duration_ms_{1000};
+  /** Out of 100 operations, how many are an eviction (Remove + Insert) instead of a Find */
+  size_t update_percent_{5};
+};
+
+/**
+ * Run `num_threads` workers on the table, return the number of operations per second. Thread t only evicts the
+ * frames t, t + num_threads, ... so that every frame maps to exactly one page id at any time.
+ */
+auto RunWorkers(bustub::HashTable<page_id_t, frame_id_t> *table, std::vector<std::atomic<page_id_t>> *frame_pages,
+                size_t num_threads, const BenchConfig &config) -> double {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> total_ops{0};
+  std::atomic<page_id_t> next_page_id{static_cast<page_id_t>(config.pool_size_)};
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t thread_id = 0; thread_id < num_threads; thread_id++) {
+    threads.emplace_back([&, thread_id] {
+      std::mt19937_64 gen(thread_id);
+      std::uniform_int_distribution<size_t> frame_dist(0, config.pool_size_ - 1);
+      std::uniform_int_distribution<size_t> op_dist(0, 99);
+      const size_t owned_frames = (config.pool_size_ - thread_id + num_threads - 1) / num_threads;
+      uint64_t ops = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        if (op_dist(gen) < config.update_percent_ && owned_frames > 0) {
+          auto frame_id = static_cast<frame_id_t>(thread_id + (frame_dist(gen) % owned_frames) * num_threads);
+          auto new_page_id = next_page_id.fetch_add(1, std::memory_order_relaxed);
+          table->Remove((*frame_pages)[frame_id].load(std::memory_order_relaxed));
+          table->Insert(new_page_id, frame_id);
+          // 只有本线程写这个 frame，其它线程读到旧 page id 时 Find 失败即可
+          (*frame_pages)[frame_id].store(new_page_id, std::memory_order_relaxed);
+        } else {
+          auto frame_id = frame_dist(gen);
+          auto page_id = (*frame_pages)[frame_id].load(std::memory_order_relaxed);
+          frame_id_t found;
+          table->Find(page_id, found);
+        }
+        ops++;
+      }
+      total_ops += ops;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(config.duration_ms_));
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return static_cast<double>(total_ops) * 1000.0 / static_cast<double>(config.duration_ms_);
+}
+
+void RunBench(const std::string &name, bustub::HashTable<page_id_t, frame_id_t> *table, const BenchConfig &config) {
+  std::vector<std::atomic<page_id_t>> frame_pages(config.pool_size_);
+  for (size_t i = 0; i < config.pool_size_; i++) {
+    frame_pages[i] = static_cast<page_id_t>(i);
+    table->Insert(static_cast<page_id_t>(i), static_cast<frame_id_t>(i));
+  }
+  double base = 0;
+  for (size_t num_threads = 1; num_threads <= config.max_threads_; num_threads <<= 1) {
+    auto throughput = RunWorkers(table, &frame_pages, num_threads, config);
+    if (num_threads == 1) {
+      base = throughput;
+    }
+    fmt::print("table={:<10} threads={:<3} ops/s={:<12.0f} speedup={:.2f}x\n", name, num_threads, throughput,
+               base > 0 ? throughput / base : 0.0);
+  }
+}
+
+}  // namespace
+
+// NOLINTNEXTLINE
+auto main(int argc, char **argv) -> int {
+  argparse::ArgumentParser program("bustub-page-table-bench");
+  program.add_argument("--pool-size").help("number of frames, i.e. number of entries in the table");
+  program.add_argument("--threads").help("max number of worker threads, doubled from 1");
+  program.add_argument("--duration").help("run each thread count for n milliseconds");
+  program.add_argument("--update-percent").help("percentage of operations that evict a page (Remove + Insert)");
+  program.add_argument("--stripes").help("number of stripes of the striped table");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+  BenchConfig config;
+  size_t num_stripes = bustub::StripedHashTable<page_id_t, frame_id_t>::DEFAULT_NUM_STRIPES;
+  if (program.present("--pool-size")) {
+    config.pool_size_ = std::stoul(program.get("--pool-size"));
+  }
+  if (program.present("--threads")) {
+    config.max_threads_ = std::stoul(program.get("--threads"));
+  }
+  if (program.present("--duration")) {
+    config.duration_ms_ = std::stoull(program.get("--duration"));
+  }
+  if (program.present("--update-percent")) {
+    config.update_percent_ = std::stoul(program.get("--update-percent"));
+  }
+  if (program.present("--stripes")) {
+    num_stripes = std::stoul(program.get("--stripes"));
+  }
+  if (config.pool_size_ == 0) {
+    std::cerr << "page_table_bench: pool size must be positive" << std::endl;
+    return 1;
+  }
+
+  fmt::print("pool_size={} update_percent={} stripes={} duration={}ms\n", config.pool_size_, config.update_percent_,
+             num_stripes, config.duration_ms_);
+  {
+    auto table = std::make_unique<bustub::ExtendibleHashTable<page_id_t, frame_id_t>>(4);
+    RunBench("extendible", table.get(), config);
+  }
+  {
+    auto table = std::make_unique<bustub::StripedHashTable<page_id_t, frame_id_t>>(config.pool_size_, num_stripes);
+    RunBench("striped", table.get(), config);
+  }
+  return 0;
+}
@@ -0,0 +1,256 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// replacer_bench.cpp
+//
+// Identification: tools/replacer_bench/replacer_bench.cpp
+//
+// Trace-replay benchmark for the buffer pool replacement policies. Every access of the trace is replayed against a
+// simulated pool of `--pool-size` frames the same way BufferPoolManagerInstance drives its replacer, and the hit
+// ratio and the replacer cost per access are reported for each policy.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "argparse/argparse.hpp"
+#include "buffer/replacer.h"
+#include "fmt/core.h"
+
+namespace {
+
+using bustub::AccessType;
+using bustub::frame_id_t;
+using bustub::page_id_t;
+
+struct Access {
+  page_id_t page_id_;
+  AccessType access_type_;
+};
+
+/** Load a trace file with one `page_id [L|S|I]` per line, the optional letter being the access hint. */
+auto LoadTrace(const std::string &path) -> std::vector<Access> {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error(fmt::format("replacer_bench: cannot open trace file {}", path));
+  }
+  std::vector<Access> trace;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    page_id_t page_id;
+    if (!(fields >> page_id)) {
+      continue;
+    }
+    char hint = 'U';
+    fields >> hint;
+    auto access_type = hint == 'L' ? AccessType::Lookup
+                       : hint == 'S' ? AccessType::Scan
+                       : hint == 'I' ? AccessType::Index
+                                     : AccessType::Unknown;
+    trace.push_back({page_id, access_type});
+  }
+  return trace;
+}
+
+/** Zipfian page ids over [0, num_pages), sampled through the inverse of the precomputed CDF. */
+class ZipfGenerator {
+ public:
+  ZipfGenerator(size_t num_pages, double theta, uint64_t seed) : cdf_(num_pages), gen_(seed) {
+    double sum = 0;
+    for (size_t i = 0; i < num_pages; i++) {
+      sum += 1.0 / std::pow(static_cast<double>(i + 1), theta);
+      cdf_[i] = sum;
+    }
+    for (auto &c : cdf_) {
+      c /= sum;
+    }
+  }
+
+  auto Next() -> page_id_t {
+    auto u = dist_(gen_);
+    auto iter = std::lower_bound(cdf_.begin(), cdf_.end(), u);
+    return static_cast<page_id_t>(iter == cdf_.end() ? cdf_.size() - 1 : iter - cdf_.begin());
+  }
+
+ private:
+  std::vector<double> cdf_;
+  std::mt19937_64 gen_;
+  std::uniform_real_distribution<double> dist_{0.0, 1.0};
+};
+
+/**
+ * Generate a synthetic trace.
+ * - zipf:  skewed point lookups over num_pages pages
+ * - loop:  repeated sequential sweeps over num_pages pages, the worst case for LRU when num_pages > pool size
+ * - mixed: zipf lookups on a hot set of num_pages pages, interrupted by full scans over scan_pages cold pages
+ */
+auto GenerateTrace(const std::string &workload, size_t num_ops, size_t num_pages, size_t scan_pages, double theta)
+    -> std::vector<Access> {
+  std::vector<Access> trace;
+  trace.reserve(num_ops);
+  if (workload == "zipf") {
+    ZipfGenerator zipf(num_pages, theta, 15445);
+    while (trace.size() < num_ops) {
+      trace.push_back({zipf.Next(), AccessType::Lookup});
+    }
+  } else if (workload == "loop") {
+    while (trace.size() < num_ops) {
+      trace.push_back({static_cast<page_id_t>(trace.size() % num_pages), AccessType::Scan});
+    }
+  } else if (workload == "mixed") {
+    ZipfGenerator zipf(num_pages, theta, 15445);
+    // 每 4 * scan_pages 次 lookup 插入一次全表扫描，扫描的 page 与 hot set 不相交
+    const size_t lookups_per_scan = 4 * scan_pages;
+    while (trace.size() < num_ops) {
+      for (size_t i = 0; i < lookups_per_scan && trace.size() < num_ops; i++) {
+        trace.push_back({zipf.Next(), AccessType::Lookup});
+      }
+      for (size_t i = 0; i < scan_pages && trace.size() < num_ops; i++) {
+        trace.push_back({static_cast<page_id_t>(num_pages + i), AccessType::Scan});
+      }
+    }
+  } else {
+    throw std::runtime_error(fmt::format("replacer_bench: unknown workload {}", workload));
+  }
+  return trace;
+}
+
+struct ReplayResult {
+  uint64_t hits_{0};
+  uint64_t misses_{0};
+  double ns_per_op_{0};
+};
+
+/**
+ * Replay the trace, pinning and unpinning every accessed page like a FetchPage/UnpinPage pair would.
+ * Without use_hints every access is recorded as AccessType::Unknown.
+ */
+auto Replay(bustub::ReplacerType type, const std::vector<Access> &trace, size_t pool_size, size_t k, bool use_hints)
+    -> ReplayResult {
+  std::unique_ptr<bustub::Replacer> replacer(bustub::CreateReplacer(type, pool_size, k));
+  std::unordered_map<page_id_t, frame_id_t> page_table;
+  std::vector<page_id_t> frames(pool_size, bustub::INVALID_PAGE_ID);
+  size_t next_free_frame = 0;
+  ReplayResult result;
+
+  auto start = std::chrono::steady_clock::now();
+  for (const auto &[page_id, access_type] : trace) {
+    frame_id_t frame_id;
+    auto iter = page_table.find(page_id);
+    if (iter != page_table.end()) {
+      frame_id = iter->second;
+      result.hits_++;
+    } else {
+      result.misses_++;
+      if (next_free_frame < pool_size) {
+        frame_id = static_cast<frame_id_t>(next_free_frame++);
+      } else {
+        if (!replacer->Evict(&frame_id)) {
+          throw std::runtime_error("replacer_bench: replacer has no evictable frame");
+        }
+        page_table.erase(frames[frame_id]);
+      }
+      frames[frame_id] = page_id;
+      page_table[page_id] = frame_id;
+      replacer->BindPage(frame_id, page_id);
+    }
+    replacer->RecordAccess(frame_id, use_hints ? access_type : AccessType::Unknown);
+    replacer->SetEvictable(frame_id, false);
+    replacer->SetEvictable(frame_id, true);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+  result.ns_per_op_ = trace.empty() ? 0 : static_cast<double>(elapsed.count()) / static_cast<double>(trace.size());
+  return result;
+}
+
+}  // namespace
+
+// NOLINTNEXTLINE
+auto main(int argc, char **argv) -> int {
+  argparse::ArgumentParser program("bustub-replacer-bench");
+  program.add_argument("--trace").help("replay a trace file with one page id per line instead of a generated one");
+  program.add_argument("--workload").help("generated workload: zipf, loop or mixed (default: mixed)");
+  program.add_argument("--pool-size").help("number of frames in the simulated pool");
+  program.add_argument("--pages").help("number of pages of the zipf / loop working set");
+  program.add_argument("--scan-pages").help("number of pages touched by each scan of the mixed workload");
+  program.add_argument("--ops").help("number of accesses of a generated trace");
+  program.add_argument("--theta").help("skew of the zipf distribution");
+  program.add_argument("--k").help("lookback constant of LRU-K");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+  size_t pool_size = 1024;
+  size_t num_pages = 4096;
+  size_t scan_pages = 2048;
+  size_t num_ops = 2000000;
+  size_t k = bustub::LRUK_REPLACER_K;
+  double theta = 0.99;
+  std::string workload = "mixed";
+  if (program.present("--pool-size")) {
+    pool_size = std::stoul(program.get("--pool-size"));
+  }
+  if (program.present("--pages")) {
+    num_pages = std::stoul(program.get("--pages"));
+  }
+  if (program.present("--scan-pages")) {
+    scan_pages = std::stoul(program.get("--scan-pages"));
+  }
+  if (program.present("--ops")) {
+    num_ops = std::stoul(program.get("--ops"));
+  }
+  if (program.present("--theta")) {
+    theta = std::stod(program.get("--theta"));
+  }
+  if (program.present("--k")) {
+    k = std::stoul(program.get("--k"));
+  }
+  if (program.present("--workload")) {
+    workload = program.get("--workload");
+  }
+
+  std::vector<Access> trace;
+  if (program.present("--trace")) {
+    workload = program.get("--trace");
+    trace = LoadTrace(workload);
+  } else {
+    trace = GenerateTrace(workload, num_ops, num_pages, scan_pages, theta);
+  }
+  fmt::print("trace={} accesses={} pool_size={} k={}\n", workload, trace.size(), pool_size, k);
+
+  const std::vector<std::pair<std::string, bustub::ReplacerType>> policies = {
+      {"lru-k", bustub::ReplacerType::LRUK},
+      {"clock", bustub::ReplacerType::Clock},
+      {"2q", bustub::ReplacerType::TwoQueue},
+      {"arc", bustub::ReplacerType::ARC},
+  };
+  for (const auto &[name, type] : policies) {
+    for (bool use_hints : {false, true}) {
+      auto result = Replay(type, trace, pool_size, k, use_hints);
+      auto total = result.hits_ + result.misses_;
+      fmt::print("policy={:<6} hints={:<3} hits={:<10} misses={:<10} hit_ratio={:.4f} ns/op={:.1f}\n", name,
+                 use_hints ? "on" : "off", result.hits_, result.misses_,
+                 total > 0 ? static_cast<double>(result.hits_) / static_cast<double>(total) : 0.0, result.ns_per_op_);
+    }
+  }
+  return 0;
+}
@@ -1,2 +1,2 @@
-// #define TERRIER_BENCH_ENABLE_UPDATE
+#define TERRIER_BENCH_ENABLE_UPDATE
 // #define TERRIER_BENCH_ENABLE_INDEX